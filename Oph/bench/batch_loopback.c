@@ -0,0 +1,404 @@
+/* Telemetry polling over loopback, one channel at a time against batches.
+**
+** Runs a telemetry server in this process on synthetic channels, laid out
+** like the real ones (subsystems whose channels share a locked source), and
+** polls every channel over 127.0.0.1 the way the ground does: first one
+** request and one reply per channel, then BATCH: requests of as many names as
+** fit in the server's receive buffer, then one GROUP: request for all of
+** them. For each it prints the polling cycles per second, the datagrams and
+** source copies (lock acquisitions) per cycle and the time per cycle. Fails
+** if a batch or group reply does not hold the values the single requests
+** gave.
+**
+** Usage: batch_loopback [-n channels] [-t seconds] [-p port]
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "telemetry_registry.h"
+
+// the server's receive buffer, MAXLEN in server.h
+#define REQUEST_LEN 1024
+// subsystems, like motor, pointing, power, system and housekeeping
+#define NUM_SOURCES 8
+#define RECV_TIMEOUT_MS 1000
+
+/* State of one synthetic subsystem, copied under its lock */
+struct subsystem {
+    pthread_mutex_t lock;
+    int counter;
+    float temperature;
+    double position;
+    char status[32];
+};
+
+static struct subsystem subsystems[NUM_SOURCES];
+static struct subsystem copies[NUM_SOURCES];
+static struct tel_source sources[NUM_SOURCES];
+static struct tel_channel * channels;
+static char ** names;
+static int num_channels;
+static long source_copies;
+static int stop_server;
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+}
+
+/* One refresh function per source, so each knows which to copy */
+#define REFRESH(n) static void refresh##n(void) { refreshSource(n); }
+
+static void refreshSource(int s) {
+    pthread_mutex_lock(&subsystems[s].lock);
+    copies[s] = subsystems[s];
+    pthread_mutex_unlock(&subsystems[s].lock);
+    __atomic_fetch_add(&source_copies, 1, __ATOMIC_RELAXED);
+}
+
+REFRESH(0) REFRESH(1) REFRESH(2) REFRESH(3)
+REFRESH(4) REFRESH(5) REFRESH(6) REFRESH(7)
+
+static void (*refreshers[NUM_SOURCES])(void) = {
+    refresh0, refresh1, refresh2, refresh3,
+    refresh4, refresh5, refresh6, refresh7,
+};
+
+/* Channels of a source, in turn: counter, temperature, position, status */
+static void getChannel(int index, struct tel_value * out) {
+    const struct subsystem * copy = &copies[index % NUM_SOURCES];
+
+    switch (index/NUM_SOURCES % 4) {
+    case 0:
+        tel_set_int(out, copy->counter + index);
+        break;
+    case 1:
+        tel_set_float(out, copy->temperature + index);
+        break;
+    case 2:
+        tel_set_double(out, copy->position + index);
+        break;
+    default:
+        tel_set_string(out, copy->status);
+        break;
+    }
+}
+
+/* The text the server sends for a single request, as send_value does */
+static void formatValue(const struct tel_value * value, char * text, size_t len) {
+    switch (value->type) {
+    case TEL_INT:
+        snprintf(text, len, "%d", value->i);
+        break;
+    case TEL_ULONG:
+        snprintf(text, len, "%lu", value->ul);
+        break;
+    case TEL_FLOAT:
+        snprintf(text, len, "%f", value->f);
+        break;
+    case TEL_DOUBLE:
+        snprintf(text, len, "%lf", value->d);
+        break;
+    case TEL_STRING:
+        snprintf(text, len, "%s", value->s);
+        break;
+    default:
+        snprintf(text, len, "(none)");
+        break;
+    }
+}
+
+/* The server loop of server.c: single requests get text, batches binary */
+static void * serveRequests(void * arg) {
+    int sockfd = *(int *) arg;
+    char request[REQUEST_LEN];
+    uint8_t reply[TEL_BATCH_MAX];
+    struct sockaddr_in client;
+
+    while (!__atomic_load_n(&stop_server, __ATOMIC_ACQUIRE)) {
+        socklen_t client_len = sizeof(client);
+        int n = recvfrom(sockfd, request, sizeof(request) - 1, 0,
+                         (struct sockaddr *) &client, &client_len);
+        int len;
+
+        if (n <= 0) {
+            continue;
+        }
+        request[n] = '\0';
+        if (tel_is_batch(request)) {
+            len = tel_batch(request, reply, sizeof(reply));
+        } else {
+            const struct tel_channel * channel = tel_lookup(request);
+            struct tel_value value;
+
+            if (channel == NULL) {
+                continue;
+            }
+            tel_snapshot();
+            tel_read(channel, &value);
+            formatValue(&value, (char *) reply, sizeof(reply));
+            len = strlen((char *) reply);
+        }
+        if (len > 0) {
+            sendto(sockfd, reply, len, 0, (struct sockaddr *) &client,
+                   client_len);
+        }
+    }
+    return NULL;
+}
+
+static int openSocket(int port, int bind_it, struct sockaddr_in * addr) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct timeval tv = {RECV_TIMEOUT_MS/1000, (RECV_TIMEOUT_MS % 1000)*1000};
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (sockfd < 0) {
+        return -1;
+    }
+    if (bind_it && bind(sockfd, (struct sockaddr *) addr, sizeof(*addr)) < 0) {
+        close(sockfd);
+        return -1;
+    }
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return sockfd;
+}
+
+static int roundTrip(int sockfd, const struct sockaddr_in * server,
+                     const char * request, uint8_t * reply, int size) {
+    sendto(sockfd, request, strlen(request), 0,
+           (const struct sockaddr *) server, sizeof(*server));
+    return recv(sockfd, reply, size, 0);
+}
+
+/* Every channel, one request each. Keeps the replies as the reference. */
+static int pollSingle(int sockfd, const struct sockaddr_in * server,
+                      char ** texts) {
+    uint8_t reply[TEL_BATCH_MAX];
+
+    for (int i = 0; i < num_channels; i++) {
+        int n = roundTrip(sockfd, server, names[i], reply, sizeof(reply) - 1);
+
+        if (n < 0) {
+            return -1;
+        }
+        if (texts != NULL) {
+            reply[n] = '\0';
+            snprintf(texts[i], TEL_STRING_LEN, "%.*s", TEL_STRING_LEN - 1,
+                     (char *) reply);
+        }
+    }
+    return num_channels;
+}
+
+/* Checks a batch reply's values against the single request replies */
+static int checkReply(const uint8_t * reply, int len, int first, int count,
+                      char ** texts) {
+    static struct tel_value values[TEL_MAX_BATCH_CHANNELS];
+    struct tel_batch_header header;
+    char text[TEL_STRING_LEN];
+    int n = tel_unpack(reply, len, &header, values, TEL_MAX_BATCH_CHANNELS);
+
+    if (n != count || header.num_requested != count) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        formatValue(&values[i], text, sizeof(text));
+        if (strcmp(text, texts[first + i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Every channel in as few BATCH: requests as fit the receive buffer */
+static int pollBatch(int sockfd, const struct sockaddr_in * server,
+                     char ** texts) {
+    char request[REQUEST_LEN];
+    uint8_t reply[TEL_BATCH_MAX];
+    int datagrams = 0;
+    int first = 0;
+
+    while (first < num_channels) {
+        int len = snprintf(request, sizeof(request), "%s", TEL_BATCH_PREFIX);
+        int count = 0;
+        int n;
+
+        while (first + count < num_channels &&
+               len + strlen(names[first + count]) + 1 < sizeof(request)) {
+            len += sprintf(request + len, "%s%s", count ? "," : "",
+                           names[first + count]);
+            count++;
+        }
+        n = roundTrip(sockfd, server, request, reply, sizeof(reply));
+        if (n < 0 || (texts != NULL &&
+                      checkReply(reply, n, first, count, texts) < 0)) {
+            return -1;
+        }
+        first += count;
+        datagrams++;
+    }
+    return datagrams;
+}
+
+static int pollGroup(int sockfd, const struct sockaddr_in * server,
+                     char ** texts) {
+    uint8_t reply[TEL_BATCH_MAX];
+    int n = roundTrip(sockfd, server, TEL_GROUP_PREFIX "all", reply,
+                      sizeof(reply));
+
+    if (n < 0 || (texts != NULL &&
+                  checkReply(reply, n, 0, num_channels, texts) < 0)) {
+        return -1;
+    }
+    return 1;
+}
+
+/* Function to poll every channel over and over for a while.
+** Input: How to poll, and for how long.
+** Output: Prints the cycles per second, datagrams and source copies per
+** cycle. Returns -1 if a poll failed.
+*/
+static int benchPoll(const char * name,
+                     int (*poll)(int, const struct sockaddr_in *, char **),
+                     int sockfd, const struct sockaddr_in * server,
+                     double seconds) {
+    double start = nowMs();
+    double elapsed;
+    long cycles = 0;
+    long requests = 0;
+    long copies_before = __atomic_load_n(&source_copies, __ATOMIC_RELAXED);
+
+    do {
+        int n = poll(sockfd, server, NULL);
+
+        if (n < 0) {
+            printf("%-8s poll failed\n", name);
+            return -1;
+        }
+        requests += n;
+        cycles++;
+        elapsed = nowMs() - start;
+    } while (elapsed < seconds*1e3);
+
+    printf("%-8s %8.1f cycles/s  %5.0f datagrams/cycle  %5.1f source copies/cycle  %8.1f us/cycle\n",
+           name, cycles/(elapsed*1e-3), 2.0*requests/cycles,
+           (double) (__atomic_load_n(&source_copies, __ATOMIC_RELAXED) -
+                     copies_before)/cycles,
+           elapsed*1e3/cycles);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    int port = 8402;
+    double seconds = 2;
+    int server_fd, client_fd;
+    struct sockaddr_in server_addr, client_addr;
+    pthread_t server;
+    char * all;
+    char ** texts;
+    size_t all_len = 1;
+    int failed = 0;
+    int opt;
+
+    num_channels = 128;
+    while ((opt = getopt(argc, argv, "n:t:p:")) != -1) {
+        switch (opt) {
+        case 'n':
+            num_channels = atoi(optarg);
+            break;
+        case 't':
+            seconds = atof(optarg);
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n channels] [-t seconds] [-p port]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (num_channels < 1) {
+        num_channels = 1;
+    }
+    if (num_channels > TEL_MAX_BATCH_CHANNELS) {
+        num_channels = TEL_MAX_BATCH_CHANNELS;
+    }
+
+    channels = calloc(num_channels, sizeof(*channels));
+    names = calloc(num_channels, sizeof(*names));
+    texts = calloc(num_channels, sizeof(*texts));
+    for (int s = 0; s < NUM_SOURCES; s++) {
+        pthread_mutex_init(&subsystems[s].lock, NULL);
+        subsystems[s].counter = 1000*s;
+        subsystems[s].temperature = 20.5f + s;
+        subsystems[s].position = 0.125*s;
+        snprintf(subsystems[s].status, sizeof(subsystems[s].status),
+                 "running:yes,subsystem:%d", s);
+        sources[s].refresh = refreshers[s];
+    }
+    for (int i = 0; i < num_channels; i++) {
+        names[i] = malloc(32);
+        texts[i] = malloc(TEL_STRING_LEN);
+        snprintf(names[i], 32, "sub%d_channel_%d", i % NUM_SOURCES, i);
+        channels[i].name = names[i];
+        channels[i].get = getChannel;
+        channels[i].index = i;
+        channels[i].source = &sources[i % NUM_SOURCES];
+        all_len += strlen(names[i]) + 1;
+    }
+    tel_register(channels, num_channels);
+    all = calloc(all_len, 1);
+    for (int i = 0; i < num_channels; i++) {
+        if (i > 0) {
+            strcat(all, ",");
+        }
+        strcat(all, names[i]);
+    }
+    tel_add_group("all", all);
+
+    server_fd = openSocket(port, 1, &server_addr);
+    client_fd = openSocket(0, 0, &client_addr);
+    if (server_fd < 0 || client_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    pthread_create(&server, NULL, serveRequests, &server_fd);
+
+    printf("%d channels in %d sources over 127.0.0.1:%d\n", num_channels,
+           NUM_SOURCES, port);
+    // the single replies are the reference for the batches
+    if (pollSingle(client_fd, &server_addr, texts) < 0 ||
+        pollBatch(client_fd, &server_addr, texts) < 0 ||
+        pollGroup(client_fd, &server_addr, texts) < 0) {
+        printf("FAILED: a batch reply does not match the single replies\n");
+        failed = 1;
+    }
+
+    if (!failed) {
+        if (benchPoll("single", pollSingle, client_fd, &server_addr, seconds) < 0 ||
+            benchPoll("batch", pollBatch, client_fd, &server_addr, seconds) < 0 ||
+            benchPoll("group", pollGroup, client_fd, &server_addr, seconds) < 0) {
+            failed = 1;
+        }
+    }
+
+    __atomic_store_n(&stop_server, 1, __ATOMIC_RELEASE);
+    pthread_join(server, NULL);
+    close(server_fd);
+    close(client_fd);
+    return failed;
+}
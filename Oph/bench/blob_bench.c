@@ -0,0 +1,604 @@
+/* Benchmark of the star camera blob finding filter, peak search, blob
+** merging and blob sorting.
+**
+** Runs the scalar single threaded box filter, peak search and O(n^2) blob
+** merge findBlobs used before blob_finder.c next to the tiled filter and the
+** spatial hash merge, at 1 thread and at every thread count up to the given
+** one, on stored frames or on synthetic frames: a sparse star field, a dense
+** 10k star field and a saturated frame with glare. The filtered images, peak
+** lists and blob lists of the two must match exactly.
+**
+** Then times the recursive merge sort findBlobs used on 100, 1000 and 10000
+** blobs against sorting only the brightest BLOB_SORT_MAX, and against sorting
+** all of them the same way. The sorted blobs must come out in the same order.
+**
+** Frames are the 8 bit mono JPEGs the camera saves (decoded with libjpeg,
+** since loadDummyPicture needs an open uEye camera) or raw 1936x1216 dumps.
+**
+** Usage: blob_bench [-t max_threads] [-n runs] [frame.jpg|frame.raw ...]
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <jpeglib.h>
+
+#include "blob_finder.h"
+
+#define WIDTH 1936
+#define HEIGHT 1216
+#define R_SMOOTH 2
+#define R_HIGH_PASS 10
+#define BORDER 1
+#define N_SIGMA 2.0f
+#define UNIQUE_STAR_SPACING 15
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec/1e6;
+}
+
+/* The box filter as camera.c had it, kept as the reference. */
+static void legacyBoxcar(const char * ib, const unsigned char * mask, int i0,
+                         int j0, int i1, int j1, int r_f,
+                         double * filtered_image) {
+    static char * nc = NULL;
+    static uint64_t * ibc1 = NULL;
+
+    if (nc == NULL) {
+        nc = calloc(WIDTH*HEIGHT, 1);
+        ibc1 = calloc(WIDTH*HEIGHT, sizeof(uint64_t));
+    }
+
+    int b = r_f;
+    int64_t isx;
+    int s, n;
+    double ds, dn;
+    double last_ds = 0;
+
+    for (int j = j0; j < j1; j++) {
+        n = 0;
+        isx = 0;
+        for (int i = i0; i < i0 + 2*r_f + 1; i++) {
+            n += mask[i + j*WIDTH];
+            isx += ib[i + j*WIDTH]*mask[i + j*WIDTH];
+        }
+
+        int idx = WIDTH*j + i0 + r_f;
+
+        for (int i = r_f + i0; i < i1 - r_f - 1; i++) {
+            ibc1[idx] = isx;
+            nc[idx] = n;
+            isx = isx + mask[idx + r_f + 1]*ib[idx + r_f + 1] -
+                  mask[idx - r_f]*ib[idx - r_f];
+            n = n + mask[idx + r_f + 1] - mask[idx - r_f];
+            idx++;
+        }
+
+        ibc1[idx] = isx;
+        nc[idx] = n;
+    }
+
+    for (int j = j0+b; j < j1-b; j++) {
+        for (int i = i0+b; i < i1-b; i++) {
+            n = s = 0;
+            for (int jp =- r_f; jp <= r_f; jp++) {
+                int idx = i + (j+jp)*WIDTH;
+                s += ibc1[idx];
+                n += nc[idx];
+            }
+            ds = s;
+            dn = n;
+            if (dn > 0.0) {
+                ds /= dn;
+                last_ds = ds;
+            } else {
+                ds = last_ds;
+            }
+            filtered_image[i + j*WIDTH] = ds;
+        }
+    }
+}
+
+/* The peak search as findBlobs had it, kept as the reference. */
+static int legacyPeaks(const double * ic, int w, int i0, int j0, int i1,
+                       int j1, double threshold, int * peaks) {
+    int num_peaks = 0;
+    double ic0;
+    for (int j = j0; j < j1; j++) {
+        for (int i = i0; i < i1; i++) {
+            if ((double) ic[i + j*w] > threshold) {
+                ic0 = ic[i + j*w];
+                if (((ic0 >= ic[i-1 + (j-1)*w]) &&
+                     (ic0 >= ic[i   + (j-1)*w]) &&
+                     (ic0 >= ic[i+1 + (j-1)*w]) &&
+                     (ic0 >= ic[i-1 + (j  )*w]) &&
+                     (ic0 >  ic[i+1 + (j  )*w]) &&
+                     (ic0 >  ic[i-1 + (j+1)*w]) &&
+                     (ic0 >  ic[i   + (j+1)*w]) &&
+                     (ic0 >  ic[i+1 + (j+1)*w])) ||
+                     (ic0 > 254)) {
+                    peaks[num_peaks++] = i + j*w;
+                }
+            }
+        }
+    }
+    return num_peaks;
+}
+
+/* The blob merge as findBlobs had it, kept as the reference. Every peak is
+** checked against every blob found so far.
+*/
+static int legacyDedup(const double * ic, int w, const int * peaks,
+                       int num_peaks, int unique_star_spacing,
+                       struct blob ** blobs) {
+    static double * star_x = NULL, * star_y = NULL, * star_mags = NULL;
+    static struct blob * out = NULL;
+    int num_blobs_alloc = 0;
+    int blob_count = 0;
+
+    // findBlobs started from its global arrays each frame, grown 500 at a time
+    free(star_x);
+    free(star_y);
+    free(star_mags);
+    star_x = star_y = star_mags = NULL;
+
+    for (int p = 0; p < num_peaks; p++) {
+        int i = peaks[p] % w;
+        int j = peaks[p] / w;
+        int unique = 1;
+
+        if (blob_count >= num_blobs_alloc) {
+            num_blobs_alloc += 500;
+            star_x = realloc(star_x, sizeof(double)*num_blobs_alloc);
+            star_y = realloc(star_y, sizeof(double)*num_blobs_alloc);
+            star_mags = realloc(star_mags, sizeof(double)*num_blobs_alloc);
+        }
+
+        star_x[blob_count] = i;
+        star_y[blob_count] = j;
+        star_mags[blob_count] = 100*ic[i + j*w];
+        if (star_mags[blob_count] < 0) {
+            star_mags[blob_count] = UINT32_MAX;
+        }
+
+        int spacing = unique_star_spacing;
+        if (star_mags[blob_count] > 25400) {
+            spacing = spacing * 4;
+        }
+        for (int ib = 0; ib < blob_count; ib++) {
+            if ((abs((int) (star_x[blob_count] - star_x[ib])) < spacing) &&
+                (abs((int) (star_y[blob_count] - star_y[ib])) < spacing)) {
+                unique = 0;
+                if (star_mags[blob_count] > star_mags[ib]) {
+                    star_x[ib] = star_x[blob_count];
+                    star_y[ib] = star_y[blob_count];
+                    star_mags[ib] = star_mags[blob_count];
+                }
+            }
+        }
+        if (unique) {
+            blob_count++;
+        }
+    }
+
+    out = realloc(out, (blob_count + 1)*sizeof(struct blob));
+    for (int ib = 0; ib < blob_count; ib++) {
+        out[ib].x = (int) star_x[ib];
+        out[ib].y = (int) star_y[ib];
+        out[ib].mag = star_mags[ib];
+    }
+    *blobs = out;
+    return blob_count;
+}
+
+/* The merge sort as findBlobs had it, kept as the reference. */
+static void legacyMerge(double * A, int p, int q, int r, double * X,
+                        double * Y) {
+    int n1 = q - p + 1, n2 = r - q;
+    int lin = n1 + 1, rin = n2 + 1;
+    double LM[lin], LX[lin], LY[lin], RM[rin], RX[rin], RY[rin];
+    int i, j, k;
+    LM[n1] = 0;
+    RM[n2] = 0;
+
+    for (i = 0; i < n1; i++) {
+        LM[i] = A[p+i];
+        LX[i] = X[p+i];
+        LY[i] = Y[p+i];
+    }
+
+    for (j = 0; j < n2; j++) {
+        RM[j] = A[q+j+1];
+        RX[j] = X[q+j+1];
+        RY[j] = Y[q+j+1];
+    }
+
+    i = 0; j = 0;
+    for (k = p; k <= r; k++) {
+        if (LM[i] >= RM[j] ){
+            A[k] = LM[i];
+            X[k] = LX[i];
+            Y[k] = LY[i];
+            i++;
+        } else {
+            A[k] = RM[j];
+            X[k] = RX[j];
+            Y[k] = RY[j];
+            j++;
+        }
+    }
+}
+
+static void legacyPart(double * A, int p, int r, double * X, double * Y) {
+    if (p < r) {
+        int q = (p + r)/2;
+        legacyPart(A, p, q, X, Y);
+        legacyPart(A, q + 1, r, X, Y);
+        legacyMerge(A, p, q, r, X, Y);
+    }
+}
+
+/* Dynamic hot pixel mask as makeMask makes it, with the frame border and a
+** block of pixels masked off so the no unmasked neighbours case is run.
+*/
+static void makeBenchMask(const char * ib, unsigned char * mask) {
+    memset(mask, 0, WIDTH*HEIGHT);
+    for (int j = 1; j < HEIGHT - 1; j++) {
+        for (int i = 1; i < WIDTH - 1; i++) {
+            int p0 = 100*ib[i + j*WIDTH]/300;
+            int a = ib[i - 1 + j*WIDTH] + ib[i + 1 + j*WIDTH] +
+                    ib[i + (j+1)*WIDTH] + ib[i + (j-1)*WIDTH] + 4;
+            int b = ib[i - 1 + (j-1)*WIDTH] + ib[i + 1 + (j+1)*WIDTH] +
+                    ib[i - 1 + (j+1)*WIDTH] + ib[i + 1 + (j-1)*WIDTH] + 4;
+            mask[i + j*WIDTH] = ((p0 < a) && (p0 < b));
+        }
+    }
+    for (int j = 600; j < 640; j++) {
+        for (int i = 900; i < 940; i++) {
+            mask[i + j*WIDTH] = 0;
+        }
+    }
+}
+
+/* Synthetic star field: noisy sky, num_stars gaussian stars and a few
+** saturated ones.
+*/
+static void makeStarField(char * ib, int num_stars, unsigned int seed) {
+    srand(seed);
+    for (int k = 0; k < WIDTH*HEIGHT; k++) {
+        ib[k] = (char) (20 + rand() % 11);
+    }
+    for (int star = 0; star < num_stars; star++) {
+        double x = 20 + rand() % (WIDTH - 40) + (rand() % 100)/100.0;
+        double y = 20 + rand() % (HEIGHT - 40) + (rand() % 100)/100.0;
+        double peak = star % 50 == 0 ? 600 : 10 + rand() % 200;
+        for (int j = (int) y - 5; j <= (int) y + 5; j++) {
+            for (int i = (int) x - 5; i <= (int) x + 5; i++) {
+                double r2 = (i - x)*(i - x) + (j - y)*(j - y);
+                int v = (unsigned char) ib[i + j*WIDTH] +
+                        (int) (peak*exp(-r2/(2*1.5*1.5)));
+                ib[i + j*WIDTH] = (char) (v > 255 ? 255 : v);
+            }
+        }
+    }
+}
+
+/* Saturated frame: bright, clipped, speckled glare over a third of the sky,
+** as when the camera looks near the sun or the moon, on top of a star
+** field. Nearly every local maximum of the glare is a peak.
+*/
+static void makeGlareFrame(char * ib, unsigned int seed) {
+    makeStarField(ib, 2000, seed);
+    for (int j = 0; j < HEIGHT; j++) {
+        for (int i = 0; i < WIDTH/3; i++) {
+            int v = (unsigned char) ib[i + j*WIDTH] + 300 - i/4 + rand() % 120;
+            ib[i + j*WIDTH] = (char) (v > 255 ? 255 : v);
+        }
+    }
+}
+
+static int loadFrame(const char * path, char * ib) {
+    FILE * f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Could not open %s.\n", path);
+        return -1;
+    }
+    size_t len = strlen(path);
+    if (len > 4 && (strcmp(path + len - 4, ".jpg") == 0 ||
+                    strcmp(path + len - 5, ".jpeg") == 0)) {
+        struct jpeg_decompress_struct cinfo;
+        struct jpeg_error_mgr jerr;
+        cinfo.err = jpeg_std_error(&jerr);
+        jpeg_create_decompress(&cinfo);
+        jpeg_stdio_src(&cinfo, f);
+        jpeg_read_header(&cinfo, TRUE);
+        cinfo.out_color_space = JCS_GRAYSCALE;
+        jpeg_start_decompress(&cinfo);
+        if (cinfo.output_width != WIDTH || cinfo.output_height != HEIGHT) {
+            fprintf(stderr, "%s is %ux%u, not %dx%d.\n", path,
+                    cinfo.output_width, cinfo.output_height, WIDTH, HEIGHT);
+            jpeg_destroy_decompress(&cinfo);
+            fclose(f);
+            return -1;
+        }
+        while (cinfo.output_scanline < cinfo.output_height) {
+            JSAMPROW row = (JSAMPROW) (ib + cinfo.output_scanline*WIDTH);
+            jpeg_read_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_decompress(&cinfo);
+        jpeg_destroy_decompress(&cinfo);
+    } else if (fread(ib, 1, WIDTH*HEIGHT, f) != WIDTH*HEIGHT) {
+        fprintf(stderr, "%s is not a raw %dx%d frame.\n", path, WIDTH,
+                HEIGHT);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* Threshold the way findBlobs does, from the smoothed and high pass filtered
+** image.
+*/
+static double blobThreshold(double * ic, const double * ic2,
+                            const unsigned char * mask, int b) {
+    double sx = 0, sx2 = 0;
+    int num_pix = 0;
+    for (int j = b; j < HEIGHT - b; j++) {
+        for (int i = b; i < WIDTH - b; i++) {
+            int idx = i + j*WIDTH;
+            ic[idx] -= ic2[idx];
+            sx += ic[idx]*mask[idx];
+            sx2 += ic[idx]*ic[idx]*mask[idx];
+            num_pix += mask[idx];
+        }
+    }
+    double mean = sx/num_pix;
+    double sigma = sqrt((sx2 - sx*sx/num_pix)/num_pix);
+    return mean + N_SIGMA*sigma;
+}
+
+struct timings {
+    double smooth_ms, high_pass_ms, peaks_ms, dedup_ms;
+    int num_peaks, num_blobs;
+};
+
+static int sameBlobs(const struct blob * a, const struct blob * b, int n) {
+    for (int ib = 0; ib < n; ib++) {
+        if (a[ib].x != b[ib].x || a[ib].y != b[ib].y ||
+            memcmp(&a[ib].mag, &b[ib].mag, sizeof(double)) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void benchFrame(const char * name, const char * ib, int max_threads,
+                       int runs, int * mismatches) {
+    static unsigned char * mask = NULL;
+    static double * ic_ref, * ic2_ref, * ic, * ic2;
+    static int * peaks_ref;
+    int b = BORDER + R_HIGH_PASS;
+
+    if (mask == NULL) {
+        mask = malloc(WIDTH*HEIGHT);
+        ic_ref = calloc(WIDTH*HEIGHT, sizeof(double));
+        ic2_ref = calloc(WIDTH*HEIGHT, sizeof(double));
+        ic = calloc(WIDTH*HEIGHT, sizeof(double));
+        ic2 = calloc(WIDTH*HEIGHT, sizeof(double));
+        peaks_ref = malloc(WIDTH*HEIGHT*sizeof(int));
+    }
+    makeBenchMask(ib, mask);
+
+    printf("%s\n", name);
+    printf("%10s %12s %14s %12s %12s %8s %8s %8s\n", "threads", "smooth ms",
+           "high pass ms", "peaks ms", "merge ms", "peaks", "blobs", "match");
+
+    struct timings ref = {0};
+    struct blob * blobs_ref = NULL;
+    double threshold = 0;
+    // run 0 warms up caches and buffers and is not timed
+    for (int run = 0; run <= runs; run++) {
+        double t0 = nowMs();
+        legacyBoxcar(ib, mask, 0, 0, WIDTH, HEIGHT, R_SMOOTH, ic_ref);
+        double t1 = nowMs();
+        legacyBoxcar(ib, mask, 0, 0, WIDTH, HEIGHT, R_HIGH_PASS, ic2_ref);
+        double t2 = nowMs();
+        threshold = blobThreshold(ic_ref, ic2_ref, mask, b);
+        double t3 = nowMs();
+        ref.num_peaks = legacyPeaks(ic_ref, WIDTH, b, b, WIDTH - b - 1,
+                                    HEIGHT - b - 1, threshold, peaks_ref);
+        double t4 = nowMs();
+        ref.num_blobs = legacyDedup(ic_ref, WIDTH, peaks_ref, ref.num_peaks,
+                                    UNIQUE_STAR_SPACING, &blobs_ref);
+        double t5 = nowMs();
+        if (run > 0) {
+            ref.smooth_ms += (t1 - t0)/runs;
+            ref.high_pass_ms += (t2 - t1)/runs;
+            ref.peaks_ms += (t4 - t3)/runs;
+            ref.dedup_ms += (t5 - t4)/runs;
+        }
+    }
+    printf("%10s %12.2f %14.2f %12.2f %12.2f %8d %8d %8s\n", "legacy",
+           ref.smooth_ms, ref.high_pass_ms, ref.peaks_ms, ref.dedup_ms,
+           ref.num_peaks, ref.num_blobs, "-");
+
+    // 1, 2, 4, ... threads, ending at max_threads
+    for (int threads = 1; threads <= max_threads;
+         threads = (threads < max_threads && 2*threads > max_threads) ?
+                   max_threads : 2*threads) {
+        struct timings t = {0};
+        int match = 1;
+        setBlobThreads(threads);
+        for (int run = 0; run <= runs; run++) {
+            const int * peaks = NULL;
+            double t0 = nowMs();
+            boxcarFilterTiled(ib, mask, WIDTH, 0, 0, WIDTH, HEIGHT, R_SMOOTH,
+                              ic);
+            double t1 = nowMs();
+            boxcarFilterTiled(ib, mask, WIDTH, 0, 0, WIDTH, HEIGHT,
+                              R_HIGH_PASS, ic2);
+            double t2 = nowMs();
+            // same serial sums as findBlobs, so the threshold only matches
+            // if the filtered images do
+            double tiled_threshold = blobThreshold(ic, ic2, mask, b);
+            double t3 = nowMs();
+            t.num_peaks = findPeaksTiled(ic, WIDTH, b, b, WIDTH - b - 1,
+                                         HEIGHT - b - 1, tiled_threshold,
+                                         &peaks);
+            double t4 = nowMs();
+            struct blob * blobs = NULL;
+            t.num_blobs = dedupPeaks(ic, WIDTH, HEIGHT, peaks, t.num_peaks,
+                                     UNIQUE_STAR_SPACING, &blobs);
+            double t5 = nowMs();
+            if (run > 0) {
+                t.smooth_ms += (t1 - t0)/runs;
+                t.high_pass_ms += (t2 - t1)/runs;
+                t.peaks_ms += (t4 - t3)/runs;
+                t.dedup_ms += (t5 - t4)/runs;
+            }
+
+            match &= memcmp(&tiled_threshold, &threshold,
+                            sizeof(double)) == 0;
+            match &= memcmp(ic, ic_ref, WIDTH*HEIGHT*sizeof(double)) == 0;
+            match &= memcmp(ic2, ic2_ref, WIDTH*HEIGHT*sizeof(double)) == 0;
+            match &= t.num_peaks == ref.num_peaks &&
+                     memcmp(peaks, peaks_ref,
+                            ref.num_peaks*sizeof(int)) == 0;
+            match &= t.num_blobs == ref.num_blobs &&
+                     sameBlobs(blobs, blobs_ref, ref.num_blobs);
+        }
+        printf("%10d %12.2f %14.2f %12.2f %12.2f %8d %8d %8s\n", threads,
+               t.smooth_ms, t.high_pass_ms, t.peaks_ms, t.dedup_ms,
+               t.num_peaks, t.num_blobs, match ? "yes" : "NO");
+        if (!match) {
+            (*mismatches)++;
+        }
+    }
+    printf("\n");
+}
+
+/* Blobs as dedupPeaks leaves them: in raster order, with magnitudes that
+** repeat and some saturated ones.
+*/
+static void makeBlobs(struct blob * blobs, int num_blobs, unsigned int seed) {
+    srand(seed);
+    for (int ib = 0; ib < num_blobs; ib++) {
+        blobs[ib].x = rand() % WIDTH;
+        blobs[ib].y = (int) ((long) ib*HEIGHT/num_blobs);
+        blobs[ib].mag = ib % 97 == 0 ? (double) UINT32_MAX :
+                                       100*(1 + rand() % 2000);
+    }
+}
+
+static void benchSort(int num_blobs, int runs, int * mismatches) {
+    struct blob * blobs = malloc(num_blobs*sizeof(struct blob));
+    struct blob * sorted = malloc(num_blobs*sizeof(struct blob));
+    struct blob * full = malloc(num_blobs*sizeof(struct blob));
+    double * x = malloc(num_blobs*sizeof(double));
+    double * y = malloc(num_blobs*sizeof(double));
+    double * mags = malloc(num_blobs*sizeof(double));
+    double legacy_ms = 0, top_ms = 0, full_ms = 0;
+    int match = 1;
+
+    makeBlobs(blobs, num_blobs, (unsigned int) num_blobs);
+    for (int run = 0; run <= runs; run++) {
+        for (int ib = 0; ib < num_blobs; ib++) {
+            x[ib] = blobs[ib].x;
+            y[ib] = blobs[ib].y;
+            mags[ib] = blobs[ib].mag;
+        }
+        memcpy(sorted, blobs, num_blobs*sizeof(struct blob));
+        memcpy(full, blobs, num_blobs*sizeof(struct blob));
+        double t0 = nowMs();
+        legacyPart(mags, 0, num_blobs - 1, x, y);
+        double t1 = nowMs();
+        int k = sortBrightestBlobs(sorted, num_blobs, BLOB_SORT_MAX);
+        double t2 = nowMs();
+        sortBrightestBlobs(full, num_blobs, num_blobs);
+        double t3 = nowMs();
+        if (run > 0) {
+            legacy_ms += (t1 - t0)/runs;
+            top_ms += (t2 - t1)/runs;
+            full_ms += (t3 - t2)/runs;
+        }
+
+        for (int ib = 0; ib < num_blobs; ib++) {
+            struct blob legacy = {(int) x[ib], (int) y[ib], mags[ib]};
+            match &= ib >= k || sameBlobs(&sorted[ib], &legacy, 1);
+            match &= sameBlobs(&full[ib], &legacy, 1);
+        }
+    }
+    printf("%10d %12.3f %12.3f %12.3f %8s\n", num_blobs, legacy_ms, top_ms,
+           full_ms, match ? "yes" : "NO");
+    if (!match) {
+        (*mismatches)++;
+    }
+    free(blobs);
+    free(sorted);
+    free(full);
+    free(x);
+    free(y);
+    free(mags);
+}
+
+int main(int argc, char * argv[]) {
+    int max_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int runs = 5;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:")) != -1) {
+        if (opt == 't') {
+            max_threads = atoi(optarg);
+        } else if (opt == 'n') {
+            runs = atoi(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [-t max_threads] [-n runs] "
+                    "[frame.jpg|frame.raw ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+    if (max_threads > BLOB_MAX_THREADS) {
+        max_threads = BLOB_MAX_THREADS;
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    char * ib = malloc(WIDTH*HEIGHT);
+    int mismatches = 0;
+    if (optind == argc) {
+        makeStarField(ib, 300, 1);
+        benchFrame("synthetic, 300 stars", ib, max_threads, runs,
+                   &mismatches);
+        makeStarField(ib, 10000, 2);
+        benchFrame("synthetic, 10000 stars", ib, max_threads, runs,
+                   &mismatches);
+        makeGlareFrame(ib, 3);
+        benchFrame("synthetic, saturated with glare", ib, max_threads, runs,
+                   &mismatches);
+    }
+    for (int arg = optind; arg < argc; arg++) {
+        if (loadFrame(argv[arg], ib) == 0) {
+            benchFrame(argv[arg], ib, max_threads, runs, &mismatches);
+        }
+    }
+    free(ib);
+
+    printf("blob sort, brightest %d\n", BLOB_SORT_MAX);
+    printf("%10s %12s %12s %12s %8s\n", "blobs", "legacy ms", "top ms",
+           "all ms", "match");
+    benchSort(100, runs, &mismatches);
+    benchSort(1000, runs, &mismatches);
+    benchSort(10000, runs, &mismatches);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,578 @@
+/* Star camera downlink over loopback, with packet loss.
+**
+** Runs the starcam_downlink server in this process on a synthetic star
+** frame and fetches it back over 127.0.0.1 the way the ground would:
+** first the old way (every chunk, no acks) as the reference, then with a
+** window and acks while a share of the chunks and acks are dropped on the
+** client side and newer images arrive partway through, then resumed by
+** timestamp from the middle, then with every progressive layer, then the
+** list of images kept. Fails if any fetch does not give back the reference
+** bytes or a layer does not decode on its own.
+**
+** Usage: downlink_loopback [-p port] [-l loss] [-w window] [-c chunk_size]
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <jpeglib.h>
+
+#include "starcam_downlink.h"
+
+#define WIDTH 640
+#define HEIGHT 480
+#define NUM_STARS 150
+#define FIRST_TIMESTAMP 1000
+#define RECV_TIMEOUT_MS 20
+#define FETCH_TIMEOUT_MS 20000
+// chunks received between acks
+#define ACK_EVERY 8
+#define MAX_ACK_MISSING 64
+
+/* One image as the client is putting it together */
+struct fetch {
+    image_header_msg_t header;
+    int have_header;
+    uint8_t * data;
+    uint8_t * have;             // chunk arrived
+    uint32_t num_have;
+    uint32_t next_chunk;        // every chunk before this one has arrived
+    uint32_t highest;           // one past the highest chunk seen
+    int complete;
+    // counters
+    uint32_t received;          // chunk datagrams that got through
+    uint32_t dropped;           // chunk datagrams thrown away as lost
+    uint32_t duplicates;
+    uint32_t acks_sent;
+    uint32_t acks_dropped;
+    uint32_t below_first;       // chunks the ground said it already had
+    // progressive transfers
+    image_layer_t layers[MAX_IMAGE_LAYERS];
+    uint32_t num_layers;
+    double layer_ms[MAX_IMAGE_LAYERS];  // when each was all in, 0 until then
+    double start_ms;
+};
+
+static double loss = 0.2;
+static unsigned int loss_seed = 1;
+// stars of the last frame made, as findBlobs gives them
+static double star_x[NUM_STARS];
+static double star_y[NUM_STARS];
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+}
+
+static int lost() {
+    return rand_r(&loss_seed) < loss*RAND_MAX;
+}
+
+/* Noise and gaussian stars, different for every seed */
+static void makeFrame(uint8_t * image, unsigned int seed) {
+    srand(seed);
+    for (int i = 0; i < WIDTH*HEIGHT; i++) {
+        image[i] = 20 + rand() % 32;
+    }
+    for (int s = 0; s < NUM_STARS; s++) {
+        double x0 = rand() % WIDTH, y0 = rand() % HEIGHT;
+        double peak = 40 + rand() % 200;
+        star_x[s] = x0;
+        star_y[s] = HEIGHT - y0;
+        for (int y = (int) y0 - 4; y <= (int) y0 + 4; y++) {
+            for (int x = (int) x0 - 4; x <= (int) x0 + 4; x++) {
+                if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT) {
+                    continue;
+                }
+                double r2 = (x - x0)*(x - x0) + (y - y0)*(y - y0);
+                double v = image[x + y*WIDTH] + peak*exp(-r2/3.0);
+                image[x + y*WIDTH] = v > 255 ? 255 : (uint8_t) v;
+            }
+        }
+    }
+}
+
+/* Time the camera thread spends handing frames over [ms] */
+static double handoff_ms = 0;
+static int num_handoffs = 0;
+
+/* Hand a new frame to the server and wait for the compression worker to
+** put it in the ring, so the frames are all kept */
+static int notifyFrame(uint8_t * image, time_t timestamp) {
+    char name[64];
+    int images, running, active;
+    uint32_t bandwidth;
+    time_t latest = 0;
+    double compress_ms, compress_mean_ms;
+
+    makeFrame(image, (unsigned int) timestamp);
+    snprintf(name, sizeof(name), "synthetic_%ld.raw", (long) timestamp);
+    double start = nowMs();
+    notifyImageServer(name, NUM_STARS, timestamp, image, WIDTH, HEIGHT,
+                      star_x, star_y);
+    handoff_ms += nowMs() - start;
+    num_handoffs++;
+
+    for (int i = 0; i < 5000 && latest != timestamp; i++) {
+        getStarcamStatus(&images, &running, &bandwidth, &active, &latest,
+                         &compress_ms, &compress_mean_ms);
+        if (latest != timestamp) {
+            usleep(1000);
+        }
+    }
+    if (latest != timestamp) {
+        fprintf(stderr, "Image %ld was never compressed.\n", (long) timestamp);
+        return -1;
+    }
+    return 0;
+}
+
+/* Acknowledge what has arrived and ask again for the gaps up to the highest
+** chunk seen, or up to the end when everything sent should be in by now,
+** unless the ack is lost. */
+static void sendAck(int sock, struct fetch * f, int to_end) {
+    uint32_t end = to_end ? f->header.total_chunks : f->highest;
+    uint8_t buffer[sizeof(image_ack_msg_t) + MAX_ACK_MISSING*sizeof(uint32_t)];
+    image_ack_msg_t * ack = (image_ack_msg_t *) buffer;
+
+    ack->timestamp = f->header.timestamp;
+    ack->next_chunk = f->next_chunk;
+    ack->num_missing = 0;
+    for (uint32_t c = f->next_chunk; c < end &&
+                                     ack->num_missing < MAX_ACK_MISSING; c++) {
+        if (!f->have[c]) {
+            ack->missing[ack->num_missing++] = c;
+        }
+    }
+    size_t size = sizeof(image_ack_msg_t) +
+                  ack->num_missing*sizeof(uint32_t);
+    ack->header = (message_header_t) {MSG_IMAGE_ACK,
+                                      size - sizeof(message_header_t), 0};
+
+    f->acks_sent++;
+    if (lost()) {
+        f->acks_dropped++;
+        return;
+    }
+    send(sock, buffer, size, 0);
+}
+
+/* Note the time each layer is all in, once chunk c has arrived */
+static void layersDone(struct fetch * f, uint32_t c) {
+    uint32_t chunk_size = starcam_config.chunk_size;
+
+    for (uint32_t l = 0; l < f->num_layers; l++) {
+        uint32_t first = f->layers[l].offset/chunk_size;
+        uint32_t last = (f->layers[l].offset + f->layers[l].size - 1)/chunk_size;
+        int done = c >= first && c <= last && f->layer_ms[l] == 0;
+
+        for (uint32_t i = first; i <= last && done; i++) {
+            done = f->have[i];
+        }
+        if (done) {
+            f->layer_ms[l] = nowMs() - f->start_ms;
+        }
+    }
+}
+
+/* Fetch an image: the latest if timestamp is 0, with no acks if window is
+** 0, every layer with REQUEST_PROGRESSIVE in flags. Chunks before first_chunk are taken from known (the part the ground
+** already has). Chunks and acks are lost if lossy. Calls mid(arg) once
+** when a third of the chunks are in, if it is given.
+** Output: 0 when the whole image arrived, -1 on MSG_ERROR or timeout.
+*/
+static int fetchImage(int sock, struct fetch * f, time_t timestamp,
+                      uint32_t window, uint32_t first_chunk, uint32_t flags,
+                      const uint8_t * known, int lossy, void (*mid)(void *),
+                      void * arg) {
+    image_request_msg_t req = {
+        .timestamp = timestamp,
+        .window = window,
+        .first_chunk = first_chunk,
+        .flags = flags,
+    };
+    size_t req_size = sizeof(req);
+    uint8_t buffer[2048];
+    uint32_t since_ack = 0;
+
+    memset(f, 0, sizeof(*f));
+    f->start_ms = nowMs();
+    if (window == 0 && first_chunk == 0 && flags == 0) {
+        // what the old ground software sends
+        req_size = timestamp ? sizeof(get_image_by_timestamp_msg_t) :
+                               sizeof(message_header_t);
+    }
+    req.header = (message_header_t) {
+        timestamp ? MSG_GET_IMAGE_BY_TIMESTAMP : MSG_GET_LATEST_IMAGE,
+        req_size - sizeof(message_header_t), 1};
+    send(sock, &req, req_size, 0);
+
+    double deadline = nowMs() + FETCH_TIMEOUT_MS;
+    while (!f->complete && nowMs() < deadline) {
+        ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            // quiet: the last ack may have been lost, say it again
+            if (window && f->have_header) {
+                sendAck(sock, f, 1);
+            }
+            continue;
+        }
+        if ((size_t) n < sizeof(message_header_t)) {
+            continue;
+        }
+
+        message_header_t * header = (message_header_t *) buffer;
+        if (header->type == MSG_ERROR) {
+            return -1;
+        } else if (header->type == MSG_IMAGE_HEADER && !f->have_header) {
+            memcpy(&f->header, buffer, sizeof(f->header));
+            f->data = malloc(f->header.total_size);
+            f->have = calloc(f->header.total_chunks + 1, 1);
+            f->have_header = 1;
+            for (uint32_t c = 0; c < first_chunk &&
+                                 c < f->header.total_chunks; c++) {
+                f->have[c] = 1;
+                f->num_have++;
+            }
+            if (known != NULL) {
+                size_t known_size = (size_t) first_chunk*starcam_config.chunk_size;
+                memcpy(f->data, known, known_size < f->header.total_size ?
+                       known_size : f->header.total_size);
+            }
+            f->next_chunk = f->highest = f->num_have;
+        } else if (header->type == MSG_IMAGE_LAYERS && f->have_header) {
+            image_layers_msg_t * layers = (image_layers_msg_t *) buffer;
+            f->num_layers = layers->num_layers < MAX_IMAGE_LAYERS ?
+                            layers->num_layers : MAX_IMAGE_LAYERS;
+            memcpy(f->layers, layers->layers,
+                   f->num_layers*sizeof(image_layer_t));
+        } else if (header->type == MSG_IMAGE_CHUNK && f->have_header) {
+            image_chunk_msg_t * chunk = (image_chunk_msg_t *) buffer;
+            uint32_t c = chunk->chunk_id;
+
+            if (c >= f->header.total_chunks) {
+                continue;
+            }
+            if (lossy && lost()) {
+                f->dropped++;
+                continue;
+            }
+            f->received++;
+            if (c < first_chunk) {
+                f->below_first++;
+            }
+            if (f->have[c]) {
+                f->duplicates++;
+            } else {
+                memcpy(f->data + (size_t) c*starcam_config.chunk_size,
+                       chunk->data, chunk->data_size);
+                f->have[c] = 1;
+                f->num_have++;
+                layersDone(f, c);
+            }
+            if (c + 1 > f->highest) {
+                f->highest = c + 1;
+            }
+            while (f->next_chunk < f->header.total_chunks &&
+                   f->have[f->next_chunk]) {
+                f->next_chunk++;
+            }
+            if (mid != NULL && f->num_have >= f->header.total_chunks/3) {
+                mid(arg);
+                mid = NULL;
+            }
+            if (window && (++since_ack >= ACK_EVERY ||
+                           f->num_have == f->header.total_chunks)) {
+                sendAck(sock, f, 0);
+                since_ack = 0;
+            }
+        } else if (header->type == MSG_IMAGE_COMPLETE && f->have_header) {
+            // without a window, chunks are not sent again
+            f->complete = 1;
+        }
+    }
+    if (!f->complete || f->num_have != f->header.total_chunks) {
+        fprintf(stderr, "Fetch of image %ld stopped with %u of %u chunks.\n",
+                (long) f->header.timestamp, f->num_have,
+                f->header.total_chunks);
+        return -1;
+    }
+    return 0;
+}
+
+static void freeFetch(struct fetch * f) {
+    free(f->data);
+    free(f->have);
+}
+
+/* Newer images arriving partway through a transfer */
+struct mid_arrivals {
+    uint8_t * image;
+    int num;
+};
+
+static void notifyNewer(void * arg) {
+    struct mid_arrivals * m = arg;
+    for (int i = 1; i <= m->num; i++) {
+        notifyFrame(m->image, FIRST_TIMESTAMP + i);
+    }
+}
+
+static int sameImage(const char * what, const struct fetch * f,
+                     const struct fetch * ref) {
+    if (f->header.timestamp != ref->header.timestamp ||
+        f->header.total_size != ref->header.total_size ||
+        memcmp(f->data, ref->data, ref->header.total_size) != 0) {
+        fprintf(stderr, "%s: image %ld differs from the reference.\n", what,
+                (long) f->header.timestamp);
+        return 0;
+    }
+    return 1;
+}
+
+/* Decode a layer on its own and check it is the size it says */
+static int decodeLayer(const uint8_t * data, const image_layer_t * layer) {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    int ok;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *) data + layer->offset, layer->size);
+    ok = jpeg_read_header(&cinfo, TRUE) == JPEG_HEADER_OK &&
+         cinfo.image_width == layer->width &&
+         cinfo.image_height == layer->height;
+    if (ok) {
+        JSAMPLE * row = malloc(cinfo.image_width*cinfo.num_components);
+        jpeg_start_decompress(&cinfo);
+        while (cinfo.output_scanline < cinfo.output_height) {
+            jpeg_read_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_decompress(&cinfo);
+        free(row);
+    }
+    jpeg_destroy_decompress(&cinfo);
+    return ok;
+}
+
+/* Every layer decodes, the full frame is the reference image and the
+** thumbnail and tiles come ahead of it */
+static int checkLayers(const struct fetch * f, const struct fetch * ref) {
+    const image_layer_t * full = &f->layers[f->num_layers - 1];
+    int num_roi = 0;
+
+    if (f->num_layers < 2 || f->layers[0].type != LAYER_THUMBNAIL ||
+        full->type != LAYER_FULL || full->size != ref->header.total_size ||
+        memcmp(f->data + full->offset, ref->data, full->size) != 0) {
+        fprintf(stderr, "Progressive fetch: layers do not end with the "
+                "reference image.\n");
+        return 0;
+    }
+    for (uint32_t l = 0; l < f->num_layers; l++) {
+        if (!decodeLayer(f->data, &f->layers[l])) {
+            fprintf(stderr, "Progressive fetch: layer %u does not decode.\n",
+                    l);
+            return 0;
+        }
+        num_roi += f->layers[l].type == LAYER_ROI;
+    }
+
+    printf("%-28s %6.1f ms thumbnail (%u bytes), %d tiles by %.1f ms, "
+           "full frame at %.1f ms\n", "  layers in", f->layer_ms[0],
+           f->layers[0].size, num_roi,
+           num_roi ? f->layer_ms[num_roi] : 0.0,
+           f->layer_ms[f->num_layers - 1]);
+    return 1;
+}
+
+static void printFetch(const char * what, const struct fetch * f, double ms) {
+    printf("%-28s %6.1f ms  %4u chunks  %4u received  %4u dropped  "
+           "%4u dup  %3u acks (%u dropped)\n", what, ms,
+           f->header.total_chunks, f->received, f->dropped, f->duplicates,
+           f->acks_sent, f->acks_dropped);
+}
+
+int main(int argc, char * argv[]) {
+    int port = 18001;
+    uint32_t window = 32;
+    int chunk_size = 1000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:l:w:c:")) != -1) {
+        if (opt == 'p') {
+            port = atoi(optarg);
+        } else if (opt == 'l') {
+            loss = atof(optarg);
+        } else if (opt == 'w') {
+            window = atoi(optarg);
+        } else if (opt == 'c') {
+            chunk_size = atoi(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [-p port] [-l loss] [-w window] "
+                    "[-c chunk_size]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (window < 1 || chunk_size < 64 || chunk_size > 1400 || loss < 0 ||
+        loss > 0.9) {
+        fprintf(stderr, "Need window >= 1, 64 <= chunk_size <= 1400 and "
+                "0 <= loss <= 0.9.\n");
+        return 1;
+    }
+
+    starcam_config = (starcam_downlink_config_t) {
+        .enabled = 1,
+        .logfile = "/dev/null",
+        .port = port,
+        .compression_quality = 80,
+        .chunk_size = chunk_size,
+        .max_bandwidth_kbps = 8000,
+        .progressive = 1,
+    };
+    if (initStarcamDownlink() != 0 || startStarcamServer() != 0) {
+        return 1;
+    }
+
+    int images, running = 0, active;
+    uint32_t bandwidth;
+    time_t latest;
+    double compress_ms, compress_mean_ms;
+    for (int i = 0; i < 100 && !running; i++) {
+        usleep(10000);
+        getStarcamStatus(&images, &running, &bandwidth, &active, &latest,
+                         &compress_ms, &compress_mean_ms);
+    }
+    if (!running) {
+        fprintf(stderr, "Downlink server did not start on port %d.\n", port);
+        return 1;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    struct timeval tv = {0, RECV_TIMEOUT_MS*1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(sock, (struct sockaddr *) &server, sizeof(server)) < 0) {
+        perror("connect");
+        return 1;
+    }
+
+    uint8_t * image = malloc(WIDTH*HEIGHT);
+    struct fetch ref, f;
+    int failed = 0;
+    double start;
+
+    if (notifyFrame(image, FIRST_TIMESTAMP) != 0) {
+        return 1;
+    }
+    printf("%dx%d synthetic frame, %d byte chunks, window %u, %.0f%% of "
+           "chunks and acks lost\n\n", WIDTH, HEIGHT, chunk_size, window,
+           100*loss);
+
+    // the old way, nothing lost: the reference
+    start = nowMs();
+    if (fetchImage(sock, &ref, 0, 0, 0, 0, NULL, 0, NULL, NULL) != 0) {
+        fprintf(stderr, "Fetch without acks failed.\n");
+        return 1;
+    }
+    printFetch("latest, no acks", &ref, nowMs() - start);
+
+    // windowed with loss, while newer images come in
+    struct mid_arrivals newer = {image, 3};
+    start = nowMs();
+    if (fetchImage(sock, &f, 0, window, 0, 0, NULL, 1, notifyNewer,
+                   &newer) != 0) {
+        fprintf(stderr, "Windowed fetch failed.\n");
+        failed = 1;
+    } else {
+        printFetch("latest, windowed, lossy", &f, nowMs() - start);
+        failed |= !sameImage("Windowed fetch", &f, &ref);
+    }
+    freeFetch(&f);
+
+    // resume the reference image from halfway, by timestamp
+    uint32_t half = ref.header.total_chunks/2;
+    start = nowMs();
+    if (fetchImage(sock, &f, FIRST_TIMESTAMP, window, half, 0, ref.data, 1,
+                   NULL, NULL) != 0) {
+        fprintf(stderr, "Resumed fetch failed.\n");
+        failed = 1;
+    } else {
+        printFetch("by timestamp, resumed", &f, nowMs() - start);
+        failed |= !sameImage("Resumed fetch", &f, &ref);
+        if (f.below_first) {
+            fprintf(stderr, "Resumed fetch sent %u chunks before %u.\n",
+                    f.below_first, half);
+            failed = 1;
+        }
+    }
+    freeFetch(&f);
+
+    // every layer, thumbnail first
+    start = nowMs();
+    if (fetchImage(sock, &f, FIRST_TIMESTAMP, window, 0, REQUEST_PROGRESSIVE,
+                   NULL, 1, NULL, NULL) != 0) {
+        fprintf(stderr, "Progressive fetch failed.\n");
+        failed = 1;
+    } else {
+        printFetch("by timestamp, progressive", &f, nowMs() - start);
+        failed |= !checkLayers(&f, &ref);
+    }
+    freeFetch(&f);
+
+    // an image that is not kept
+    if (fetchImage(sock, &f, FIRST_TIMESTAMP - 1, window, 0, 0, NULL, 0, NULL,
+                   NULL) != -1 || f.have_header) {
+        fprintf(stderr, "Fetch of an unknown timestamp did not fail.\n");
+        failed = 1;
+    }
+    freeFetch(&f);
+
+    // every image notified is kept, oldest first
+    message_header_t list_req = {MSG_GET_IMAGE_LIST, 0, 2};
+    uint8_t buffer[2048];
+    image_list_msg_t * list = (image_list_msg_t *) buffer;
+    ssize_t n;
+    send(sock, &list_req, sizeof(list_req), 0);
+    do {
+        n = recv(sock, buffer, sizeof(buffer), 0);
+    } while (n > 0 && list->header.type != MSG_IMAGE_LIST);
+    if (n < (ssize_t) sizeof(image_list_msg_t) ||
+        list->num_images != (uint32_t) newer.num + 1) {
+        fprintf(stderr, "Image list does not have the %d images sent.\n",
+                newer.num + 1);
+        failed = 1;
+    } else {
+        printf("\nimages kept:");
+        for (uint32_t i = 0; i < list->num_images; i++) {
+            printf(" %ld", (long) list->timestamps[i]);
+            if (list->timestamps[i] != FIRST_TIMESTAMP + (time_t) i) {
+                failed = 1;
+            }
+        }
+        printf("\n");
+    }
+
+    getStarcamStatus(&images, &running, &bandwidth, &active, &latest,
+                     &compress_ms, &compress_mean_ms);
+    printf("frame handoff %.2f ms, compression %.1f ms (last %.1f ms)\n",
+           handoff_ms/num_handoffs, compress_mean_ms, compress_ms);
+
+    freeFetch(&ref);
+    close(sock);
+    cleanupStarcamDownlink();
+    free(image);
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
@@ -0,0 +1,287 @@
+/* Time to solution of the Astrometry solver pool with 1 to N solvers.
+**
+** Finds the blobs of the .raw and .jpg frames of a directory the way
+** starcam_replay does, then solves every frame blind against all the index
+** files of an astrometry.cfg, first with one solver searching every index
+** and then with the indexes split between 2, 4, ... solvers, and prints the
+** time to solution of each. Indexes are loaded before timing starts, as
+** initAstrometry does. More solvers can solve frames that one solver runs
+** out of time on, but it fails if a frame solves somewhere else than it did
+** with one solver.
+**
+** Needs libastrometry and its index files, so it is built apart from the
+** other benchmarks (-DOPH_SOLVE_BENCH=ON).
+**
+** Usage: solve_bench [-t max_solvers] [-n frames] [-T timelimit_s]
+**                    [-c astrometry.cfg] dir
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <astrometry/engine.h>
+#include <astrometry/solver.h>
+#include <astrometry/index.h>
+#include <astrometry/sip.h>
+#include <astrometry/bl.h>
+
+#include "blob_finder.h"
+#include "solver_pool.h"
+#include "starcam_pipeline.h"
+
+#define WIDTH 1936
+#define HEIGHT 1216
+#define MIN_PS 6.0
+#define MAX_PS 7.0
+#define LOGODDS 1e8
+#define R_SMOOTH 2
+#define BORDER 1
+#define N_SIGMA 2.0f
+#define UNIQUE_STAR_SPACING 15
+// solutions further apart than this are not the same [deg]
+#define SAME_POINTING 0.02
+
+/* Blobs of one frame and how it solved with one solver */
+struct bench_frame {
+    double * x;
+    double * y;
+    double * mags;
+    int num_blobs;
+    int solved;
+    double ra;
+    double dec;
+};
+
+static int compareMs(const void * a, const void * b) {
+    double da = *(const double *) a, db = *(const double *) b;
+    return (da > db) - (da < db);
+}
+
+/* Blobs of a frame: the smoothing, peak search, merge and sort of findBlobs,
+** as starcam_replay does it. */
+static int detectFrame(const struct starcam_frame * frame,
+                       const unsigned char * mask, double * ic,
+                       struct bench_frame * out) {
+    const int * peaks = NULL;
+    struct blob * blobs = NULL;
+    int b = BORDER;
+
+    boxcarFilterTiled(frame->image, mask, WIDTH, 0, 0, WIDTH, HEIGHT,
+                      R_SMOOTH, ic);
+
+    double sx = 0, sx2 = 0;
+    int num_pix = 0;
+    for (int j = b; j < HEIGHT - b; j++) {
+        for (int i = b; i < WIDTH - b; i++) {
+            sx += ic[i + j*WIDTH];
+            sx2 += ic[i + j*WIDTH]*ic[i + j*WIDTH];
+            num_pix++;
+        }
+    }
+    double mean = sx/num_pix;
+    double sigma = sqrt((sx2 - sx*sx/num_pix)/num_pix);
+
+    int num_peaks = findPeaksTiled(ic, WIDTH, b, b, WIDTH - b - 1,
+                                   HEIGHT - b - 1, mean + N_SIGMA*sigma,
+                                   &peaks);
+    int blob_count = dedupPeaks(ic, WIDTH, HEIGHT, peaks, num_peaks,
+                                UNIQUE_STAR_SPACING, &blobs);
+    if (num_peaks < 0 || blob_count < 0) {
+        return -1;
+    }
+    sortBrightestBlobs(blobs, blob_count, BLOB_SORT_MAX);
+    if (blob_count > BLOB_SORT_MAX) {
+        blob_count = BLOB_SORT_MAX;
+    }
+
+    out->x = malloc(sizeof(double)*(blob_count + 1));
+    out->y = malloc(sizeof(double)*(blob_count + 1));
+    out->mags = malloc(sizeof(double)*(blob_count + 1));
+    if (out->x == NULL || out->y == NULL || out->mags == NULL) {
+        return -1;
+    }
+    for (int ib = 0; ib < blob_count; ib++) {
+        out->x[ib] = blobs[ib].x;
+        out->y[ib] = HEIGHT - blobs[ib].y;
+        out->mags[ib] = blobs[ib].mag;
+    }
+    out->num_blobs = blob_count;
+    return 0;
+}
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+}
+
+int main(int argc, char * argv[]) {
+    const char * cfg = "/usr/local/etc/astrometry.cfg";
+    int max_solvers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int max_frames = 20;
+    int timelimit = 10;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:T:c:")) != -1) {
+        if (opt == 't') {
+            max_solvers = atoi(optarg);
+        } else if (opt == 'n') {
+            max_frames = atoi(optarg);
+        } else if (opt == 'T') {
+            timelimit = atoi(optarg);
+        } else if (opt == 'c') {
+            cfg = optarg;
+        } else {
+            break;
+        }
+    }
+    if (optind != argc - 1 || opt == '?' || max_frames < 1) {
+        fprintf(stderr, "Usage: %s [-t max_solvers] [-n frames] "
+                "[-T timelimit_s] [-c astrometry.cfg] dir\n", argv[0]);
+        return 1;
+    }
+    if (max_solvers < 1) {
+        max_solvers = 1;
+    }
+    if (max_solvers > SOLVE_MAX_WORKERS) {
+        max_solvers = SOLVE_MAX_WORKERS;
+    }
+
+    // load every index up front, as initAstrometry does
+    engine_t * engine = engine_new();
+    if (engine_parse_config_file(engine, cfg)) {
+        fprintf(stderr, "Bad Astrometry configuration file %s.\n", cfg);
+        return 1;
+    }
+    int num_indexes = 0;
+    index_t ** indexes = calloc(pl_size(engine->indexes) + 1,
+                                sizeof(index_t *));
+    double load_start = nowMs();
+    for (size_t i = 0; i < pl_size(engine->indexes); i++) {
+        index_t * index = pl_get(engine->indexes, i);
+        if (index_reload(index) == 0) {
+            indexes[num_indexes++] = index;
+        }
+    }
+    printf("%d indexes loaded in %.0f ms\n", num_indexes,
+           nowMs() - load_start);
+
+    // find the blobs of every frame once
+    struct frame_directory dir;
+    struct starcam_frame frame = {
+        .width = WIDTH,
+        .height = HEIGHT,
+        .image = malloc(WIDTH*HEIGHT),
+    };
+    unsigned char * mask = malloc(WIDTH*HEIGHT);
+    double * ic = calloc(WIDTH*HEIGHT, sizeof(double));
+    struct bench_frame * frames = calloc(max_frames,
+                                         sizeof(struct bench_frame));
+    int num_frames = 0;
+    int ret;
+
+    memset(mask, 1, WIDTH*HEIGHT);
+    if (openFrameDirectory(&dir, argv[optind], 0) < 0) {
+        return 1;
+    }
+    while (num_frames < max_frames && (ret = readDirectoryFrame(&dir,
+                                                                &frame)) != 0) {
+        if (ret > 0 && detectFrame(&frame, mask, ic,
+                                   &frames[num_frames]) == 0) {
+            num_frames++;
+        }
+    }
+    closeFrameDirectory(&dir);
+    if (num_frames == 0) {
+        fprintf(stderr, "No frames in %s.\n", argv[optind]);
+        return 1;
+    }
+    printf("%d frames, solved blind at %.1f to %.1f arcsec/px, "
+           "%d s time limit\n\n", num_frames, MIN_PS, MAX_PS, timelimit);
+    printf("solvers  solved  mean ms  median ms  max ms  speedup\n");
+
+    double * ms = malloc(sizeof(double)*num_frames);
+    double base_mean = 0;
+    int failed = 0;
+
+    for (int num_solvers = 1; ; num_solvers *= 2) {
+        int solved = 0;
+        double sum = 0;
+
+        if (num_solvers > max_solvers) {
+            num_solvers = max_solvers;
+        }
+
+        setSolveWorkers(num_solvers);
+        for (int f = 0; f < num_frames; f++) {
+            struct solve_params params = {
+                .x = frames[f].x,
+                .y = frames[f].y,
+                .flux = frames[f].mags,
+                .num_stars = frames[f].num_blobs,
+                .field_width = WIDTH,
+                .field_height = HEIGHT,
+                .funits_lower = MIN_PS,
+                .funits_upper = MAX_PS,
+                .parity = PARITY_BOTH,
+                .quadsize_min = 0.1*HEIGHT,
+                .logodds = log(LOGODDS),
+                .timelimit = timelimit,
+            };
+            struct solve_result result;
+            double ra = 0, dec = 0;
+
+            double start = nowMs();
+            int ok = solveOnPool(&params, indexes, num_indexes, &result);
+            ms[f] = nowMs() - start;
+            sum += ms[f];
+
+            if (ok) {
+                tan_pixelxy2radec(&result.wcs, (WIDTH - 1)/2.0,
+                                  (HEIGHT - 1)/2.0, &ra, &dec);
+                solved++;
+            }
+            // one solver searching everything is the reference
+            if (num_solvers == 1) {
+                frames[f].solved = ok;
+                frames[f].ra = ra;
+                frames[f].dec = dec;
+            } else if (ok && frames[f].solved &&
+                       (fabs(dec - frames[f].dec) > SAME_POINTING ||
+                        fabs(remainder(ra - frames[f].ra, 360.0))*
+                        cos(dec*M_PI/180.0) > SAME_POINTING)) {
+                fprintf(stderr, "Frame %d solved differently with %d "
+                        "solvers.\n", f, num_solvers);
+                failed = 1;
+            }
+        }
+
+        double mean = sum/num_frames;
+        if (num_solvers == 1) {
+            base_mean = mean;
+        }
+        qsort(ms, num_frames, sizeof(double), compareMs);
+        printf("%7d  %6d  %7.0f  %9.0f  %6.0f  %6.2fx\n", num_solvers, solved,
+               mean, ms[num_frames/2], ms[num_frames - 1], base_mean/mean);
+        if (num_solvers == max_solvers) {
+            break;
+        }
+    }
+
+    for (int f = 0; f < num_frames; f++) {
+        free(frames[f].x);
+        free(frames[f].y);
+        free(frames[f].mags);
+    }
+    free(frames);
+    free(ms);
+    free(mask);
+    free(ic);
+    free(frame.image);
+    free(indexes);
+    engine_free(engine);
+    return failed;
+}
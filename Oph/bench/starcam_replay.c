@@ -0,0 +1,245 @@
+/* Headless run of the star camera pipeline against recorded frames.
+**
+** Replays the .raw and .jpg frames of a directory (in name order, over and
+** over) as if they came from the camera every interval milliseconds, runs
+** blob finding on them with blob_finder.c and stands in for Astrometry with
+** a fixed solve time, since the solver and its index files are not needed
+** to exercise the pipeline. Runs the same frames one at a time first, the
+** way doCameraAndAstrometry does, then through the pipeline, and prints the
+** frame rates and the pipeline's latency counters and drops.
+**
+** Usage: starcam_replay [-n frames] [-i interval_ms] [-s solve_ms] dir
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "blob_finder.h"
+#include "starcam_pipeline.h"
+
+#define WIDTH 1936
+#define HEIGHT 1216
+#define R_SMOOTH 2
+#define BORDER 1
+#define N_SIGMA 2.0f
+#define UNIQUE_STAR_SPACING 15
+
+struct replay {
+    struct frame_directory dir;
+    int max_frames;
+    int captured;
+    double interval_ms;
+    double next_ms;             // when the camera has the next frame
+    double solve_ms;
+    unsigned char * mask;
+    double * ic;
+};
+
+static void sleepMs(double ms) {
+    if (ms <= 0) {
+        return;
+    }
+    struct timespec ts = {
+        .tv_sec = (time_t) (ms/1e3),
+        .tv_nsec = (long) (fmod(ms, 1e3)*1e6),
+    };
+    nanosleep(&ts, NULL);
+}
+
+/* Capture: the next recorded frame, no sooner than the camera would have
+** it. */
+static int replayCapture(struct starcam_frame * frame, void * arg) {
+    struct replay * replay = arg;
+
+    if (replay->captured >= replay->max_frames) {
+        return -1;
+    }
+    sleepMs(replay->next_ms - pipelineNowMs());
+    replay->next_ms = pipelineNowMs() + replay->interval_ms;
+
+    int ret = readDirectoryFrame(&replay->dir, frame);
+    if (ret == 0) {
+        return -1;
+    }
+    if (ret < 0) {
+        return 0;
+    }
+    replay->captured++;
+    frame->solve = 1;
+    return 1;
+}
+
+/* Detect: the smoothing, peak search, merge and sort of findBlobs, without
+** hot pixel masking or high pass filtering. */
+static int replayDetect(struct starcam_frame * frame, void * arg) {
+    struct replay * replay = arg;
+    const int * peaks = NULL;
+    struct blob * blobs = NULL;
+    int b = BORDER;
+
+    boxcarFilterTiled(frame->image, replay->mask, WIDTH, 0, 0, WIDTH, HEIGHT,
+                      R_SMOOTH, replay->ic);
+
+    double sx = 0, sx2 = 0;
+    int num_pix = 0;
+    for (int j = b; j < HEIGHT - b; j++) {
+        for (int i = b; i < WIDTH - b; i++) {
+            sx += replay->ic[i + j*WIDTH];
+            sx2 += replay->ic[i + j*WIDTH]*replay->ic[i + j*WIDTH];
+            num_pix++;
+        }
+    }
+    double mean = sx/num_pix;
+    double sigma = sqrt((sx2 - sx*sx/num_pix)/num_pix);
+
+    int num_peaks = findPeaksTiled(replay->ic, WIDTH, b, b, WIDTH - b - 1,
+                                   HEIGHT - b - 1, mean + N_SIGMA*sigma,
+                                   &peaks);
+    int blob_count = dedupPeaks(replay->ic, WIDTH, HEIGHT, peaks, num_peaks,
+                                UNIQUE_STAR_SPACING, &blobs);
+    if (num_peaks < 0 || blob_count < 0) {
+        return -1;
+    }
+    sortBrightestBlobs(blobs, blob_count, BLOB_SORT_MAX);
+
+    if (blob_count > frame->blobs_alloc) {
+        frame->blobs_alloc = blob_count + 500;
+        frame->star_x = realloc(frame->star_x,
+                                sizeof(double)*frame->blobs_alloc);
+        frame->star_y = realloc(frame->star_y,
+                                sizeof(double)*frame->blobs_alloc);
+        frame->star_mags = realloc(frame->star_mags,
+                                   sizeof(double)*frame->blobs_alloc);
+        if (frame->star_x == NULL || frame->star_y == NULL ||
+            frame->star_mags == NULL) {
+            fprintf(stderr, "Could not allocate blob arrays.\n");
+            exit(1);
+        }
+    }
+    for (int ib = 0; ib < blob_count; ib++) {
+        frame->star_x[ib] = blobs[ib].x;
+        frame->star_y[ib] = HEIGHT - blobs[ib].y;
+        frame->star_mags[ib] = blobs[ib].mag;
+    }
+    frame->blob_count = blob_count;
+    return 1;
+}
+
+/* Solve: a fixed time in place of lostInSpace, solved if there are enough
+** blobs to make quads from. */
+static int replaySolve(struct starcam_frame * frame, void * arg) {
+    struct replay * replay = arg;
+    sleepMs(replay->solve_ms);
+    return frame->blob_count >= 4;
+}
+
+static void replayDownlink(struct starcam_frame * frame, void * arg) {
+    (void) frame;
+    (void) arg;
+}
+
+/* The frames one at a time, capture to downlink, the way
+** doCameraAndAstrometry takes them.
+*/
+static double runSequential(struct replay * replay,
+                            const struct pipeline_ops * ops) {
+    struct starcam_frame frame = {
+        .width = WIDTH,
+        .height = HEIGHT,
+        .image = malloc(WIDTH*HEIGHT),
+    };
+    double start = pipelineNowMs();
+    int status;
+
+    while ((status = ops->capture(&frame, replay)) >= 0) {
+        if (status == 1 && ops->detect(&frame, replay) == 1) {
+            ops->solve(&frame, replay);
+        }
+        ops->downlink(&frame, replay);
+    }
+    double elapsed = pipelineNowMs() - start;
+
+    free(frame.image);
+    free(frame.star_x);
+    free(frame.star_y);
+    free(frame.star_mags);
+    return elapsed;
+}
+
+int main(int argc, char * argv[]) {
+    struct replay replay = {
+        .max_frames = 20,
+        .interval_ms = 100,
+        .solve_ms = 1000,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:i:s:")) != -1) {
+        if (opt == 'n') {
+            replay.max_frames = atoi(optarg);
+        } else if (opt == 'i') {
+            replay.interval_ms = atof(optarg);
+        } else if (opt == 's') {
+            replay.solve_ms = atof(optarg);
+        } else {
+            break;
+        }
+    }
+    if (optind != argc - 1 || opt == '?') {
+        fprintf(stderr, "Usage: %s [-n frames] [-i interval_ms] "
+                "[-s solve_ms] dir\n", argv[0]);
+        return 1;
+    }
+
+    replay.mask = malloc(WIDTH*HEIGHT);
+    replay.ic = calloc(WIDTH*HEIGHT, sizeof(double));
+    memset(replay.mask, 1, WIDTH*HEIGHT);
+
+    struct pipeline_ops ops = {
+        .capture = replayCapture,
+        .detect = replayDetect,
+        .solve = replaySolve,
+        .downlink = replayDownlink,
+        .arg = &replay,
+    };
+
+    printf("%d frames every %.0f ms, %.0f ms to solve\n\n", replay.max_frames,
+           replay.interval_ms, replay.solve_ms);
+
+    if (openFrameDirectory(&replay.dir, argv[optind], 1) < 0) {
+        return 1;
+    }
+    double sequential_ms = runSequential(&replay, &ops);
+    closeFrameDirectory(&replay.dir);
+    printf("one at a time: %d frames in %.0f ms, %.2f frames/s, "
+           "%d solver runs\n", replay.captured, sequential_ms,
+           replay.captured*1e3/sequential_ms, replay.captured);
+
+    openFrameDirectory(&replay.dir, argv[optind], 1);
+    replay.captured = 0;
+    replay.next_ms = 0;
+    double start = pipelineNowMs();
+    int frames = runPipeline(&ops, WIDTH, HEIGHT);
+    double pipeline_ms = pipelineNowMs() - start;
+    closeFrameDirectory(&replay.dir);
+    if (frames < 0) {
+        return 1;
+    }
+
+    struct pipeline_stats stats;
+    getPipelineStats(&stats);
+    printf("pipeline:      %d frames in %.0f ms, %.2f frames/s, "
+           "%lu solver runs\n\n", frames, pipeline_ms, frames*1e3/pipeline_ms,
+           stats.solved + stats.failed);
+    printPipelineStats(stdout);
+
+    free(replay.mask);
+    free(replay.ic);
+    // every frame captured must have come out of the pipeline
+    return stats.stages[STAGE_DOWNLINK].frames == (unsigned long) frames ?
+           0 : 1;
+}
@@ -0,0 +1,518 @@
+/* Telemetry subscriptions over loopback.
+**
+** Runs a telemetry server with the subscription thread in this process, on a
+** few synthetic channels one of which a producer thread changes every
+** change_ms (its value is the time of the change), and subscribes to them
+** over 127.0.0.1 the way a ground client would, echoing the server's nonce:
+**   periodic   every period_ms: update rate, snapshot to arrival latency and
+**              interval jitter
+**   on change  deadband 0, checked every min_period_ms: one update per change
+**              and the latency from the change itself to its arrival
+**   rate limit a period below min_period_ms is sent at min_period_ms
+**   per IP     only TEL_MAX_SUBS_PER_IP subscriptions from one address
+**   no echo    nothing but the nonce is sent to a client that does not
+**              send it back, and a wrong nonce is refused
+**   byte cap   a subscription to a long string at 1 ms gets no more than
+**              TEL_SUB_MAX_BPS once its saved up second is spent
+**   UNSUB      no updates after it
+** Fails if any of these do not hold.
+**
+** Usage: subscribe_loopback [-r period_ms] [-c change_ms] [-m min_period_ms]
+**                           [-t seconds] [-p port]
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "telemetry_registry.h"
+#include "telemetry_subscribe.h"
+
+// the server's receive buffer, MAXLEN in server.h
+#define REQUEST_LEN 1024
+#define RECV_TIMEOUT_MS 20
+
+/* The producer's state, copied under its lock */
+static struct {
+    pthread_mutex_t lock;
+    double changed;             // [s] since the epoch, of the last change
+    int changes;
+    float temperature;
+} state = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .temperature = 21.5f,
+};
+
+static double changed_copy;
+static int changes_copy;
+static float temperature_copy;
+static char text[TEL_STRING_LEN];
+static int stop;
+
+static double nowS(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void refreshState(void) {
+    pthread_mutex_lock(&state.lock);
+    changed_copy = state.changed;
+    changes_copy = state.changes;
+    temperature_copy = state.temperature;
+    pthread_mutex_unlock(&state.lock);
+}
+
+static struct tel_source state_source = {refreshState, 0};
+
+static void getChanged(int index, struct tel_value * out) {
+    (void) index;
+    tel_set_double(out, changed_copy);
+}
+
+static void getChanges(int index, struct tel_value * out) {
+    (void) index;
+    tel_set_int(out, changes_copy);
+}
+
+static void getTemperature(int index, struct tel_value * out) {
+    (void) index;
+    tel_set_float(out, temperature_copy);
+}
+
+static void getText(int index, struct tel_value * out) {
+    (void) index;
+    tel_set_string(out, text);
+}
+
+static const struct tel_channel bench_channels[] = {
+    {"bench_changed", getChanged, 0, &state_source},
+    {"bench_changes", getChanges, 0, &state_source},
+    {"bench_temp", getTemperature, 0, &state_source},
+    {"bench_text", getText, 0, NULL},
+};
+
+static void * produce(void * arg) {
+    long change_ns = *(int *) arg*1000000L;
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+        next.tv_nsec += change_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        pthread_mutex_lock(&state.lock);
+        state.changed = nowS(CLOCK_REALTIME);
+        state.changes++;
+        pthread_mutex_unlock(&state.lock);
+    }
+    return NULL;
+}
+
+/* The server loop of server.c, answering what a subscription needs */
+static void * serveRequests(void * arg) {
+    int sockfd = *(int *) arg;
+    char request[REQUEST_LEN];
+    struct sockaddr_in client;
+
+    while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+        socklen_t client_len = sizeof(client);
+        int n = recvfrom(sockfd, request, sizeof(request) - 1, 0,
+                         (struct sockaddr *) &client, &client_len);
+
+        if (n <= 0) {
+            continue;
+        }
+        request[n] = '\0';
+        if (tel_is_subscription(request) &&
+            tel_subscribe(&client, request) < 0) {
+            sendto(sockfd, "ERROR", 5, 0, (struct sockaddr *) &client,
+                   client_len);
+        }
+    }
+    return NULL;
+}
+
+static int openSocket(int port, int bind_it, struct sockaddr_in * addr) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct timeval tv = {0, RECV_TIMEOUT_MS*1000};
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (sockfd < 0) {
+        return -1;
+    }
+    if (bind_it && bind(sockfd, (struct sockaddr *) addr, sizeof(*addr)) < 0) {
+        close(sockfd);
+        return -1;
+    }
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return sockfd;
+}
+
+static void sendRequest(int sockfd, const struct sockaddr_in * server,
+                        const char * request) {
+    sendto(sockfd, request, strlen(request), 0,
+           (const struct sockaddr *) server, sizeof(*server));
+}
+
+/* Function to subscribe the way a client has to: send the SUB and then the
+** nonce the server answers it with.
+** Input: The client socket, the server and the SUB: request.
+** Output: 1 if the nonce was sent back, 0 if the server refused or did not
+** answer.
+*/
+static int subscribe(int sockfd, const struct sockaddr_in * server,
+                     const char * request) {
+    char reply[TEL_BATCH_MAX + 1];
+    double end = nowS(CLOCK_MONOTONIC) + 0.5;
+
+    sendRequest(sockfd, server, request);
+    while (nowS(CLOCK_MONOTONIC) < end) {
+        int len = recv(sockfd, reply, sizeof(reply) - 1, 0);
+
+        if (len <= 0) {
+            continue;
+        }
+        reply[len] = '\0';
+        if (strncmp(reply, TEL_SUB_NONCE, strlen(TEL_SUB_NONCE)) == 0) {
+            sendRequest(sockfd, server, reply);
+            return 1;
+        }
+        if (strcmp(reply, "ERROR") == 0) {
+            return 0;
+        }
+        // an update of the subscription this one replaces
+    }
+    return 0;
+}
+
+/* Function to count the bytes pushed to a socket for a while. */
+static long receiveBytes(int sockfd, double seconds) {
+    uint8_t reply[TEL_BATCH_MAX];
+    double end = nowS(CLOCK_MONOTONIC) + seconds;
+    long bytes = 0;
+
+    while (nowS(CLOCK_MONOTONIC) < end) {
+        int len = recv(sockfd, reply, sizeof(reply), 0);
+
+        if (len > 0) {
+            bytes += len;
+        }
+    }
+    return bytes;
+}
+
+static int compareDoubles(const void * a, const void * b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+struct updates {
+    int count;
+    int errors;                 // text replies, refusals
+    int changes_first;          // bench_changes in the first and last update
+    int changes_last;
+    double * latency;           // [ms] snapshot to arrival
+    double * change_latency;    // [ms] change to arrival
+    double * interval;          // [ms] since the update before
+};
+
+/* Function to take the updates of a subscription for a while.
+** Input: The client socket and how long to listen.
+** Output: The updates, with up to max of each measurement.
+*/
+static void receiveUpdates(int sockfd, double seconds, int max,
+                           struct updates * u) {
+    static struct tel_value values[TEL_MAX_BATCH_CHANNELS];
+    uint8_t reply[TEL_BATCH_MAX];
+    double end = nowS(CLOCK_MONOTONIC) + seconds;
+    double last = 0;
+
+    memset(u, 0, sizeof(*u));
+    u->latency = calloc(max, sizeof(double));
+    u->change_latency = calloc(max, sizeof(double));
+    u->interval = calloc(max, sizeof(double));
+    while (nowS(CLOCK_MONOTONIC) < end) {
+        struct tel_batch_header header;
+        int len = recv(sockfd, reply, sizeof(reply), 0);
+        double arrival = nowS(CLOCK_MONOTONIC);
+        double now = nowS(CLOCK_REALTIME);
+
+        if (len <= 0) {
+            continue;
+        }
+        if (tel_unpack(reply, len, &header, values, TEL_MAX_BATCH_CHANNELS) != 3) {
+            u->errors++;
+            continue;
+        }
+        if (u->count < max) {
+            u->latency[u->count] = (now - header.time)*1e3;
+            u->change_latency[u->count] = (now - values[0].d)*1e3;
+            u->interval[u->count] = last > 0 ? (arrival - last)*1e3 : 0;
+        }
+        if (u->count == 0) {
+            u->changes_first = values[1].i;
+        }
+        u->changes_last = values[1].i;
+        last = arrival;
+        u->count++;
+    }
+    if (u->count > max) {
+        u->count = max;
+    }
+}
+
+static double percentile(double * x, int n, double p) {
+    qsort(x, n, sizeof(*x), compareDoubles);
+    return x[(int) ((n - 1)*p)];
+}
+
+static void freeUpdates(struct updates * u) {
+    free(u->latency);
+    free(u->change_latency);
+    free(u->interval);
+}
+
+int main(int argc, char * argv[]) {
+    int port = 8403;
+    int period_ms = 20;
+    int change_ms = 50;
+    int min_period_ms = 5;
+    double seconds = 2;
+    int server_fd, client_fd;
+    int per_ip[TEL_MAX_SUBS_PER_IP + 1];
+    int confirmed[TEL_MAX_SUBS_PER_IP + 1];
+    int other_fd;
+    struct sockaddr_in server_addr, client_addr;
+    char request[REQUEST_LEN];
+    struct updates u;
+    pthread_t server, producer;
+    int max;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:c:m:t:p:")) != -1) {
+        switch (opt) {
+        case 'r':
+            period_ms = atoi(optarg);
+            break;
+        case 'c':
+            change_ms = atoi(optarg);
+            break;
+        case 'm':
+            min_period_ms = atoi(optarg);
+            break;
+        case 't':
+            seconds = atof(optarg);
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r period_ms] [-c change_ms] [-m min_period_ms] "
+                    "[-t seconds] [-p port]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (period_ms < 1 || change_ms < 1 || min_period_ms < 1 || seconds <= 0) {
+        fprintf(stderr, "periods and seconds have to be positive\n");
+        return 1;
+    }
+    max = seconds*1000/min_period_ms + 16;
+
+    tel_register(bench_channels, sizeof(bench_channels)/sizeof(bench_channels[0]));
+    tel_add_group("bench", "bench_changed,bench_changes,bench_temp");
+    tel_add_group("text", "bench_text");
+    memset(text, 'x', sizeof(text) - 1);
+
+    server_fd = openSocket(port, 1, &server_addr);
+    client_fd = openSocket(0, 0, &client_addr);
+    if (server_fd < 0 || client_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    if (tel_sub_start(server_fd, min_period_ms, NULL) < 0) {
+        printf("could not start the subscription thread\n");
+        return 1;
+    }
+    pthread_create(&server, NULL, serveRequests, &server_fd);
+    pthread_create(&producer, NULL, produce, &change_ms);
+    printf("subscriptions over 127.0.0.1:%d, a change every %d ms, min period %d ms\n",
+           port, change_ms, min_period_ms);
+
+    // periodic
+    snprintf(request, sizeof(request), "%s%d:%sbench", TEL_SUB_PREFIX,
+             period_ms, TEL_GROUP_PREFIX);
+    subscribe(client_fd, &server_addr, request);
+    receiveUpdates(client_fd, seconds, max, &u);
+    if (u.count < 2 || u.errors) {
+        printf("periodic   FAILED: %d updates, %d errors\n", u.count, u.errors);
+        failed = 1;
+    } else {
+        double expected = seconds*1000/(period_ms > min_period_ms ? period_ms : min_period_ms);
+
+        printf("periodic   %4d updates in %.1f s (%.0f expected)  latency p50 %.3f ms  "
+               "p99 %.3f ms  interval %.2f-%.2f ms\n",
+               u.count, seconds, expected, percentile(u.latency, u.count, 0.5),
+               percentile(u.latency, u.count, 0.99),
+               percentile(u.interval + 1, u.count - 1, 0),
+               percentile(u.interval + 1, u.count - 1, 1));
+        if (u.count < expected*0.8 || u.count > expected*1.1 + 1) {
+            printf("periodic   FAILED: update rate off\n");
+            failed = 1;
+        }
+    }
+    freeUpdates(&u);
+
+    // on change, replacing the periodic subscription of this client
+    snprintf(request, sizeof(request), "%s%d:0:%sbench", TEL_SUB_PREFIX,
+             min_period_ms, TEL_GROUP_PREFIX);
+    subscribe(client_fd, &server_addr, request);
+    receiveUpdates(client_fd, seconds, max, &u);
+    if (u.count < 2 || u.errors) {
+        printf("on change  FAILED: %d updates, %d errors\n", u.count, u.errors);
+        failed = 1;
+    } else {
+        // the first update is sent straight away, then one per change
+        int changes = u.changes_last - u.changes_first;
+
+        printf("on change  %4d updates for %d changes  change to arrival p50 %.3f ms  "
+               "p99 %.3f ms  max %.3f ms\n",
+               u.count, changes,
+               percentile(u.change_latency + 1, u.count - 1, 0.5),
+               percentile(u.change_latency + 1, u.count - 1, 0.99),
+               percentile(u.change_latency + 1, u.count - 1, 1));
+        if (u.count - 1 != changes) {
+            printf("on change  FAILED: not one update per change\n");
+            failed = 1;
+        }
+    }
+    freeUpdates(&u);
+
+    // rate limit
+    snprintf(request, sizeof(request), "%s1:%sbench", TEL_SUB_PREFIX,
+             TEL_GROUP_PREFIX);
+    subscribe(client_fd, &server_addr, request);
+    receiveUpdates(client_fd, seconds/2, max, &u);
+    if (u.count < 2 || u.errors) {
+        printf("rate limit FAILED: %d updates, %d errors\n", u.count, u.errors);
+        failed = 1;
+    } else {
+        double sum = 0;
+
+        for (int i = 1; i < u.count; i++) {
+            sum += u.interval[i];
+        }
+        printf("rate limit %4d updates in %.1f s asking for 1 ms  mean interval %.2f ms\n",
+               u.count, seconds/2, sum/(u.count - 1));
+        if (u.count > seconds/2*1000/min_period_ms*1.1 + 1) {
+            printf("rate limit FAILED: sent faster than %d ms\n", min_period_ms);
+            failed = 1;
+        }
+    }
+    freeUpdates(&u);
+
+    // per IP, this client already has one
+    snprintf(request, sizeof(request), "%s%d:%sbench", TEL_SUB_PREFIX,
+             period_ms, TEL_GROUP_PREFIX);
+    for (int i = 0; i < TEL_MAX_SUBS_PER_IP; i++) {
+        struct sockaddr_in addr;
+
+        per_ip[i] = openSocket(0, 0, &addr);
+        confirmed[i] = subscribe(per_ip[i], &server_addr, request);
+    }
+    printf("per IP     subscription %d of %d: %s, %d subscriptions\n",
+           TEL_MAX_SUBS_PER_IP + 1, TEL_MAX_SUBS_PER_IP,
+           confirmed[TEL_MAX_SUBS_PER_IP - 1] ? "not refused" : "refused",
+           tel_num_subscriptions());
+    for (int i = 0; i < TEL_MAX_SUBS_PER_IP - 1; i++) {
+        if (!confirmed[i]) {
+            confirmed[TEL_MAX_SUBS_PER_IP - 1] = 1;    // to fail below
+        }
+    }
+    if (confirmed[TEL_MAX_SUBS_PER_IP - 1] ||
+        tel_num_subscriptions() != TEL_MAX_SUBS_PER_IP) {
+        printf("per IP     FAILED\n");
+        failed = 1;
+    }
+    for (int i = 0; i < TEL_MAX_SUBS_PER_IP; i++) {
+        sendRequest(per_ip[i], &server_addr, TEL_UNSUB);
+        close(per_ip[i]);
+    }
+
+    // no echo: only the nonce comes back, then a wrong one is refused
+    other_fd = openSocket(0, 0, &client_addr);
+    sendRequest(other_fd, &server_addr, request);
+    receiveUpdates(other_fd, 0.3, max, &u);
+    freeUpdates(&u);
+    printf("no echo    %d updates, %d other replies without the nonce sent back\n",
+           u.count, u.errors);
+    if (u.count || u.errors != 1 || tel_num_subscriptions() != 1) {
+        printf("no echo    FAILED\n");
+        failed = 1;
+    }
+    sendRequest(other_fd, &server_addr, TEL_SUB_NONCE "0123456789abcdef");
+    receiveUpdates(other_fd, 0.3, max, &u);
+    freeUpdates(&u);
+    if (u.count || u.errors != 1 || tel_num_subscriptions() != 1) {
+        printf("no echo    FAILED: a wrong nonce was not refused\n");
+        failed = 1;
+    }
+
+    // byte cap, measured once the second it saved up is spent
+    snprintf(request, sizeof(request), "%s1:%stext", TEL_SUB_PREFIX,
+             TEL_GROUP_PREFIX);
+    if (!subscribe(other_fd, &server_addr, request)) {
+        printf("byte cap   FAILED: not subscribed\n");
+        failed = 1;
+    } else {
+        double bps;
+
+        receiveBytes(other_fd, 3);
+        bps = receiveBytes(other_fd, seconds)/seconds;
+        printf("byte cap   %.0f bytes/s asking for %zu bytes every 1 ms (cap %d)\n",
+               bps, strlen(text), TEL_SUB_MAX_BPS);
+        if (bps > TEL_SUB_MAX_BPS*1.05) {
+            printf("byte cap   FAILED\n");
+            failed = 1;
+        }
+    }
+    sendRequest(other_fd, &server_addr, TEL_UNSUB);
+    receiveBytes(other_fd, 0.1);
+    close(other_fd);
+
+    // UNSUB, then anything left in flight drains within a period
+    sendRequest(client_fd, &server_addr, TEL_UNSUB);
+    receiveUpdates(client_fd, 0.1, max, &u);
+    freeUpdates(&u);
+    receiveUpdates(client_fd, 0.3, max, &u);
+    printf("UNSUB      %d updates after, %d subscriptions left\n", u.count,
+           tel_num_subscriptions());
+    if (u.count || tel_num_subscriptions() != 0) {
+        printf("UNSUB      FAILED\n");
+        failed = 1;
+    }
+    freeUpdates(&u);
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+    pthread_join(producer, NULL);
+    pthread_join(server, NULL);
+    tel_sub_stop();
+    close(server_fd);
+    close(client_fd);
+    return failed;
+}
@@ -0,0 +1,188 @@
+/* Telemetry channel lookup, registry against the old strcmp chain.
+**
+** Times finding a request's channel the way send_metric used to, comparing
+** the request with every name in turn until one matches, and with the
+** telemetry registry's hash table. Does it for the Oph channel names in the
+** order the old chain tested them, then for synthetic channel sets of
+** growing size, each for the first, middle and last name and a name that is
+** not a channel. The registry keeps every set registered so far, so its times
+** are for a table of all of them. Fails if the two ever find different
+** channels.
+**
+** Usage: telemetry_bench [-n lookups]
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telemetry_registry.h"
+
+#define NUM_SYNTHETIC_SETS 5
+
+// Oph channels in the order the old send_metric chain tested them
+static const char * oph_names[] = {
+    "sc_ra", "sc_dec", "sc_fr", "sc_ir", "sc_alt", "sc_az",
+    "sc_lat", "sc_lon", "sc_texp", "sc_start_focus", "sc_end_focus", "sc_curr_focus",
+    "sc_focus_step", "sc_focus_mode", "sc_solve", "sc_save", "mc_curr", "mc_sw",
+    "mc_lf", "mc_sr", "mc_pos", "mc_temp", "mc_vel", "mc_cwr",
+    "mc_cww", "mc_np", "mc_pt", "mc_it", "mc_dt", "mc_P",
+    "mc_I", "mc_D", "mc_gv", "mc_Imax", "mc_period", "mc_lat",
+    "mc_lat_max", "mc_jit_max", "mc_work_max", "mc_cycles", "mc_overruns", "lock_d",
+    "lock_state", "ax_mode", "ax_dest", "ax_vel", "ax_dest_az", "ax_vel_az",
+    "ax_ot", "scan_mode", "scan_start", "scan_stop", "scan_vel", "scan_scan",
+    "scan_nscans", "scan_offset", "scan_time", "scan_len", "scan_op", "target_lon",
+    "target_lat", "target_type", "sc_state", "sc_curr", "m_state", "m_curr",
+    "lp_state", "lp_curr", "lna_state", "lna_curr", "mix_state", "mix_curr",
+    "rfsoc_state", "rfsoc_curr", "gps_state", "gps_curr", "bkd_state", "bkd_curr",
+    "timing_state", "timing_curr", "heat_state", "heat_curr", "hk_state", "hk_curr",
+    "pos_state", "pos_curr", "oph_sys_cpu_temp", "oph_sys_cpu_usage", "oph_sys_mem_used", "oph_sys_mem_total",
+    "oph_sys_mem_used_str", "oph_sys_mem_total_str", "oph_sys_ssd_mounted", "oph_sys_ssd_used", "oph_sys_ssd_total", "oph_sys_ssd_path",
+    "hk_ocxo_temp", "hk_ocxo_temp_ready", "hk_pv_pressure_bar", "hk_pv_pressure_psi", "hk_pv_pressure_torr", "hk_pressure_valid",
+    "hk_ifamp_temp", "hk_lo_temp", "hk_tec_temp", "hk_backend_chassis_temp", "hk_nic_temp", "hk_rfsoc_chassis_temp",
+    "hk_rfsoc_chip_temp", "hk_lna1_temp", "hk_lna2_temp", "hk_running", "hk_powered"
+};
+
+static const int synthetic_sizes[NUM_SYNTHETIC_SETS] = {50, 100, 200, 400, 800};
+
+static volatile long sink;
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+static void getNothing(int index, struct tel_value * out) {
+    tel_set_int(out, index);
+}
+
+/* The old dispatch: every name in turn until one matches */
+static int chainLookup(const char ** names, int num_names, const char * id) {
+    for (int i = 0; i < num_names; i++) {
+        if (strcmp(id, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Function to time both lookups of one name.
+** Input: The set's names and channels, the name and the number of lookups.
+** Output: The nanoseconds per lookup of each. Returns -1 if they disagree.
+*/
+static int benchName(const char ** names, const struct tel_channel * channels,
+                     int num_names, const char * id, long lookups,
+                     double * chain_ns, double * table_ns) {
+    // copied so neither lookup can compare pointers
+    char request[64];
+    int index = chainLookup(names, num_names, id);
+    const struct tel_channel * channel = tel_lookup(id);
+    double start;
+
+    snprintf(request, sizeof(request), "%s", id);
+    if ((index < 0 && channel != NULL) ||
+        (index >= 0 && channel != &channels[index])) {
+        return -1;
+    }
+
+    start = nowNs();
+    for (long i = 0; i < lookups; i++) {
+        sink += chainLookup(names, num_names, request);
+    }
+    *chain_ns = (nowNs() - start)/lookups;
+
+    start = nowNs();
+    for (long i = 0; i < lookups; i++) {
+        sink += (long) tel_lookup(request);
+    }
+    *table_ns = (nowNs() - start)/lookups;
+    return 0;
+}
+
+static int benchSet(const char * set_name, const char ** names, int num_names,
+                    long lookups) {
+    struct tel_channel * channels = calloc(num_names, sizeof(*channels));
+    const char * ids[4];
+    const char * labels[4] = {"first", "middle", "last", "unknown"};
+    int failed = 0;
+
+    for (int i = 0; i < num_names; i++) {
+        channels[i].name = names[i];
+        channels[i].get = getNothing;
+        channels[i].index = i;
+    }
+    if (tel_register(channels, num_names) != num_names) {
+        printf("%s: could not register every channel\n", set_name);
+        return -1;
+    }
+
+    ids[0] = names[0];
+    ids[1] = names[num_names/2];
+    ids[2] = names[num_names - 1];
+    ids[3] = "not_a_channel";
+
+    printf("%-12s %5d channels (%4d registered)\n", set_name, num_names,
+           tel_num_channels());
+    for (int i = 0; i < 4; i++) {
+        double chain_ns, table_ns;
+
+        if (benchName(names, channels, num_names, ids[i], lookups,
+                      &chain_ns, &table_ns) < 0) {
+            printf("  %-8s %-24s lookups disagree\n", labels[i], ids[i]);
+            failed = 1;
+            continue;
+        }
+        printf("  %-8s %-24s chain %8.1f ns  registry %6.1f ns  (%.1fx)\n",
+               labels[i], ids[i], chain_ns, table_ns, chain_ns/table_ns);
+    }
+    return failed ? -1 : 0;
+}
+
+int main(int argc, char * argv[]) {
+    long lookups = 1000000;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            lookups = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n lookups]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (lookups < 1) {
+        lookups = 1;
+    }
+
+    if (benchSet("oph", oph_names, sizeof(oph_names)/sizeof(oph_names[0]),
+                 lookups) < 0) {
+        failed = 1;
+    }
+
+    for (int s = 0; s < NUM_SYNTHETIC_SETS; s++) {
+        int n = synthetic_sizes[s];
+        const char ** names = calloc(n, sizeof(*names));
+
+        // names like the real ones, a subsystem prefix and a field
+        for (int i = 0; i < n; i++) {
+            char * name = malloc(32);
+            snprintf(name, 32, "s%d_sub%d_field_%d", s, i % 16, i);
+            names[i] = name;
+        }
+        if (benchSet("synthetic", names, n, lookups) < 0) {
+            failed = 1;
+        }
+    }
+
+    if (failed) {
+        printf("FAILED: the registry and the chain found different channels\n");
+        return 1;
+    }
+    return 0;
+}
@@ -4,7 +4,48 @@
 int initAstrometry(FILE* log);
 void closeAstrometry();
 int lostInSpace(FILE* logfile, double * star_x, double * star_y, double * star_mags, 
-                unsigned num_blobs, struct tm * tm_info, char * datafile);
+                unsigned num_blobs, struct tm * tm_info, double el_enc, 
+                double az_enc, char * datafile);
+// elevation encoder and lazisusan angle now [deg], 0 for disabled axes
+void readAxes(double * el, double * az);
+
+/* Tracking solves: once Astrometry has solved, the next frames are solved 
+** only around where the last solution says the telescope points, moved by 
+** how much the elevation encoder and the lazisusan had turned since when the
+** frame was taken (not when it is solved), at the
+** last pixel scale and parity. If that fails the frame is solved blind. */
+// search radius around the predicted pointing, on top of the field [deg]
+#define TRACK_RADIUS    2.0
+// and this much more for every second since the last solution [deg/s]
+#define TRACK_DRIFT     0.05
+// solutions older than this are not tracked from [s]
+#define TRACK_MAX_AGE   600.0
+// fraction of the last pixel scale to search either side of it
+#define TRACK_PS_TOL    0.02
+// solve time histogram bins, the last one open ended
+#define SOLVE_HIST_BINS 8
+
+enum solve_mode {
+    SOLVE_BLIND,
+    SOLVE_TRACKING,
+    NUM_SOLVE_MODES,
+};
+
+/* Solver runs and their times in one mode [msec] */
+struct solve_stats {
+    unsigned long attempts;
+    unsigned long solved;
+    unsigned long fell_back;    // tracking failed and the frame went blind
+    double last_ms;
+    double mean_ms;
+    double max_ms;
+    double cold_ms;             // the first run in this mode
+    double warm_mean_ms;        // the runs after it
+    unsigned long hist[SOLVE_HIST_BINS];
+};
+
+void getSolveStats(enum solve_mode mode, struct solve_stats * stats);
+void printSolveStats(FILE * f);
 
 /* Astrometry parameters and solutions struct */
 #pragma pack(push, 1)
@@ -0,0 +1,38 @@
+#ifndef BLOB_FINDER_H
+#define BLOB_FINDER_H
+
+// most bands a frame is split into, one per thread including the caller
+#define BLOB_MAX_THREADS 8
+// brightest blobs findBlobs sorts by magnitude and astrometry solves with
+#define BLOB_SORT_MAX 500
+
+/* Tiled, vectorized image filtering and peak finding for findBlobs.
+** The frame is split into bands of rows that are worked on by a pool of
+** threads, and the inner loops use AVX2 or NEON where the CPU has them.
+** Results are bit-for-bit the same as the scalar single threaded code in
+** camera.c used to give: sums are exact integers, the division and
+** comparisons are the same double precision operations, and peaks come
+** back in raster order. Peaks are merged into blobs through a spatial hash
+** over a blob arena that is reused from frame to frame, and only the
+** brightest blobs are sorted.
+*/
+
+/* A blob found in a frame, at pixel (x, y) of the image in memory */
+struct blob {
+    int x;
+    int y;
+    double mag;     // 100 times the filtered pixel value
+};
+
+int setBlobThreads(int num_threads);
+int getBlobThreads();
+void boxcarFilterTiled(const char * ib, const unsigned char * mask, int w,
+                       int i0, int j0, int i1, int j1, int r_f,
+                       double * filtered_image);
+int findPeaksTiled(const double * ic, int w, int i0, int j0, int i1, int j1,
+                   double threshold, const int ** peaks);
+int dedupPeaks(const double * ic, int w, int h, const int * peaks,
+               int num_peaks, int unique_star_spacing, struct blob ** blobs);
+int sortBrightestBlobs(struct blob * blobs, int num_blobs, int max_sorted);
+
+#endif
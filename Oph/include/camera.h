@@ -40,6 +40,7 @@ void setSaveImage();
 int loadCamera(FILE* log);
 int initCamera(FILE* log);
 int doCameraAndAstrometry(FILE* log);
+int runCameraPipeline(FILE* log);
 void clean();
 void closeCamera();
 const char * printCameraError();
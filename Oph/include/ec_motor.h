@@ -226,6 +226,23 @@ typedef struct {
 
 #define ECAT_DC_SYNCH_MNG_2_TYPE 0x1C32, 1
 
+// Elevation loop timing, kept by do_motors for the mc_ telemetry channels.
+// Histogram bins are in microseconds: below 10, 20, 50, 100, 200, 500, 1000
+// and everything above
+#define LOOP_HIST_BINS 8
+
+typedef struct {
+	unsigned long cycles;
+	unsigned long overruns;       // cycles that ran past the next deadline
+	double period_ms;             // last measured period, the PID dt
+	double latency_us;            // last wake up after the deadline
+	double latency_max_us;
+	double jitter_max_us;         // largest |period - 1/MOTORSR|
+	double work_max_us;           // longest cycle from wake up to done
+	unsigned long latency_hist[LOOP_HIST_BINS];
+	unsigned long jitter_hist[LOOP_HIST_BINS];
+}motor_loop_stats_t;
+
 int configure_ec_motor(void);
 
 void enable(void);
@@ -257,4 +274,5 @@ extern FILE* motor_log;
 extern int comms_ok;
 extern double motor_offset;
 extern double parking_pos;
+extern motor_loop_stats_t motor_loop_stats;
 #endif
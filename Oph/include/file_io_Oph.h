@@ -28,6 +28,7 @@ typedef struct bvexcam_conf {
     double alt;
     int pbob;
     int relay;
+    int tracking;
 } bvexcam_conf;
 
 typedef struct accelerometer_conf {
@@ -60,6 +61,8 @@ typedef struct motor_conf {
     double pos_tol;
     int pbob;
     int relay;
+    int rt_priority; // SCHED_FIFO priority of the control loop, 0 to leave it alone
+    int cpu;         // CPU to pin the control loop to, -1 for any
 } motor_conf;
 
 typedef struct lazisusan_conf{
@@ -103,6 +106,7 @@ typedef struct starcam_downlink_conf{
 	int chunk_size;
 	int max_bandwidth_kbps;
 	int image_timeout_sec;
+	int progressive;
 	char *workdir;
 	char *notification_file;
 } starcam_downlink_conf;
@@ -113,6 +117,10 @@ typedef struct server_conf{
 	char *ip;
 	int port;
 	int timeout;
+	int sub_min_period_ms;
+	int num_groups;
+	char **group_names;
+	char **group_channels; // comma separated, as in a BATCH: request
 } server_conf;
 
 typedef struct pbob_conf{
@@ -50,7 +50,7 @@ typedef struct{
 	double scan_len;
 }ScanModeStruct;
 
-void command_motor(void);
+void command_motor(double dt);
 void go_to_enc(double angle);
 void set_el_offset(double cal_angle);
 int start_motor(void);
@@ -0,0 +1,80 @@
+#ifndef RING_LOGGER_H
+#define RING_LOGGER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+/* Binary data logging off a control thread. The control thread pushes fixed
+** size records into a lock free single producer, single consumer ring and
+** never waits on the disk. A writer thread takes whatever has built up every
+** RING_LOG_FLUSH_MS, writes it in one go and starts a new file every
+** records_per_file records. If the writer falls a whole ring behind, records
+** are dropped and counted rather than blocking the control loop.
+**
+** Each file starts with a struct ring_log_header and is followed by the
+** records back to back, in the machine's byte order. tools/ringlog_decode
+** turns them back into the text the loops used to write.
+*/
+
+#define RING_LOG_MAGIC "BCPRLOG1"
+#define RING_LOG_FLUSH_MS 50
+
+/* Record types */
+#define RING_LOG_MOTOR_PV 1     // struct motor_pv_record, elevation loop
+#define RING_LOG_LAZISUSAN 2    // struct lazisusan_record, azimuth loop
+
+struct ring_log_header {
+    char magic[8];              // RING_LOG_MAGIC
+    uint32_t record_type;
+    uint32_t record_size;
+};
+
+/* Decoded as %lf;%lf;%lf;%lf;%d;%d;%d */
+struct motor_pv_record {
+    double t;                   // [s] since the epoch
+    double position;            // [deg]
+    double velocity;            // [deg/s]
+    double current;             // [A]
+    int32_t scan;
+    int32_t turnaround;
+    int32_t scanning;
+    int32_t pad;
+};
+
+/* Decoded as %lf;%lf */
+struct lazisusan_record {
+    double t;                   // [s] since the epoch
+    double angle;               // [deg]
+};
+
+struct ring_logger {
+    uint32_t record_type;
+    uint32_t record_size;
+    uint32_t capacity;          // records, a power of two
+    uint8_t * records;
+    uint64_t head;              // records pushed, written by the control thread
+    uint64_t tail;              // records written, written by the writer
+    uint64_t dropped;           // records lost to a full ring
+    char dir[256];
+    char prefix[32];
+    long records_per_file;
+    long file_records;
+    time_t file_time;           // second the current file was started
+    int file_seq;
+    FILE * file;
+    FILE * log;                 // messages, if not NULL
+    pthread_t writer;
+    int stop;
+    int running;
+};
+
+int ring_logger_start(struct ring_logger * rl, const char * dir,
+                      const char * prefix, uint32_t record_type,
+                      uint32_t record_size, uint32_t capacity,
+                      long records_per_file, FILE * log);
+int ring_logger_push(struct ring_logger * rl, const void * record);
+void ring_logger_stop(struct ring_logger * rl);
+
+#endif
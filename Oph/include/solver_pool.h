@@ -0,0 +1,52 @@
+#ifndef SOLVER_POOL_H
+#define SOLVER_POOL_H
+
+#include <astrometry/solver.h>
+#include <astrometry/index.h>
+
+// most solvers run at once, one per thread including the caller
+#define SOLVE_MAX_WORKERS 16
+
+/* Astrometry solving split across a pool of threads. Each worker has its
+** own solver and takes every num_workers'th index of the list, so the
+** indexes are searched at the same time instead of one after the other.
+** The first worker to solve the field stops the others. An index is only
+** ever searched by one worker at a time, and solves are run one at a time
+** (lostInSpace is only called from the solver thread).
+*/
+
+/* What to solve and how, the same for every worker */
+struct solve_params {
+    const double * x;           // stars, any order
+    const double * y;
+    const double * flux;
+    int num_stars;
+    double field_width;         // [px]
+    double field_height;        // [px]
+    double funits_lower;        // pixel scale range [arcsec/px]
+    double funits_upper;
+    int parity;                 // PARITY_NORMAL, PARITY_FLIP or PARITY_BOTH
+    double quadsize_min;        // smallest quad to try [px]
+    double logodds;             // log odds a match needs to be kept
+    int use_radec;              // only search around (ra, dec)
+    double ra;                  // [deg]
+    double dec;                 // [deg]
+    double radius;              // [deg]
+    int timelimit;              // timer callbacks (about 1 s) before giving up
+    const int * stop;           // give up as soon as this is set, if not NULL
+};
+
+/* The solution, copied out of the worker's solver before it cleans up */
+struct solve_result {
+    tan_t wcs;
+    int parity;                 // PARITY_NORMAL or PARITY_FLIP
+    double logodds;
+    int worker;                 // which worker solved it
+};
+
+int setSolveWorkers(int num_workers);
+int getSolveWorkers();
+int solveOnPool(const struct solve_params * params, index_t ** indexes,
+                int num_indexes, struct solve_result * result);
+
+#endif
@@ -4,6 +4,39 @@
 #include <stdint.h>
 #include <time.h>
 
+// Compressed images kept for the ground to fetch by timestamp
+#define STARCAM_RING_SIZE 8
+// Chunks the ground can ask to be sent again before it acknowledges more
+#define MAX_RESEND_CHUNKS 256
+// Resend the oldest unacknowledged chunk when the ground is quiet this long
+#define ACK_TIMEOUT_MS 1000
+// Give up on a windowed transfer after this long without an acknowledgement
+#define TRANSFER_IDLE_SEC 30
+// Most of the bandwidth budget that can be sent in one burst [ms]
+#define BANDWIDTH_BURST_MS 20
+
+// Progressive images: a thumbnail, full resolution tiles around the
+// brightest blobs, a half resolution frame, then the full frame
+#define THUMBNAIL_SCALE 8
+#define REFINE_SCALE 2
+#define ROI_TILE_SIZE 64
+#define MAX_ROI_TILES 16
+#define ROI_QUALITY 90
+#define MAX_IMAGE_LAYERS (MAX_ROI_TILES + 3)
+
+// Compression presets by bandwidth budget: below FAST_PRESET_KBPS the fast
+// integer DCT and at most FAST_PRESET_QUALITY, below LOW_PRESET_KBPS at
+// most LOW_PRESET_QUALITY
+#define FAST_PRESET_KBPS 1000
+#define FAST_PRESET_QUALITY 50
+#define LOW_PRESET_KBPS 300
+#define LOW_PRESET_QUALITY 35
+// Blobs handed to the compression worker with a frame, for the tiles
+#define MAX_HANDOFF_BLOBS (4 * MAX_ROI_TILES)
+
+// Request flags
+#define REQUEST_PROGRESSIVE 1   // Every layer, not just the full frame
+
 // Configuration structure
 typedef struct {
     int enabled;
@@ -13,10 +46,31 @@ typedef struct {
     int chunk_size;
     int max_bandwidth_kbps;
     int image_timeout_sec;
+    int progressive;            // Encode the thumbnail, tiles and refinement too
     char workdir[256];
     char notification_file[256];
 } starcam_downlink_config_t;
 
+// Layers of a progressive image, in the order they are sent
+typedef enum {
+    LAYER_THUMBNAIL = 0,
+    LAYER_ROI = 1,
+    LAYER_REFINE = 2,
+    LAYER_FULL = 3
+} layer_type_t;
+
+// One independently decodable JPEG in an image's data
+typedef struct {
+    uint8_t type;           // layer_type_t
+    uint8_t scale;          // Full frame pixels per layer pixel, each way
+    uint16_t x;             // Top left corner in the full frame [px]
+    uint16_t y;
+    uint16_t width;         // Layer size [layer px]
+    uint16_t height;
+    uint32_t offset;        // Where its JPEG starts in the image data
+    uint32_t size;
+} __attribute__((packed)) image_layer_t;
+
 // Image data structure (replaces image_metadata_t)
 typedef struct {
     char image_path[512];
@@ -28,7 +82,10 @@ typedef struct {
     int width;
     int height;
     time_t created_time;
-    uint8_t *compressed_data;  // In-memory compressed data
+    uint8_t *compressed_data;  // In-memory compressed data, every layer
+    uint32_t compressed_alloc; // Size of the compressed_data buffer
+    image_layer_t layers[MAX_IMAGE_LAYERS];  // The full frame is the last one
+    int num_layers;
     int valid;  // Whether this slot contains valid data
 } image_data_t;
 
@@ -42,7 +99,10 @@ typedef enum {
     MSG_IMAGE_CHUNK = 6,
     MSG_IMAGE_COMPLETE = 7,
     MSG_ERROR = 8,
-    MSG_STATUS_RESPONSE = 9
+    MSG_STATUS_RESPONSE = 9,
+    MSG_IMAGE_ACK = 10,
+    MSG_IMAGE_LIST = 11,
+    MSG_IMAGE_LAYERS = 12
 } message_type_t;
 
 // Protocol structures
@@ -57,6 +117,45 @@ typedef struct {
     time_t timestamp;
 } __attribute__((packed)) get_image_by_timestamp_msg_t;
 
+// GET_LATEST_IMAGE or GET_IMAGE_BY_TIMESTAMP with a window: no more than
+// window chunks past the last acknowledged one are in flight, and the
+// transfer starts at first_chunk to resume one that was cut off. With
+// REQUEST_PROGRESSIVE every layer is sent, highest priority first, after an
+// IMAGE_LAYERS saying where each one is. Requests without it get the full
+// frame JPEG alone, and those without a window every chunk with no
+// acknowledgements.
+typedef struct {
+    message_header_t header;
+    time_t timestamp;       // ignored for GET_LATEST_IMAGE
+    uint32_t window;        // chunks in flight, 0 to send without waiting
+    uint32_t first_chunk;   // first chunk the ground does not have
+    uint32_t flags;         // REQUEST_PROGRESSIVE
+} __attribute__((packed)) image_request_msg_t;
+
+// Ground -> server during a windowed transfer
+typedef struct {
+    message_header_t header;
+    time_t timestamp;       // image being acknowledged
+    uint32_t next_chunk;    // every chunk before this one has arrived
+    uint32_t num_missing;   // chunks after next_chunk to send again
+    uint32_t missing[0];
+} __attribute__((packed)) image_ack_msg_t;
+
+// Server -> ground, answer to GET_IMAGE_LIST
+typedef struct {
+    message_header_t header;
+    uint32_t num_images;
+    time_t timestamps[0];   // oldest first
+} __attribute__((packed)) image_list_msg_t;
+
+// Server -> ground after IMAGE_HEADER in a progressive transfer
+typedef struct {
+    message_header_t header;
+    time_t timestamp;
+    uint32_t num_layers;
+    image_layer_t layers[0];    // in the order they are sent
+} __attribute__((packed)) image_layers_msg_t;
+
 typedef struct {
     message_header_t header;
     time_t timestamp;
@@ -93,11 +192,13 @@ typedef struct {
 int initStarcamDownlink(void);
 void cleanupStarcamDownlink(void);
 void notifyImageServer(const char* image_path, int blob_count, time_t timestamp, 
-                      void* raw_data, int width, int height);
+                      void* raw_data, int width, int height,
+                      const double* star_x, const double* star_y);
 int startStarcamServer(void);
 int getStarcamStatus(int *images_available_out, int *server_running_out, 
                     uint32_t *bandwidth_usage_out, int *transmission_active_out,
-                    time_t *latest_timestamp_out);
+                    time_t *latest_timestamp_out, double *compress_ms_out,
+                    double *compress_mean_ms_out);
 
 // Global configuration
 extern starcam_downlink_config_t starcam_config;
@@ -0,0 +1,125 @@
+#ifndef STARCAM_PIPELINE_H
+#define STARCAM_PIPELINE_H
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <dirent.h>
+
+// frames in flight: one being captured, one being detected, one being solved
+#define PIPELINE_SLOTS 3
+// frames captured longer ago than this are not solved [msec]
+#define PIPELINE_STALE_MS 5000
+
+/* Capture -> detect -> solve -> downlink pipeline for the star camera.
+** Each stage runs on its own thread, so frame N+1 is captured and blob
+** detected while frame N is being solved. Frames live in PIPELINE_SLOTS
+** buffers that are reused, and the queues between stages are bounded by
+** the number of slots, so a slow stage holds up capture instead of piling
+** up frames.
+**
+** The solver only ever waits on the newest frame: a frame that finishes
+** blob detection while another is already waiting to be solved replaces it,
+** and the older one goes on to downlink unsolved. Frames captured more than
+** PIPELINE_STALE_MS before the solver gets to them are not solved either.
+** Downlink takes frames as they come, so a dropped frame can go down before
+** an older one that was being solved.
+*/
+
+enum pipeline_stage {
+    STAGE_CAPTURE,
+    STAGE_DETECT,
+    STAGE_SOLVE,
+    STAGE_DOWNLINK,
+    NUM_STAGES,
+};
+
+/* Why a frame was not solved */
+enum solve_skip {
+    SOLVE_NOT_SKIPPED,
+    SOLVE_NOT_WANTED,       // detect said not to solve it
+    SOLVE_SUPERSEDED,       // a newer frame was ready for the solver
+    SOLVE_STALE,            // captured over PIPELINE_STALE_MS ago
+};
+
+/* A frame going through the pipeline. Buffers belong to the slot and are
+** kept from frame to frame. */
+struct starcam_frame {
+    unsigned long seq;          // frame number, from 1
+    int width;
+    int height;
+    char * image;               // frame as captured
+    char * filtered;            // filtered frame from blob detection
+    double * star_x;
+    double * star_y;
+    double * star_mags;
+    int blobs_alloc;            // length of the star arrays
+    int blob_count;
+    int solve;                  // capture and detect set this to solve it
+    int solved;                 // the solver found a solution
+    enum solve_skip skipped;
+    struct timeval tv;          // when it was captured
+    struct tm tm_info;          // tv in UTC, adjusted for leap years
+    double el_enc;              // elevation encoder at capture [deg]
+    double az_enc;              // lazisusan angle at capture [deg]
+    char date[256];             // saved image name without extension
+    double queued_ms[NUM_STAGES];   // when it was put in each stage's queue
+    double start_ms[NUM_STAGES];    // when each stage started on it
+    double end_ms[NUM_STAGES];      // when each stage finished with it
+};
+
+/* Stage functions. capture returns 1 if it filled the frame, 0 if it did
+** not (the slot is reused) and -1 to stop the pipeline. detect and solve
+** return 1 on success. */
+struct pipeline_ops {
+    int (*capture)(struct starcam_frame * frame, void * arg);
+    int (*detect)(struct starcam_frame * frame, void * arg);
+    int (*solve)(struct starcam_frame * frame, void * arg);
+    void (*downlink)(struct starcam_frame * frame, void * arg);
+    void * arg;
+};
+
+/* Time frames spent waiting for and in one stage [msec] */
+struct stage_stats {
+    unsigned long frames;
+    double last_ms;
+    double mean_ms;
+    double max_ms;
+    double mean_wait_ms;        // in the queue before the stage
+    double max_wait_ms;
+};
+
+struct pipeline_stats {
+    struct stage_stats stages[NUM_STAGES];
+    unsigned long captured;
+    unsigned long solved;
+    unsigned long failed;       // solver ran but found no solution
+    unsigned long superseded;   // dropped for a newer frame
+    unsigned long stale;        // dropped for waiting too long
+    double last_latency_ms;     // capture start to downlink end
+    double mean_latency_ms;
+    double max_latency_ms;
+};
+
+/* Recorded frames to replay instead of a camera: the .raw and .jpg files
+** of a directory, in name order. */
+struct frame_directory {
+    char * path;
+    struct dirent ** names;
+    int num_names;
+    int next;
+    int loop;                   // start over after the last frame
+};
+
+int runPipeline(const struct pipeline_ops * ops, int width, int height);
+void drainPipeline();
+void getPipelineStats(struct pipeline_stats * stats);
+void printPipelineStats(FILE * f);
+double pipelineNowMs();
+int openFrameDirectory(struct frame_directory * dir, const char * path,
+                       int loop);
+int readDirectoryFrame(struct frame_directory * dir,
+                       struct starcam_frame * frame);
+void closeFrameDirectory(struct frame_directory * dir);
+
+#endif
@@ -3,6 +3,11 @@
 #define _USE_MATH_DEFINES
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <astrometry/os-features.h>
 #include <astrometry/engine.h>
 #include <astrometry/solver.h>
@@ -26,6 +31,9 @@
 #include "bvexcam.h"
 #include "file_io_Oph.h"
 #include "gps_server.h"
+#include "ec_motor.h"
+#include "lazisusan.h"
+#include "solver_pool.h"
 
 /* Longitude and latitude constants (deg) */
 #define backyard_lat  44.224327
@@ -33,10 +41,43 @@
 #define backyard_hm   50
 
 engine_t * engine = NULL;
-solver_t * solver = NULL;
-int solver_timelimit;
 extern GPS_data curr_gps;
 extern int server_running;
+
+/* Last solution to track from */
+static struct {
+	int valid;
+	double t;           // when it was solved [sec, monotonic]
+	double alt, az;     // observed pointing [deg]
+	double el_enc;      // elevation encoder then [deg]
+	double az_enc;      // lazisusan angle then [deg]
+	double ps;
+	int parity;
+} last_solution;
+
+/* Solve times per mode, read by the downlink thread */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct solve_stats solve_stats[NUM_SOLVE_MODES];
+// upper edges of the solve time histogram bins [msec]
+static const double solve_hist_ms[SOLVE_HIST_BINS - 1] = {
+	50, 100, 200, 500, 1000, 2000, 5000
+};
+static const char * solve_mode_names[NUM_SOLVE_MODES] = {
+	"blind", "tracking"
+};
+
+/* Index files, loaded once and kept mapped and locked in memory */
+static struct resident_index {
+	index_t * index;
+	void * map;         // the file mapped over the solver's own mapping
+	size_t size;
+	int locked;
+} * resident = NULL;
+static int num_resident = 0;
+// the resident indexes a solve searches
+static index_t ** selected = NULL;
+static size_t resident_locked_bytes = 0;
+static double index_load_ms = 0;
 /* Astrometry parameters global structure, accessible from commands.c as well */
 struct astrometry all_astro_params = {
 	.timelimit = 1,
@@ -54,38 +95,103 @@ struct astrometry all_astro_params = {
 	.az = 0,
 };
 
-/* Function to decrement a counter for tracking Astrometry timeout.
-** Input: The pointer to the counter.
-** Output: If the counter has reached zero yet (or not).
+/* Function to load every index file once and keep it in memory. The files
+** are mapped again here and locked, which pins the pages the solver's own
+** mappings of them read from, so solves never wait on the disk.
+** Input: The log file.
+** Output: The number of indexes loaded, or -1 if there was no memory.
 */
-time_t timeout(void * arg) {
-	int * counter = (int *) arg;
+static int loadIndexes(FILE * log) {
+	struct timespec tp_start, tp_end;
+	int num_indexes = (int) pl_size((*engine).indexes);
+
+	clock_gettime(CLOCK_MONOTONIC, &tp_start);
+	resident = calloc(num_indexes, sizeof(struct resident_index));
+	selected = calloc(num_indexes, sizeof(index_t *));
+	if (num_indexes > 0 && (resident == NULL || selected == NULL)) {
+		write_to_log(log,"astrometry.c","loadIndexes","Could not allocate index list.");
+		return -1;
+	}
 
-	if (*(counter) != 0) {
-		if (verbose) {
-			printf("Have yet to solve Astrometry. Decrementing time "
-			       "counter...\n");
+	for (int i = 0; i < num_indexes; i++) {
+		index_t * index = (index_t *) pl_get((*engine).indexes, i);
+		struct resident_index * r = &resident[num_resident];
+		struct stat st;
+		int map_errno = 0;      // left 0 for an empty file
+		int fd;
+
+		if (index_reload(index)) {
+			fprintf(log, "[%ld][astrometry.c][loadIndexes] Could not load index %s, leaving it out.\n", time(NULL), index->indexname);
+			continue;
 		}
+		r->index = index;
+		num_resident++;
 
-		(*counter)--;
-
-		if (verbose) {
-			printf("Timeout counter is now %d.\n", *counter);
+		if ((fd = open(index->indexname, O_RDONLY)) < 0) {
+			fprintf(log, "[%ld][astrometry.c][loadIndexes] Could not open index %s to lock it: %s.\n", time(NULL), index->indexname, 
+			        strerror(errno));
+			continue;
 		}
-	} 
-
-	// if we are shutting down, we don't want to keep trying to solve (we just
-	// want to abort altogether)
-	if (shutting_down) {
-		if (verbose) {
-			printf("Shutting down -> zeroing timeout counter.\n");
+		if (fstat(fd, &st) != 0) {
+			map_errno = errno;
+		} else if (st.st_size > 0) {
+			r->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE, 
+			              fd, 0);
+			if (r->map == MAP_FAILED) {
+				map_errno = errno;
+				r->map = NULL;
+			} else {
+				r->size = st.st_size;
+			}
+		}
+		close(fd);
+
+		if (r->map == NULL && map_errno == 0) {
+			fprintf(log, "[%ld][astrometry.c][loadIndexes] Could not map index %s: the file is empty.\n", time(NULL), 
+			        index->indexname);
+		} else if (r->map == NULL) {
+			// errno of the failed fstat or mmap, close may have changed it
+			fprintf(log, "[%ld][astrometry.c][loadIndexes] Could not map index %s: %s.\n", time(NULL), index->indexname, 
+			        strerror(map_errno));
+		} else if (mlock(r->map, r->size) == 0) {
+			r->locked = 1;
+			resident_locked_bytes += r->size;
+		} else {
+			// still mapped and read in, just not pinned (RLIMIT_MEMLOCK)
+			fprintf(log, "[%ld][astrometry.c][loadIndexes] Could not lock index %s: %s.\n", time(NULL), index->indexname, 
+			        strerror(errno));
 		}
-		*counter = 0;
 	}
 
-	return (*counter != 0);
+	clock_gettime(CLOCK_MONOTONIC, &tp_end);
+	index_load_ms = (tp_end.tv_sec - tp_start.tv_sec)*1e3 + 
+	                (tp_end.tv_nsec - tp_start.tv_nsec)*1e-6;
+	fprintf(log, "[%ld][astrometry.c][loadIndexes] Loaded %d of %d indexes, %.1f MB locked, in %f msec.\n", time(NULL), 
+	        num_resident, num_indexes, resident_locked_bytes/1048576.0, 
+	        index_load_ms);
+	return num_resident;
 }
 
+/* Function to unlock and unmap the index files.
+** Input: None.
+** Output: None (void).
+*/
+static void releaseIndexes() {
+	for (int i = 0; i < num_resident; i++) {
+		if (resident[i].locked) {
+			munlock(resident[i].map, resident[i].size);
+		}
+		if (resident[i].map != NULL) {
+			munmap(resident[i].map, resident[i].size);
+		}
+	}
+	free(resident);
+	free(selected);
+	resident = NULL;
+	selected = NULL;
+	num_resident = 0;
+	resident_locked_bytes = 0;
+}
 
 /* Function to initialize astrometry.
 ** Input: None.
@@ -93,7 +199,6 @@ time_t timeout(void * arg) {
 */
 int initAstrometry(FILE* log) {
 	engine = engine_new();
-	solver = solver_new();
 	
 	if (engine_parse_config_file(engine, 
 	                             "/usr/local/etc/astrometry.cfg")) {
@@ -122,10 +227,12 @@ int initAstrometry(FILE* log) {
 		all_astro_params.hm=config.bvexcam.alt;
 	}
 	
-	// set solver timeout
-	solver_timelimit = (int) all_astro_params.timelimit;
-	solver->timer_callback = timeout;
-	solver->userdata = &solver_timelimit;
+	if (loadIndexes(log) < 0) {
+		return -1;
+	}
+	
+	// one solver per core, each searching a share of the indexes
+	fprintf(log, "[%ld][astrometry.c][initAstrometry] Solving with %d solvers.\n", time(NULL), setSolveWorkers(0));
 
 	return 1;
 }
@@ -138,95 +245,279 @@ void closeAstrometry() {
 	if (verbose) {
 		printf("Closing Astrometry...\n");
 	}
+	releaseIndexes();
 	engine_free(engine);
-	solver_free(solver);
 }
 
-/* Function for solving for pointing location on the sky.
+/* Function to get the monotonic time.
+** Input: None.
+** Output: Seconds since some fixed point.
+*/
+static double monotonicSec() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* Function to read the elevation encoder and the lazisusan angle.
+** Input: Where to put the elevation and azimuth [deg].
+** Output: None (void). Axes that are not enabled read 0.
+*/
+void readAxes(double * el, double * az) {
+	*el = config.motor.enabled ? 
+	      MotorData[GETREADINDEX(motor_index)].position : 0;
+	*az = config.lazisusan.enabled ? get_angle() : 0;
+}
+
+/* Function to predict where the telescope points from the last solution and
+** how far the axes had turned since by the time the frame was taken.
+** Input: Log file, time of the frame, the axes when it was taken [deg], 
+** where to put the predicted RA and DEC and the radius to search around them 
+** [deg].
+** Output: 1 if a prediction was made, 0 if the frame has to be solved blind.
+*/
+static int predictPointing(FILE * logfile, struct tm * tm_info, double el_enc, 
+                           double az_enc, double * ra, double * dec, 
+                           double * radius) {
+	double alt, az, age, d1, d2;
+
+	if (!config.bvexcam.tracking || !last_solution.valid) {
+		return 0;
+	}
+	age = monotonicSec() - last_solution.t;
+	if (age > TRACK_MAX_AGE) {
+		last_solution.valid = 0;
+		return 0;
+	}
+
+	// move the last pointing by how much the axes moved
+	alt = last_solution.alt + (el_enc - last_solution.el_enc);
+	az = last_solution.az + remainder(az_enc - last_solution.az_enc, 360.0);
+	if (alt > 90.0) {
+		alt = 90.0;
+	}
+
+	// and see where that is on the sky now
+	if (iauDtf2d("UTC", tm_info->tm_year + 1900, tm_info->tm_mon + 1, 
+	                    tm_info->tm_mday, tm_info->tm_hour, tm_info->tm_min,
+	                    (double) tm_info->tm_sec, &d1, &d2) != 0) {
+		write_to_log(logfile,"astrometry.c","predictPointing","Julian date not properly calculated.");
+		return 0;
+	}
+	if (iauAtoc13("A", az*(M_PI/180.0), (90.0 - alt)*(M_PI/180.0), d1, d2, 
+	              dut1, all_astro_params.longitude*(M_PI/180.0), 
+	              all_astro_params.latitude*(M_PI/180.0), 
+	              all_astro_params.hm, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, ra, 
+	              dec) != 0) {
+		write_to_log(logfile,"astrometry.c","predictPointing","Dubious date passed to RA/DEC calculation.");
+		return 0;
+	}
+	*ra *= 180.0/M_PI;
+	*dec *= 180.0/M_PI;
+
+	// anywhere the field can be, plus room for the axes and the sky drifting
+	*radius = last_solution.ps*hypot(CAMERA_WIDTH - 2*CAMERA_MARGIN, 
+	                                 CAMERA_HEIGHT - 2*CAMERA_MARGIN)/(2.0*3600.0)
+	          + TRACK_RADIUS + TRACK_DRIFT*age;
+	return 1;
+}
+
+/* Function to add a solver run to the solve time statistics.
+** Input: The mode, how long the solver ran [msec], if it solved and if it fell
+** back to a blind solve.
+** Output: None (void).
+*/
+static void recordSolve(enum solve_mode mode, double ms, int solved, 
+                        int fell_back) {
+	struct solve_stats * stats = &solve_stats[mode];
+	int bin = 0;
+
+	while (bin < SOLVE_HIST_BINS - 1 && ms >= solve_hist_ms[bin]) {
+		bin++;
+	}
+
+	pthread_mutex_lock(&stats_lock);
+	stats->attempts++;
+	stats->solved += solved;
+	stats->fell_back += fell_back;
+	stats->last_ms = ms;
+	stats->mean_ms += (ms - stats->mean_ms)/stats->attempts;
+	if (stats->attempts == 1) {
+		stats->cold_ms = ms;
+	} else {
+		stats->warm_mean_ms += (ms - stats->warm_mean_ms)/(stats->attempts - 1);
+	}
+	if (ms > stats->max_ms) {
+		stats->max_ms = ms;
+	}
+	stats->hist[bin]++;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/* Function to get the solve time statistics of one mode.
+** Input: The mode and where to copy its statistics.
+** Output: None (void).
+*/
+void getSolveStats(enum solve_mode mode, struct solve_stats * stats) {
+	pthread_mutex_lock(&stats_lock);
+	*stats = solve_stats[mode];
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/* Function to print the solve time statistics of each mode.
+** Input: The file to print them to.
+** Output: None (void).
+*/
+void printSolveStats(FILE * f) {
+	struct solve_stats stats;
+
+	fprintf(f, "  %d indexes resident, %.1f MB locked, loaded in %.0f msec\n",
+	        num_resident, resident_locked_bytes/1048576.0, index_load_ms);
+	for (int mode = 0; mode < NUM_SOLVE_MODES; mode++) {
+		getSolveStats(mode, &stats);
+		fprintf(f, "  %-8s %lu runs, %lu solved, %lu fell back, "
+		        "last %.0f mean %.0f max %.0f msec, cold %.0f warm mean "
+		        "%.0f msec\n", 
+		        solve_mode_names[mode], stats.attempts, stats.solved, 
+		        stats.fell_back, stats.last_ms, stats.mean_ms, stats.max_ms, 
+		        stats.cold_ms, stats.warm_mean_ms);
+		fprintf(f, "  %-8s", "");
+		for (int bin = 0; bin < SOLVE_HIST_BINS; bin++) {
+			if (bin < SOLVE_HIST_BINS - 1) {
+				fprintf(f, " <%.0f:%lu", solve_hist_ms[bin], stats.hist[bin]);
+			} else {
+				fprintf(f, " >=%.0f:%lu\n", solve_hist_ms[bin - 1], 
+				        stats.hist[bin]);
+			}
+		}
+	}
+}
+
+/* Function to run the solvers on a field once.
+** Input: The mode to solve in, the blobs, for tracking the predicted pointing
+** and the radius around it to search [deg], and where to put the solution.
+** Output: 1 if a solver solved the field.
+*/
+static int solveField(enum solve_mode mode, double * star_x, double * star_y,
+                      double * star_mags, unsigned num_blobs, double ra, 
+                      double dec, double radius, struct solve_result * result) {
+	double quadlo, quadhi;
+	int num_indexes = 0;
+	struct solve_params params = {
+		.x = star_x,
+		.y = star_y,
+		.flux = star_mags,
+		// set max number of sources
+		.num_stars = num_blobs,
+		.field_width = CAMERA_WIDTH - 2*CAMERA_MARGIN,
+		.field_height = CAMERA_HEIGHT - 2*CAMERA_MARGIN,
+		// disallow tiny quads
+		.quadsize_min = 0.1*MIN(CAMERA_WIDTH - 2*CAMERA_MARGIN, 
+		                        CAMERA_HEIGHT - 2*CAMERA_MARGIN),
+		// sets the odds ratio we will accept (logodds parameter)
+		.logodds = log(all_astro_params.logodds),
+		// every solver gets the full timeout
+		.timelimit = (int) all_astro_params.timelimit,
+		// if we are shutting down, we don't want to keep trying to solve
+		.stop = &shutting_down,
+	};
+
+	if (verbose) {
+		printf("Astrom. timeout is %i cycles.\n", params.timelimit);
+	}
+
+	// set up solver configuration
+	if (mode == SOLVE_TRACKING) {
+		params.funits_lower = last_solution.ps*(1.0 - TRACK_PS_TOL);
+		params.funits_upper = last_solution.ps*(1.0 + TRACK_PS_TOL);
+		params.parity = last_solution.parity;
+		params.use_radec = 1;
+		params.ra = ra;
+		params.dec = dec;
+		params.radius = radius;
+	} else {
+		params.funits_lower = MIN_PS;
+		params.funits_upper = MAX_PS;
+		// set parity which can speed up x2
+		params.parity = PARITY_BOTH; 
+	}
+
+	// quad sizes the field can hold at this scale [arcsec]
+	quadlo = params.quadsize_min*params.funits_lower;
+	quadhi = hypot(params.field_width, params.field_height)*params.funits_upper;
+
+	// search the resident indexes, when tracking only those whose healpix is
+	// near the search area and that hold quads of this scale
+	for (int i = 0; i < num_resident; i++) {
+		index_t * index = resident[i].index;
+		if (mode == SOLVE_TRACKING && 
+		    (!index_is_within_range(index, ra, dec, radius) || 
+		     !index_overlaps_scale_range(index, quadlo, quadhi))) {
+			continue;
+		}
+		selected[num_indexes++] = index;
+	}
+
+	return solveOnPool(&params, selected, num_indexes, result);
+}
+
+/* Function for solving for pointing location on the sky. Solves around the 
+** last solution if there is one to track from, and blind if not or if that
+** fails.
 ** Input: x coordinates of the stars (star_x), y coordinates of the stars 
 ** (star_y), magnitudes of the stars (star_mags), the number of blobs, timing 
-** structure, and the observing file name.
+** structure, the elevation encoder and lazisusan angle when the frame was 
+** taken [deg], and the observing file name.
 ** Output: the status of finding a solution or not (sol_status).
 */
 int lostInSpace(FILE* logfile,double * star_x, double * star_y, double * star_mags, unsigned 
-				num_blobs, struct tm * tm_info, char * datafile) {
-	int sol_status;
+				num_blobs, struct tm * tm_info, double el_enc, double az_enc, 
+				char * datafile) {
+	int sol_status, solved;
+	enum solve_mode mode;
 	// timers for astrometry
 	struct timespec astrom_tp_beginning, astrom_tp_end; 
-	double hprange, start, end, astrom_time;
-	double ra, dec, fr, ps, ir;
+	double start, end, astrom_time, run_start;
+	double ra, dec, fr, ps, ir, radius;
 	// for apportioning Julian dates
 	double d1, d2;
 	// 'ob' means observed (observed frame versus ICRS frame)
 	double aob, zob, hob, dob, rob, eo;
 	FILE * fptr;
-
-	// reset solver timeout
-	solver_timelimit = (int) all_astro_params.timelimit;
-	if (verbose) {
-		printf("Astrom. timeout is %i cycles.\n", *((int *) solver->userdata));
-	}
-
-	// set up solver configuration
-	solver->funits_lower = MIN_PS;
-	solver->funits_upper = MAX_PS;
-	
-	// set max number of sources
-	solver->endobj = num_blobs;
-
-	// disallow tiny quads
-	solver->quadsize_min = 0.1*MIN(CAMERA_WIDTH - 2*CAMERA_MARGIN, 
-	                               CAMERA_HEIGHT - 2*CAMERA_MARGIN);
-
-	// set parity which can speed up x2
-	solver->parity = PARITY_BOTH; 
-	
-	// sets the odds ratio we will accept (logodds parameter)
-	solver_set_keep_logodds(solver, log(all_astro_params.logodds));  
-
-	solver->logratio_totune = log(1e6);
-	solver->logratio_toprint = log(1e6);
-	solver->distance_from_quad_bonus = 1;
-
-	// figure out the index file range to search in
-	hprange = arcsec2dist(MAX_PS*hypot(CAMERA_WIDTH - 2*CAMERA_MARGIN, 
-	                                   CAMERA_HEIGHT - 2*CAMERA_MARGIN)/2.0);
-
-	// make list of stars
-	starxy_t * field = starxy_new(num_blobs, 1, 0);
+	struct solve_result result;
 
 	// start timer for astrometry 
 	if (clock_gettime(CLOCK_REALTIME, &astrom_tp_beginning) == -1) {
 		fprintf(logfile, "[%ld][astrometry.c][lostInSpace] Unable to start timer: %s.\n", time(NULL), strerror(errno));
     	}
 
-	starxy_set_x_array(field, star_x);
-	starxy_set_y_array(field, star_y);
-	starxy_set_flux_array(field, star_mags);
-	starxy_sort_by_flux(field);
-
-	solver_set_field(solver, field);
-	solver_set_field_bounds(solver, 0, CAMERA_WIDTH - 2*CAMERA_MARGIN, 0, 
-	                        CAMERA_HEIGHT - 2*CAMERA_MARGIN);
-
-	// add index files
-	for (int i = 0; i < (int) pl_size((*engine).indexes); i++) {
-		index_t * index = (index_t *) pl_get((*engine).indexes, i);
-		solver_add_index(solver, index);
-		index_reload(index);
+	mode = predictPointing(logfile, tm_info, el_enc, az_enc, &ra, &dec, &radius) ? 
+	       SOLVE_TRACKING : SOLVE_BLIND;
+	run_start = monotonicSec();
+	solved = solveField(mode, star_x, star_y, star_mags, num_blobs, ra, dec, 
+	                    radius, &result);
+
+	if (!solved && mode == SOLVE_TRACKING) {
+		recordSolve(mode, (monotonicSec() - run_start)*1e3, 0, 1);
+		fprintf(logfile, "[%ld][astrometry.c][lostInSpace] No solution within %.1f deg of RA %f DEC %f, solving blind.\n", 
+		        time(NULL), radius, ra, dec);
+
+		mode = SOLVE_BLIND;
+		run_start = monotonicSec();
+		solved = solveField(mode, star_x, star_y, star_mags, num_blobs, 0, 0,
+		                    0, &result);
 	}
-
-	solver_log_params(solver);
-	solver_run(solver);
+	recordSolve(mode, (monotonicSec() - run_start)*1e3, solved, 0);
 
 	// solution status should be 0 since we have yet to achieve a solution 
 	sol_status = 0;
-	if ((*solver).best_match_solves) {
+	if (solved) {
 		double pscale;
 		tan_t * wcs;
 
 		// get World Coordinate System data (wcs)
-		wcs = &((*solver).best_match.wcstan);
+		wcs = &result.wcs;
 		tan_pixelxy2radec(wcs, (CAMERA_WIDTH - 2*CAMERA_MARGIN - 1)/2.0, 
 		                       (CAMERA_HEIGHT - 2*CAMERA_MARGIN - 1)/2.0, &ra, 
 							   &dec);
@@ -273,6 +564,17 @@ int lostInSpace(FILE* logfile,double * star_x, double * star_y, double * star_ma
 		all_astro_params.az = aob*(180.0/M_PI); 
 		all_astro_params.fr = fr;
 		all_astro_params.ps = ps;
+
+		// track from here
+		last_solution.valid = 1;
+		last_solution.t = monotonicSec();
+		last_solution.alt = all_astro_params.alt;
+		last_solution.az = all_astro_params.az;
+		// the axes as they were when the frame was taken, not now
+		last_solution.el_enc = el_enc;
+		last_solution.az_enc = az_enc;
+		last_solution.ps = ps;
+		last_solution.parity = result.parity;
 /*
 		write_to_log(logfile,"astrometry.c","lostInSpace","");
 		fprintf(logfile,"\n+---------------------------------------------------------+\n");
@@ -296,7 +598,7 @@ int lostInSpace(FILE* logfile,double * star_x, double * star_y, double * star_ma
 		start = (double) (astrom_tp_beginning.tv_sec*1e9) + (double) astrom_tp_beginning.tv_nsec;
 		end = (double) (astrom_tp_end.tv_sec*1e9) + (double) astrom_tp_end.tv_nsec;
     		astrom_time = end - start;
-		fprintf(logfile,"[%ld][astrometry.c][lostInSpace] Astrometry solved in %f msec.\n", time(NULL), astrom_time*1e-6);
+		fprintf(logfile,"[%ld][astrometry.c][lostInSpace] Astrometry solved (%s) in %f msec.\n", time(NULL), solve_mode_names[mode], astrom_time*1e-6);
 
 		// write astrometry solution to data.txt file
 		if (verbose) {
@@ -331,9 +633,5 @@ int lostInSpace(FILE* logfile,double * star_x, double * star_y, double * star_ma
 		all_astro_params.dec = 0;
     	}
 	
-	// clean everything up and return the status
-	solver_cleanup_field(solver);
-	solver_clear_indexes(solver);
-
 	return sol_status;
 }
@@ -0,0 +1,865 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLOB_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BLOB_NEON 1
+#endif
+
+#include "blob_finder.h"
+
+typedef void (*band_job)(void * arg, int band, int num_bands);
+
+/* Pool of threads that each take one band of a job. The caller works on
+** band 0 and waits for the workers to finish the rest. Only one job runs at
+** a time, findBlobs is only called from the camera thread.
+*/
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    pthread_t threads[BLOB_MAX_THREADS - 1];
+    int num_workers;       // worker threads started, never stopped
+    int num_bands;         // bands a job is split into, 0 until first use
+    unsigned long job_id;  // bumped for every job
+    int running;           // workers still working on the current job
+    // job_id when each worker was started, it runs the jobs after that
+    unsigned long first_job[BLOB_MAX_THREADS];
+    band_job job;
+    void * arg;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+#ifdef BLOB_X86
+// -1 until checked, then whether the CPU has AVX2
+static int use_avx2 = -1;
+#endif
+
+// row box sums of the image and the mask, full frame
+static int32_t * row_s = NULL, * row_n = NULL;
+static size_t row_s_alloc = 0, row_n_alloc = 0;
+// running column sums of each band
+static int32_t * col_s[BLOB_MAX_THREADS], * col_n[BLOB_MAX_THREADS];
+static int col_alloc = 0;
+// rows of the filtered image with a pixel that had no unmasked neighbours
+static unsigned char * empty_row = NULL;
+static int empty_alloc = 0;
+// peaks found by each band, then all of them in raster order
+static int * band_peaks[BLOB_MAX_THREADS];
+static int band_num_peaks[BLOB_MAX_THREADS];
+static int band_peaks_alloc[BLOB_MAX_THREADS];
+static int band_failed[BLOB_MAX_THREADS];
+static int * all_peaks = NULL;
+static int all_peaks_alloc = 0;
+// blob arena and the spatial hash over it, grown to the most peaks seen and
+// never shrunk
+static struct blob * blob_arena = NULL;
+static int * blob_next = NULL, * blob_prev = NULL, * blob_cell = NULL;
+static size_t blob_arena_alloc = 0, blob_next_alloc = 0;
+static size_t blob_prev_alloc = 0, blob_cell_alloc = 0;
+static int * cell_head = NULL;
+static size_t cell_head_alloc = 0;
+// heap of the brightest blobs, which blobs it took and a copy of the others
+static int * sort_heap = NULL;
+static unsigned char * sort_taken = NULL;
+static struct blob * sort_rest = NULL;
+static size_t sort_heap_alloc = 0, sort_taken_alloc = 0, sort_rest_alloc = 0;
+
+/* Worker thread of the pool, runs band (arg) of every job.
+** Input: The band number.
+** Output: None, runs forever.
+*/
+static void * poolWorker(void * arg) {
+    int band = (int) (intptr_t) arg;
+
+    pthread_mutex_lock(&pool.lock);
+    unsigned long last_job = pool.first_job[band];
+    while (1) {
+        while (pool.job_id == last_job) {
+            pthread_cond_wait(&pool.start, &pool.lock);
+        }
+        last_job = pool.job_id;
+        band_job job = pool.job;
+        void * job_arg = pool.arg;
+        int num_bands = pool.num_bands;
+        pthread_mutex_unlock(&pool.lock);
+
+        if (band < num_bands) {
+            job(job_arg, band, num_bands);
+        }
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.running == 0) {
+            pthread_cond_signal(&pool.done);
+        }
+    }
+    return NULL;
+}
+
+/* Function to set how many threads findBlobs splits a frame between.
+** Input: The number of threads including the caller, 0 or less for one per
+** online CPU. Capped at BLOB_MAX_THREADS.
+** Output: The number of threads that will be used.
+*/
+int setBlobThreads(int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    if (num_threads > BLOB_MAX_THREADS) {
+        num_threads = BLOB_MAX_THREADS;
+    }
+
+#ifdef BLOB_X86
+    if (use_avx2 < 0) {
+        __builtin_cpu_init();
+        use_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+#endif
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.num_workers < num_threads - 1) {
+        int band = pool.num_workers + 1;
+        pool.first_job[band] = pool.job_id;
+        if (pthread_create(&pool.threads[pool.num_workers], NULL, poolWorker,
+                           (void *) (intptr_t) band) != 0) {
+            fprintf(stderr, "Could not start blob finding thread %d, using "
+                    "%d threads.\n", band, band);
+            num_threads = band;
+            break;
+        }
+        pool.num_workers++;
+    }
+    pool.num_bands = num_threads;
+    pthread_mutex_unlock(&pool.lock);
+    return num_threads;
+}
+
+/* Function to get how many threads findBlobs splits a frame between.
+** Input: None.
+** Output: The number of threads, including the caller.
+*/
+int getBlobThreads() {
+    if (pool.num_bands == 0) {
+        setBlobThreads(0);
+    }
+    return pool.num_bands;
+}
+
+/* Function to run a job on every band, one band per thread.
+** Input: The job and its argument.
+** Output: None (void). Returns once every band is done.
+*/
+static void runBands(band_job job, void * arg) {
+    int num_bands = getBlobThreads();
+
+    if (num_bands <= 1) {
+        job(arg, 0, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.job = job;
+    pool.arg = arg;
+    pool.running = pool.num_workers;
+    pool.job_id++;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+
+    job(arg, 0, num_bands);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.running > 0) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+/* Helper to split rows [lo, hi) evenly between bands.
+** Input: The rows, the band and the number of bands, and where to put the
+** band's first and one past last row.
+** Output: None (void).
+*/
+static void bandRows(int lo, int hi, int band, int num_bands, int * first,
+                     int * last) {
+    long rows = hi > lo ? hi - lo : 0;
+    *first = lo + (int) (rows*band/num_bands);
+    *last = lo + (int) (rows*(band + 1)/num_bands);
+}
+
+/* Helper to grow a buffer to hold at least count elements.
+** Input: The buffer, its allocated element count, the wanted count and the
+** element size.
+** Output: 0 on success, -1 if out of memory (the buffer is unchanged).
+*/
+static int growBuffer(void ** buffer, size_t * alloc, size_t count,
+                      size_t size) {
+    if (count <= *alloc) {
+        return 0;
+    }
+    void * grown = realloc(*buffer, count*size);
+    if (grown == NULL) {
+        return -1;
+    }
+    *buffer = grown;
+    *alloc = count;
+    return 0;
+}
+
+/* Row pass of the box filter: slides a 2*r_f + 1 wide window along each row
+** of the band, summing unmasked pixel values and the number of unmasked
+** pixels.
+*/
+struct boxcar_job {
+    const char * ib;
+    const unsigned char * mask;
+    int w, i0, j0, i1, j1, r_f;
+    double * out;
+};
+
+static void boxcarRowJob(void * arg, int band, int num_bands) {
+    struct boxcar_job * job = arg;
+    int r_f = job->r_f;
+    int first, last;
+
+    bandRows(job->j0, job->j1, band, num_bands, &first, &last);
+    for (int j = first; j < last; j++) {
+        const char * p = job->ib + (size_t) j*job->w;
+        const unsigned char * m = job->mask + (size_t) j*job->w;
+        int32_t * s = row_s + (size_t) j*job->w;
+        int32_t * n = row_n + (size_t) j*job->w;
+        int32_t isx = 0, cnt = 0;
+        int i;
+
+        for (i = job->i0; i < job->i0 + 2*r_f + 1; i++) {
+            cnt += m[i];
+            isx += p[i]*m[i];
+        }
+        for (i = job->i0 + r_f; i < job->i1 - r_f - 1; i++) {
+            s[i] = isx;
+            n[i] = cnt;
+            isx += m[i + r_f + 1]*p[i + r_f + 1] - m[i - r_f]*p[i - r_f];
+            cnt += m[i + r_f + 1] - m[i - r_f];
+        }
+        s[i] = isx;
+        n[i] = cnt;
+    }
+}
+
+/* Helpers for the column pass. slideColumns moves the running column sums
+** down a row, adding the row entering the box and taking off the one leaving
+** it. divideRow writes a filtered row as sum/count, which is 0/0 = NaN where
+** no pixel of the box was unmasked, and returns whether that happened.
+*/
+static void slideColumnsScalar(int32_t * cs, int32_t * cn,
+                               const int32_t * add_s, const int32_t * add_n,
+                               const int32_t * sub_s, const int32_t * sub_n,
+                               int i, int ihi) {
+    for (; i < ihi; i++) {
+        cs[i] += add_s[i] - sub_s[i];
+        cn[i] += add_n[i] - sub_n[i];
+    }
+}
+
+static int divideRowScalar(const int32_t * cs, const int32_t * cn,
+                           double * out, int i, int ihi) {
+    int empty = 0;
+    for (; i < ihi; i++) {
+        out[i] = (double) cs[i]/(double) cn[i];
+        empty |= (cn[i] == 0);
+    }
+    return empty;
+}
+
+#ifdef BLOB_X86
+__attribute__((target("avx2")))
+static void slideColumnsAvx2(int32_t * cs, int32_t * cn,
+                             const int32_t * add_s, const int32_t * add_n,
+                             const int32_t * sub_s, const int32_t * sub_n,
+                             int i, int ihi) {
+    for (; i + 8 <= ihi; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *) (cs + i));
+        __m256i n = _mm256_loadu_si256((const __m256i *) (cn + i));
+        s = _mm256_add_epi32(s, _mm256_sub_epi32(
+                _mm256_loadu_si256((const __m256i *) (add_s + i)),
+                _mm256_loadu_si256((const __m256i *) (sub_s + i))));
+        n = _mm256_add_epi32(n, _mm256_sub_epi32(
+                _mm256_loadu_si256((const __m256i *) (add_n + i)),
+                _mm256_loadu_si256((const __m256i *) (sub_n + i))));
+        _mm256_storeu_si256((__m256i *) (cs + i), s);
+        _mm256_storeu_si256((__m256i *) (cn + i), n);
+    }
+    slideColumnsScalar(cs, cn, add_s, add_n, sub_s, sub_n, i, ihi);
+}
+
+__attribute__((target("avx2")))
+static int divideRowAvx2(const int32_t * cs, const int32_t * cn, double * out,
+                         int i, int ihi) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i empty = zero;
+    for (; i + 8 <= ihi; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *) (cs + i));
+        __m256i n = _mm256_loadu_si256((const __m256i *) (cn + i));
+        empty = _mm256_or_si256(empty, _mm256_cmpeq_epi32(n, zero));
+        __m256d lo = _mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_castsi256_si128(s)),
+            _mm256_cvtepi32_pd(_mm256_castsi256_si128(n)));
+        __m256d hi = _mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_extracti128_si256(s, 1)),
+            _mm256_cvtepi32_pd(_mm256_extracti128_si256(n, 1)));
+        _mm256_storeu_pd(out + i, lo);
+        _mm256_storeu_pd(out + i + 4, hi);
+    }
+    int any_empty = !_mm256_testz_si256(empty, empty);
+    return any_empty | divideRowScalar(cs, cn, out, i, ihi);
+}
+#endif
+
+#ifdef BLOB_NEON
+static void slideColumnsNeon(int32_t * cs, int32_t * cn,
+                             const int32_t * add_s, const int32_t * add_n,
+                             const int32_t * sub_s, const int32_t * sub_n,
+                             int i, int ihi) {
+    for (; i + 4 <= ihi; i += 4) {
+        vst1q_s32(cs + i, vaddq_s32(vld1q_s32(cs + i),
+                  vsubq_s32(vld1q_s32(add_s + i), vld1q_s32(sub_s + i))));
+        vst1q_s32(cn + i, vaddq_s32(vld1q_s32(cn + i),
+                  vsubq_s32(vld1q_s32(add_n + i), vld1q_s32(sub_n + i))));
+    }
+    slideColumnsScalar(cs, cn, add_s, add_n, sub_s, sub_n, i, ihi);
+}
+
+static int divideRowNeon(const int32_t * cs, const int32_t * cn, double * out,
+                         int i, int ihi) {
+    uint32x4_t empty = vdupq_n_u32(0);
+    for (; i + 4 <= ihi; i += 4) {
+        int32x4_t s = vld1q_s32(cs + i);
+        int32x4_t n = vld1q_s32(cn + i);
+        empty = vorrq_u32(empty, vceqq_s32(n, vdupq_n_s32(0)));
+        vst1q_f64(out + i, vdivq_f64(
+            vcvtq_f64_s64(vmovl_s32(vget_low_s32(s))),
+            vcvtq_f64_s64(vmovl_s32(vget_low_s32(n)))));
+        vst1q_f64(out + i + 2, vdivq_f64(
+            vcvtq_f64_s64(vmovl_high_s32(s)),
+            vcvtq_f64_s64(vmovl_high_s32(n))));
+    }
+    return (vmaxvq_u32(empty) != 0) | divideRowScalar(cs, cn, out, i, ihi);
+}
+#endif
+
+static void slideColumns(int32_t * cs, int32_t * cn, const int32_t * add_s,
+                         const int32_t * add_n, const int32_t * sub_s,
+                         const int32_t * sub_n, int ilo, int ihi) {
+#if defined(BLOB_X86)
+    if (use_avx2) {
+        slideColumnsAvx2(cs, cn, add_s, add_n, sub_s, sub_n, ilo, ihi);
+        return;
+    }
+#elif defined(BLOB_NEON)
+    slideColumnsNeon(cs, cn, add_s, add_n, sub_s, sub_n, ilo, ihi);
+    return;
+#endif
+    slideColumnsScalar(cs, cn, add_s, add_n, sub_s, sub_n, ilo, ihi);
+}
+
+static int divideRow(const int32_t * cs, const int32_t * cn, double * out,
+                     int ilo, int ihi) {
+#if defined(BLOB_X86)
+    if (use_avx2) {
+        return divideRowAvx2(cs, cn, out, ilo, ihi);
+    }
+#elif defined(BLOB_NEON)
+    return divideRowNeon(cs, cn, out, ilo, ihi);
+#endif
+    return divideRowScalar(cs, cn, out, ilo, ihi);
+}
+
+/* Column pass of the box filter: keeps running sums of the row sums over the
+** 2*r_f + 1 rows around each output row of the band, so every pixel costs
+** the same whatever the filter radius.
+*/
+static void boxcarColumnJob(void * arg, int band, int num_bands) {
+    struct boxcar_job * job = arg;
+    int r_f = job->r_f;
+    int ilo = job->i0 + r_f, ihi = job->i1 - r_f;
+    int32_t * cs = col_s[band], * cn = col_n[band];
+    size_t w = job->w;
+    int first, last;
+
+    bandRows(job->j0 + r_f, job->j1 - r_f, band, num_bands, &first, &last);
+    if (first >= last) {
+        return;
+    }
+
+    for (int i = ilo; i < ihi; i++) {
+        cs[i] = cn[i] = 0;
+    }
+    for (int jp = first - r_f; jp <= first + r_f; jp++) {
+        for (int i = ilo; i < ihi; i++) {
+            cs[i] += row_s[i + jp*w];
+            cn[i] += row_n[i + jp*w];
+        }
+    }
+
+    for (int j = first; j < last; j++) {
+        empty_row[j] = divideRow(cs, cn, job->out + j*w, ilo, ihi);
+        if (j + 1 < last) {
+            size_t add = (j + r_f + 1)*w, sub = (j - r_f)*w;
+            slideColumns(cs, cn, row_s + add, row_n + add, row_s + sub,
+                         row_n + sub, ilo, ihi);
+        }
+    }
+}
+
+/* Function to box filter an image, ignoring masked pixels. Replaces every
+** pixel in [i0 + r_f, i1 - r_f) x [j0 + r_f, j1 - r_f) of filtered_image with
+** the mean of the unmasked pixels within r_f of it, or with the last pixel
+** written before it in raster order if there are none.
+** Input: The image bytes (ib), the mask of usable pixels (mask), the image
+** width (w), the image border indices (i0, j0, i1, j1), the filter radius
+** (r_f) and the filtered image to write to.
+** Output: None (void).
+*/
+void boxcarFilterTiled(const char * ib, const unsigned char * mask, int w,
+                       int i0, int j0, int i1, int j1, int r_f,
+                       double * filtered_image) {
+    size_t frame = (size_t) w*j1;
+
+    if (growBuffer((void **) &row_s, &row_s_alloc, frame,
+                   sizeof(int32_t)) < 0 ||
+        growBuffer((void **) &row_n, &row_n_alloc, frame,
+                   sizeof(int32_t)) < 0) {
+        fprintf(stderr, "Could not allocate blob filter buffers.\n");
+        return;
+    }
+    if (w > col_alloc) {
+        for (int band = 0; band < BLOB_MAX_THREADS; band++) {
+            free(col_s[band]);
+            free(col_n[band]);
+            col_s[band] = calloc(w, sizeof(int32_t));
+            col_n[band] = calloc(w, sizeof(int32_t));
+            if (col_s[band] == NULL || col_n[band] == NULL) {
+                fprintf(stderr, "Could not allocate blob filter buffers.\n");
+                col_alloc = 0;
+                return;
+            }
+        }
+        col_alloc = w;
+    }
+    if (j1 > empty_alloc) {
+        free(empty_row);
+        empty_row = calloc(j1, 1);
+        if (empty_row == NULL) {
+            fprintf(stderr, "Could not allocate blob filter buffers.\n");
+            empty_alloc = 0;
+            return;
+        }
+        empty_alloc = j1;
+    }
+
+    struct boxcar_job job = {
+        .ib = ib, .mask = mask, .w = w, .i0 = i0, .j0 = j0, .i1 = i1,
+        .j1 = j1, .r_f = r_f, .out = filtered_image,
+    };
+    runBands(boxcarRowJob, &job);
+    runBands(boxcarColumnJob, &job);
+
+    // pixels with nothing unmasked around them take the last value written
+    // before them, which may be in another band, so this pass is serial
+    double last_ds = 0;
+    int ilo = i0 + r_f, ihi = i1 - r_f;
+    for (int j = j0 + r_f; j < j1 - r_f && ilo < ihi; j++) {
+        double * row = filtered_image + (size_t) j*w;
+        if (empty_row[j]) {
+            for (int i = ilo; i < ihi; i++) {
+                if (isnan(row[i])) {
+                    row[i] = last_ds;
+                } else {
+                    last_ds = row[i];
+                }
+            }
+        } else {
+            last_ds = row[ihi - 1];
+        }
+    }
+}
+
+/* Peak search: every pixel above threshold that is a local maximum of its 8
+** neighbours, or is saturated, is a peak. Ties go to the first pixel in
+** raster order.
+*/
+struct peak_job {
+    const double * ic;
+    int w, i0, j0, i1, j1;
+    double threshold;
+};
+
+static inline int isPeak(const double * ic, int w, int i, int j) {
+    double ic0 = ic[i + j*w];
+    return ((ic0 >= ic[i-1 + (j-1)*w]) &&
+            (ic0 >= ic[i   + (j-1)*w]) &&
+            (ic0 >= ic[i+1 + (j-1)*w]) &&
+            (ic0 >= ic[i-1 + (j  )*w]) &&
+            (ic0 >  ic[i+1 + (j  )*w]) &&
+            (ic0 >  ic[i-1 + (j+1)*w]) &&
+            (ic0 >  ic[i   + (j+1)*w]) &&
+            (ic0 >  ic[i+1 + (j+1)*w])) ||
+           (ic0 > 254);
+}
+
+static void addPeak(int band, int idx) {
+    if (band_num_peaks[band] >= band_peaks_alloc[band]) {
+        int alloc = band_peaks_alloc[band] ? 2*band_peaks_alloc[band] : 1024;
+        int * grown = realloc(band_peaks[band], alloc*sizeof(int));
+        if (grown == NULL) {
+            band_failed[band] = 1;
+            return;
+        }
+        band_peaks[band] = grown;
+        band_peaks_alloc[band] = alloc;
+    }
+    band_peaks[band][band_num_peaks[band]++] = idx;
+}
+
+#ifdef BLOB_X86
+/* Function to find the peaks of one row, four pixels per compare.
+** Input: The job, the band and the row.
+** Output: The first column left for the scalar loop.
+*/
+__attribute__((target("avx2")))
+static int findRowPeaksAvx2(const struct peak_job * job, int band, int j) {
+    const double * row = job->ic + (size_t) j*job->w;
+    __m256d threshold = _mm256_set1_pd(job->threshold);
+    int i = job->i0;
+    for (; i + 4 <= job->i1; i += 4) {
+        int above = _mm256_movemask_pd(
+            _mm256_cmp_pd(_mm256_loadu_pd(row + i), threshold, _CMP_GT_OQ));
+        while (above) {
+            int k = __builtin_ctz(above);
+            above &= above - 1;
+            if (isPeak(job->ic, job->w, i + k, j)) {
+                addPeak(band, i + k + j*job->w);
+            }
+        }
+    }
+    return i;
+}
+#endif
+
+#ifdef BLOB_NEON
+static int findRowPeaksNeon(const struct peak_job * job, int band, int j) {
+    const double * row = job->ic + (size_t) j*job->w;
+    float64x2_t threshold = vdupq_n_f64(job->threshold);
+    int i = job->i0;
+    for (; i + 4 <= job->i1; i += 4) {
+        uint64x2_t lo = vcgtq_f64(vld1q_f64(row + i), threshold);
+        uint64x2_t hi = vcgtq_f64(vld1q_f64(row + i + 2), threshold);
+        if ((vmaxvq_u32(vreinterpretq_u32_u64(vorrq_u64(lo, hi)))) == 0) {
+            continue;
+        }
+        for (int k = 0; k < 4; k++) {
+            if (row[i + k] > job->threshold &&
+                isPeak(job->ic, job->w, i + k, j)) {
+                addPeak(band, i + k + j*job->w);
+            }
+        }
+    }
+    return i;
+}
+#endif
+
+static void peakJob(void * arg, int band, int num_bands) {
+    struct peak_job * job = arg;
+    int first, last;
+
+    band_num_peaks[band] = 0;
+    band_failed[band] = 0;
+    bandRows(job->j0, job->j1, band, num_bands, &first, &last);
+    for (int j = first; j < last; j++) {
+        const double * row = job->ic + (size_t) j*job->w;
+        int i = job->i0;
+#if defined(BLOB_X86)
+        if (use_avx2) {
+            i = findRowPeaksAvx2(job, band, j);
+        }
+#elif defined(BLOB_NEON)
+        i = findRowPeaksNeon(job, band, j);
+#endif
+        for (; i < job->i1; i++) {
+            if (row[i] > job->threshold && isPeak(job->ic, job->w, i, j)) {
+                addPeak(band, i + j*job->w);
+            }
+        }
+    }
+}
+
+/* Function to find the peaks of a filtered image: the pixels in
+** [i0, i1) x [j0, j1) that are above threshold and are a local maximum or
+** saturated. Neighbours are read one pixel outside that range.
+** Input: The filtered image (ic), its width (w), the search range, the
+** threshold and where to put the list of peaks.
+** Output: The number of peaks, or -1 if out of memory. *peaks is set to their
+** pixel indices (i + j*w) in raster order, valid until the next call.
+*/
+int findPeaksTiled(const double * ic, int w, int i0, int j0, int i1, int j1,
+                   double threshold, const int ** peaks) {
+    struct peak_job job = {
+        .ic = ic, .w = w, .i0 = i0, .j0 = j0, .i1 = i1, .j1 = j1,
+        .threshold = threshold,
+    };
+    int num_bands = getBlobThreads();
+    int num_peaks = 0;
+
+    runBands(peakJob, &job);
+
+    for (int band = 0; band < num_bands; band++) {
+        if (band_failed[band]) {
+            fprintf(stderr, "Could not allocate blob peak list.\n");
+            return -1;
+        }
+        num_peaks += band_num_peaks[band];
+    }
+    if (num_peaks > all_peaks_alloc) {
+        int * grown = realloc(all_peaks, num_peaks*sizeof(int));
+        if (grown == NULL) {
+            fprintf(stderr, "Could not allocate blob peak list.\n");
+            return -1;
+        }
+        all_peaks = grown;
+        all_peaks_alloc = num_peaks;
+    }
+    // bands are in row order, so joining them keeps raster order
+    num_peaks = 0;
+    for (int band = 0; band < num_bands; band++) {
+        memcpy(all_peaks + num_peaks, band_peaks[band],
+               band_num_peaks[band]*sizeof(int));
+        num_peaks += band_num_peaks[band];
+    }
+    *peaks = all_peaks;
+    return num_peaks;
+}
+
+// smallest grid cell, so a tiny star spacing does not make a huge grid
+#define MIN_BLOB_CELL 8
+
+static void linkBlob(int blob, int cell) {
+    blob_cell[blob] = cell;
+    blob_prev[blob] = -1;
+    blob_next[blob] = cell_head[cell];
+    if (cell_head[cell] >= 0) {
+        blob_prev[cell_head[cell]] = blob;
+    }
+    cell_head[cell] = blob;
+}
+
+static void unlinkBlob(int blob) {
+    if (blob_prev[blob] >= 0) {
+        blob_next[blob_prev[blob]] = blob_next[blob];
+    } else {
+        cell_head[blob_cell[blob]] = blob_next[blob];
+    }
+    if (blob_next[blob] >= 0) {
+        blob_prev[blob_next[blob]] = blob_prev[blob];
+    }
+}
+
+/* Function to turn peaks into blobs at least unique_star_spacing apart.
+** Peaks are taken in order. A peak within the spacing of a blob already
+** found (four times the spacing for saturated peaks) replaces every such
+** blob it is brighter than, otherwise it becomes a new blob. Blobs are kept
+** in a grid of cells about the spacing wide, so a peak is only checked
+** against the blobs in the cells around it, however crowded the frame.
+** Input: The filtered image (ic), its size (w, h), the peaks from
+** findPeaksTiled, the spacing and where to put the blobs.
+** Output: The number of blobs, or -1 if out of memory. *blobs is set to
+** them, valid until the next call.
+*/
+int dedupPeaks(const double * ic, int w, int h, const int * peaks,
+               int num_peaks, int unique_star_spacing, struct blob ** blobs) {
+    int cell_size = unique_star_spacing > MIN_BLOB_CELL ? 
+                    unique_star_spacing : MIN_BLOB_CELL;
+    int cells_x = w/cell_size + 1, cells_y = h/cell_size + 1;
+    size_t num_cells = (size_t) cells_x*cells_y;
+    size_t max_blobs = num_peaks > 0 ? num_peaks : 1;
+
+    if (growBuffer((void **) &blob_arena, &blob_arena_alloc, max_blobs,
+                   sizeof(struct blob)) < 0 ||
+        growBuffer((void **) &blob_next, &blob_next_alloc, max_blobs,
+                   sizeof(int)) < 0 ||
+        growBuffer((void **) &blob_prev, &blob_prev_alloc, max_blobs,
+                   sizeof(int)) < 0 ||
+        growBuffer((void **) &blob_cell, &blob_cell_alloc, max_blobs,
+                   sizeof(int)) < 0 ||
+        growBuffer((void **) &cell_head, &cell_head_alloc, num_cells,
+                   sizeof(int)) < 0) {
+        fprintf(stderr, "Could not allocate blob arena.\n");
+        return -1;
+    }
+    memset(cell_head, 0xff, num_cells*sizeof(int));
+
+    int blob_count = 0;
+    for (int p = 0; p < num_peaks; p++) {
+        struct blob peak = {
+            .x = peaks[p] % w,
+            .y = peaks[p] / w,
+            .mag = 100*ic[peaks[p]],
+        };
+        // FIXME: not sure why this is necessary..
+        if (peak.mag < 0) {
+            peak.mag = UINT32_MAX;
+        }
+
+        int spacing = unique_star_spacing;
+        if (peak.mag > 25400) {
+            spacing = spacing * 4;
+        }
+
+        int unique = 1;
+        if (spacing > 0) {
+            int cx0 = (peak.x - spacing + 1)/cell_size;
+            int cx1 = (peak.x + spacing - 1)/cell_size;
+            int cy0 = (peak.y - spacing + 1)/cell_size;
+            int cy1 = (peak.y + spacing - 1)/cell_size;
+            cx0 = cx0 < 0 ? 0 : cx0;
+            cy0 = cy0 < 0 ? 0 : cy0;
+            cx1 = cx1 >= cells_x ? cells_x - 1 : cx1;
+            cy1 = cy1 >= cells_y ? cells_y - 1 : cy1;
+            for (int cy = cy0; cy <= cy1; cy++) {
+                for (int cx = cx0; cx <= cx1; cx++) {
+                    int blob = cell_head[cx + cy*cells_x];
+                    while (blob >= 0) {
+                        // a replaced blob may move to a cell not yet
+                        // visited, so step on before moving it
+                        int next = blob_next[blob];
+                        struct blob * b = &blob_arena[blob];
+                        if (abs(peak.x - b->x) < spacing && 
+                            abs(peak.y - b->y) < spacing) {
+                            unique = 0;
+                            // keep the brighter one
+                            if (peak.mag > b->mag) {
+                                *b = peak;
+                                int cell = peak.x/cell_size + 
+                                           (peak.y/cell_size)*cells_x;
+                                if (cell != blob_cell[blob]) {
+                                    unlinkBlob(blob);
+                                    linkBlob(blob, cell);
+                                }
+                            }
+                        }
+                        blob = next;
+                    }
+                }
+            }
+        }
+        // if we didn't find a close one, it is unique.
+        if (unique) {
+            blob_arena[blob_count] = peak;
+            linkBlob(blob_count, peak.x/cell_size + 
+                                 (peak.y/cell_size)*cells_x);
+            blob_count++;
+        }
+    }
+    *blobs = blob_arena;
+    return blob_count;
+}
+
+/* Function to tell if blob a goes after blob b: it is dimmer, or as bright
+** and found later, like a stable sort by magnitude from brightest puts them.
+*/
+static inline int dimmerBlob(const struct blob * blobs, int a, int b) {
+    return blobs[a].mag < blobs[b].mag ||
+           (blobs[a].mag == blobs[b].mag && a > b);
+}
+
+/* Function to restore the heap property below node (root) of a heap of blob
+** indices with the dimmest blob on top.
+*/
+static void siftDownBlob(const struct blob * blobs, int * heap, int size,
+                         int root) {
+    int blob = heap[root];
+    while (2*root + 1 < size) {
+        int child = 2*root + 1;
+        if (child + 1 < size &&
+            dimmerBlob(blobs, heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!dimmerBlob(blobs, heap[child], blob)) {
+            break;
+        }
+        heap[root] = heap[child];
+        root = child;
+    }
+    heap[root] = blob;
+}
+
+/* Function to move the max_sorted brightest blobs to the front, brightest
+** first, in the order the merge sort findBlobs used gave them. The rest
+** follow in the order they were found. A heap of indices picks them in one
+** pass, so only they are sorted and nothing recurses.
+** Input: The blobs, how many there are and how many to sort.
+** Output: The number of blobs sorted, or -1 if out of memory (the blobs are
+** then left as they were).
+*/
+int sortBrightestBlobs(struct blob * blobs, int num_blobs, int max_sorted) {
+    int k = max_sorted < num_blobs ? max_sorted : num_blobs;
+    if (k <= 0) {
+        return 0;
+    }
+    if (growBuffer((void **) &sort_heap, &sort_heap_alloc, k,
+                   sizeof(int)) < 0 ||
+        growBuffer((void **) &sort_taken, &sort_taken_alloc, num_blobs, 1) < 0 ||
+        growBuffer((void **) &sort_rest, &sort_rest_alloc, num_blobs,
+                   sizeof(struct blob)) < 0) {
+        fprintf(stderr, "Could not allocate blob sort.\n");
+        return -1;
+    }
+
+    // the k brightest so far, dimmest of them on top
+    for (int blob = 0; blob < k; blob++) {
+        sort_heap[blob] = blob;
+    }
+    for (int root = k/2 - 1; root >= 0; root--) {
+        siftDownBlob(blobs, sort_heap, k, root);
+    }
+    for (int blob = k; blob < num_blobs; blob++) {
+        if (dimmerBlob(blobs, sort_heap[0], blob)) {
+            sort_heap[0] = blob;
+            siftDownBlob(blobs, sort_heap, k, 0);
+        }
+    }
+    // pop the dimmest to the back, leaving them brightest first
+    for (int size = k - 1; size > 0; size--) {
+        int dimmest = sort_heap[0];
+        sort_heap[0] = sort_heap[size];
+        sort_heap[size] = dimmest;
+        siftDownBlob(blobs, sort_heap, size, 0);
+    }
+
+    memcpy(sort_rest, blobs, num_blobs*sizeof(struct blob));
+    memset(sort_taken, 0, num_blobs);
+    for (int rank = 0; rank < k; rank++) {
+        blobs[rank] = sort_rest[sort_heap[rank]];
+        sort_taken[sort_heap[rank]] = 1;
+    }
+    int next = k;
+    for (int blob = 0; blob < num_blobs; blob++) {
+        if (!sort_taken[blob]) {
+            blobs[next++] = sort_rest[blob];
+        }
+    }
+    return k;
+}
@@ -207,11 +207,16 @@ void verifyTelemetryData() {
 ** Output: None (void). 
 */
 int updateAstrometry(FILE* log) {
-    // solve astrometry perpetually when the camera is not shutting down
-    while (!shutting_down) {
-        if (doCameraAndAstrometry((FILE *)log) < 1) {
-            fprintf(log,"[%ld][bvexcam.c][updateAstrometry]Did not solve or timeout of Astrometry properly, or did not"
-                   " auto-focus properly.\n",time(NULL));
+    // solve astrometry perpetually when the camera is not shutting down, 
+    // taking the next picture while the last one is solved
+    if (runCameraPipeline((FILE *)log) < 0) {
+        fprintf(log,"[%ld][bvexcam.c][updateAstrometry]Could not start the camera pipeline, taking pictures one at a"
+               " time.\n",time(NULL));
+        while (!shutting_down) {
+            if (doCameraAndAstrometry((FILE *)log) < 1) {
+                fprintf(log,"[%ld][bvexcam.c][updateAstrometry]Did not solve or timeout of Astrometry properly, or did not"
+                       " auto-focus properly.\n",time(NULL));
+            }
         }
     }
 
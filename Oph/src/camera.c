@@ -12,6 +12,8 @@
 #include <pthread.h>  
 
 #include "camera.h"
+#include "blob_finder.h"
+#include "starcam_pipeline.h"
 #include "astrometry.h"
 #include "bvexcam.h"
 #include "lens_adapter.h"
@@ -21,10 +23,8 @@
 
 // Forward declaration for notification function
 void notifyImageServer(const char* image_path, int blob_count, time_t timestamp, 
-                      void* raw_data, int width, int height);
-
-void merge(double A[], int p, int q, int r, double X[],double Y[]);
-void part(double A[], int p, int r, double X[], double Y[]);
+                      void* raw_data, int width, int height,
+                      const double* star_x, const double* star_y);
 
 // 1-254 are possible IDs. Command-line argument from user with ./commands
 HIDS camera_handle;          
@@ -670,64 +670,9 @@ void makeMask(char * ib, int i0, int j0, int i1, int j1, int x0, int y0,
 */
 void boxcarFilterImage(char * ib, int i0, int j0, int i1, int j1, int r_f, 
                        double * filtered_image) {
-    static int first_time = 1;
-    static char * nc = NULL;
-    static uint64_t * ibc1 = NULL;
-
-    if (first_time) {
-        nc = calloc(CAMERA_WIDTH*CAMERA_HEIGHT, 1);
-        ibc1 = calloc(CAMERA_WIDTH*CAMERA_HEIGHT, sizeof(uint64_t));
-        first_time = 0;
-    }
-
-    int b = r_f;
-    int64_t isx;
-    int s, n;
-    double ds, dn;
-    double last_ds = 0;
-
-    for (int j = j0; j < j1; j++) {
-        n = 0;
-        isx = 0;
-        for (int i = i0; i < i0 + 2*r_f + 1; i++) {
-            n += mask[i + j*CAMERA_WIDTH];
-            isx += ib[i + j*CAMERA_WIDTH]*mask[i + j*CAMERA_WIDTH];
-        }
-
-        int idx = CAMERA_WIDTH*j + i0 + r_f;
-
-        for (int i = r_f + i0; i < i1 - r_f - 1; i++) {
-            ibc1[idx] = isx;
-            nc[idx] = n;
-            isx = isx + mask[idx + r_f + 1]*ib[idx + r_f + 1] - 
-                  mask[idx - r_f]*ib[idx - r_f];
-            n = n + mask[idx + r_f + 1] - mask[idx - r_f];
-            idx++;
-        }
-
-        ibc1[idx] = isx;
-        nc[idx] = n;
-    }
-
-    for (int j = j0+b; j < j1-b; j++) {
-        for (int i = i0+b; i < i1-b; i++) {
-            n = s = 0;
-            for (int jp =- r_f; jp <= r_f; jp++) {
-                int idx = i + (j+jp)*CAMERA_WIDTH;
-                s += ibc1[idx];
-                n += nc[idx];
-            }
-            ds = s;
-            dn = n;
-            if (dn > 0.0) {
-                ds /= dn;
-                last_ds = ds;
-            } else {
-                ds = last_ds;
-            }
-            filtered_image[i + j*CAMERA_WIDTH] = ds;
-        }
-    }
+    // split across threads and vectorized, see blob_finder.c
+    boxcarFilterTiled(ib, mask, CAMERA_WIDTH, i0, j0, i1, j1, r_f, 
+                      filtered_image);
 }
 
 /* Function to find the blobs in an image.
@@ -909,77 +854,38 @@ int findBlobs(char * input_buffer, int w, int h, double ** star_x,
     }
 
     // find the blobs 
-    double ic0;
-    int blob_count = 0;
-    for (int j = j0 + b; j < j1-b-1; j++) {
-        for (int i = i0 + b; i < i1-b-1; i++) {
-            // if pixel exceeds threshold
-            if ((double) ic[i + j*w] > mean + all_blob_params.n_sigma*sigma) {
-                ic0 = ic[i + j*w];
-                // if pixel is a local maximum or saturated
-                if (((ic0 >= ic[i-1 + (j-1)*w]) &&
-                     (ic0 >= ic[i   + (j-1)*w]) &&
-                     (ic0 >= ic[i+1 + (j-1)*w]) &&
-                     (ic0 >= ic[i-1 + (j  )*w]) &&
-                     (ic0 >  ic[i+1 + (j  )*w]) &&
-                     (ic0 >  ic[i-1 + (j+1)*w]) &&
-                     (ic0 >  ic[i   + (j+1)*w]) &&
-                     (ic0 >  ic[i+1 + (j+1)*w])) ||
-                     (ic0 > 254)) {
-                      
-                    int unique = 1;
-
-                    // realloc array if necessary (when the camera looks at a 
-                    // really bright image, this slows everything down severely)
-                    if (blob_count >= num_blobs_alloc) {
-                        num_blobs_alloc += 500;
-                        *star_x = realloc(*star_x, sizeof(double)*num_blobs_alloc);
-                        *star_y = realloc(*star_y, sizeof(double)*num_blobs_alloc);
-                        *star_mags = realloc(*star_mags, sizeof(double)*num_blobs_alloc);
-                    }
-
-                    (*star_x)[blob_count] = i;
-                    (*star_y)[blob_count] = j;
-                    (*star_mags)[blob_count] = 100*ic[i + j*CAMERA_WIDTH];
-
-                    // FIXME: not sure why this is necessary..
-                    if ((*star_mags)[blob_count] < 0) {
-                        (*star_mags)[blob_count] = UINT32_MAX;
-                    }
-
-                    // if we already found a blob within SPACING and this one is
-                    // bigger, replace it.
-                    int spacing = all_blob_params.unique_star_spacing;
-                    if ((*star_mags)[blob_count] > 25400) {
-                        spacing = spacing * 4;
-                    }
-                    for (int ib = 0; ib < blob_count; ib++) {
-                        if ((abs((*star_x)[blob_count]-(*star_x)[ib]) < spacing) &&
-                            (abs((*star_y)[blob_count]-(*star_y)[ib]) < spacing)) {
-                            unique = 0;
-                            // keep the brighter one
-                            if ((*star_mags)[blob_count] > (*star_mags)[ib]) {
-                                (*star_x)[ib] = (*star_x)[blob_count];
-                                (*star_y)[ib] = (*star_y)[blob_count];
-                                (*star_mags)[ib] = (*star_mags)[blob_count];
-                            }
-                        }
-                    }
-                    // if we didn't find a close one, it is unique.
-                    if (unique) {
-                        blob_count++;
-                    }
-                }
-            }
-        }
+    const int * peaks = NULL;
+    int num_peaks = findPeaksTiled(ic, w, i0 + b, j0 + b, i1 - b - 1, 
+                                   j1 - b - 1, 
+                                   mean + all_blob_params.n_sigma*sigma, 
+                                   &peaks);
+    // merge peaks closer than the star spacing, keeping the brightest
+    struct blob * blobs = NULL;
+    int blob_count = dedupPeaks(ic, w, h, peaks, num_peaks, 
+                                all_blob_params.unique_star_spacing, &blobs);
+    if (blob_count < 0) {
+        blob_count = 0;
+    }
+
+    // brightest first, only as many as astrometry takes (if this runs out 
+    // of memory the blobs stay in the order they were found)
+    sortBrightestBlobs(blobs, blob_count, BLOB_SORT_MAX);
+
+    // grow the arrays in one go rather than 500 blobs at a time
+    if (blob_count > num_blobs_alloc) {
+        num_blobs_alloc = blob_count + 500;
+        *star_x = realloc(*star_x, sizeof(double)*num_blobs_alloc);
+        *star_y = realloc(*star_y, sizeof(double)*num_blobs_alloc);
+        *star_mags = realloc(*star_mags, sizeof(double)*num_blobs_alloc);
     }
+
     // this loop flips vertical position of blobs back to their normal location
     for (int ibb = 0; ibb < blob_count; ibb++) {
-        (*star_y)[ibb] = CAMERA_HEIGHT - (*star_y)[ibb];
+        (*star_x)[ibb] = blobs[ibb].x;
+        (*star_y)[ibb] = CAMERA_HEIGHT - blobs[ibb].y;
+        (*star_mags)[ibb] = blobs[ibb].mag;
     }
 
-    // merge sort
-    part(*star_mags, 0, blob_count - 1, *star_x, *star_y); 
     if (verbose) {
         printf("(*) Number of blobs found in image: %i\n\n", blob_count);
     }
@@ -987,59 +893,6 @@ int findBlobs(char * input_buffer, int w, int h, double ** star_x,
     return blob_count;
 }
 
-/* Function for sorting implementation.
-** Input: 
-** Output:
-*/
-void merge(double * A, int p, int q, int r, double * X, double * Y){
-    int n1 = q - p + 1, n2 = r - q;
-    int lin = n1 + 1, rin = n2 + 1;
-    double LM[lin], LX[lin], LY[lin], RM[rin], RX[rin], RY[rin];
-    int i, j, k;
-    LM[n1] = 0;
-    RM[n2] = 0;
-
-    for (i = 0; i < n1; i++) {
-        LM[i] = A[p+i];
-        LX[i] = X[p+i];
-        LY[i] = Y[p+i];
-    }
-
-    for (j = 0; j < n2; j++) {
-        RM[j] = A[q+j+1];
-        RX[j] = X[q+j+1];
-        RY[j] = Y[q+j+1];
-    }
-
-    i = 0; j = 0;
-    for (k = p; k <= r; k++) {
-        if (LM[i] >= RM[j] ){
-            A[k] = LM[i];
-            X[k] = LX[i];
-            Y[k] = LY[i];
-            i++;
-        } else {
-            A[k] = RM[j];
-            X[k] = RX[j];
-            Y[k] = RY[j];
-            j++;
-        }
-    }
-}
-
-/* Recursive part of sorting.
-** Input:
-** Output:
-*/
-void part(double * A, int p, int r, double * X, double * Y) {
-    if (p < r) {
-        int q = (p + r)/2;
-        part(A, p, q, X, Y);
-        part(A, q + 1, r, X, Y);
-        merge(A, p, q, r, X, Y);
-    }
-}
-
 /* Function to load saved images (likely from previous observing sessions, but 
 ** could also be test pictures).
 ** Inputs: the name of the image to be loaded (filename) and the active image 
@@ -1086,40 +939,14 @@ int makeTable(char * filename, double * star_mags, double * star_x,
     return 1;
 }
 
-/* Function to take observing images and solve for pointing using Astrometry.
-** Main function for the Astrometry thread in commands.c.
-** Input: None.
-** Output: A flag indicating successful round of image + solution by the camera 
-** (e.g. if the camera can't open the observing file, the function will 
-** automatically return with -1).
+/* Function to get the time of a new frame in UTC, adjusted for leap years
+** the way lostInSpace expects.
+** Input: Where to put the time of day and the broken down UTC time.
+** Output: None (void).
 */
-int doCameraAndAstrometry(FILE* log) {
-    // these must be static since this function is called perpetually in 
-    // updateAstrometry thread
-    static double * star_x = NULL, * star_y = NULL, * star_mags = NULL;
-    static char * output_buffer = NULL;
-    static int first_time = 1, af_photo = 0;
-    static FILE * af_file = NULL;
-    static FILE * fptr = NULL;
-    static int num_focus_pos;
-    static int * blob_mags;
-    int blob_count;
-    char datafile[100], buff[100], date[256];
-    static char af_filename[256];
-    wchar_t filename[200] = L"";
-    struct timespec camera_tp_beginning, camera_tp_end;
-    struct timeval tv; 
-    struct tm * tm_info;
-
-    gettimeofday(&tv,NULL);
-    // uncomment line below for testing the values of each field in the global 
-    // structure for blob_params
-    if (verbose) {
-        verifyBlobParams();
-    }
-
-    tm_info = gmtime(&tv.tv_sec);
-    all_astro_params.rawtime = tv.tv_sec;
+static void frameTime(struct timeval * tv, struct tm * tm_info) {
+    gettimeofday(tv, NULL);
+    gmtime_r(&tv->tv_sec, tm_info);
     // if it is a leap year, adjust tm_info accordingly before it is passed to 
     // calculations in lostInSpace
     if (isLeapYear(tm_info->tm_year)) {
@@ -1134,6 +961,13 @@ int doCameraAndAstrometry(FILE* log) {
             tm_info->tm_yday++;           
         }
     }
+}
+
+/* Function to take the observing location from the GPS when it has one.
+** Input: None.
+** Output: None (void).
+*/
+static void updateLocation() {
     if(config.gps_server.enabled && server_running){
                 if(curr_gps.gps_lat != 0){
                         all_astro_params.latitude=curr_gps.gps_lat;
@@ -1147,38 +981,27 @@ int doCameraAndAstrometry(FILE* log) {
                         all_astro_params.hm=curr_gps.gps_alt;
                 }
     }
-    // data file to pass to lostInSpace
-    strftime(datafile, sizeof(datafile), 
+}
+
+/* Function to open the observing data file for a frame, writing the session
+** header to it the first time.
+** Input: The log file, the frame time and where to put the data file name.
+** Output: The data file opened for appending, or NULL.
+*/
+static FILE * openDataFile(FILE * log, struct tm * tm_info, char * datafile,
+                           size_t datafile_len) {
+    static int header_written = 0;
+    char buff[100];
+    FILE * fptr;
+
+    strftime(datafile, datafile_len, 
              join_path(config.bvexcam.workdir,"/data_%b-%d.txt"), tm_info);
-    
-    // set file descriptor for observing file to NULL in case of previous bad
-    // shutdown or termination of Astrometry
-    if (fptr != NULL) {
-        fclose(fptr);
-        fptr = NULL;
-    }
-    
     if ((fptr = fopen(datafile, "a")) == NULL) {
-        fprintf(log, "[%ld][camera.c][doCameraAndAstrometry] Could not open obs. file: %s.\n",time(NULL),strerror(errno));
-        return -1;
+        fprintf(log, "[%ld][camera.c][openDataFile] Could not open obs. file: %s.\n",time(NULL),strerror(errno));
+        return NULL;
     }
 
-    if (first_time) {
-        // FIX: Allocate as unsigned char array for proper image data handling
-        output_buffer = calloc(CAMERA_WIDTH*CAMERA_HEIGHT, sizeof(unsigned char));
-        if (output_buffer == NULL) {
-            fprintf(log, "[%ld][camera.c][doCameraAndAstrometry] Error allocating output buffer: %s.\n", time(NULL), 
-                    strerror(errno));
-            return -1;
-        }
-
-        blob_mags = calloc(default_focus_photos, sizeof(int));
-        if (blob_mags == NULL) {
-            fprintf(log, "[%ld][camera.c][doCameraAndAstrometry.c] Error allocating array for blob mags: %s.\n", time(NULL), 
-                    strerror(errno));
-            return -1;
-        }
-
+    if (!header_written) {
         // get frame rate again
         is_SetFrameRate(camera_handle, IS_GET_FRAMERATE, (void *) &actual_fps);
 
@@ -1220,11 +1043,132 @@ int doCameraAndAstrometry(FILE* log) {
         if (fprintf(fptr, "\nC time|GMT|Blob #|RA (deg)|DEC (deg)|FR (deg)|PS|"
                           "ALT (deg)|AZ (deg)|IR (deg)|Astrom. solve time "
                           "(msec)|Camera time (msec)") < 0) {
-            fprintf(log, "[%ld][camera.c][doCameraAndAstrometry]Error writing header to observing file: %s.\n", time(NULL),
+            fprintf(log, "[%ld][camera.c][openDataFile]Error writing header to observing file: %s.\n", time(NULL),
                     strerror(errno));
         }
 
         fflush(fptr);
+        header_written = 1;
+    }
+    return fptr;
+}
+
+/* Function to take an image with the camera and save it if saving is on.
+** Input: The log file, the frame time and where to put the name the image is
+** saved under (without extension).
+** Output: None (void). The image is in the camera memory (memory).
+*/
+static void takeImage(FILE * log, struct timeval * tv, struct tm * tm_info, 
+                      char * date, size_t date_len) {
+    wchar_t filename[200] = L"";
+
+    //take an image
+    if (verbose) {
+        printf("\n> Taking a new image...\n\n");
+    }
+
+    taking_image = 1;
+    if (is_FreezeVideo(camera_handle, IS_WAIT) != IS_SUCCESS) {
+       const char * last_error_str = printCameraError();
+       fprintf(log, "[%ld][camera.c][takeImage] Failed to capture new image: %s\n", time(NULL), last_error_str);
+    } 
+    taking_image = 0;
+
+    // get the image from memory
+    if (is_GetActSeqBuf(camera_handle, &buffer_num, &waiting_mem, &memory) 
+        != IS_SUCCESS) {
+        cam_error = printCameraError();
+        fprintf(log,"[%ld][camera.c][takeImage] Error retrieving the active image memory: %s.\n", time(NULL), cam_error);
+    }
+    strftime(date, date_len, join_path(config.bvexcam.workdir,"/pics/saved_image_%Y-%m-%d_%H:%M:%S"), tm_info);
+    swprintf(filename, 200, L"%s:%ld.jpg", date,tv->tv_usec);
+
+    if (all_camera_params.save_image) {
+        ImageFileParams.pwchFileName = filename;
+        if (is_ImageFile(camera_handle, IS_IMAGE_FILE_CMD_SAVE, 
+                        (void *) &ImageFileParams, sizeof(ImageFileParams)) != IS_SUCCESS) {
+            const char * last_error_str = printCameraError();
+            fprintf(log,"[%ld][camera.c][takeImage] Failed to save image: %s\n", time(NULL), last_error_str);
+        } else {
+            fprintf(log,"[%ld][camera.c][takeImage] Saving to %ls\n", time(NULL),filename);
+        }
+
+        // unlink whatever the latest saved image was linked to before
+        unlink(join_path(config.bvexcam.workdir,"/latest_saved_image.jpg"));
+        // sym link current date to latest image for live Kst updates
+        symlink((const char*)filename, join_path(config.bvexcam.workdir,"/latest_saved_image.jpg"));
+         } else {
+         if (verbose) {
+             printf("Image saving disabled - skipping save operation\n");
+         }
+     }
+}
+
+/* Function to take observing images and solve for pointing using Astrometry.
+** Main function for the Astrometry thread in commands.c.
+** Input: None.
+** Output: A flag indicating successful round of image + solution by the camera 
+** (e.g. if the camera can't open the observing file, the function will 
+** automatically return with -1).
+*/
+int doCameraAndAstrometry(FILE* log) {
+    // these must be static since this function is called perpetually in 
+    // updateAstrometry thread
+    static double * star_x = NULL, * star_y = NULL, * star_mags = NULL;
+    static char * output_buffer = NULL;
+    static int first_time = 1, af_photo = 0;
+    static FILE * af_file = NULL;
+    static FILE * fptr = NULL;
+    static int num_focus_pos;
+    static int * blob_mags;
+    int blob_count = 0;
+    char datafile[100], buff[100], date[256];
+    static char af_filename[256];
+    wchar_t filename[200] = L"";
+    struct timespec camera_tp_beginning, camera_tp_end;
+    struct timeval tv; 
+    struct tm tm_buf;
+    struct tm * tm_info = &tm_buf;
+    double el_enc, az_enc;
+
+    // uncomment line below for testing the values of each field in the global 
+    // structure for blob_params
+    if (verbose) {
+        verifyBlobParams();
+    }
+
+    frameTime(&tv, tm_info);
+    all_astro_params.rawtime = tv.tv_sec;
+    updateLocation();
+    
+    // set file descriptor for observing file to NULL in case of previous bad
+    // shutdown or termination of Astrometry
+    if (fptr != NULL) {
+        fclose(fptr);
+        fptr = NULL;
+    }
+    
+    // data file to pass to lostInSpace
+    if ((fptr = openDataFile(log, tm_info, datafile, sizeof(datafile))) == NULL) {
+        return -1;
+    }
+
+    if (first_time) {
+        // FIX: Allocate as unsigned char array for proper image data handling
+        output_buffer = calloc(CAMERA_WIDTH*CAMERA_HEIGHT, sizeof(unsigned char));
+        if (output_buffer == NULL) {
+            fprintf(log, "[%ld][camera.c][doCameraAndAstrometry] Error allocating output buffer: %s.\n", time(NULL), 
+                    strerror(errno));
+            return -1;
+        }
+
+        blob_mags = calloc(default_focus_photos, sizeof(int));
+        if (blob_mags == NULL) {
+            fprintf(log, "[%ld][camera.c][doCameraAndAstrometry.c] Error allocating array for blob mags: %s.\n", time(NULL), 
+                    strerror(errno));
+            return -1;
+        }
+
         first_time = 0;
     }
 
@@ -1312,46 +1256,8 @@ int doCameraAndAstrometry(FILE* log) {
         symlink(af_filename, join_path(config.bvexcam.workdir,"/latest_auto_focus_data.txt"));
     }
 
-    //take an image
-    if (verbose) {
-        printf("\n> Taking a new image...\n\n");
-    }
-
-    taking_image = 1;
-    if (is_FreezeVideo(camera_handle, IS_WAIT) != IS_SUCCESS) {
-       const char * last_error_str = printCameraError();
-       fprintf(log, "[%ld][camera.c][doCameraAndAstrometry] Failed to capture new image: %s\n", time(NULL), last_error_str);
-    } 
-    taking_image = 0;
-
-    // get the image from memory
-    if (is_GetActSeqBuf(camera_handle, &buffer_num, &waiting_mem, &memory) 
-        != IS_SUCCESS) {
-        cam_error = printCameraError();
-        fprintf(log,"[%ld][camera.c][doCameraAndAstrometry] Error retrieving the active image memory: %s.\n", time(NULL), cam_error);
-    }
-    strftime(date, sizeof(date), join_path(config.bvexcam.workdir,"/pics/saved_image_%Y-%m-%d_%H:%M:%S"), tm_info);
-    swprintf(filename, 200, L"%s:%ld.jpg", date,tv.tv_usec);
-
-    if (all_camera_params.save_image) {
-        ImageFileParams.pwchFileName = filename;
-        if (is_ImageFile(camera_handle, IS_IMAGE_FILE_CMD_SAVE, 
-                        (void *) &ImageFileParams, sizeof(ImageFileParams)) != IS_SUCCESS) {
-            const char * last_error_str = printCameraError();
-            fprintf(log,"[%ld][camera.c][doCameraAndAstrometry] Failed to save image: %s\n", time(NULL), last_error_str);
-        } else {
-            fprintf(log,"[%ld][camera.c][doCameraAndAstrometry] Saving to %ls\n", time(NULL),filename);
-        }
-
-        // unlink whatever the latest saved image was linked to before
-        unlink(join_path(config.bvexcam.workdir,"/latest_saved_image.jpg"));
-        // sym link current date to latest image for live Kst updates
-        symlink((const char*)filename, join_path(config.bvexcam.workdir,"/latest_saved_image.jpg"));
-         } else {
-         if (verbose) {
-             printf("Image saving disabled - skipping save operation\n");
-         }
-     }
+    readAxes(&el_enc, &az_enc);
+    takeImage(log, &tv, tm_info, date, sizeof(date));
     // testing pictures that have already been taken 
     /*
     if (loadDummyPicture(L"/home/felix/blastcam/pics/test_2.jpg", 
@@ -1567,8 +1473,10 @@ int doCameraAndAstrometry(FILE* log) {
             		printf("\n> Trying to solve astrometry...\n");
        	 	}
 
-        	if (lostInSpace(log,star_x, star_y, star_mags, blob_count, tm_info, 
-                	        datafile) != 1) {
+        	// only the brightest blobs are sorted to the front
+        	if (lostInSpace(log,star_x, star_y, star_mags, 
+        	                (blob_count < BLOB_SORT_MAX) ? blob_count : BLOB_SORT_MAX, 
+        	                tm_info, el_enc, az_enc, datafile) != 1) {
             		write_to_log(log,"camera.c","doCameraAndAstrometry","Could not solve Astrometry.");
         	}
 
@@ -1618,7 +1526,8 @@ int doCameraAndAstrometry(FILE* log) {
     // Notify image server of new image for downlink
     // FIX: Send original camera image data (before blob processing) instead of processed buffers
     // The 'memory' buffer was overwritten by processed data, so use original_camera_data
-    notifyImageServer(date, blob_count, tv.tv_sec, original_camera_data, CAMERA_WIDTH, CAMERA_HEIGHT);
+    notifyImageServer(date, blob_count, tv.tv_sec, original_camera_data, CAMERA_WIDTH, CAMERA_HEIGHT,
+                      star_x, star_y);
 
     // make a table of blobs for Kst
     if (all_camera_params.solve_img){
@@ -1663,3 +1572,213 @@ int doCameraAndAstrometry(FILE* log) {
     }
     return 1;
 }
+
+// how often the pipeline latency counters go to the log [frames]
+#define PIPELINE_STATS_FRAMES 100
+
+/* Function for the capture stage of the pipeline: takes an image into a 
+** frame. While auto-focusing, doCameraAndAstrometry takes the images one at 
+** a time instead, with the rest of the pipeline idle, since the lens moves 
+** between them.
+** Input: The frame and the log file.
+** Output: 1 if the frame was filled, 0 if not and -1 when shutting down.
+*/
+static int captureStage(struct starcam_frame * frame, void * arg) {
+    FILE * log = (FILE *) arg;
+
+    if (shutting_down) {
+        return -1;
+    }
+
+    if (all_camera_params.focus_mode) {
+        drainPipeline();
+        if (doCameraAndAstrometry(log) < 1) {
+            fprintf(log,"[%ld][camera.c][captureStage] Did not auto-focus properly.\n", time(NULL));
+        }
+        return 0;
+    }
+
+    if (verbose) {
+        verifyBlobParams();
+    }
+
+    frameTime(&frame->tv, &frame->tm_info);
+    // the frame may wait in the pipeline, so track from where it was taken
+    readAxes(&frame->el_enc, &frame->az_enc);
+    takeImage(log, &frame->tv, &frame->tm_info, frame->date, 
+              sizeof(frame->date));
+    if (memory == NULL) {
+        return 0;
+    }
+    // the camera memory is reused by the next image, so keep a copy
+    memcpy(frame->image, memory, CAMERA_WIDTH*CAMERA_HEIGHT);
+    frame->solve = all_camera_params.solve_img;
+    return 1;
+}
+
+/* Function for the detect stage of the pipeline: finds the blobs in a frame
+** that is to be solved.
+** Input: The frame and the log file.
+** Output: 1 if the blobs were found, -1 if they could not be stored.
+*/
+static int detectStage(struct starcam_frame * frame, void * arg) {
+    FILE * log = (FILE *) arg;
+    // findBlobs keeps track of how big these are, so they are shared by all
+    // frames and the blobs are copied out
+    static double * star_x = NULL, * star_y = NULL, * star_mags = NULL;
+
+    if (!frame->solve) {
+        return 1;
+    }
+
+    frame->blob_count = findBlobs(frame->image, CAMERA_WIDTH, CAMERA_HEIGHT, 
+                                  &star_x, &star_y, &star_mags, 
+                                  frame->filtered);
+
+    if (frame->blob_count > frame->blobs_alloc) {
+        int alloc = frame->blob_count + 500;
+        double * x = realloc(frame->star_x, sizeof(double)*alloc);
+        if (x != NULL) {
+            frame->star_x = x;
+        }
+        double * y = realloc(frame->star_y, sizeof(double)*alloc);
+        if (y != NULL) {
+            frame->star_y = y;
+        }
+        double * mags = realloc(frame->star_mags, sizeof(double)*alloc);
+        if (mags != NULL) {
+            frame->star_mags = mags;
+        }
+        if (x == NULL || y == NULL || mags == NULL) {
+            fprintf(log, "[%ld][camera.c][detectStage] Error allocating blob arrays: %s.\n", time(NULL), 
+                    strerror(errno));
+            frame->blob_count = 0;
+            return -1;
+        }
+        frame->blobs_alloc = alloc;
+    }
+    if (frame->blob_count > 0) {
+        memcpy(frame->star_x, star_x, sizeof(double)*frame->blob_count);
+        memcpy(frame->star_y, star_y, sizeof(double)*frame->blob_count);
+        memcpy(frame->star_mags, star_mags, 
+               sizeof(double)*frame->blob_count);
+    }
+
+    // pointer for transmitting to user should point to the filtered image
+    camera_raw = frame->filtered;
+    return 1;
+}
+
+/* Function for the solve stage of the pipeline: solves a frame with 
+** Astrometry and writes the result to the observing data file.
+** Input: The frame and the log file.
+** Output: 1 if a solution was found.
+*/
+static int solveStage(struct starcam_frame * frame, void * arg) {
+    FILE * log = (FILE *) arg;
+    FILE * fptr;
+    char datafile[100], buff[100];
+    double camera_time;
+    int sol_status;
+
+    send_data = 1;
+    all_astro_params.rawtime = frame->tv.tv_sec;
+    updateLocation();
+
+    if ((fptr = openDataFile(log, &frame->tm_info, datafile, 
+                             sizeof(datafile))) == NULL) {
+        return -1;
+    }
+
+    // write blob and time information to data file
+    strftime(buff, sizeof(buff), "%b %d %H:%M:%S", &frame->tm_info); 
+    fprintf(log,"[%ld][camera.c][solveStage] Time going into Astrometry.net: %s\n", time(NULL), buff);
+    if (fprintf(fptr, "\r%li|%s|", frame->tv.tv_sec, buff) < 0) {
+        fprintf(log, "[%ld][camera.c][solveStage] Unable to write time and blob count to observing "
+                "file: %s.\n", time(NULL), strerror(errno));
+    }
+    fflush(fptr);
+
+    // solve astrometry
+    if (verbose) {
+        printf("\n> Trying to solve astrometry...\n");
+    }
+
+    // only the brightest blobs are sorted to the front
+    sol_status = lostInSpace(log, frame->star_x, frame->star_y, 
+                             frame->star_mags, 
+                             (frame->blob_count < BLOB_SORT_MAX) ? 
+                             frame->blob_count : BLOB_SORT_MAX, 
+                             &frame->tm_info, frame->el_enc, frame->az_enc,
+                             datafile);
+    if (sol_status != 1) {
+        write_to_log(log,"camera.c","solveStage","Could not solve Astrometry.");
+    }
+
+    // time from after blob finding to the solution, as doCameraAndAstrometry
+    // counts it, now including the time the frame waited for the solver
+    camera_time = pipelineNowMs() - frame->end_ms[STAGE_DETECT];
+    fprintf(log,"[%ld][camera.c][solveStage] Camera completed one round in %f msec.\n", time(NULL), camera_time);
+
+    // write this time to the data file
+    if (fprintf(fptr, "|%f", camera_time) < 0) {
+        fprintf(log, "[%ld][camera.c][solveStage] Unable to write Astrometry solution time to "
+                "observing file: %s.\n", time(NULL), strerror(errno));
+    }
+    fflush(fptr);
+    fclose(fptr);
+    return sol_status;
+}
+
+/* Function for the downlink stage of the pipeline: hands the frame to the 
+** image server and writes its blobs out for Kst.
+** Input: The frame and the log file.
+** Output: None (void).
+*/
+static void downlinkStage(struct starcam_frame * frame, void * arg) {
+    FILE * log = (FILE *) arg;
+
+    // send the image as captured, not the filtered one
+    notifyImageServer(frame->date, frame->blob_count, frame->tv.tv_sec, 
+                      frame->image, CAMERA_WIDTH, CAMERA_HEIGHT,
+                      frame->star_x, frame->star_y);
+
+    // make a table of blobs for Kst
+    if (frame->skipped != SOLVE_NOT_WANTED) {
+        if (makeTable("makeTable.txt", frame->star_mags, frame->star_x, 
+                      frame->star_y, frame->blob_count) != 1) {
+            write_to_log(log,"camera.c","downlinkStage","Error (above) writing blob table for Kst.\n");
+        }
+    }
+
+    if (frame->seq % PIPELINE_STATS_FRAMES == 0) {
+        fprintf(log, "[%ld][camera.c][downlinkStage] Pipeline after %lu frames:\n", time(NULL), frame->seq);
+        printPipelineStats(log);
+        printSolveStats(log);
+    }
+}
+
+/* Function to take pictures and solve them until the camera shuts down, 
+** with capture, blob finding, solving and downlink each on their own 
+** thread (see starcam_pipeline.h).
+** Input: The log file.
+** Output: The number of frames captured, or -1 if the pipeline could not be
+** started.
+*/
+int runCameraPipeline(FILE * log) {
+    struct pipeline_ops ops = {
+        .capture = captureStage,
+        .detect = detectStage,
+        .solve = solveStage,
+        .downlink = downlinkStage,
+        .arg = log,
+    };
+    int frames = runPipeline(&ops, CAMERA_WIDTH, CAMERA_HEIGHT);
+
+    if (frames >= 0) {
+        fprintf(log, "[%ld][camera.c][runCameraPipeline] Pipeline stopped after %d frames:\n", time(NULL), frames);
+        printPipelineStats(log);
+        printSolveStats(log);
+    }
+    return frames;
+}
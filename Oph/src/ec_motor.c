@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <ethercat.h>
@@ -15,13 +16,19 @@
 #include <glib.h>
 #include <unistd.h>
 #include <curses.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
 
 
 #include "ec_motor.h"
 #include "motor_control.h"
 #include "file_io_Oph.h"
+#include "ring_logger.h"
 
 FILE* motor_log;
+motor_loop_stats_t motor_loop_stats = {0};
 static int32_t dummy_var = 0;
 static char io_map[4096]; //Memory mapping for PDO
 
@@ -903,16 +910,104 @@ int close_ec_motor(void){
     return(1);
 }
 
+static const long loop_period_ns = (long) (1e9/MOTORSR);
+static const double loop_hist_edges_us[LOOP_HIST_BINS-1] = {10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0};
+
+/* Function to put the control loop on the configured priority and CPU
+** Input: None
+** Output: None, failures are logged and the loop runs as it is
+*/
+static void set_loop_scheduling(void){
+	int ret;
+
+	if(config.motor.rt_priority > 0){
+		struct sched_param param = {.sched_priority = config.motor.rt_priority};
+		ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if(ret != 0){
+			fprintf(motor_log,"[%ld][ec_motor.c][set_loop_scheduling] Could not set SCHED_FIFO priority %d: %s\n", time(NULL), config.motor.rt_priority, strerror(ret));
+		}else{
+			fprintf(motor_log,"[%ld][ec_motor.c][set_loop_scheduling] Running at SCHED_FIFO priority %d\n", time(NULL), config.motor.rt_priority);
+		}
+	}
+	if(config.motor.cpu >= 0){
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(config.motor.cpu, &cpus);
+		ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if(ret != 0){
+			fprintf(motor_log,"[%ld][ec_motor.c][set_loop_scheduling] Could not pin to CPU %d: %s\n", time(NULL), config.motor.cpu, strerror(ret));
+		}else{
+			fprintf(motor_log,"[%ld][ec_motor.c][set_loop_scheduling] Pinned to CPU %d\n", time(NULL), config.motor.cpu);
+		}
+	}
+	fflush(motor_log);
+}
+
+static long timespec_diff_ns(const struct timespec *a, const struct timespec *b){
+	return (a->tv_sec - b->tv_sec)*1000000000L + (a->tv_nsec - b->tv_nsec);
+}
+
+static void timespec_add_ns(struct timespec *t, long ns){
+	t->tv_nsec += ns;
+	while(t->tv_nsec >= 1000000000L){
+		t->tv_nsec -= 1000000000L;
+		t->tv_sec++;
+	}
+}
+
+static int loop_hist_bin(double us){
+	int i;
+	for(i = 0; i < LOOP_HIST_BINS-1; i++){
+		if(us < loop_hist_edges_us[i]){
+			break;
+		}
+	}
+	return i;
+}
+
+/* Function to sleep until an absolute deadline on the monotonic clock
+** Input: deadline
+** Output: None
+*/
+static void wait_for_deadline(const struct timespec *deadline){
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR);
+}
+
+/* Function to record when a cycle woke up against when it was due
+** Input: wake, deadline and the period since the last wake up [ns]
+** Output: None, updates motor_loop_stats
+*/
+static void record_wake(const struct timespec *wake, const struct timespec *deadline, long period_ns){
+	double latency_us = timespec_diff_ns(wake, deadline)/1e3;
+	double jitter_us = labs(period_ns - loop_period_ns)/1e3;
+
+	motor_loop_stats.cycles++;
+	motor_loop_stats.period_ms = period_ns/1e6;
+	motor_loop_stats.latency_us = latency_us;
+	if(latency_us > motor_loop_stats.latency_max_us){
+		motor_loop_stats.latency_max_us = latency_us;
+	}
+	if(jitter_us > motor_loop_stats.jitter_max_us){
+		motor_loop_stats.jitter_max_us = jitter_us;
+	}
+	motor_loop_stats.latency_hist[loop_hist_bin(latency_us)]++;
+	motor_loop_stats.jitter_hist[loop_hist_bin(jitter_us)]++;
+}
+
 void *do_motors(void*){
 	int expectedWKC, wkc;
 	int ret;
-	long int count = 0;
 	double t;
+	double dt;
+	long period_ns;
+	int first_cycle;
 	struct timeval current_time;
+	struct timespec deadline, wake, last_wake, done;
 	char * ifname = config.motor.port;
-	int flen = strlen(config.motor.datadir)+25;
-	char fname[flen];
-	FILE* outfile;
+	struct ring_logger pv_log;
+	struct motor_pv_record pv;
+	
+	set_loop_scheduling();
 	
 	write_to_log(motor_log,"ec_motor.c","do_motors","Initializing NIC...");
 	if(!(ec_init(ifname))){
@@ -931,20 +1026,36 @@ void *do_motors(void*){
 	
 	expectedWKC = (ec_group[0].outputsWKC*2) + ec_group[0].inputsWKC;
 	
-	snprintf(fname,flen,"%s/motor_pv_%ld.txt",config.motor.datadir,time(NULL));
-	
-	outfile = fopen(fname, "w");
+	// 10 minutes a file, and over a second of records in case the disk stalls
+	if(ring_logger_start(&pv_log, config.motor.datadir, "motor_pv", RING_LOG_MOTOR_PV, sizeof(pv), 256, 120000, motor_log) < 0){
+		write_to_log(motor_log,"ec_motor.c","do_motors","Could not start the motor data log");
+	}
 	
 	start_loop:
+		// Each cycle is due loop_period_ns after the last one was, however
+		// long the work took, and the PID uses the period actually measured
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		first_cycle = 1;
 		while(!stop){
+			wait_for_deadline(&deadline);
+			clock_gettime(CLOCK_MONOTONIC, &wake);
+			if(first_cycle){
+				period_ns = loop_period_ns;
+				first_cycle = 0;
+			}else{
+				period_ns = timespec_diff_ns(&wake, &last_wake);
+				record_wake(&wake, &deadline, period_ns);
+			}
+			last_wake = wake;
+			// A stalled cycle should not make the PID take a huge step
+			dt = period_ns/1e9;
+			if(dt < 0.5/MOTORSR){
+				dt = 0.5/MOTORSR;
+			}else if(dt > 2.0/MOTORSR){
+				dt = 2.0/MOTORSR;
+			}
 			gettimeofday(&current_time, NULL);
 			t = current_time.tv_sec+current_time.tv_usec/1e6;
-			if (count > 120000){
-				fclose(outfile);
-				snprintf(fname,flen,"%s/motor_pv_%ld.txt",config.motor.datadir,time(NULL));
-        			outfile = fopen(fname, "w");
-				count = 0;
-			}
 			enable();
 			ec_send_processdata();
 			wkc = ec_receive_processdata(EC_TIMEOUTRET);
@@ -960,20 +1071,38 @@ void *do_motors(void*){
 				motor_offset = MotorData[GETREADINDEX(motor_index)].position + TELESCOPE_ANGLE;
 				firsttime = 0;
 			}
-			command_motor();
-			fprintf(outfile,"%lf;%lf;%lf;%lf;%d;%d;%d\n",t,MotorData[GETREADINDEX(motor_index)].position,MotorData[GETREADINDEX(motor_index)].velocity,MotorData[GETREADINDEX(motor_index)].current,scan_mode.scan,scan_mode.turnaround,scan_mode.scanning);
-			usleep(4600);
-			count++;
+			command_motor(dt);
+			pv.t = t;
+			pv.position = MotorData[GETREADINDEX(motor_index)].position;
+			pv.velocity = MotorData[GETREADINDEX(motor_index)].velocity;
+			pv.current = MotorData[GETREADINDEX(motor_index)].current;
+			pv.scan = scan_mode.scan;
+			pv.turnaround = scan_mode.turnaround;
+			pv.scanning = scan_mode.scanning;
+			pv.pad = 0;
+			ring_logger_push(&pv_log, &pv);
+			
+			clock_gettime(CLOCK_MONOTONIC, &done);
+			if(timespec_diff_ns(&done, &wake)/1e3 > motor_loop_stats.work_max_us){
+				motor_loop_stats.work_max_us = timespec_diff_ns(&done, &wake)/1e3;
+			}
+			timespec_add_ns(&deadline, loop_period_ns);
+			if(timespec_diff_ns(&done, &deadline) > 0){
+				// Missed the next deadline: start again from now rather
+				// than running the missed cycles back to back
+				motor_loop_stats.overruns++;
+				deadline = done;
+			}
 		}
-	fclose(outfile);
-	close_ec_motor();
-	
 	
+	// The loop ending and a reset while stopping both leave through here
 	reset:
 	if(!stop){
 		reset_ec_motor();
 		ready = 1;
 		goto start_loop;
 	}
-
+	ring_logger_stop(&pv_log);
+	close_ec_motor();
+	return NULL;
 }
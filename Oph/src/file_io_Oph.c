@@ -14,6 +14,31 @@ void write_to_log(FILE* fptr, char* cfile, char* func, char* msg) {
     fprintf(fptr, "[%ld][%s][%s] %s\n", time_m, cfile, func, msg);
 }
 
+// joins an array of channel names with commas
+static char* join_names(config_setting_t* names) {
+    int n = config_setting_length(names);
+    size_t len = 1;
+    char* joined;
+
+    for (int i = 0; i < n; i++) {
+        const char* name = config_setting_get_string_elem(names, i);
+        if (name != NULL) {
+            len += strlen(name) + 1;
+        }
+    }
+    joined = (char*)calloc(len, sizeof(char));
+    for (int i = 0; i < n; i++) {
+        const char* name = config_setting_get_string_elem(names, i);
+        if (name != NULL) {
+            if (joined[0] != '\0') {
+                strcat(joined, ",");
+            }
+            strcat(joined, name);
+        }
+    }
+    return joined;
+}
+
 void read_in_config(char* filepath) {
     config_t conf;
     const char* tmpstr = NULL;
@@ -142,6 +167,13 @@ void read_in_config(char* filepath) {
     }
     config.bvexcam.relay = tmpint;
 
+    if(!config_lookup_int(&conf, "bvexcam.tracking",&tmpint)){
+        printf("Missing bvexcam.tracking in %s\n", filepath);
+        config_destroy(&conf);
+        exit(0);
+    }
+    config.bvexcam.tracking = tmpint;
+
     // Accelerometer configuration
     if (!config_lookup_int(&conf, "accelerometer.enabled", &tmpint)) {
         printf("Missing accelerometer.enabled in %s\n", filepath);
@@ -327,6 +359,20 @@ void read_in_config(char* filepath) {
     }
     config.motor.relay = tmpint;
 
+    if(!config_lookup_int(&conf,"motor.rt_priority",&tmpint)){
+        printf("Missing motor.rt_priority in %s\n",filepath);
+        config_destroy(&conf);
+        exit(0);
+    }
+    config.motor.rt_priority = tmpint;
+
+    if(!config_lookup_int(&conf,"motor.cpu",&tmpint)){
+        printf("Missing motor.cpu in %s\n",filepath);
+        config_destroy(&conf);
+        exit(0);
+    }
+    config.motor.cpu = tmpint;
+
     //Lazisusan config
 
     if(!config_lookup_int(&conf,"lazisusan.enabled",&tmpint)){
@@ -551,6 +597,13 @@ void read_in_config(char* filepath) {
     }
     config.starcam_downlink.image_timeout_sec = tmpint;
 
+    if(!config_lookup_int(&conf,"starcam_downlink.progressive",&tmpint)){
+        printf("Missing starcam_downlink.progressive in %s\n",filepath);
+        config_destroy(&conf);
+        exit(0);
+    }
+    config.starcam_downlink.progressive = tmpint;
+
     if(!config_lookup_string(&conf,"starcam_downlink.workdir",&tmpstr)){
         printf("Missing starcam_downlink.workdir in %s\n",filepath);
         config_destroy(&conf);
@@ -601,6 +654,33 @@ void read_in_config(char* filepath) {
     }
     config.server.timeout = tmpint;
 
+    if(!config_lookup_int(&conf,"server.sub_min_period_ms",&tmpint)){
+        printf("Missing server.sub_min_period_ms in %s\n",filepath);
+        config_destroy(&conf);
+        exit(0);
+    }
+    config.server.sub_min_period_ms = tmpint;
+
+    // channel groups for GROUP: requests are optional, name = [channels]
+    config_setting_t* groups = config_lookup(&conf,"server.groups");
+    config.server.num_groups = 0;
+    if(groups != NULL && config_setting_is_group(groups)){
+        int n = config_setting_length(groups);
+        config.server.group_names = (char**)calloc(n, sizeof(char*));
+        config.server.group_channels = (char**)calloc(n, sizeof(char*));
+        for(int i = 0; i < n; i++){
+            config_setting_t* group = config_setting_get_elem(groups, i);
+            if(!config_setting_is_array(group)){
+                printf("server.groups.%s in %s is not a list of channels\n",config_setting_name(group),filepath);
+                config_destroy(&conf);
+                exit(0);
+            }
+            config.server.group_names[i] = strdup(config_setting_name(group));
+            config.server.group_channels[i] = join_names(group);
+            config.server.num_groups++;
+        }
+    }
+
     //power config
 
     if(!config_lookup_int(&conf,"power.enabled",&tmpint)){
@@ -984,6 +1064,7 @@ void print_config() {
     printf("  configdir = %s;\n",config.bvexcam.configdir);
     printf("  t_exp = %d;\n", config.bvexcam.t_exp);
     printf("  save_image = %d;\n", config.bvexcam.save_image);
+    printf("  tracking = %d;\n", config.bvexcam.tracking);
     printf("};\n\n");
     printf("accelerometer:{\n");
     printf("  enabled = %d;\n", config.accelerometer.enabled);
@@ -1012,6 +1093,8 @@ void print_config() {
     printf(" max_current = %d;\n", config.motor.max_current);
     printf(" max_velocity = %lf;\n", config.motor.max_velocity);
     printf(" pos_tol = %lf;\n", config.motor.pos_tol);
+    printf(" rt_priority = %d;\n", config.motor.rt_priority);
+    printf(" cpu = %d;\n", config.motor.cpu);
     printf("};\n\n");
     printf("lazisusan:{\n");
     printf(" enabled = %d;\n",config.lazisusan.enabled);
@@ -1054,6 +1137,7 @@ void print_config() {
     printf(" chunk_size = %d;\n",config.starcam_downlink.chunk_size);
     printf(" max_bandwidth_kbps = %d;\n",config.starcam_downlink.max_bandwidth_kbps);
     printf(" image_timeout_sec = %d;\n",config.starcam_downlink.image_timeout_sec);
+    printf(" progressive = %d;\n",config.starcam_downlink.progressive);
     printf(" workdir = %s;\n",config.starcam_downlink.workdir);
     printf(" notification_file = %s;\n",config.starcam_downlink.notification_file);
     printf("};\n\n"); 
@@ -1064,6 +1148,10 @@ void print_config() {
     printf(" ip = %s;\n",config.server.ip);
     printf(" port = %d;\n",config.server.port);
     printf(" timeout = %d;\n",config.server.timeout);
+    printf(" sub_min_period_ms = %d;\n",config.server.sub_min_period_ms);
+    for(int i = 0; i < config.server.num_groups; i++){
+        printf(" groups.%s = [%s];\n",config.server.group_names[i],config.server.group_channels[i]);
+    }
     printf("};\n\n"); 
 
     printf("power:{\n");
@@ -9,6 +9,7 @@
 #include "arduino.h"
 #include "lazisusan.h"
 #include "file_io_Oph.h"
+#include "ring_logger.h"
 #include "motor_control.h"
 #include "astrometry.h"
 #include "gps_server.h"
@@ -188,27 +189,21 @@ int check_gps(){
 }
 
 void * do_az_motor(void*){
-  FILE *ls_data;
+  struct ring_logger ls_data = {0};
+  struct lazisusan_record record;
   struct timeval current_time;
   int buf_max = 10;
   char buf[buf_max];
   int delta = 0;
   fd_az = start_az_motor(config.lazisusan.port,9600);
   int cmd_i = 0;
-  double t;
-  int flen;
   static int count_prev = 0;
   
-  flen = strlen(config.lazisusan.datadir)+26;
-
-  char datafile[flen];
-  
   if (fd_az>0){
   	enable_disable_motor();
   	write_to_log(ls_log,"lazisusan.c","do_az_motor","Starting datafile");
-	snprintf(datafile,flen,"%s/lazisusan_%ld.txt",config.lazisusan.datadir,time(NULL));
-  	ls_data = fopen(datafile,"w");
-	if(ls_data == NULL){
+	// 10 minutes a file, and about 2 s of records in case the disk stalls
+	if(ring_logger_start(&ls_data,config.lazisusan.datadir,"lazisusan",RING_LOG_LAZISUSAN,sizeof(record),2048,600000,ls_log) < 0){
 		write_to_log(ls_log,"lazisusan.c","do_az_motor","Error opening datafile\n");
 	}else{
   		az_is_ready=1;
@@ -242,13 +237,14 @@ void * do_az_motor(void*){
       			   }
     			}
 			gettimeofday(&current_time,NULL);
-			t = current_time.tv_sec+current_time.tv_usec/1e6;
-			fprintf(ls_data,"%lf;%lf\n",t,get_angle());
+			record.t = current_time.tv_sec+current_time.tv_usec/1e6;
+			record.angle = get_angle();
+			ring_logger_push(&ls_data,&record);
     			usleep(833); 
   		}
   	}
   }
-  fclose(ls_data);
+  ring_logger_stop(&ls_data);
   stop_motor();
   fd_az = -1;
 
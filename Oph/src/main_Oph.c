@@ -129,6 +129,7 @@ int main(int argc, char* argv[]) {
         starcam_config.chunk_size = config.starcam_downlink.chunk_size;
         starcam_config.max_bandwidth_kbps = config.starcam_downlink.max_bandwidth_kbps;
         starcam_config.image_timeout_sec = config.starcam_downlink.image_timeout_sec;
+        starcam_config.progressive = config.starcam_downlink.progressive;
         strncpy(starcam_config.workdir, config.starcam_downlink.workdir, sizeof(starcam_config.workdir) - 1);
         strncpy(starcam_config.notification_file, config.starcam_downlink.notification_file, sizeof(starcam_config.notification_file) - 1);
         if (initStarcamDownlink() != 0) {
@@ -75,7 +75,7 @@ double average_vel(){
 	return summed_vel/3.0;
 }
 
-static int16_t calculate_current(float v_req){
+static int16_t calculate_current(float v_req, double dt){
 	
 	float K_p = 0.0; //proportional gain
 	float T_i = 0.0; //Integral time constant
@@ -129,7 +129,7 @@ static int16_t calculate_current(float v_req){
 
 	P_term = K_p * error_pv;
 
-	I_step = error_pv * K_p/(T_i * MOTORSR);
+	I_step = error_pv * K_p * dt/T_i;
 
 	if (fabsf(I_step)< I_db){
 		I_step = 0;
@@ -148,7 +148,7 @@ static int16_t calculate_current(float v_req){
     	lpfilter(lpfilter_in,lpfilter_out,pv-last_pv);
     	
 	       
-        D_term = K_p * T_d * MOTORSR * lpfilter_out[5];
+        D_term = K_p * T_d * lpfilter_out[5]/dt;
         last_pv = pv;
         
         
@@ -605,7 +605,11 @@ int check_sc(){
 }
 
 
-void command_motor(void){
+/* Function to run one cycle of the elevation control loop
+** Input: dt, time since the last cycle [s], measured by do_motors
+** Output: None, sets the motor current
+*/
+void command_motor(double dt){
 	
 	int16_t current;
 	float v_req;
@@ -631,7 +635,7 @@ void command_motor(void){
 		//}
 	}
 	v_req = calculate_velocity_enc();
-	current = calculate_current(v_req);
+	current = calculate_current(v_req, dt);
 	set_current(current);
 }
 
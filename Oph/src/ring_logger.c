@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ring_logger.h"
+
+/* Function to start a new data file and write its header.
+** Input: The logger.
+** Output: 0 on success, -1 if the file could not be opened.
+*/
+static int openLogFile(struct ring_logger * rl) {
+    char fname[sizeof(rl->dir) + sizeof(rl->prefix) + 32];
+    struct ring_log_header header;
+    time_t now = time(NULL);
+
+    if (rl->file != NULL) {
+        fclose(rl->file);
+        rl->file = NULL;
+    }
+    // files are named by the second they start, with a count after it if
+    // more than one starts in the same second
+    if (now == rl->file_time) {
+        rl->file_seq++;
+        snprintf(fname, sizeof(fname), "%s/%s_%ld_%d.bin", rl->dir, rl->prefix,
+                 (long) now, rl->file_seq);
+    } else {
+        rl->file_time = now;
+        rl->file_seq = 0;
+        snprintf(fname, sizeof(fname), "%s/%s_%ld.bin", rl->dir, rl->prefix,
+                 (long) now);
+    }
+    rl->file = fopen(fname, "wb");
+    rl->file_records = 0;
+    if (rl->file == NULL) {
+        if (rl->log != NULL) {
+            fprintf(rl->log, "[%ld][ring_logger.c][openLogFile] Could not open %s\n",
+                    time(NULL), fname);
+            fflush(rl->log);
+        }
+        return -1;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RING_LOG_MAGIC, sizeof(header.magic));
+    header.record_type = rl->record_type;
+    header.record_size = rl->record_size;
+    fwrite(&header, sizeof(header), 1, rl->file);
+    return 0;
+}
+
+/* Function to write out everything pushed so far, starting new files as
+** they fill up.
+** Input: The logger.
+** Output: None (void). Records are discarded if there is no file to write
+** them to, so the control thread can keep pushing.
+*/
+static void drainRing(struct ring_logger * rl) {
+    uint64_t head = __atomic_load_n(&rl->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = rl->tail;
+
+    while (tail != head) {
+        uint32_t first = tail & (rl->capacity - 1);
+        uint64_t n = head - tail;
+
+        if (rl->file == NULL || rl->file_records >= rl->records_per_file) {
+            if (openLogFile(rl) < 0) {
+                __atomic_add_fetch(&rl->dropped, head - tail, __ATOMIC_RELAXED);
+                tail = head;
+                break;
+            }
+        }
+        // one contiguous run of the ring, and no further than the file takes
+        if (n > rl->capacity - first) {
+            n = rl->capacity - first;
+        }
+        if (n > (uint64_t) (rl->records_per_file - rl->file_records)) {
+            n = rl->records_per_file - rl->file_records;
+        }
+        fwrite(rl->records + (size_t) first * rl->record_size, rl->record_size,
+               n, rl->file);
+        rl->file_records += n;
+        tail += n;
+        __atomic_store_n(&rl->tail, tail, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&rl->tail, tail, __ATOMIC_RELEASE);
+    if (rl->file != NULL) {
+        fflush(rl->file);
+    }
+}
+
+/* Writer thread, empties the ring every RING_LOG_FLUSH_MS until stopped.
+** Input: The logger.
+** Output: NULL.
+*/
+static void * ringLoggerWriter(void * arg) {
+    struct ring_logger * rl = arg;
+    uint64_t reported_drops = 0;
+    uint64_t dropped;
+    int stopping = 0;
+
+    while (!stopping) {
+        // read stop first so the last pass sees every record pushed before it
+        stopping = __atomic_load_n(&rl->stop, __ATOMIC_ACQUIRE);
+        drainRing(rl);
+        dropped = __atomic_load_n(&rl->dropped, __ATOMIC_RELAXED);
+        if (dropped != reported_drops && rl->log != NULL) {
+            fprintf(rl->log, "[%ld][ring_logger.c][ringLoggerWriter] %s: %lu records dropped so far\n",
+                    time(NULL), rl->prefix, (unsigned long) dropped);
+            fflush(rl->log);
+            reported_drops = dropped;
+        }
+        if (!stopping) {
+            usleep(RING_LOG_FLUSH_MS * 1000);
+        }
+    }
+    return NULL;
+}
+
+/* Function to open the first data file and start the writer thread.
+** Input: The logger, where to write and what to call the files, the record
+** type and size, how many records the ring holds (rounded up to a power of
+** two), how many go in a file before starting another and where to log
+** messages (may be NULL).
+** Output: 0 on success, -1 on failure, in which case nothing is running.
+*/
+int ring_logger_start(struct ring_logger * rl, const char * dir,
+                      const char * prefix, uint32_t record_type,
+                      uint32_t record_size, uint32_t capacity,
+                      long records_per_file, FILE * log) {
+    uint32_t cap = 1;
+
+    memset(rl, 0, sizeof(*rl));
+    if (record_size == 0 || capacity == 0 || records_per_file <= 0) {
+        return -1;
+    }
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+    rl->record_type = record_type;
+    rl->record_size = record_size;
+    rl->capacity = cap;
+    rl->records_per_file = records_per_file;
+    rl->log = log;
+    snprintf(rl->dir, sizeof(rl->dir), "%s", dir);
+    snprintf(rl->prefix, sizeof(rl->prefix), "%s", prefix);
+
+    rl->records = malloc((size_t) cap * record_size);
+    if (rl->records == NULL) {
+        return -1;
+    }
+    if (openLogFile(rl) < 0) {
+        free(rl->records);
+        rl->records = NULL;
+        return -1;
+    }
+    if (pthread_create(&rl->writer, NULL, ringLoggerWriter, rl) != 0) {
+        fclose(rl->file);
+        rl->file = NULL;
+        free(rl->records);
+        rl->records = NULL;
+        return -1;
+    }
+    rl->running = 1;
+    return 0;
+}
+
+/* Function to queue a record for the writer, called from the control thread
+** only. Never blocks.
+** Input: The logger and a record of its record_size.
+** Output: 0 if queued, -1 if the ring was full and the record was dropped.
+*/
+int ring_logger_push(struct ring_logger * rl, const void * record) {
+    uint64_t head = rl->head;
+    uint64_t tail = __atomic_load_n(&rl->tail, __ATOMIC_ACQUIRE);
+
+    if (!rl->running) {
+        return -1;
+    }
+    if (head - tail >= rl->capacity) {
+        __atomic_add_fetch(&rl->dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    memcpy(rl->records + (size_t) (head & (rl->capacity - 1)) * rl->record_size,
+           record, rl->record_size);
+    __atomic_store_n(&rl->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Function to write out what is left, stop the writer and close the file.
+** Call it from the thread that pushes, once it has stopped pushing.
+** Input: The logger.
+** Output: None (void).
+*/
+void ring_logger_stop(struct ring_logger * rl) {
+    if (!rl->running) {
+        return;
+    }
+    __atomic_store_n(&rl->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(rl->writer, NULL);
+    rl->running = 0;
+    if (rl->file != NULL) {
+        fclose(rl->file);
+        rl->file = NULL;
+    }
+    free(rl->records);
+    rl->records = NULL;
+    if (rl->log != NULL) {
+        fprintf(rl->log, "[%ld][ring_logger.c][ring_logger_stop] %s: %lu records queued, %lu dropped\n",
+                time(NULL), rl->prefix, (unsigned long) rl->head,
+                (unsigned long) rl->dropped);
+        fflush(rl->log);
+    }
+}
@@ -19,6 +19,8 @@
 #include "system_monitor.h"
 #include "housekeeping.h"
 #include "lockpin.h"
+#include "telemetry_registry.h"
+#include "telemetry_subscribe.h"
 
 struct sockaddr_in cliaddr;
 int tel_server_running = 0;
@@ -49,6 +51,14 @@ void sendInt(int sockfd, int sample){
         return;
 }
 
+void sendULong(int sockfd, unsigned long sample){
+        char string_sample[21];
+
+        snprintf(string_sample,21,"%lu",sample);
+        sendto(sockfd, (const char*) string_sample, strlen(string_sample), MSG_CONFIRM,(const struct sockaddr *) &cliaddr, sizeof(cliaddr));
+        return;
+}
+
 void sendFloat(int sockfd, float sample){
         char string_sample[10];
 
@@ -124,415 +134,453 @@ void sock_listen(int sockfd, char* buffer){
 	return;
 }
 
+// Channels that read one variable or expression
+#define INT_CHANNEL(fn, expr) \
+	static void fn(int index, struct tel_value * out){ (void) index; tel_set_int(out, (expr)); }
+#define FLOAT_CHANNEL(fn, expr) \
+	static void fn(int index, struct tel_value * out){ (void) index; tel_set_float(out, (expr)); }
+#define DOUBLE_CHANNEL(fn, expr) \
+	static void fn(int index, struct tel_value * out){ (void) index; tel_set_double(out, (expr)); }
+#define ULONG_CHANNEL(fn, expr) \
+	static void fn(int index, struct tel_value * out){ (void) index; tel_set_ulong(out, (expr)); }
+
+//Star Camera channels
+DOUBLE_CHANNEL(get_sc_ra, all_astro_params.ra)
+DOUBLE_CHANNEL(get_sc_dec, all_astro_params.dec)
+DOUBLE_CHANNEL(get_sc_fr, all_astro_params.fr)
+DOUBLE_CHANNEL(get_sc_ir, all_astro_params.ir)
+DOUBLE_CHANNEL(get_sc_alt, all_astro_params.alt)
+DOUBLE_CHANNEL(get_sc_az, all_astro_params.az)
+DOUBLE_CHANNEL(get_sc_lat, all_astro_params.latitude)
+DOUBLE_CHANNEL(get_sc_lon, all_astro_params.longitude)
+DOUBLE_CHANNEL(get_sc_texp, all_camera_params.exposure_time)
+INT_CHANNEL(get_sc_start_focus, all_camera_params.start_focus_pos)
+INT_CHANNEL(get_sc_end_focus, all_camera_params.end_focus_pos)
+INT_CHANNEL(get_sc_curr_focus, all_camera_params.focus_position)
+INT_CHANNEL(get_sc_focus_step, all_camera_params.focus_step)
+INT_CHANNEL(get_sc_focus_mode, all_camera_params.focus_mode)
+INT_CHANNEL(get_sc_solve, all_camera_params.solve_img)
+INT_CHANNEL(get_sc_save, all_camera_params.save_image)
+
+static const struct tel_channel starcam_channels[] = {
+	{"sc_ra", get_sc_ra, 0, NULL},
+	{"sc_dec", get_sc_dec, 0, NULL},
+	{"sc_fr", get_sc_fr, 0, NULL},
+	{"sc_ir", get_sc_ir, 0, NULL},
+	{"sc_alt", get_sc_alt, 0, NULL},
+	{"sc_az", get_sc_az, 0, NULL},
+	{"sc_lat", get_sc_lat, 0, NULL},
+	{"sc_lon", get_sc_lon, 0, NULL},
+	{"sc_texp", get_sc_texp, 0, NULL},
+	{"sc_start_focus", get_sc_start_focus, 0, NULL},
+	{"sc_end_focus", get_sc_end_focus, 0, NULL},
+	{"sc_curr_focus", get_sc_curr_focus, 0, NULL},
+	{"sc_focus_step", get_sc_focus_step, 0, NULL},
+	{"sc_focus_mode", get_sc_focus_mode, 0, NULL},
+	{"sc_solve", get_sc_solve, 0, NULL},
+	{"sc_save", get_sc_save, 0, NULL},
+};
+
+//Motor channels, from one copy of the latest motor data
+static motor_data_t motor_copy;
+static motor_loop_stats_t loop_copy;
+
+static void refresh_motor(void){
+	motor_copy = MotorData[GETREADINDEX(motor_index)];
+}
+
+static void refresh_loop(void){
+	loop_copy = motor_loop_stats;
+}
+
+static struct tel_source motor_source = {refresh_motor, 0};
+static struct tel_source loop_source = {refresh_loop, 0};
+
+DOUBLE_CHANNEL(get_mc_curr, motor_copy.current)
+INT_CHANNEL(get_mc_sw, motor_copy.drive_info)
+INT_CHANNEL(get_mc_lf, motor_copy.fault_reg)
+INT_CHANNEL(get_mc_sr, motor_copy.status)
+DOUBLE_CHANNEL(get_mc_pos, motor_copy.position)
+INT_CHANNEL(get_mc_temp, motor_copy.temp)
+DOUBLE_CHANNEL(get_mc_vel, motor_copy.velocity)
+INT_CHANNEL(get_mc_cwr, motor_copy.control_word_read)
+INT_CHANNEL(get_mc_cww, motor_copy.control_word_write)
+INT_CHANNEL(get_mc_np, motor_copy.network_problem)
+FLOAT_CHANNEL(get_mc_pt, p_pub)
+FLOAT_CHANNEL(get_mc_it, i_pub)
+FLOAT_CHANNEL(get_mc_dt, d_pub)
+FLOAT_CHANNEL(get_mc_P, config.motor.velP)
+FLOAT_CHANNEL(get_mc_I, config.motor.velI)
+FLOAT_CHANNEL(get_mc_D, config.motor.velD)
+FLOAT_CHANNEL(get_mc_gv, config.motor.vel_gain)
+INT_CHANNEL(get_mc_Imax, config.motor.max_current)
+// Elevation loop timing, see motor_loop_stats_t
+DOUBLE_CHANNEL(get_mc_period, loop_copy.period_ms)
+DOUBLE_CHANNEL(get_mc_lat, loop_copy.latency_us)
+DOUBLE_CHANNEL(get_mc_lat_max, loop_copy.latency_max_us)
+DOUBLE_CHANNEL(get_mc_jit_max, loop_copy.jitter_max_us)
+DOUBLE_CHANNEL(get_mc_work_max, loop_copy.work_max_us)
+ULONG_CHANNEL(get_mc_cycles, loop_copy.cycles)
+ULONG_CHANNEL(get_mc_overruns, loop_copy.overruns)
+
+static void get_mc_lat_h(int index, struct tel_value * out){
+	tel_set_ulong(out, loop_copy.latency_hist[index]);
+}
+
+static void get_mc_jit_h(int index, struct tel_value * out){
+	tel_set_ulong(out, loop_copy.jitter_hist[index]);
+}
+
+static const struct tel_channel motor_channels[] = {
+	{"mc_curr", get_mc_curr, 0, &motor_source},
+	{"mc_sw", get_mc_sw, 0, &motor_source},
+	{"mc_lf", get_mc_lf, 0, &motor_source},
+	{"mc_sr", get_mc_sr, 0, &motor_source},
+	{"mc_pos", get_mc_pos, 0, &motor_source},
+	{"mc_temp", get_mc_temp, 0, &motor_source},
+	{"mc_vel", get_mc_vel, 0, &motor_source},
+	{"mc_cwr", get_mc_cwr, 0, &motor_source},
+	{"mc_cww", get_mc_cww, 0, &motor_source},
+	{"mc_np", get_mc_np, 0, &motor_source},
+	{"mc_pt", get_mc_pt, 0, NULL},
+	{"mc_it", get_mc_it, 0, NULL},
+	{"mc_dt", get_mc_dt, 0, NULL},
+	{"mc_P", get_mc_P, 0, NULL},
+	{"mc_I", get_mc_I, 0, NULL},
+	{"mc_D", get_mc_D, 0, NULL},
+	{"mc_gv", get_mc_gv, 0, NULL},
+	{"mc_Imax", get_mc_Imax, 0, NULL},
+	{"mc_period", get_mc_period, 0, &loop_source},
+	{"mc_lat", get_mc_lat, 0, &loop_source},
+	{"mc_lat_max", get_mc_lat_max, 0, &loop_source},
+	{"mc_jit_max", get_mc_jit_max, 0, &loop_source},
+	{"mc_work_max", get_mc_work_max, 0, &loop_source},
+	{"mc_cycles", get_mc_cycles, 0, &loop_source},
+	{"mc_overruns", get_mc_overruns, 0, &loop_source},
+	// one per histogram bin
+	{"mc_lat_h0", get_mc_lat_h, 0, &loop_source},
+	{"mc_lat_h1", get_mc_lat_h, 1, &loop_source},
+	{"mc_lat_h2", get_mc_lat_h, 2, &loop_source},
+	{"mc_lat_h3", get_mc_lat_h, 3, &loop_source},
+	{"mc_lat_h4", get_mc_lat_h, 4, &loop_source},
+	{"mc_lat_h5", get_mc_lat_h, 5, &loop_source},
+	{"mc_lat_h6", get_mc_lat_h, 6, &loop_source},
+	{"mc_lat_h7", get_mc_lat_h, 7, &loop_source},
+	{"mc_jit_h0", get_mc_jit_h, 0, &loop_source},
+	{"mc_jit_h1", get_mc_jit_h, 1, &loop_source},
+	{"mc_jit_h2", get_mc_jit_h, 2, &loop_source},
+	{"mc_jit_h3", get_mc_jit_h, 3, &loop_source},
+	{"mc_jit_h4", get_mc_jit_h, 4, &loop_source},
+	{"mc_jit_h5", get_mc_jit_h, 5, &loop_source},
+	{"mc_jit_h6", get_mc_jit_h, 6, &loop_source},
+	{"mc_jit_h7", get_mc_jit_h, 7, &loop_source},
+};
+
+//Lock pin, axes, scan and target channels
+INT_CHANNEL(get_lock_d, config.lockpin.duration)
+INT_CHANNEL(get_lock_state, is_locked)
+INT_CHANNEL(get_ax_mode, axes_mode.mode)
+DOUBLE_CHANNEL(get_ax_dest, axes_mode.dest)
+DOUBLE_CHANNEL(get_ax_vel, axes_mode.vel)
+DOUBLE_CHANNEL(get_ax_dest_az, axes_mode.dest_az)
+DOUBLE_CHANNEL(get_ax_vel_az, axes_mode.vel_az)
+DOUBLE_CHANNEL(get_ax_ot, axes_mode.on_target)
+INT_CHANNEL(get_scan_mode, scan_mode.mode)
+DOUBLE_CHANNEL(get_scan_start, scan_mode.start_el)
+DOUBLE_CHANNEL(get_scan_stop, scan_mode.stop_el)
+DOUBLE_CHANNEL(get_scan_vel, scan_mode.vel)
+INT_CHANNEL(get_scan_scan, scan_mode.scan)
+INT_CHANNEL(get_scan_nscans, scan_mode.nscans)
+DOUBLE_CHANNEL(get_scan_offset, scan_mode.offset)
+DOUBLE_CHANNEL(get_scan_time, scan_mode.time)
+DOUBLE_CHANNEL(get_scan_len, scan_mode.scan_len)
+INT_CHANNEL(get_scan_op, scan_mode.on_position)
+DOUBLE_CHANNEL(get_target_lon, target.lon)
+DOUBLE_CHANNEL(get_target_lat, target.lat)
+
+static void get_target_type(int index, struct tel_value * out){
+	(void) index;
+	tel_set_string(out, target.type);
+}
+
+static const struct tel_channel pointing_channels[] = {
+	{"lock_d", get_lock_d, 0, NULL},
+	{"lock_state", get_lock_state, 0, NULL},
+	{"ax_mode", get_ax_mode, 0, NULL},
+	{"ax_dest", get_ax_dest, 0, NULL},
+	{"ax_vel", get_ax_vel, 0, NULL},
+	{"ax_dest_az", get_ax_dest_az, 0, NULL},
+	{"ax_vel_az", get_ax_vel_az, 0, NULL},
+	{"ax_ot", get_ax_ot, 0, NULL},
+	{"scan_mode", get_scan_mode, 0, NULL},
+	{"scan_start", get_scan_start, 0, NULL},
+	{"scan_stop", get_scan_stop, 0, NULL},
+	{"scan_vel", get_scan_vel, 0, NULL},
+	{"scan_scan", get_scan_scan, 0, NULL},
+	{"scan_nscans", get_scan_nscans, 0, NULL},
+	{"scan_offset", get_scan_offset, 0, NULL},
+	{"scan_time", get_scan_time, 0, NULL},
+	{"scan_len", get_scan_len, 0, NULL},
+	{"scan_op", get_scan_op, 0, NULL},
+	{"target_lon", get_target_lon, 0, NULL},
+	{"target_lat", get_target_lat, 0, NULL},
+	{"target_type", get_target_type, 0, NULL},
+};
+
+//Power channels, the state and current of each subsystem's relay
+static const struct {
+	int * pbob;
+	int * relay;
+} relays[] = {
+	{&config.bvexcam.pbob, &config.bvexcam.relay},
+	{&config.motor.pbob, &config.motor.relay},
+	{&config.lockpin.pbob, &config.lockpin.relay},
+	{&config.lna.pbob, &config.lna.relay},
+	{&config.mixer.pbob, &config.mixer.relay},
+	{&config.rfsoc.pbob, &config.rfsoc.relay},
+	{&config.gps.pbob, &config.gps.relay},
+	{&config.backend.pbob, &config.backend.relay},
+	{&config.timing_box.pbob, &config.timing_box.relay},
+	{&config.heaters.pbob, &config.heaters.relay},
+	{&config.housekeeping.pbob, &config.housekeeping.relay},
+	{&config.position_box.pbob, &config.position_box.relay},
+};
+
+static void get_relay_state(int index, struct tel_value * out){
+	tel_set_int(out, get_state(*relays[index].pbob, *relays[index].relay));
+}
+
+static void get_relay_curr(int index, struct tel_value * out){
+	tel_set_double(out, get_relay_current(*relays[index].pbob, *relays[index].relay));
+}
+
+static const struct tel_channel power_channels[] = {
+	{"sc_state", get_relay_state, 0, NULL},
+	{"sc_curr", get_relay_curr, 0, NULL},
+	{"m_state", get_relay_state, 1, NULL},
+	{"m_curr", get_relay_curr, 1, NULL},
+	{"lp_state", get_relay_state, 2, NULL},
+	{"lp_curr", get_relay_curr, 2, NULL},
+	{"lna_state", get_relay_state, 3, NULL},
+	{"lna_curr", get_relay_curr, 3, NULL},
+	{"mix_state", get_relay_state, 4, NULL},
+	{"mix_curr", get_relay_curr, 4, NULL},
+	{"rfsoc_state", get_relay_state, 5, NULL},
+	{"rfsoc_curr", get_relay_curr, 5, NULL},
+	{"gps_state", get_relay_state, 6, NULL},
+	{"gps_curr", get_relay_curr, 6, NULL},
+	{"bkd_state", get_relay_state, 7, NULL},
+	{"bkd_curr", get_relay_curr, 7, NULL},
+	{"timing_state", get_relay_state, 8, NULL},
+	{"timing_curr", get_relay_curr, 8, NULL},
+	{"heat_state", get_relay_state, 9, NULL},
+	{"heat_curr", get_relay_curr, 9, NULL},
+	{"hk_state", get_relay_state, 10, NULL},
+	{"hk_curr", get_relay_curr, 10, NULL},
+	{"pos_state", get_relay_state, 11, NULL},
+	{"pos_curr", get_relay_curr, 11, NULL},
+};
+
+//System monitor channels, copied under the monitor's lock once per request
+static struct {
+	int valid;
+	float cpu_temp_celsius;
+	float cpu_usage_percent;
+	float memory_used_gb;
+	float memory_total_gb;
+	char memory_used_str[32];
+	char memory_total_str[32];
+	char ssd_used[32];
+	char ssd_total[32];
+	char ssd_mount_path[128];
+	int ssd_mounted;
+} sys_copy;
+
+static void refresh_sys(void){
+	sys_copy.valid = config.system_monitor.enabled;
+	if(!sys_copy.valid){
+		return;
+	}
+	pthread_mutex_lock(&sys_monitor.data_mutex);
+	sys_copy.cpu_temp_celsius = sys_monitor.cpu_temp_celsius;
+	sys_copy.cpu_usage_percent = sys_monitor.cpu_usage_percent;
+	sys_copy.memory_used_gb = sys_monitor.memory_used_gb;
+	sys_copy.memory_total_gb = sys_monitor.memory_total_gb;
+	memcpy(sys_copy.memory_used_str, sys_monitor.memory_used_str, sizeof(sys_copy.memory_used_str));
+	memcpy(sys_copy.memory_total_str, sys_monitor.memory_total_str, sizeof(sys_copy.memory_total_str));
+	memcpy(sys_copy.ssd_used, sys_monitor.ssd_used, sizeof(sys_copy.ssd_used));
+	memcpy(sys_copy.ssd_total, sys_monitor.ssd_total, sizeof(sys_copy.ssd_total));
+	memcpy(sys_copy.ssd_mount_path, sys_monitor.ssd_mount_path, sizeof(sys_copy.ssd_mount_path));
+	sys_copy.ssd_mounted = sys_monitor.ssd_mounted;
+	pthread_mutex_unlock(&sys_monitor.data_mutex);
+}
+
+static struct tel_source sys_source = {refresh_sys, 0};
+
+// -1 when the monitor is off, as before
+FLOAT_CHANNEL(get_oph_sys_cpu_temp, sys_copy.valid ? sys_copy.cpu_temp_celsius : -1.0)
+FLOAT_CHANNEL(get_oph_sys_cpu_usage, sys_copy.valid ? sys_copy.cpu_usage_percent : -1.0)
+FLOAT_CHANNEL(get_oph_sys_mem_used, sys_copy.valid ? sys_copy.memory_used_gb : -1.0)
+FLOAT_CHANNEL(get_oph_sys_mem_total, sys_copy.valid ? sys_copy.memory_total_gb : -1.0)
+INT_CHANNEL(get_oph_sys_ssd_mounted, sys_copy.valid ? sys_copy.ssd_mounted : -1)
+
+static void get_oph_sys_string(int index, struct tel_value * out){
+	const char * strings[] = {sys_copy.memory_used_str, sys_copy.memory_total_str,
+	                          sys_copy.ssd_used, sys_copy.ssd_total, sys_copy.ssd_mount_path};
+	tel_set_string(out, sys_copy.valid ? strings[index] : "N/A");
+}
+
+static const struct tel_channel sys_channels[] = {
+	{"oph_sys_cpu_temp", get_oph_sys_cpu_temp, 0, &sys_source},
+	{"oph_sys_cpu_usage", get_oph_sys_cpu_usage, 0, &sys_source},
+	{"oph_sys_mem_used", get_oph_sys_mem_used, 0, &sys_source},
+	{"oph_sys_mem_total", get_oph_sys_mem_total, 0, &sys_source},
+	{"oph_sys_mem_used_str", get_oph_sys_string, 0, &sys_source},
+	{"oph_sys_mem_total_str", get_oph_sys_string, 1, &sys_source},
+	{"oph_sys_ssd_mounted", get_oph_sys_ssd_mounted, 0, &sys_source},
+	{"oph_sys_ssd_used", get_oph_sys_string, 2, &sys_source},
+	{"oph_sys_ssd_total", get_oph_sys_string, 3, &sys_source},
+	{"oph_sys_ssd_path", get_oph_sys_string, 4, &sys_source},
+};
+
+//Housekeeping channels, copied under the housekeeping lock once per request
+static HousekeepingData hk_copy;
+static int hk_valid;
+
+static void refresh_hk(void){
+	hk_valid = config.housekeeping.enabled && housekeeping_running;
+	if(hk_valid){
+		pthread_mutex_lock(&housekeeping_data_mutex);
+		hk_copy = latest_housekeeping_data;
+		pthread_mutex_unlock(&housekeeping_data_mutex);
+	}
+}
+
+static struct tel_source hk_source = {refresh_hk, 0};
+
+// -999 for temperatures and pressures and 0 for flags when it is not running
+FLOAT_CHANNEL(get_hk_ocxo_temp, hk_valid ? hk_copy.ocxo_temp_c : -999.0)
+INT_CHANNEL(get_hk_ocxo_temp_ready, hk_valid ? hk_copy.temp_data_ready : 0)
+FLOAT_CHANNEL(get_hk_pv_pressure_bar, hk_valid ? hk_copy.pv_pressure_bar : -999.0)
+FLOAT_CHANNEL(get_hk_pv_pressure_psi, hk_valid ? hk_copy.pv_pressure_psi : -999.0)
+FLOAT_CHANNEL(get_hk_pv_pressure_torr, hk_valid ? hk_copy.pv_pressure_torr : -999.0)
+INT_CHANNEL(get_hk_pressure_valid, hk_valid ? hk_copy.pressure_valid : 0)
+FLOAT_CHANNEL(get_hk_ifamp_temp, hk_valid ? hk_copy.ifamp_temp_c : -999.0)
+FLOAT_CHANNEL(get_hk_lo_temp, hk_valid ? hk_copy.lo_temp_c : -999.0)
+FLOAT_CHANNEL(get_hk_tec_temp, hk_valid ? hk_copy.tec_temp_c : -999.0)
+FLOAT_CHANNEL(get_hk_backend_chassis_temp, hk_valid ? hk_copy.backend_chassis_temp_c : -999.0)
+FLOAT_CHANNEL(get_hk_nic_temp, hk_valid ? hk_copy.nic_temp_c : -999.0)
+FLOAT_CHANNEL(get_hk_rfsoc_chassis_temp, hk_valid ? hk_copy.rfsoc_chassis_temp_c : -999.0)
+FLOAT_CHANNEL(get_hk_rfsoc_chip_temp, hk_valid ? hk_copy.rfsoc_chip_temp_c : -999.0)
+FLOAT_CHANNEL(get_hk_lna1_temp, hk_valid ? hk_copy.lna1_temp_c : -999.0)
+FLOAT_CHANNEL(get_hk_lna2_temp, hk_valid ? hk_copy.lna2_temp_c : -999.0)
+INT_CHANNEL(get_hk_running, housekeeping_running)
+INT_CHANNEL(get_hk_powered, housekeeping_on)
+
+static const struct tel_channel hk_channels[] = {
+	{"hk_ocxo_temp", get_hk_ocxo_temp, 0, &hk_source},
+	{"hk_ocxo_temp_ready", get_hk_ocxo_temp_ready, 0, &hk_source},
+	{"hk_pv_pressure_bar", get_hk_pv_pressure_bar, 0, &hk_source},
+	{"hk_pv_pressure_psi", get_hk_pv_pressure_psi, 0, &hk_source},
+	{"hk_pv_pressure_torr", get_hk_pv_pressure_torr, 0, &hk_source},
+	{"hk_pressure_valid", get_hk_pressure_valid, 0, &hk_source},
+	{"hk_ifamp_temp", get_hk_ifamp_temp, 0, &hk_source},
+	{"hk_lo_temp", get_hk_lo_temp, 0, &hk_source},
+	{"hk_tec_temp", get_hk_tec_temp, 0, &hk_source},
+	{"hk_backend_chassis_temp", get_hk_backend_chassis_temp, 0, &hk_source},
+	{"hk_nic_temp", get_hk_nic_temp, 0, &hk_source},
+	{"hk_rfsoc_chassis_temp", get_hk_rfsoc_chassis_temp, 0, &hk_source},
+	{"hk_rfsoc_chip_temp", get_hk_rfsoc_chip_temp, 0, &hk_source},
+	{"hk_lna1_temp", get_hk_lna1_temp, 0, &hk_source},
+	{"hk_lna2_temp", get_hk_lna2_temp, 0, &hk_source},
+	{"hk_running", get_hk_running, 0, NULL},
+	{"hk_powered", get_hk_powered, 0, NULL},
+};
+
+#define NUM_CHANNELS(table) ((int) (sizeof(table)/sizeof(table[0])))
+
+// add channels by adding a table above and registering it here
+static void register_channels(void){
+	tel_register(starcam_channels, NUM_CHANNELS(starcam_channels));
+	tel_register(motor_channels, NUM_CHANNELS(motor_channels));
+	tel_register(pointing_channels, NUM_CHANNELS(pointing_channels));
+	tel_register(power_channels, NUM_CHANNELS(power_channels));
+	tel_register(sys_channels, NUM_CHANNELS(sys_channels));
+	tel_register(hk_channels, NUM_CHANNELS(hk_channels));
+	fprintf(server_log,"[%ld][server.c][register_channels] %d telemetry channels\n",time(NULL),tel_num_channels());
+	for(int i = 0; i < config.server.num_groups; i++){
+		int unknown = tel_add_group(config.server.group_names[i],config.server.group_channels[i]);
+		if(unknown < 0){
+			fprintf(server_log,"[%ld][server.c][register_channels] Could not add channel group %s\n",time(NULL),config.server.group_names[i]);
+		}else if(unknown > 0){
+			fprintf(server_log,"[%ld][server.c][register_channels] Channel group %s has %d unknown channels\n",time(NULL),config.server.group_names[i],unknown);
+		}
+	}
+	fflush(server_log);
+}
+
+void send_value(int sockfd, const struct tel_value * value){
+	switch(value->type){
+	case TEL_INT:
+		sendInt(sockfd,value->i);
+		break;
+	case TEL_ULONG:
+		sendULong(sockfd,value->ul);
+		break;
+	case TEL_FLOAT:
+		sendFloat(sockfd,value->f);
+		break;
+	case TEL_DOUBLE:
+		sendDouble(sockfd,value->d);
+		break;
+	default:
+		sendString(sockfd,(char*) value->s);
+		break;
+	}
+}
+
+// answers BATCH:name,... and GROUP:name with every value in one packed reply
+void send_batch(int sockfd, char* request){
+	uint8_t reply[TEL_BATCH_MAX];
+	int len = tel_batch(request,reply,sizeof(reply));
+
+	if(len < 0){
+		fprintf(server_log,"[%ld][server.c][send_batch] Received bad batch request: '%s'\n",time(NULL),request);
+		fflush(server_log);
+		return;
+	}
+	sendto(sockfd, reply, len, MSG_CONFIRM,(const struct sockaddr *) &cliaddr, sizeof(cliaddr));
+}
+
 //check if metric exists if so send the corresponding value
 void send_metric(int sockfd, char* id){
-	// add channels using the format below here;
-	//Star Camera channels
-	int motor_i;
-	if(strcmp(id,"sc_ra")==0){
-		sendDouble(sockfd,all_astro_params.ra);
-	}else if(strcmp(id,"sc_dec")==0){
-		sendDouble(sockfd,all_astro_params.dec);
-	}else if(strcmp(id,"sc_fr")==0){
-                sendDouble(sockfd,all_astro_params.fr);
-        }else if(strcmp(id,"sc_ir")==0){
-                sendDouble(sockfd,all_astro_params.ir);
-        }else if(strcmp(id,"sc_alt")==0){
-                sendDouble(sockfd,all_astro_params.alt);
-        }else if(strcmp(id,"sc_az")==0){
-                sendDouble(sockfd,all_astro_params.az);
-        }else if(strcmp(id,"sc_lat")==0){
-                sendDouble(sockfd,all_astro_params.latitude);
-        }else if(strcmp(id,"sc_lon")==0){
-                sendDouble(sockfd,all_astro_params.longitude);
-        }else if(strcmp(id,"sc_texp")==0){
-                sendDouble(sockfd,all_camera_params.exposure_time);
-        }else if(strcmp(id,"sc_start_focus")==0){
-                sendInt(sockfd,all_camera_params.start_focus_pos);
-        }else if(strcmp(id,"sc_end_focus")==0){
-                sendInt(sockfd,all_camera_params.end_focus_pos);
-        }else if(strcmp(id,"sc_curr_focus")==0){
-                sendInt(sockfd,all_camera_params.focus_position);
-        }else if(strcmp(id,"sc_focus_step")==0){
-                sendInt(sockfd,all_camera_params.focus_step);
-        }else if(strcmp(id,"sc_focus_mode")==0){
-                sendInt(sockfd,all_camera_params.focus_mode);
-        }else if(strcmp(id,"sc_solve")==0){
-                sendInt(sockfd,all_camera_params.solve_img);
-        }else if(strcmp(id,"sc_save")==0){
-                sendInt(sockfd,all_camera_params.save_image);
-        }else if(strcmp(id,"mc_curr")==0){
-               motor_i = GETREADINDEX(motor_index);
-               sendDouble(sockfd,MotorData[motor_i].current);
-       }else if(strcmp(id,"mc_sw")==0){
-                motor_i = GETREADINDEX(motor_index);
-                sendInt(sockfd,MotorData[motor_i].drive_info);
-        }else if(strcmp(id,"mc_lf")==0){
-                motor_i = GETREADINDEX(motor_index);
-                sendInt(sockfd,MotorData[motor_i].fault_reg);
-        }else if(strcmp(id,"mc_sr")==0){
-                motor_i = GETREADINDEX(motor_index);
-                sendInt(sockfd,MotorData[motor_i].status);
-        }else if(strcmp(id,"mc_pos")==0){
-                motor_i = GETREADINDEX(motor_index);
-                sendDouble(sockfd,MotorData[motor_i].position);
-        }else if(strcmp(id,"mc_temp")==0){
-                motor_i = GETREADINDEX(motor_index);
-                sendInt(sockfd,MotorData[motor_i].temp);
-        }else if(strcmp(id,"mc_vel")==0){
-                motor_i = GETREADINDEX(motor_index);
-                sendDouble(sockfd,MotorData[motor_i].velocity);
-        }else if(strcmp(id,"mc_cwr")==0){
-                motor_i = GETREADINDEX(motor_index);
-                sendInt(sockfd,MotorData[motor_i].control_word_read);
-        }else if(strcmp(id,"mc_cww")==0){
-                motor_i = GETREADINDEX(motor_index);
-                sendInt(sockfd,MotorData[motor_i].control_word_write);
-        }else if(strcmp(id,"mc_np")==0){
-                motor_i = GETREADINDEX(motor_index);
-                sendInt(sockfd,MotorData[motor_i].network_problem);
-        }else if(strcmp(id,"mc_pt")==0){
-               sendFloat(sockfd,p_pub);
-       }else if(strcmp(id,"mc_it")==0){
-                sendFloat(sockfd,i_pub);
-        }else if(strcmp(id,"mc_dt")==0){
-                sendFloat(sockfd,d_pub);
-        }else if(strcmp(id,"mc_P")==0){
-		sendFloat(sockfd,config.motor.velP);
-	}else if(strcmp(id,"mc_I")==0){
-                sendFloat(sockfd,config.motor.velI);
-        }else if(strcmp(id,"mc_D")==0){
-                sendFloat(sockfd,config.motor.velD);
-        }else if(strcmp(id,"mc_gv")==0){
-		sendFloat(sockfd,config.motor.vel_gain);
-	}else if(strcmp(id,"mc_Imax")==0){
-                sendInt(sockfd,config.motor.max_current);
-        }else if(strcmp(id,"lock_d")==0){
-                sendInt(sockfd,config.lockpin.duration);
-        }else if(strcmp(id,"lock_state")==0){
-                sendInt(sockfd,is_locked);
-        }else if(strcmp(id,"ax_mode")==0){
-               sendInt(sockfd,axes_mode.mode);
-       }else if(strcmp(id,"ax_dest")==0){
-                sendDouble(sockfd,axes_mode.dest);
-        }else if(strcmp(id,"ax_vel")==0){
-                sendDouble(sockfd,axes_mode.vel);
-        }else if(strcmp(id,"ax_dest_az")==0){
-                sendDouble(sockfd,axes_mode.dest_az);
-        }else if(strcmp(id,"ax_vel_az")==0){
-                sendDouble(sockfd,axes_mode.vel_az);
-        }else if(strcmp(id,"ax_ot")==0){
-                sendDouble(sockfd,axes_mode.on_target);
-        }else if(strcmp(id,"scan_mode")==0){
-                sendInt(sockfd,scan_mode.mode);
-        }else if(strcmp(id,"scan_start")==0){
-                sendDouble(sockfd,scan_mode.start_el);
-        }else if(strcmp(id,"scan_stop")==0){
-                sendDouble(sockfd,scan_mode.stop_el);
-        }else if(strcmp(id,"scan_vel")==0){
-                sendDouble(sockfd,scan_mode.vel);
-        }else if(strcmp(id,"scan_scan")==0){
-                sendInt(sockfd,scan_mode.scan);
-        }else if(strcmp(id,"scan_nscans")==0){
-                sendInt(sockfd,scan_mode.nscans);
-        }else if(strcmp(id,"scan_offset")==0){
-                sendDouble(sockfd,scan_mode.offset);
-        }else if(strcmp(id,"scan_time")==0){
-               sendDouble(sockfd,scan_mode.time);
-        }else if(strcmp(id,"scan_len")==0){
-               sendDouble(sockfd,scan_mode.scan_len);
-	}else if(strcmp(id,"scan_op")==0){
-                sendInt(sockfd,scan_mode.on_position);
-        }else if(strcmp(id,"target_lon")==0){
-                sendDouble(sockfd,target.lon);
-        }else if(strcmp(id,"target_lat")==0){
-		sendDouble(sockfd,target.lat);
-	}else if(strcmp(id,"target_type")==0){
-                sendString(sockfd,target.type);
-        }else if(strcmp(id,"sc_state")==0){
-		sendInt(sockfd,get_state(config.bvexcam.pbob,config.bvexcam.relay));
-        }else if(strcmp(id,"sc_curr")==0){
-		sendDouble(sockfd,get_relay_current(config.bvexcam.pbob,config.bvexcam.relay));
-	}else if(strcmp(id,"m_state")==0){
-                sendInt(sockfd,get_state(config.motor.pbob,config.motor.relay));
-        }else if(strcmp(id,"m_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.motor.pbob,config.motor.relay));
-        }else if(strcmp(id,"lp_state")==0){
-                sendInt(sockfd,get_state(config.lockpin.pbob,config.lockpin.relay));
-        }else if(strcmp(id,"lp_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.lockpin.pbob,config.lockpin.relay));
-        }else if(strcmp(id,"lna_state")==0){
-                sendInt(sockfd,get_state(config.lna.pbob,config.lna.relay));
-        }else if(strcmp(id,"lna_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.lna.pbob,config.lna.relay));
-        }else if(strcmp(id,"mix_state")==0){
-                sendInt(sockfd,get_state(config.mixer.pbob,config.mixer.relay));
-        }else if(strcmp(id,"mix_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.mixer.pbob,config.mixer.relay));
-        }else if(strcmp(id,"rfsoc_state")==0){
-                sendInt(sockfd,get_state(config.rfsoc.pbob,config.rfsoc.relay));
-        }else if(strcmp(id,"rfsoc_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.rfsoc.pbob,config.rfsoc.relay));
-        }else if(strcmp(id,"gps_state")==0){
-		sendInt(sockfd,get_state(config.gps.pbob,config.gps.relay));
-	}else if(strcmp(id,"gps_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.gps.pbob,config.gps.relay));
-        }else if(strcmp(id,"bkd_state")==0){
-                sendInt(sockfd,get_state(config.backend.pbob,config.backend.relay));
-        }else if(strcmp(id,"bkd_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.backend.pbob,config.backend.relay));
-        }else if(strcmp(id,"timing_state")==0){
-		sendInt(sockfd,get_state(config.timing_box.pbob,config.timing_box.relay));
-	}else if(strcmp(id,"timing_curr")==0){
-		sendDouble(sockfd,get_relay_current(config.timing_box.pbob,config.timing_box.relay));
-	}else if(strcmp(id,"heat_state")==0){
-                sendInt(sockfd,get_state(config.heaters.pbob,config.heaters.relay));
-        }else if(strcmp(id,"heat_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.heaters.pbob,config.heaters.relay));
-        }else if(strcmp(id,"hk_state")==0){
-                sendInt(sockfd,get_state(config.housekeeping.pbob,config.housekeeping.relay));
-        }else if(strcmp(id,"hk_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.housekeeping.pbob,config.housekeeping.relay));
-	}else if(strcmp(id,"pos_state")==0){
-                sendInt(sockfd,get_state(config.position_box.pbob,config.position_box.relay));
-        }else if(strcmp(id,"pos_curr")==0){
-                sendDouble(sockfd,get_relay_current(config.position_box.pbob,config.position_box.relay));
-        }else if(strcmp(id,"oph_sys_cpu_temp")==0){
-                // CPU temperature in Celsius
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendFloat(sockfd, sys_monitor.cpu_temp_celsius);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendFloat(sockfd, -1.0);  // Indicate not available
-                }
-        }else if(strcmp(id,"oph_sys_cpu_usage")==0){
-                // CPU usage percentage
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendFloat(sockfd, sys_monitor.cpu_usage_percent);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendFloat(sockfd, -1.0);  // Indicate not available
-                }
-        }else if(strcmp(id,"oph_sys_mem_used")==0){
-                // Memory used in GB
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendFloat(sockfd, sys_monitor.memory_used_gb);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendFloat(sockfd, -1.0);  // Indicate not available
-                }
-        }else if(strcmp(id,"oph_sys_mem_total")==0){
-                // Total memory in GB
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendFloat(sockfd, sys_monitor.memory_total_gb);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendFloat(sockfd, -1.0);  // Indicate not available
-                }
-        }else if(strcmp(id,"oph_sys_mem_used_str")==0){
-                // Memory used as string with units
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendString(sockfd, sys_monitor.memory_used_str);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendString(sockfd, "N/A");
-                }
-        }else if(strcmp(id,"oph_sys_mem_total_str")==0){
-                // Total memory as string with units
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendString(sockfd, sys_monitor.memory_total_str);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendString(sockfd, "N/A");
-                }
-        }else if(strcmp(id,"oph_sys_ssd_mounted")==0){
-                // SSD mounted status (1 = mounted, 0 = not mounted)
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendInt(sockfd, sys_monitor.ssd_mounted);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendInt(sockfd, -1);  // Indicate not available
-                }
-        }else if(strcmp(id,"oph_sys_ssd_used")==0){
-                // SSD used space as string with units
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendString(sockfd, sys_monitor.ssd_used);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendString(sockfd, "N/A");
-                }
-        }else if(strcmp(id,"oph_sys_ssd_total")==0){
-                // SSD total space as string with units
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendString(sockfd, sys_monitor.ssd_total);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendString(sockfd, "N/A");
-                }
-        }else if(strcmp(id,"oph_sys_ssd_path")==0){
-                // SSD mount path
-                if (config.system_monitor.enabled) {
-                    pthread_mutex_lock(&sys_monitor.data_mutex);
-                    sendString(sockfd, sys_monitor.ssd_mount_path);
-                    pthread_mutex_unlock(&sys_monitor.data_mutex);
-                } else {
-                    sendString(sockfd, "N/A");
-                }
-        }else if(strcmp(id,"hk_ocxo_temp")==0){
-                // OCXO temperature from TMP117 I2C sensor
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.ocxo_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);  // Indicate not available
-                }
-        }else if(strcmp(id,"hk_ocxo_temp_ready")==0){
-                // OCXO temperature data ready flag
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendInt(sockfd, latest_housekeeping_data.temp_data_ready);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendInt(sockfd, 0);
-                }
-        }else if(strcmp(id,"hk_pv_pressure_bar")==0){
-                // Pump-down valve pressure in bar
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.pv_pressure_bar);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_pv_pressure_psi")==0){
-                // Pump-down valve pressure in PSI
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.pv_pressure_psi);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_pv_pressure_torr")==0){
-                // Pump-down valve pressure in Torr
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.pv_pressure_torr);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_pressure_valid")==0){
-                // Pressure measurement validity flag
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendInt(sockfd, latest_housekeeping_data.pressure_valid);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendInt(sockfd, 0);
-                }
-        }else if(strcmp(id,"hk_ifamp_temp")==0){
-                // IF Amplifier temperature (AIN0)
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.ifamp_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_lo_temp")==0){
-                // Local Oscillator temperature (AIN3)
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.lo_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_tec_temp")==0){
-                // TEC temperature (AIN123)
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.tec_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_backend_chassis_temp")==0){
-                // Backend Chassis temperature (AIN122)
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.backend_chassis_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_nic_temp")==0){
-                // NIC temperature (AIN121)
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.nic_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_rfsoc_chassis_temp")==0){
-                // RFSoC Chassis temperature (AIN126)
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.rfsoc_chassis_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_rfsoc_chip_temp")==0){
-                // RFSoC Chip temperature (AIN127)
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.rfsoc_chip_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_lna1_temp")==0){
-                // LNA1 temperature (AIN125)
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.lna1_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_lna2_temp")==0){
-                // LNA2 temperature (AIN124)
-                if (config.housekeeping.enabled && housekeeping_running) {
-                    pthread_mutex_lock(&housekeeping_data_mutex);
-                    sendFloat(sockfd, latest_housekeeping_data.lna2_temp_c);
-                    pthread_mutex_unlock(&housekeeping_data_mutex);
-                } else {
-                    sendFloat(sockfd, -999.0);
-                }
-        }else if(strcmp(id,"hk_running")==0){
-                // Housekeeping system running status
-                sendInt(sockfd, housekeeping_running);
-        }else if(strcmp(id,"hk_powered")==0){
-                // Housekeeping system power status
-                sendInt(sockfd, housekeeping_on);
-        }else{
+	const struct tel_channel * channel;
+	struct tel_value value;
+
+	if(tel_is_batch(id)){
+		send_batch(sockfd,id);
+		return;
+	}
+	if(tel_is_subscription(id)){
+		// updates come from the subscription thread
+		int result = tel_subscribe(&cliaddr,id);
+		if(result == TEL_SUB_BAD_REQUEST){
+			fprintf(server_log,"[%ld][server.c][send_metric] Received bad subscription: '%s'\n",time(NULL),id);
+			fflush(server_log);
+		}else if(result == TEL_SUB_REFUSED){
+			fprintf(server_log,"[%ld][server.c][send_metric] Refused subscription, too many: '%s'\n",time(NULL),id);
+			fflush(server_log);
+		}
+		return;
+	}
+	channel = tel_lookup(id);
+	if(channel == NULL){
 		fprintf(server_log,"[%ld][server.c][send_metric] Received unknown request: '%s'\n",time(NULL),id);
 		fflush(server_log);
+		return;
 	}
-
+	tel_get(channel,&value);
+	send_value(sockfd,&value);
 }
 
 void *do_server(){
@@ -540,12 +588,19 @@ void *do_server(){
 	int sockfd = init_socket();
 	char buffer[MAXLEN];
 
+	if(tel_num_channels() == 0){
+		register_channels();
+	}
 	if(tel_server_running){
+		if(tel_sub_start(sockfd,config.server.sub_min_period_ms,server_log) < 0){
+			write_to_log(server_log,"server.c","do_server","Could not start the subscription thread");
+		}
 		while(!stop_tel){
 			sock_listen(sockfd, buffer);
 			send_metric(sockfd, buffer);
 		}
 		write_to_log(server_log,"server.c","do_server","Shutting down server");
+		tel_sub_stop();
 		tel_server_running = 0;
 		stop_tel = 0;
 		fclose(server_log);
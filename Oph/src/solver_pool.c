@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <astrometry/starxy.h>
+#include <astrometry/matchobj.h>
+
+#include "solver_pool.h"
+
+/* A worker's solver and the timer callbacks it has left on this solve */
+struct solve_worker {
+    solver_t * solver;
+    int timelimit;
+    int running;            // in solver_run, so it can be told to quit
+};
+
+/* Pool of threads that each search one share of the indexes. The caller
+** searches share 0 and waits for the workers to finish the rest.
+*/
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    pthread_t threads[SOLVE_MAX_WORKERS - 1];
+    int num_threads;        // worker threads started, never stopped
+    int num_workers;        // solvers, including the caller's, 0 until use
+    unsigned long job_id;   // bumped for every solve
+    int running;            // worker threads still on the current solve
+    // job_id when each worker was started, it runs the solves after that
+    unsigned long first_job[SOLVE_MAX_WORKERS];
+    struct solve_worker workers[SOLVE_MAX_WORKERS];
+    // the current solve
+    const struct solve_params * params;
+    index_t ** indexes;
+    int num_indexes;
+    int num_shares;
+    int solved;
+    struct solve_result * result;
+    int cancelled;          // read by the timer callbacks without the lock
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+/* Timer callback of every worker's solver, called about once a second.
+** Input: The worker.
+** Output: 0 to stop the solver.
+*/
+static time_t solveTimer(void * arg) {
+    struct solve_worker * worker = arg;
+
+    if (worker->timelimit > 0) {
+        worker->timelimit--;
+    }
+    if (__atomic_load_n(&pool.cancelled, __ATOMIC_RELAXED) ||
+        (pool.params->stop != NULL && *pool.params->stop)) {
+        worker->timelimit = 0;
+    }
+    return worker->timelimit != 0;
+}
+
+/* Function to search one share of the indexes for the current solve.
+** Input: The share, which is also the worker, and the number of shares.
+** Output: None (void). The first share to solve fills in the result and
+** stops the others.
+*/
+static void solveShare(int share, int num_shares) {
+    struct solve_worker * worker = &pool.workers[share];
+    const struct solve_params * params = pool.params;
+    solver_t * sp = worker->solver;
+    int num_indexes = 0;
+
+    for (int i = share; i < pool.num_indexes; i += num_shares) {
+        solver_add_index(sp, pool.indexes[i]);
+        num_indexes++;
+    }
+    if (num_indexes == 0) {
+        return;
+    }
+
+    sp->funits_lower = params->funits_lower;
+    sp->funits_upper = params->funits_upper;
+    sp->parity = params->parity;
+    sp->endobj = params->num_stars;
+    sp->quadsize_min = params->quadsize_min;
+    solver_set_keep_logodds(sp, params->logodds);
+    sp->logratio_totune = log(1e6);
+    sp->logratio_toprint = log(1e6);
+    sp->distance_from_quad_bonus = 1;
+    if (params->use_radec) {
+        solver_set_radec(sp, params->ra, params->dec, params->radius);
+    } else {
+        solver_clear_radec(sp);
+    }
+
+    // every solver frees its own copy of the field
+    starxy_t * field = starxy_new(params->num_stars, 1, 0);
+    starxy_set_x_array(field, params->x);
+    starxy_set_y_array(field, params->y);
+    starxy_set_flux_array(field, params->flux);
+    starxy_sort_by_flux(field);
+    solver_set_field(sp, field);
+    solver_set_field_bounds(sp, 0, params->field_width, 0,
+                            params->field_height);
+    worker->timelimit = params->timelimit;
+
+    pthread_mutex_lock(&pool.lock);
+    worker->running = !pool.cancelled;
+    sp->quit_now = FALSE;
+    pthread_mutex_unlock(&pool.lock);
+
+    if (worker->running) {
+        solver_run(sp);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    worker->running = 0;
+    if (sp->best_match_solves && !pool.solved) {
+        pool.solved = 1;
+        pool.result->wcs = sp->best_match.wcstan;
+        pool.result->parity = sp->best_match.parity ? PARITY_FLIP :
+                                                      PARITY_NORMAL;
+        pool.result->logodds = sp->best_match.logodds;
+        pool.result->worker = share;
+
+        // first solution wins, the rest stop at their next check
+        __atomic_store_n(&pool.cancelled, 1, __ATOMIC_RELAXED);
+        for (int w = 0; w < num_shares; w++) {
+            if (pool.workers[w].running) {
+                __atomic_store_n(&pool.workers[w].solver->quit_now, TRUE,
+                                 __ATOMIC_RELAXED);
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    solver_cleanup_field(sp);
+    solver_clear_indexes(sp);
+}
+
+/* Worker thread of the pool, searches share (arg) of every solve.
+** Input: The share number.
+** Output: None, runs forever.
+*/
+static void * poolWorker(void * arg) {
+    int share = (int) (intptr_t) arg;
+
+    pthread_mutex_lock(&pool.lock);
+    unsigned long last_job = pool.first_job[share];
+    while (1) {
+        while (pool.job_id == last_job) {
+            pthread_cond_wait(&pool.start, &pool.lock);
+        }
+        last_job = pool.job_id;
+        int num_shares = pool.num_shares;
+        pthread_mutex_unlock(&pool.lock);
+
+        if (share < num_shares) {
+            solveShare(share, num_shares);
+        }
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.running == 0) {
+            pthread_cond_signal(&pool.done);
+        }
+    }
+    return NULL;
+}
+
+/* Function to set how many solvers search the indexes at once.
+** Input: The number of solvers including the caller's, 0 or less for one
+** per online CPU. Capped at SOLVE_MAX_WORKERS.
+** Output: The number of solvers that will be used.
+*/
+int setSolveWorkers(int num_workers) {
+    if (num_workers <= 0) {
+        num_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_workers < 1) {
+        num_workers = 1;
+    }
+    if (num_workers > SOLVE_MAX_WORKERS) {
+        num_workers = SOLVE_MAX_WORKERS;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    for (int w = 0; w < num_workers; w++) {
+        struct solve_worker * worker = &pool.workers[w];
+        if (worker->solver == NULL) {
+            worker->solver = solver_new();
+            worker->solver->timer_callback = solveTimer;
+            worker->solver->userdata = worker;
+        }
+    }
+    while (pool.num_threads < num_workers - 1) {
+        int share = pool.num_threads + 1;
+        pool.first_job[share] = pool.job_id;
+        if (pthread_create(&pool.threads[pool.num_threads], NULL, poolWorker,
+                           (void *) (intptr_t) share) != 0) {
+            fprintf(stderr, "Could not start solver thread %d, using %d "
+                    "solvers.\n", share, share);
+            num_workers = share;
+            break;
+        }
+        pool.num_threads++;
+    }
+    pool.num_workers = num_workers;
+    pthread_mutex_unlock(&pool.lock);
+    return num_workers;
+}
+
+/* Function to get how many solvers search the indexes at once.
+** Input: None.
+** Output: The number of solvers, including the caller's.
+*/
+int getSolveWorkers() {
+    if (pool.num_workers == 0) {
+        setSolveWorkers(0);
+    }
+    return pool.num_workers;
+}
+
+/* Function to solve a field against a list of indexes, split between the
+** solvers of the pool.
+** Input: What to solve, the indexes to search (loaded), and where to put the
+** solution.
+** Output: 1 if a solver solved the field, 0 if none did.
+*/
+int solveOnPool(const struct solve_params * params, index_t ** indexes,
+                int num_indexes, struct solve_result * result) {
+    int num_shares = getSolveWorkers();
+
+    // no more shares than indexes, or some solvers would sit idle
+    if (num_shares > num_indexes) {
+        num_shares = num_indexes;
+    }
+    if (num_shares <= 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.params = params;
+    pool.indexes = indexes;
+    pool.num_indexes = num_indexes;
+    pool.num_shares = num_shares;
+    pool.result = result;
+    pool.solved = 0;
+    pool.cancelled = 0;
+    if (num_shares > 1) {
+        pool.running = pool.num_threads;
+        pool.job_id++;
+        pthread_cond_broadcast(&pool.start);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    solveShare(0, num_shares);
+
+    pthread_mutex_lock(&pool.lock);
+    while (num_shares > 1 && pool.running > 0) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    int solved = pool.solved;
+    pthread_mutex_unlock(&pool.lock);
+    return solved;
+}
@@ -10,7 +10,9 @@
 #include <errno.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <jpeglib.h>
 #include <setjmp.h>
 #include <stdarg.h>
@@ -24,19 +26,31 @@ static int server_socket = -1;
 static int server_running = 0;
 static FILE *log_file = NULL;
 
-// Smart replacement image management
-static image_data_t current_image = {0};     // Latest available image
-static image_data_t pending_image = {0};     // Newer image waiting to replace current
+// Recent compressed images, oldest overwritten first. The one being
+// transmitted is pinned so the chunks can be sent straight from it.
+static image_data_t image_ring[STARCAM_RING_SIZE] = {0};
+static int ring_newest = -1;                 // Slot of the latest image
+static int ring_pinned = -1;                 // Slot being transmitted
 static pthread_mutex_t image_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // Current transmission state
 static struct {
     int active;
+    int slot;
+    uint32_t base;                           // Part of the image data being sent
+    uint32_t size;
     time_t image_timestamp;
     uint32_t total_chunks;
+    uint32_t window;                         // 0 when the ground does not ack
+    uint32_t acked;                          // Every chunk before this one arrived
+    uint32_t next_chunk;                     // First chunk never sent
+    uint32_t resend[MAX_RESEND_CHUNKS];      // Chunks the ground asked for again
+    int num_resend;
     uint32_t chunks_sent;
     struct sockaddr_in client_addr;
     time_t start_time;
+    double last_heard_ms;
+    double last_probe_ms;
 } transmission_state = {0};
 
 // Bandwidth limiting
@@ -44,6 +58,8 @@ static struct {
     time_t last_update;
     uint32_t bytes_sent;
     uint32_t current_bps;
+    double tokens;                           // Bytes that can be sent now
+    double last_refill_ms;
 } bandwidth_tracker = {0};
 
 // Error handling for JPEG compression
@@ -73,195 +89,407 @@ static void log_message(const char *level, const char *message, ...) {
     va_end(args);
 }
 
-// Compress raw image data to JPEG
-static int compress_image_to_jpeg(void *raw_data, int width, int height, 
-                                 uint8_t **output_buffer, uint32_t *output_size) {
+// Compress raw image data to JPEG. Rows are stride bytes apart, so a
+// tile can be compressed in place. The output goes into *buffer, which is
+// kept from one call to the next and only replaced when libjpeg needs more
+// than *alloc bytes.
+static int compress_image_to_jpeg(const uint8_t *raw_data, int stride, int width, int height,
+                                 int quality, J_DCT_METHOD dct_method, uint8_t **buffer,
+                                 unsigned long *alloc, unsigned long *output_size) {
     struct jpeg_compress_struct cinfo;
     struct jpeg_error_mgr_custom jerr;
     JSAMPROW row_pointer[1];
-    uint8_t *jpeg_buffer = NULL;
-    unsigned long jpeg_size = 0;
-    
-    // DEBUG: Check for obviously invalid image data
-    uint8_t *data_ptr = (uint8_t*)raw_data;
-    int zero_count = 0, nonzero_count = 0;
-    uint32_t pixel_sum = 0;
-    
-    // Sample first 1000 pixels to check image validity
-    int sample_size = (width * height > 1000) ? 1000 : width * height;
-    for (int i = 0; i < sample_size; i++) {
-        if (data_ptr[i] == 0) {
-            zero_count++;
-        } else {
-            nonzero_count++;
-            pixel_sum += data_ptr[i];
-        }
-    }
-    
-    log_message("DEBUG", "Image statistics: %dx%d, sample %d pixels: %d zeros, %d non-zeros, avg non-zero: %.1f", 
-               width, height, sample_size, zero_count, nonzero_count, 
-               nonzero_count > 0 ? (float)pixel_sum / nonzero_count : 0.0);
-    
+    uint8_t *jpeg_buffer = *buffer;
+    unsigned long jpeg_size = *buffer ? *alloc : 0;
+
     // Set up error handling
     cinfo.err = jpeg_std_error(&jerr.pub);
     jerr.pub.error_exit = jpeg_error_exit;
-    
+
     if (setjmp(jerr.setjmp_buffer)) {
         jpeg_destroy_compress(&cinfo);
-        if (jpeg_buffer) free(jpeg_buffer);
+        if (jpeg_buffer && jpeg_buffer != *buffer) free(jpeg_buffer);
         log_message("ERROR", "JPEG compression failed with libjpeg error");
         return -1;
     }
-    
+
     // Initialize JPEG compression
     jpeg_create_compress(&cinfo);
     jpeg_mem_dest(&cinfo, &jpeg_buffer, &jpeg_size);
-    
+
     // Set compression parameters
     cinfo.image_width = width;
     cinfo.image_height = height;
     cinfo.input_components = 1;  // Grayscale
     cinfo.in_color_space = JCS_GRAYSCALE;
-    
+
     jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, starcam_config.compression_quality, TRUE);
-    
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.dct_method = dct_method;
+
     // Start compression
     jpeg_start_compress(&cinfo, TRUE);
-    
+
     // Compress line by line
     while (cinfo.next_scanline < cinfo.image_height) {
-        row_pointer[0] = (JSAMPROW)((uint8_t*)raw_data + cinfo.next_scanline * width);
+        row_pointer[0] = (JSAMPROW)(raw_data + cinfo.next_scanline * stride);
         jpeg_write_scanlines(&cinfo, row_pointer, 1);
     }
-    
+
     jpeg_finish_compress(&cinfo);
     jpeg_destroy_compress(&cinfo);
-    
-    // Allocate output buffer and copy data
-    *output_buffer = malloc(jpeg_size);
-    if (!*output_buffer) {
-        free(jpeg_buffer);
-        log_message("ERROR", "Failed to allocate output buffer for compressed image");
-        return -1;
+
+    // libjpeg grew the buffer into a new one of its own: keep that instead
+    if (jpeg_buffer != *buffer) {
+        free(*buffer);
+        *buffer = jpeg_buffer;
+        *alloc = jpeg_size;
     }
-    
-    memcpy(*output_buffer, jpeg_buffer, jpeg_size);
     *output_size = jpeg_size;
-    
-    free(jpeg_buffer);
-    log_message("DEBUG", "JPEG compression successful: %u bytes output", jpeg_size);
     return 0;
 }
 
+// A frame handed from the camera thread to the compression worker
+typedef struct {
+    char image_path[512];
+    time_t timestamp;
+    int blob_count;
+    int width;
+    int height;
+    uint8_t *raw_data;
+    size_t raw_alloc;
+    double star_x[MAX_HANDOFF_BLOBS];        // Brightest blobs, for the tiles
+    double star_y[MAX_HANDOFF_BLOBS];
+    int num_stars;
+} frame_handoff_t;
+
+// Compression worker. notifyImageServer copies the frame into pending and
+// returns; the worker swaps it with work and compresses it. A frame still
+// pending when the next one comes is replaced by it. The buffers are all
+// reused from frame to frame.
+static struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int running;
+    int has_pending;
+    frame_handoff_t pending;
+    frame_handoff_t work;
+    uint8_t *jpeg_buffer;                    // Each layer is compressed here
+    unsigned long jpeg_alloc;
+    uint8_t *spare;                          // Image data of the last evicted slot
+    uint32_t spare_alloc;
+    uint8_t *small;                          // Downsampled frame
+    size_t small_alloc;
+    // per-frame compression latency, guarded by lock
+    unsigned long frames;
+    uint32_t frames_replaced;
+    double last_ms;
+    double mean_ms;
+} compressor = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+// Image data being put together one layer at a time
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t alloc;
+    image_layer_t layers[MAX_IMAGE_LAYERS];
+    int num_layers;
+} layer_builder_t;
+
+// Pick the JPEG quality and DCT for the bandwidth budget: the configured
+// quality with the accurate DCT when there is room, otherwise a lower
+// quality with the fast integer DCT
+static int choose_quality(J_DCT_METHOD *dct_method) {
+    int quality = starcam_config.compression_quality;
+    int preset;
+
+    if (starcam_config.max_bandwidth_kbps >= FAST_PRESET_KBPS) {
+        *dct_method = JDCT_ISLOW;
+        return quality;
+    }
+    *dct_method = JDCT_IFAST;
+    preset = starcam_config.max_bandwidth_kbps >= LOW_PRESET_KBPS ?
+             FAST_PRESET_QUALITY : LOW_PRESET_QUALITY;
+    return quality < preset ? quality : preset;
+}
+
+// Compress one layer and append it to the image data
+static int add_layer(layer_builder_t *builder, layer_type_t type, int scale, int x, int y,
+                     const uint8_t *pixels, int stride, int width, int height, int quality,
+                     J_DCT_METHOD dct_method) {
+    unsigned long jpeg_size;
+
+    if (builder->num_layers >= MAX_IMAGE_LAYERS ||
+        compress_image_to_jpeg(pixels, stride, width, height, quality, dct_method,
+                               &compressor.jpeg_buffer, &compressor.jpeg_alloc, &jpeg_size) != 0) {
+        return -1;
+    }
+
+    if (builder->size + jpeg_size > builder->alloc) {
+        uint32_t alloc = 2 * (builder->size + jpeg_size);
+        uint8_t *data = realloc(builder->data, alloc);
+        if (!data) {
+            log_message("ERROR", "Failed to allocate output buffer for compressed image");
+            return -1;
+        }
+        builder->data = data;
+        builder->alloc = alloc;
+    }
+    memcpy(builder->data + builder->size, compressor.jpeg_buffer, jpeg_size);
+
+    builder->layers[builder->num_layers++] = (image_layer_t) {
+        .type = type,
+        .scale = scale,
+        .x = x,
+        .y = y,
+        .width = width,
+        .height = height,
+        .offset = builder->size,
+        .size = jpeg_size
+    };
+    builder->size += jpeg_size;
+    return 0;
+}
+
+// Box average the frame down by scale each way, rounding the size down
+static void downsample_image(const uint8_t *raw_data, int width, int height, int scale,
+                             uint8_t *output) {
+    int out_width = width / scale, out_height = height / scale;
+
+    for (int j = 0; j < out_height; j++) {
+        for (int i = 0; i < out_width; i++) {
+            uint32_t sum = 0;
+            for (int dj = 0; dj < scale; dj++) {
+                const uint8_t *row = raw_data + (j * scale + dj) * width + i * scale;
+                for (int di = 0; di < scale; di++) {
+                    sum += row[di];
+                }
+            }
+            output[i + j * out_width] = sum / (scale * scale);
+        }
+    }
+}
+
+// Full resolution tiles around the brightest blobs, which come brightest
+// first. star_y counts up from the bottom of the frame, as findBlobs gives
+// it. Blobs inside a tile already taken do not get their own.
+static int add_roi_layers(layer_builder_t *builder, const uint8_t *raw_data, int width, int height,
+                          int blob_count, const double *star_x, const double *star_y) {
+    int size_x = width < ROI_TILE_SIZE ? width : ROI_TILE_SIZE;
+    int size_y = height < ROI_TILE_SIZE ? height : ROI_TILE_SIZE;
+    int first = builder->num_layers;
+
+    for (int b = 0; b < blob_count && builder->num_layers - first < MAX_ROI_TILES; b++) {
+        int cx = (int) star_x[b];
+        int cy = height - (int) star_y[b];
+        int covered = 0;
+
+        for (int l = first; l < builder->num_layers && !covered; l++) {
+            const image_layer_t *tile = &builder->layers[l];
+            covered = cx >= tile->x && cx < tile->x + tile->width &&
+                      cy >= tile->y && cy < tile->y + tile->height;
+        }
+        if (covered || cx < 0 || cy < 0 || cx >= width || cy >= height) {
+            continue;
+        }
+
+        int x = cx - size_x / 2, y = cy - size_y / 2;
+        x = x < 0 ? 0 : (x > width - size_x ? width - size_x : x);
+        y = y < 0 ? 0 : (y > height - size_y ? height - size_y : y);
+        if (add_layer(builder, LAYER_ROI, 1, x, y, raw_data + x + y * width, width,
+                      size_x, size_y, ROI_QUALITY, JDCT_ISLOW) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Compress a frame into its layers, into builder's data (which it may
+// grow): the full frame alone, or with progressive encoding a thumbnail, the
+// blob tiles and a half resolution frame ahead of it
+static int compress_image_layers(const frame_handoff_t *frame, int quality,
+                                 J_DCT_METHOD dct_method, layer_builder_t *builder) {
+    const uint8_t *raw_data = frame->raw_data;
+    int width = frame->width, height = frame->height;
+
+    builder->size = 0;
+    builder->num_layers = 0;
+
+    if (starcam_config.progressive) {
+        size_t small_size = (size_t) (width / REFINE_SCALE) * (height / REFINE_SCALE);
+        if (small_size > compressor.small_alloc) {
+            uint8_t *small = realloc(compressor.small, small_size);
+            if (!small) {
+                log_message("ERROR", "Failed to allocate downsampled image");
+                return -1;
+            }
+            compressor.small = small;
+            compressor.small_alloc = small_size;
+        }
+
+        downsample_image(raw_data, width, height, THUMBNAIL_SCALE, compressor.small);
+        if (add_layer(builder, LAYER_THUMBNAIL, THUMBNAIL_SCALE, 0, 0, compressor.small,
+                      width / THUMBNAIL_SCALE, width / THUMBNAIL_SCALE,
+                      height / THUMBNAIL_SCALE, quality, dct_method) != 0 ||
+            add_roi_layers(builder, raw_data, width, height, frame->num_stars,
+                           frame->star_x, frame->star_y) != 0) {
+            return -1;
+        }
+        downsample_image(raw_data, width, height, REFINE_SCALE, compressor.small);
+        if (add_layer(builder, LAYER_REFINE, REFINE_SCALE, 0, 0, compressor.small,
+                      width / REFINE_SCALE, width / REFINE_SCALE,
+                      height / REFINE_SCALE, quality, dct_method) != 0) {
+            return -1;
+        }
+    }
+
+    return add_layer(builder, LAYER_FULL, 1, 0, 0, raw_data, width, width, height,
+                     quality, dct_method);
+}
+
 // Helper function to free compressed data
 static void free_image_data(image_data_t *image) {
     if (image->compressed_data) {
         free(image->compressed_data);
         image->compressed_data = NULL;
     }
+    image->compressed_alloc = 0;
     image->valid = 0;
 }
 
-// Note: Proactive streaming to trusted IPs has been removed
-// Server now operates in request-response mode only
+// Monotonic time in milliseconds for the ack timeouts
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
 
-// Replace current image with new one (smart replacement logic)
-static int replace_current_image(const char *image_path, int blob_count, 
-                               time_t timestamp, void *raw_data, int width, int height) {
-    pthread_mutex_lock(&image_mutex);
-    
-    // Compress the new image
-    uint8_t *compressed_data;
-    uint32_t compressed_size;
-    if (compress_image_to_jpeg(raw_data, width, height, &compressed_data, &compressed_size) != 0) {
-        log_message("ERROR", "Failed to compress image: %s", image_path);
-        pthread_mutex_unlock(&image_mutex);
+// Compress a new image and put it in the ring over the oldest one that is
+// not being transmitted. The evicted image's buffer is kept for the next.
+static int store_image(const frame_handoff_t *frame) {
+    J_DCT_METHOD dct_method;
+    int quality = choose_quality(&dct_method);
+
+    // Compress the new image, the ring is only locked to swap it in
+    layer_builder_t builder = {.data = compressor.spare, .alloc = compressor.spare_alloc};
+    compressor.spare = NULL;
+    compressor.spare_alloc = 0;
+    if (compress_image_layers(frame, quality, dct_method, &builder) != 0) {
+        log_message("ERROR", "Failed to compress image: %s", frame->image_path);
+        compressor.spare = builder.data;
+        compressor.spare_alloc = builder.alloc;
         return -1;
     }
-    
-    log_message("INFO", "Compressed image %s: %dx%d -> %u bytes (%.1f%% reduction)", 
-               image_path, width, height, compressed_size, 
-               100.0 * (1.0 - (double)compressed_size / (width * height)));
-    
-    if (transmission_state.active) {
-        // Transmission in progress - update pending image
-        free_image_data(&pending_image);
-        
-        strncpy(pending_image.image_path, image_path, sizeof(pending_image.image_path) - 1);
-        pending_image.timestamp = timestamp;
-        pending_image.blob_count = blob_count;
-        pending_image.width = width;
-        pending_image.height = height;
-        pending_image.compressed_data = compressed_data;
-        pending_image.compressed_size = compressed_size;
-        pending_image.original_size = width * height;
-        pending_image.compression_quality = starcam_config.compression_quality;
-        pending_image.created_time = time(NULL);
-        pending_image.valid = 1;
-        
-        log_message("INFO", "Stored pending image: %s (transmission in progress)", image_path);
-    } else {
-        // No transmission - update current image immediately
-        free_image_data(&current_image);
-        
-        strncpy(current_image.image_path, image_path, sizeof(current_image.image_path) - 1);
-        current_image.timestamp = timestamp;
-        current_image.blob_count = blob_count;
-        current_image.width = width;
-        current_image.height = height;
-        current_image.compressed_data = compressed_data;
-        current_image.compressed_size = compressed_size;
-        current_image.original_size = width * height;
-        current_image.compression_quality = starcam_config.compression_quality;
-        current_image.created_time = time(NULL);
-        current_image.valid = 1;
-        
-        log_message("INFO", "Updated current image: %s", image_path);
+
+    uint32_t full_size = builder.layers[builder.num_layers - 1].size;
+    log_message("INFO", "Compressed image %s: %dx%d -> %u bytes (%.1f%% reduction, quality %d), %u bytes in %d layers",
+               frame->image_path, frame->width, frame->height, full_size,
+               100.0 * (1.0 - (double)full_size / (frame->width * frame->height)),
+               quality, builder.size, builder.num_layers);
+
+    pthread_mutex_lock(&image_mutex);
+
+    int slot = (ring_newest + 1) % STARCAM_RING_SIZE;
+    if (slot == ring_pinned) {
+        slot = (slot + 1) % STARCAM_RING_SIZE;
     }
-    
+    image_data_t *img = &image_ring[slot];
+    compressor.spare = img->compressed_data;
+    compressor.spare_alloc = img->compressed_alloc;
+
+    strncpy(img->image_path, frame->image_path, sizeof(img->image_path) - 1);
+    img->image_path[sizeof(img->image_path) - 1] = '\0';
+    img->timestamp = frame->timestamp;
+    img->blob_count = frame->blob_count;
+    img->width = frame->width;
+    img->height = frame->height;
+    img->compressed_data = builder.data;
+    img->compressed_size = builder.size;
+    img->compressed_alloc = builder.alloc;
+    memcpy(img->layers, builder.layers, sizeof(builder.layers));
+    img->num_layers = builder.num_layers;
+    img->original_size = frame->width * frame->height;
+    img->compression_quality = quality;
+    img->created_time = time(NULL);
+    img->valid = 1;
+    ring_newest = slot;
+
     pthread_mutex_unlock(&image_mutex);
+
+    log_message("INFO", "Stored image %s in slot %d", frame->image_path, slot);
     return 0;
 }
 
-// Get the latest available image for transmission
-static image_data_t* get_latest_image(void) {
-    pthread_mutex_lock(&image_mutex);
-    
-    if (!current_image.valid) {
-        pthread_mutex_unlock(&image_mutex);
-        return NULL;
+// Compression worker thread: compresses the latest frame handed over and
+// keeps track of how long each one takes
+static void* compress_thread_func(void *arg) {
+    (void) arg;
+
+    pthread_mutex_lock(&compressor.lock);
+    while (compressor.running) {
+        if (!compressor.has_pending) {
+            pthread_cond_wait(&compressor.cond, &compressor.lock);
+            continue;
+        }
+        frame_handoff_t frame = compressor.work;
+        compressor.work = compressor.pending;
+        compressor.pending = frame;
+        compressor.has_pending = 0;
+        pthread_mutex_unlock(&compressor.lock);
+
+        double start = now_ms();
+        int ret = store_image(&compressor.work);
+        double ms = now_ms() - start;
+
+        pthread_mutex_lock(&compressor.lock);
+        if (ret == 0) {
+            compressor.frames++;
+            compressor.last_ms = ms;
+            compressor.mean_ms += (ms - compressor.mean_ms) / compressor.frames;
+        }
     }
-    
-    // Return pointer to current image (caller should not free this)
-    pthread_mutex_unlock(&image_mutex);
-    return &current_image;
+    pthread_mutex_unlock(&compressor.lock);
+    return NULL;
 }
 
-// Called when transmission completes - promote pending image if available
+// Find the latest image, or the one taken at timestamp, in the ring. Call
+// with image_mutex held. Returns the slot or -1.
+static int find_image(int latest, time_t timestamp) {
+    if (ring_newest < 0) {
+        return -1;
+    }
+    if (latest) {
+        return image_ring[ring_newest].valid ? ring_newest : -1;
+    }
+
+    for (int i = 0; i < STARCAM_RING_SIZE; i++) {
+        int slot = (ring_newest - i + STARCAM_RING_SIZE) % STARCAM_RING_SIZE;
+        if (image_ring[slot].valid && image_ring[slot].timestamp == timestamp) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+// Called when transmission completes or is given up - unpin its image
 static void on_transmission_complete(void) {
     pthread_mutex_lock(&image_mutex);
-    
+
     transmission_state.active = 0;
-    
-    if (pending_image.valid) {
-        // Promote pending image to current
-        free_image_data(&current_image);
-        current_image = pending_image;
-        
-        // Clear pending slot
-        memset(&pending_image, 0, sizeof(pending_image));
-        
-        log_message("INFO", "Promoted pending image to current: %s", current_image.image_path);
-    }
-    
+    ring_pinned = -1;
+
     pthread_mutex_unlock(&image_mutex);
 }
 
 // Update bandwidth usage tracking
 static void update_bandwidth_usage(uint32_t bytes_sent) {
     time_t now = time(NULL);
-    
+
+    bandwidth_tracker.tokens -= bytes_sent;
     if (now != bandwidth_tracker.last_update) {
         bandwidth_tracker.current_bps = bandwidth_tracker.bytes_sent;
         bandwidth_tracker.bytes_sent = bytes_sent;
@@ -271,21 +499,31 @@ static void update_bandwidth_usage(uint32_t bytes_sent) {
     }
 }
 
-// Check if we can send data without exceeding bandwidth limit
+// Check if we can send data without exceeding bandwidth limit. The budget
+// refills continuously and only BANDWIDTH_BURST_MS of it can build up, so
+// chunks go out evenly over the second instead of all at its start.
 static int can_send_data(uint32_t bytes) {
-    uint32_t max_bps = starcam_config.max_bandwidth_kbps * 1024 / 8;  // Convert to bytes per second
-    return (bandwidth_tracker.bytes_sent + bytes) <= max_bps;
+    double max_bps = starcam_config.max_bandwidth_kbps * 1024.0 / 8;  // Convert to bytes per second
+    double burst = max_bps * BANDWIDTH_BURST_MS / 1000;
+    double now = now_ms();
+
+    // A whole chunk always fits, however low the limit
+    if (burst < sizeof(image_chunk_msg_t) + starcam_config.chunk_size) {
+        burst = sizeof(image_chunk_msg_t) + starcam_config.chunk_size;
+    }
+    bandwidth_tracker.tokens += (now - bandwidth_tracker.last_refill_ms) * max_bps / 1000;
+    if (bandwidth_tracker.tokens > burst) {
+        bandwidth_tracker.tokens = burst;
+    }
+    bandwidth_tracker.last_refill_ms = now;
+    return bandwidth_tracker.tokens >= bytes;
 }
 
-// Send message to client
+// Send a control message to client. These are small and the transfer
+// stalls without them, so they always go out: what they use is taken from
+// the budget and the chunks after them wait for it instead.
 static int send_message(int socket, struct sockaddr_in *client_addr, 
                        void *message, size_t size) {
-    if (!can_send_data(size)) {
-        log_message("WARN", "Bandwidth limit reached, delaying transmission");
-        usleep(100000);  // Wait 100ms
-        return 0;  // Return 0 to indicate delay, not error
-    }
-    
     ssize_t sent = sendto(socket, message, size, 0, 
                          (struct sockaddr*)client_addr, sizeof(*client_addr));
     if (sent > 0) {
@@ -295,59 +533,269 @@ static int send_message(int socket, struct sockaddr_in *client_addr,
     return sent;
 }
 
+// Send one chunk of the image being transmitted, straight from its ring
+// slot: the chunk header and the data go out as one datagram without being
+// copied together
+static ssize_t send_chunk(int socket, uint32_t chunk_id) {
+    const image_data_t *img = &image_ring[transmission_state.slot];
+    uint32_t chunk_offset = chunk_id * starcam_config.chunk_size;
+    uint32_t chunk_size = starcam_config.chunk_size;
+
+    // Last chunk might be smaller
+    if (chunk_offset + chunk_size > transmission_state.size) {
+        chunk_size = transmission_state.size - chunk_offset;
+    }
+
+    image_chunk_msg_t chunk_msg = {
+        .header = {MSG_IMAGE_CHUNK, sizeof(image_chunk_msg_t) - sizeof(message_header_t) + chunk_size, chunk_id},
+        .chunk_id = chunk_id,
+        .data_size = chunk_size
+    };
+    struct iovec iov[2] = {
+        {.iov_base = &chunk_msg, .iov_len = sizeof(chunk_msg)},
+        {.iov_base = img->compressed_data + transmission_state.base + chunk_offset, .iov_len = chunk_size}
+    };
+    struct msghdr msg = {
+        .msg_name = &transmission_state.client_addr,
+        .msg_namelen = sizeof(transmission_state.client_addr),
+        .msg_iov = iov,
+        .msg_iovlen = 2
+    };
+
+    ssize_t sent = sendmsg(socket, &msg, 0);
+    if (sent > 0) {
+        update_bandwidth_usage(sent);
+        transmission_state.chunks_sent++;
+    }
+    return sent;
+}
+
+// Send IMAGE_COMPLETE and end the transmission
+static void finish_transmission(int socket) {
+    image_complete_msg_t complete_msg = {
+        .header = {MSG_IMAGE_COMPLETE, sizeof(image_complete_msg_t) - sizeof(message_header_t), 0},
+        .timestamp = transmission_state.image_timestamp,
+        .total_chunks_sent = transmission_state.chunks_sent
+    };
+
+    send_message(socket, &transmission_state.client_addr, &complete_msg, sizeof(complete_msg));
+
+    log_message("INFO", "Completed transmission of image %ld (%u chunks sent for %u)",
+               transmission_state.image_timestamp, transmission_state.chunks_sent,
+               transmission_state.total_chunks);
+
+    on_transmission_complete();
+}
+
+// Start sending the image in a ring slot, pinned by the caller: every
+// layer if progressive, or else the full frame JPEG alone
+static void start_transmission(int socket, struct sockaddr_in *client_addr,
+                               uint32_t sequence, int slot, uint32_t window,
+                               uint32_t first_chunk, int progressive) {
+    const image_data_t *img = &image_ring[slot];
+    const image_layer_t *full = &img->layers[img->num_layers - 1];
+    uint32_t base = progressive ? 0 : full->offset;
+    uint32_t size = progressive ? img->compressed_size : full->size;
+    uint32_t total_chunks = (size + starcam_config.chunk_size - 1) / starcam_config.chunk_size;
+
+    if (first_chunk > total_chunks) {
+        first_chunk = total_chunks;
+    }
+
+    transmission_state.active = 1;
+    transmission_state.slot = slot;
+    transmission_state.base = base;
+    transmission_state.size = size;
+    transmission_state.image_timestamp = img->timestamp;
+    transmission_state.total_chunks = total_chunks;
+    transmission_state.window = window;
+    transmission_state.acked = first_chunk;
+    transmission_state.next_chunk = first_chunk;
+    transmission_state.num_resend = 0;
+    transmission_state.chunks_sent = 0;
+    transmission_state.client_addr = *client_addr;
+    transmission_state.start_time = time(NULL);
+    transmission_state.last_heard_ms = now_ms();
+    transmission_state.last_probe_ms = transmission_state.last_heard_ms;
+
+    // Send image header
+    image_header_msg_t img_header = {
+        .header = {MSG_IMAGE_HEADER, sizeof(image_header_msg_t) - sizeof(message_header_t), sequence},
+        .timestamp = img->timestamp,
+        .total_size = size,
+        .total_chunks = total_chunks,
+        .compression_quality = img->compression_quality,
+        .blob_count = img->blob_count,
+        .width = img->width,
+        .height = img->height
+    };
+
+    send_message(socket, client_addr, &img_header, sizeof(img_header));
+
+    // Then where each layer is, so the ground can show them as they arrive
+    if (progressive) {
+        uint8_t layers_buffer[sizeof(image_layers_msg_t) + MAX_IMAGE_LAYERS * sizeof(image_layer_t)];
+        image_layers_msg_t *layers_msg = (image_layers_msg_t*)layers_buffer;
+        size_t layers_size = sizeof(image_layers_msg_t) + img->num_layers * sizeof(image_layer_t);
+
+        layers_msg->header = (message_header_t){MSG_IMAGE_LAYERS, layers_size - sizeof(message_header_t), sequence};
+        layers_msg->timestamp = img->timestamp;
+        layers_msg->num_layers = img->num_layers;
+        memcpy(layers_msg->layers, img->layers, img->num_layers * sizeof(image_layer_t));
+        send_message(socket, client_addr, layers_msg, layers_size);
+    }
+
+    log_message("INFO", "Started transmission of image %ld (%u bytes in %u chunks, %d layers, from chunk %u, window %u)",
+               img->timestamp, size, total_chunks, progressive ? img->num_layers : 1, first_chunk, window);
+}
+
+// Take in an acknowledgement of a windowed transmission: move the window
+// up and queue the chunks the ground says it is missing
+static void handle_ack(int socket, struct sockaddr_in *client_addr,
+                       uint8_t *buffer, size_t buffer_size) {
+    if (buffer_size < sizeof(image_ack_msg_t)) {
+        log_message("ERROR", "Received invalid ack size: %zu", buffer_size);
+        return;
+    }
+
+    image_ack_msg_t *ack = (image_ack_msg_t*)buffer;
+    if (!transmission_state.active || !transmission_state.window ||
+        ack->timestamp != transmission_state.image_timestamp ||
+        client_addr->sin_addr.s_addr != transmission_state.client_addr.sin_addr.s_addr ||
+        client_addr->sin_port != transmission_state.client_addr.sin_port) {
+        return;  // Stale ack for a transfer that is over
+    }
+    transmission_state.last_heard_ms = now_ms();
+
+    if (ack->next_chunk > transmission_state.acked) {
+        transmission_state.acked = ack->next_chunk < transmission_state.total_chunks ?
+                                   ack->next_chunk : transmission_state.total_chunks;
+    }
+    if (transmission_state.acked >= transmission_state.total_chunks) {
+        finish_transmission(socket);
+        return;
+    }
+
+    // Drop queued resends the ground has now, then queue the missing ones
+    int kept = 0;
+    for (int i = 0; i < transmission_state.num_resend; i++) {
+        if (transmission_state.resend[i] >= transmission_state.acked) {
+            transmission_state.resend[kept++] = transmission_state.resend[i];
+        }
+    }
+    transmission_state.num_resend = kept;
+
+    uint32_t num_missing = ack->num_missing;
+    if (num_missing > (buffer_size - sizeof(image_ack_msg_t)) / sizeof(uint32_t)) {
+        num_missing = (buffer_size - sizeof(image_ack_msg_t)) / sizeof(uint32_t);
+    }
+    for (uint32_t i = 0; i < num_missing &&
+                         transmission_state.num_resend < MAX_RESEND_CHUNKS; i++) {
+        uint32_t chunk_id = ack->missing[i];
+        int queued = 0;
+
+        // Only chunks that were sent and not acknowledged
+        if (chunk_id < transmission_state.acked ||
+            chunk_id >= transmission_state.next_chunk) {
+            continue;
+        }
+        for (int j = 0; j < transmission_state.num_resend && !queued; j++) {
+            queued = transmission_state.resend[j] == chunk_id;
+        }
+        if (!queued) {
+            transmission_state.resend[transmission_state.num_resend++] = chunk_id;
+        }
+    }
+}
+
 // Handle client requests
-static void handle_client_request(int socket, struct sockaddr_in *client_addr, 
+static void handle_client_request(int socket, struct sockaddr_in *client_addr,
                                 uint8_t *buffer, size_t buffer_size) {
     if (buffer_size < sizeof(message_header_t)) {
         log_message("ERROR", "Received invalid message size: %zu", buffer_size);
         return;
     }
-    
+
     message_header_t *header = (message_header_t*)buffer;
-    
+
     switch (header->type) {
-        case MSG_GET_LATEST_IMAGE: {
-            image_data_t *img = get_latest_image();
-            if (!img) {
+        case MSG_GET_LATEST_IMAGE:
+        case MSG_GET_IMAGE_BY_TIMESTAMP: {
+            int latest = header->type == MSG_GET_LATEST_IMAGE;
+            time_t timestamp = 0;
+            uint32_t window = 0, first_chunk = 0, flags = 0;
+
+            if (!latest && buffer_size < sizeof(get_image_by_timestamp_msg_t)) {
+                message_header_t error_msg = {MSG_ERROR, 0, header->sequence};
+                send_message(socket, client_addr, &error_msg, sizeof(error_msg));
+                return;
+            }
+            if (!latest) {
+                timestamp = ((get_image_by_timestamp_msg_t*)buffer)->timestamp;
+            }
+            if (buffer_size >= sizeof(image_request_msg_t)) {
+                image_request_msg_t *req = (image_request_msg_t*)buffer;
+                window = req->window;
+                first_chunk = req->first_chunk;
+                flags = req->flags;
+            }
+
+            // A new request takes over from any transfer in progress
+            pthread_mutex_lock(&image_mutex);
+            int slot = find_image(latest, timestamp);
+            if (slot >= 0) {
+                ring_pinned = slot;
+            }
+            pthread_mutex_unlock(&image_mutex);
+
+            if (slot < 0) {
                 // Send error response
                 message_header_t error_msg = {MSG_ERROR, 0, header->sequence};
                 send_message(socket, client_addr, &error_msg, sizeof(error_msg));
+                if (transmission_state.active) {
+                    on_transmission_complete();
+                }
                 return;
             }
-            
-            // Start transmission using in-memory compressed data
-            transmission_state.active = 1;
-            transmission_state.image_timestamp = img->timestamp;
-            transmission_state.total_chunks = (img->compressed_size + starcam_config.chunk_size - 1) / starcam_config.chunk_size;
-            transmission_state.chunks_sent = 0;
-            transmission_state.client_addr = *client_addr;
-            transmission_state.start_time = time(NULL);
-            
-            // Send image header
-            image_header_msg_t img_header = {
-                .header = {MSG_IMAGE_HEADER, sizeof(image_header_msg_t) - sizeof(message_header_t), header->sequence},
-                .timestamp = img->timestamp,
-                .total_size = img->compressed_size,
-                .total_chunks = transmission_state.total_chunks,
-                .compression_quality = img->compression_quality,
-                .blob_count = img->blob_count,
-                .width = img->width,
-                .height = img->height
-            };
-            
-            send_message(socket, client_addr, &img_header, sizeof(img_header));
-            
-            log_message("INFO", "Started transmission of image %ld (%u bytes in %u chunks)",
-                       img->timestamp, img->compressed_size, transmission_state.total_chunks);
+
+            start_transmission(socket, client_addr, header->sequence, slot,
+                               window, first_chunk, flags & REQUEST_PROGRESSIVE);
             break;
         }
-        
+
+        case MSG_IMAGE_ACK:
+            handle_ack(socket, client_addr, buffer, buffer_size);
+            break;
+
+        case MSG_GET_IMAGE_LIST: {
+            uint8_t list_buffer[sizeof(image_list_msg_t) + STARCAM_RING_SIZE * sizeof(time_t)];
+            image_list_msg_t *list = (image_list_msg_t*)list_buffer;
+
+            list->num_images = 0;
+            pthread_mutex_lock(&image_mutex);
+            for (int i = 1; i <= STARCAM_RING_SIZE && ring_newest >= 0; i++) {
+                int slot = (ring_newest + i) % STARCAM_RING_SIZE;
+                if (image_ring[slot].valid) {
+                    list->timestamps[list->num_images++] = image_ring[slot].timestamp;
+                }
+            }
+            pthread_mutex_unlock(&image_mutex);
+
+            size_t list_size = sizeof(image_list_msg_t) + list->num_images * sizeof(time_t);
+            list->header = (message_header_t){MSG_IMAGE_LIST, list_size - sizeof(message_header_t), header->sequence};
+            send_message(socket, client_addr, list, list_size);
+            break;
+        }
+
         case MSG_GET_STATUS: {
+            int images_available = 0;
             pthread_mutex_lock(&image_mutex);
-            int images_available = current_image.valid ? 1 : 0;
-            time_t latest_timestamp = current_image.valid ? current_image.timestamp : 0;
+            for (int i = 0; i < STARCAM_RING_SIZE; i++) {
+                images_available += image_ring[i].valid;
+            }
+            time_t latest_timestamp = ring_newest >= 0 ? image_ring[ring_newest].timestamp : 0;
             pthread_mutex_unlock(&image_mutex);
-            
+
             status_response_msg_t status = {
                 .header = {MSG_STATUS_RESPONSE, sizeof(status_response_msg_t) - sizeof(message_header_t), header->sequence},
                 .current_images_available = images_available,
@@ -355,119 +803,84 @@ static void handle_client_request(int socket, struct sockaddr_in *client_addr,
                 .bandwidth_usage_kbps = bandwidth_tracker.current_bps * 8 / 1024,
                 .transmission_active = transmission_state.active
             };
-            
+
             send_message(socket, client_addr, &status, sizeof(status));
             break;
         }
-        
-        case MSG_GET_IMAGE_BY_TIMESTAMP: {
-            if (buffer_size < sizeof(get_image_by_timestamp_msg_t)) {
-                message_header_t error_msg = {MSG_ERROR, 0, header->sequence};
-                send_message(socket, client_addr, &error_msg, sizeof(error_msg));
-                return;
-            }
-            
-            get_image_by_timestamp_msg_t *req = (get_image_by_timestamp_msg_t*)buffer;
-            image_data_t *img = get_latest_image();
-            
-            if (!img) {
-                message_header_t error_msg = {MSG_ERROR, 0, header->sequence};
-                send_message(socket, client_addr, &error_msg, sizeof(error_msg));
-                return;
-            }
-            
-            // Similar logic to MSG_GET_LATEST_IMAGE...
-            // (Implementation would be similar to above)
-            break;
-        }
-        
+
         default:
             log_message("WARN", "Unknown message type: %d", header->type);
             break;
     }
 }
 
-// Continue ongoing transmission
+// Continue ongoing transmission: send requested resends first, then new
+// chunks while the window and the bandwidth allow
 static void continue_transmission(int socket) {
     if (!transmission_state.active) return;
-    
-    // Get current image being transmitted
-    pthread_mutex_lock(&image_mutex);
-    if (!current_image.valid || current_image.timestamp != transmission_state.image_timestamp) {
-        // Image no longer available or changed, abort transmission
-        pthread_mutex_unlock(&image_mutex);
-        log_message("WARN", "Aborting transmission - image no longer available");
-        transmission_state.active = 0;
-        on_transmission_complete();
-        return;
-    }
-    
-    uint8_t *compressed_data = current_image.compressed_data;
-    uint32_t compressed_size = current_image.compressed_size;
-    pthread_mutex_unlock(&image_mutex);
-    
-    while (transmission_state.chunks_sent < transmission_state.total_chunks) {
-        uint32_t chunk_offset = transmission_state.chunks_sent * starcam_config.chunk_size;
-        uint32_t chunk_size = starcam_config.chunk_size;
-        
-        // Last chunk might be smaller
-        if (chunk_offset + chunk_size > compressed_size) {
-            chunk_size = compressed_size - chunk_offset;
+
+    if (transmission_state.window) {
+        double now = now_ms();
+
+        if (now - transmission_state.last_heard_ms > TRANSFER_IDLE_SEC * 1e3) {
+            log_message("WARN", "Giving up on transmission of image %ld after %d s without an ack (%u of %u chunks acked)",
+                       transmission_state.image_timestamp, TRANSFER_IDLE_SEC,
+                       transmission_state.acked, transmission_state.total_chunks);
+            on_transmission_complete();
+            return;
+        }
+
+        // The ground has gone quiet, maybe its ack was lost: poke it with
+        // the oldest chunk it is missing so it acks again
+        if (now - transmission_state.last_heard_ms > ACK_TIMEOUT_MS &&
+            now - transmission_state.last_probe_ms > ACK_TIMEOUT_MS &&
+            transmission_state.acked < transmission_state.next_chunk &&
+            transmission_state.num_resend == 0) {
+            transmission_state.resend[transmission_state.num_resend++] = transmission_state.acked;
+            transmission_state.last_probe_ms = now;
         }
-        
-        // Create chunk message
-        size_t msg_size = sizeof(image_chunk_msg_t) + chunk_size;
-        image_chunk_msg_t *chunk_msg = malloc(msg_size);
-        if (!chunk_msg) {
-            log_message("ERROR", "Failed to allocate chunk message");
+    }
+
+    while (1) {
+        uint32_t chunk_id;
+        int resend = transmission_state.num_resend > 0;
+
+        if (resend) {
+            chunk_id = transmission_state.resend[0];
+        } else if (transmission_state.next_chunk < transmission_state.total_chunks &&
+                   (!transmission_state.window ||
+                    transmission_state.next_chunk < transmission_state.acked + transmission_state.window)) {
+            chunk_id = transmission_state.next_chunk;
+        } else {
             break;
         }
-        
-        chunk_msg->header.type = MSG_IMAGE_CHUNK;
-        chunk_msg->header.payload_size = msg_size - sizeof(message_header_t);
-        chunk_msg->header.sequence = transmission_state.chunks_sent;
-        chunk_msg->chunk_id = transmission_state.chunks_sent;
-        chunk_msg->data_size = chunk_size;
-        
-        memcpy(chunk_msg->data, compressed_data + chunk_offset, chunk_size);
-        
-        int sent = send_message(socket, &transmission_state.client_addr, chunk_msg, msg_size);
-        free(chunk_msg);
-        
-        if (sent <= 0) {
-            if (sent == 0) {
-                // Bandwidth limited, try again later
-                break;
-            } else {
-                log_message("ERROR", "Failed to send chunk %u: %s", 
-                           transmission_state.chunks_sent, strerror(errno));
-                break;
+
+        // Bandwidth limited, try again later
+        if (!can_send_data(sizeof(image_chunk_msg_t) + starcam_config.chunk_size)) {
+            return;
+        }
+
+        ssize_t sent = send_chunk(socket, chunk_id);
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_message("ERROR", "Failed to send chunk %u: %s", chunk_id, strerror(errno));
             }
+            return;
+        }
+
+        if (resend) {
+            transmission_state.num_resend--;
+            memmove(transmission_state.resend, transmission_state.resend + 1,
+                    transmission_state.num_resend * sizeof(uint32_t));
+        } else {
+            transmission_state.next_chunk++;
         }
-        
-        transmission_state.chunks_sent++;
-        
-        // Small delay between chunks to avoid overwhelming the network
-        usleep(1000);  // 1ms delay
     }
-    
-    // Check if transmission is complete
-    if (transmission_state.chunks_sent >= transmission_state.total_chunks) {
-        image_complete_msg_t complete_msg = {
-            .header = {MSG_IMAGE_COMPLETE, sizeof(image_complete_msg_t) - sizeof(message_header_t), 0},
-            .timestamp = transmission_state.image_timestamp,
-            .total_chunks_sent = transmission_state.chunks_sent
-        };
-        
-        send_message(socket, &transmission_state.client_addr, &complete_msg, sizeof(complete_msg));
-        
-        log_message("INFO", "Completed transmission of image %ld (%u chunks sent)",
-                   transmission_state.image_timestamp, transmission_state.chunks_sent);
-        
-        // Clean up transmission state
-        memset(&transmission_state, 0, sizeof(transmission_state));
-        
-        on_transmission_complete();
+
+    // Without a window, the transfer is over once everything has been sent
+    if (!transmission_state.window &&
+        transmission_state.next_chunk >= transmission_state.total_chunks) {
+        finish_transmission(socket);
     }
 }
 
@@ -476,55 +889,62 @@ static void* server_thread_func(void *arg) {
     struct sockaddr_in server_addr, client_addr;
     socklen_t client_addr_len = sizeof(client_addr);
     uint8_t buffer[2048];
-    
+
     // Create UDP socket
     server_socket = socket(AF_INET, SOCK_DGRAM, 0);
     if (server_socket < 0) {
         log_message("ERROR", "Failed to create socket: %s", strerror(errno));
         return NULL;
     }
-    
+
     // Set socket options
     int reuse = 1;
     setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
-    
+
     // Set non-blocking
     int flags = fcntl(server_socket, F_GETFL, 0);
     fcntl(server_socket, F_SETFL, flags | O_NONBLOCK);
-    
+
     // Bind socket
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
     server_addr.sin_port = htons(starcam_config.port);
-    
+
     if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         log_message("ERROR", "Failed to bind socket: %s", strerror(errno));
         close(server_socket);
         return NULL;
     }
-    
+
     log_message("INFO", "Starcam downlink server started on port %d", starcam_config.port);
     server_running = 1;
-    
+
     while (server_running) {
-        // Check for incoming requests
-        ssize_t received = recvfrom(server_socket, buffer, sizeof(buffer), 0,
-                                   (struct sockaddr*)&client_addr, &client_addr_len);
-        
-        if (received > 0) {
-            handle_client_request(server_socket, &client_addr, buffer, received);
-        } else if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-            log_message("ERROR", "Error receiving data: %s", strerror(errno));
+        // Wait for a request, or until the bandwidth allows more chunks
+        struct pollfd pfd = {.fd = server_socket, .events = POLLIN};
+        poll(&pfd, 1, 10);
+
+        // Take every request that came in
+        while (1) {
+            client_addr_len = sizeof(client_addr);
+            ssize_t received = recvfrom(server_socket, buffer, sizeof(buffer), 0,
+                                       (struct sockaddr*)&client_addr, &client_addr_len);
+
+            if (received > 0) {
+                handle_client_request(server_socket, &client_addr, buffer, received);
+            } else {
+                if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    log_message("ERROR", "Error receiving data: %s", strerror(errno));
+                }
+                break;
+            }
         }
-        
+
         // Continue any ongoing transmission
         continue_transmission(server_socket);
-        
-        // Small delay to avoid busy waiting
-        usleep(10000);  // 10ms
     }
-    
+
     close(server_socket);
     log_message("INFO", "Starcam downlink server stopped");
     return NULL;
@@ -539,7 +959,11 @@ int initStarcamDownlink(void) {
         return -1;
     }
     
-    log_message("INFO", "Starcam downlink initialized");
+#ifdef LIBJPEG_TURBO_VERSION
+    log_message("INFO", "Starcam downlink initialized (libjpeg-turbo, SIMD DCT)");
+#else
+    log_message("WARN", "Starcam downlink initialized without libjpeg-turbo, compression will be slow");
+#endif
     return 0;
 }
 
@@ -549,11 +973,34 @@ void cleanupStarcamDownlink(void) {
     if (server_thread) {
         pthread_join(server_thread, NULL);
     }
+
+    // Stop the compression worker and free its buffers
+    pthread_mutex_lock(&compressor.lock);
+    int compressing = compressor.running;
+    compressor.running = 0;
+    pthread_cond_signal(&compressor.cond);
+    pthread_mutex_unlock(&compressor.lock);
+    if (compressing) {
+        pthread_join(compressor.thread, NULL);
+    }
+    free(compressor.pending.raw_data);
+    free(compressor.work.raw_data);
+    free(compressor.jpeg_buffer);
+    free(compressor.spare);
+    free(compressor.small);
+    memset(&compressor.pending, 0, sizeof(compressor.pending));
+    memset(&compressor.work, 0, sizeof(compressor.work));
+    compressor.jpeg_buffer = compressor.spare = compressor.small = NULL;
+    compressor.jpeg_alloc = compressor.spare_alloc = compressor.small_alloc = 0;
+    compressor.has_pending = 0;
     
     // Clean up image data
     pthread_mutex_lock(&image_mutex);
-    free_image_data(&current_image);
-    free_image_data(&pending_image);
+    for (int i = 0; i < STARCAM_RING_SIZE; i++) {
+        free_image_data(&image_ring[i]);
+    }
+    ring_newest = -1;
+    ring_pinned = -1;
     pthread_mutex_unlock(&image_mutex);
     
     if (log_file) {
@@ -564,12 +1011,50 @@ void cleanupStarcamDownlink(void) {
 }
 
 void notifyImageServer(const char* image_path, int blob_count, time_t timestamp, 
-                      void* raw_data, int width, int height) {
+                      void* raw_data, int width, int height,
+                      const double* star_x, const double* star_y) {
     if (!starcam_config.enabled || !server_running) {
         return;
     }
-    
-    replace_current_image(image_path, blob_count, timestamp, raw_data, width, height);
+
+    // Hand the frame to the compression worker; only the copy is done here
+    pthread_mutex_lock(&compressor.lock);
+    frame_handoff_t *frame = &compressor.pending;
+    size_t raw_size = (size_t) width * height;
+
+    if (raw_size > frame->raw_alloc) {
+        uint8_t *raw = realloc(frame->raw_data, raw_size);
+        if (!raw) {
+            pthread_mutex_unlock(&compressor.lock);
+            log_message("ERROR", "Failed to allocate frame for compression: %s", image_path);
+            return;
+        }
+        frame->raw_data = raw;
+        frame->raw_alloc = raw_size;
+    }
+    if (compressor.has_pending) {
+        compressor.frames_replaced++;
+        log_message("WARN", "Compression behind, %s replaces %s", image_path, frame->image_path);
+    }
+
+    memcpy(frame->raw_data, raw_data, raw_size);
+    strncpy(frame->image_path, image_path, sizeof(frame->image_path) - 1);
+    frame->image_path[sizeof(frame->image_path) - 1] = '\0';
+    frame->timestamp = timestamp;
+    frame->blob_count = blob_count;
+    frame->width = width;
+    frame->height = height;
+    frame->num_stars = (star_x && star_y) ? blob_count : 0;
+    if (frame->num_stars > MAX_HANDOFF_BLOBS) {
+        frame->num_stars = MAX_HANDOFF_BLOBS;
+    }
+    if (frame->num_stars > 0) {
+        memcpy(frame->star_x, star_x, frame->num_stars * sizeof(double));
+        memcpy(frame->star_y, star_y, frame->num_stars * sizeof(double));
+    }
+    compressor.has_pending = 1;
+    pthread_cond_signal(&compressor.cond);
+    pthread_mutex_unlock(&compressor.lock);
 }
 
 int startStarcamServer(void) {
@@ -577,6 +1062,13 @@ int startStarcamServer(void) {
         return 0;  // Not enabled, but not an error
     }
     
+    compressor.running = 1;
+    if (pthread_create(&compressor.thread, NULL, compress_thread_func, NULL) != 0) {
+        log_message("ERROR", "Failed to create compression thread: %s", strerror(errno));
+        compressor.running = 0;
+        return -1;
+    }
+
     if (pthread_create(&server_thread, NULL, server_thread_func, NULL) != 0) {
         log_message("ERROR", "Failed to create server thread: %s", strerror(errno));
         return -1;
@@ -588,19 +1080,28 @@ int startStarcamServer(void) {
 // Get server status for CLI
 int getStarcamStatus(int *images_available_out, int *server_running_out, 
                     uint32_t *bandwidth_usage_out, int *transmission_active_out,
-                    time_t *latest_timestamp_out) {
+                    time_t *latest_timestamp_out, double *compress_ms_out,
+                    double *compress_mean_ms_out) {
     if (!starcam_config.enabled) {
         return 0;
     }
     
     pthread_mutex_lock(&image_mutex);
-    *images_available_out = current_image.valid ? 1 : 0;
-    *latest_timestamp_out = current_image.valid ? current_image.timestamp : 0;
+    *images_available_out = 0;
+    for (int i = 0; i < STARCAM_RING_SIZE; i++) {
+        *images_available_out += image_ring[i].valid;
+    }
+    *latest_timestamp_out = ring_newest >= 0 ? image_ring[ring_newest].timestamp : 0;
     pthread_mutex_unlock(&image_mutex);
     
     *server_running_out = server_running;
     *bandwidth_usage_out = bandwidth_tracker.current_bps * 8 / 1024; // kbps
     *transmission_active_out = transmission_state.active;
+
+    pthread_mutex_lock(&compressor.lock);
+    *compress_ms_out = compressor.last_ms;
+    *compress_mean_ms_out = compressor.mean_ms;
+    pthread_mutex_unlock(&compressor.lock);
     
     return 1;
 } 
\ No newline at end of file
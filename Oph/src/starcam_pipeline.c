@@ -0,0 +1,524 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <jpeglib.h>
+
+#include "starcam_pipeline.h"
+
+/* Slots waiting for a stage, oldest first */
+struct frame_queue {
+    int slots[PIPELINE_SLOTS];
+    int head;
+    int count;
+};
+
+/* The one pipeline. Everything but the frames a stage is working on is
+** guarded by the lock, and every change is broadcast on changed.
+*/
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int running;
+    const struct pipeline_ops * ops;
+    struct starcam_frame frames[PIPELINE_SLOTS];
+    // queue[STAGE_CAPTURE] holds the free slots
+    struct frame_queue queue[NUM_STAGES];
+    int busy[NUM_STAGES];       // stage is working on a frame
+    int done[NUM_STAGES];       // stage has stopped for good
+    unsigned long seq;
+    struct pipeline_stats stats;
+} pipeline = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .changed = PTHREAD_COND_INITIALIZER,
+};
+
+static const char * stage_names[NUM_STAGES] = {
+    "capture", "detect", "solve", "downlink",
+};
+
+/* Function to get a monotonic time for latencies.
+** Input: None.
+** Output: The time in milliseconds.
+*/
+double pipelineNowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec/1e6;
+}
+
+static void pushFrame(struct frame_queue * queue, int slot) {
+    queue->slots[(queue->head + queue->count) % PIPELINE_SLOTS] = slot;
+    queue->count++;
+}
+
+static int popFrame(struct frame_queue * queue) {
+    int slot = queue->slots[queue->head];
+    queue->head = (queue->head + 1) % PIPELINE_SLOTS;
+    queue->count--;
+    return slot;
+}
+
+/* Function to add a frame to the counters of a stage it went through.
+** Called with the lock held.
+*/
+static void recordStage(enum pipeline_stage stage,
+                        const struct starcam_frame * frame) {
+    struct stage_stats * s = &pipeline.stats.stages[stage];
+    double ms = frame->end_ms[stage] - frame->start_ms[stage];
+    double wait_ms = frame->start_ms[stage] - frame->queued_ms[stage];
+
+    s->frames++;
+    s->last_ms = ms;
+    s->mean_ms += (ms - s->mean_ms)/s->frames;
+    s->max_ms = ms > s->max_ms ? ms : s->max_ms;
+    s->mean_wait_ms += (wait_ms - s->mean_wait_ms)/s->frames;
+    s->max_wait_ms = wait_ms > s->max_wait_ms ? wait_ms : s->max_wait_ms;
+}
+
+/* Function to queue a frame for a stage. Called with the lock held. */
+static void queueFrame(enum pipeline_stage stage, int slot) {
+    pipeline.frames[slot].queued_ms[stage] = pipelineNowMs();
+    pushFrame(&pipeline.queue[stage], slot);
+}
+
+/* Function to pass a frame that is done with a stage on to the next one.
+** A frame for the solver replaces one that is already waiting for it, which
+** goes to downlink unsolved instead. Called with the lock held.
+*/
+static void passFrame(enum pipeline_stage stage, int slot) {
+    struct starcam_frame * frame = &pipeline.frames[slot];
+
+    switch (stage) {
+    case STAGE_CAPTURE:
+        queueFrame(STAGE_DETECT, slot);
+        break;
+    case STAGE_DETECT:
+        if (!frame->solve) {
+            frame->skipped = SOLVE_NOT_WANTED;
+            queueFrame(STAGE_DOWNLINK, slot);
+            break;
+        }
+        while (pipeline.queue[STAGE_SOLVE].count > 0) {
+            int older = popFrame(&pipeline.queue[STAGE_SOLVE]);
+            pipeline.frames[older].skipped = SOLVE_SUPERSEDED;
+            pipeline.stats.superseded++;
+            queueFrame(STAGE_DOWNLINK, older);
+        }
+        queueFrame(STAGE_SOLVE, slot);
+        break;
+    case STAGE_SOLVE:
+        queueFrame(STAGE_DOWNLINK, slot);
+        break;
+    default:
+        // downlinked, the slot is free again
+        pipeline.stats.last_latency_ms = frame->end_ms[STAGE_DOWNLINK] -
+                                         frame->start_ms[STAGE_CAPTURE];
+        pipeline.stats.mean_latency_ms += (pipeline.stats.last_latency_ms -
+                                           pipeline.stats.mean_latency_ms)/
+                                          pipeline.stats.stages[STAGE_DOWNLINK].frames;
+        if (pipeline.stats.last_latency_ms > pipeline.stats.max_latency_ms) {
+            pipeline.stats.max_latency_ms = pipeline.stats.last_latency_ms;
+        }
+        pushFrame(&pipeline.queue[STAGE_CAPTURE], slot);
+        break;
+    }
+    pthread_cond_broadcast(&pipeline.changed);
+}
+
+/* Function to run one stage's work on a frame, outside the lock.
+** Input: The stage and the frame.
+** Output: None, the result is left in the frame.
+*/
+static void runStage(enum pipeline_stage stage, struct starcam_frame * frame) {
+    const struct pipeline_ops * ops = pipeline.ops;
+    void * arg = ops->arg;
+
+    frame->start_ms[stage] = pipelineNowMs();
+    if (stage == STAGE_DETECT) {
+        if (ops->detect(frame, arg) < 1) {
+            frame->solve = 0;
+        }
+    } else if (stage == STAGE_SOLVE) {
+        frame->solved = ops->solve(frame, arg) == 1;
+    } else {
+        ops->downlink(frame, arg);
+    }
+    frame->end_ms[stage] = pipelineNowMs();
+}
+
+/* Thread running the detect, solve or downlink stage until the stage before
+** it has stopped and its queue is empty.
+** Input: The stage.
+** Output: None.
+*/
+static void * stageWorker(void * arg) {
+    enum pipeline_stage stage = (enum pipeline_stage) (intptr_t) arg;
+
+    pthread_mutex_lock(&pipeline.lock);
+    while (1) {
+        while (pipeline.queue[stage].count == 0 && !pipeline.done[stage - 1]) {
+            pthread_cond_wait(&pipeline.changed, &pipeline.lock);
+        }
+        if (pipeline.queue[stage].count == 0) {
+            break;
+        }
+        int slot = popFrame(&pipeline.queue[stage]);
+        struct starcam_frame * frame = &pipeline.frames[slot];
+
+        if (stage == STAGE_SOLVE &&
+            pipelineNowMs() - frame->end_ms[STAGE_CAPTURE] > PIPELINE_STALE_MS) {
+            // the pointing it would give is too old to be of use
+            frame->skipped = SOLVE_STALE;
+            pipeline.stats.stale++;
+            passFrame(stage, slot);
+            continue;
+        }
+
+        pipeline.busy[stage] = 1;
+        pthread_mutex_unlock(&pipeline.lock);
+
+        runStage(stage, frame);
+
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.busy[stage] = 0;
+        recordStage(stage, frame);
+        if (stage == STAGE_SOLVE) {
+            if (frame->solved) {
+                pipeline.stats.solved++;
+            } else {
+                pipeline.stats.failed++;
+            }
+        }
+        passFrame(stage, slot);
+    }
+    pipeline.done[stage] = 1;
+    pthread_cond_broadcast(&pipeline.changed);
+    pthread_mutex_unlock(&pipeline.lock);
+    return NULL;
+}
+
+/* Function to free the buffers of the frame slots. */
+static void freeFrames() {
+    for (int slot = 0; slot < PIPELINE_SLOTS; slot++) {
+        struct starcam_frame * frame = &pipeline.frames[slot];
+        free(frame->image);
+        free(frame->filtered);
+        free(frame->star_x);
+        free(frame->star_y);
+        free(frame->star_mags);
+        memset(frame, 0, sizeof(*frame));
+    }
+}
+
+/* Function to run frames through the pipeline until capture says to stop.
+** Capture runs on the calling thread, the other stages on threads of their
+** own. Frames already captured are finished before it returns.
+** Input: The stage functions and the frame size.
+** Output: The number of frames captured, or -1 if the pipeline could not be
+** started.
+*/
+int runPipeline(const struct pipeline_ops * ops, int width, int height) {
+    pthread_t threads[NUM_STAGES];
+    int started = STAGE_DETECT;
+
+    pthread_mutex_lock(&pipeline.lock);
+    if (pipeline.running) {
+        pthread_mutex_unlock(&pipeline.lock);
+        fprintf(stderr, "Star camera pipeline is already running.\n");
+        return -1;
+    }
+    pipeline.running = 1;
+    pipeline.ops = ops;
+    memset(pipeline.queue, 0, sizeof(pipeline.queue));
+    memset(pipeline.busy, 0, sizeof(pipeline.busy));
+    memset(pipeline.done, 0, sizeof(pipeline.done));
+    memset(&pipeline.stats, 0, sizeof(pipeline.stats));
+    pipeline.seq = 0;
+    pthread_mutex_unlock(&pipeline.lock);
+
+    for (int slot = 0; slot < PIPELINE_SLOTS; slot++) {
+        struct starcam_frame * frame = &pipeline.frames[slot];
+        frame->width = width;
+        frame->height = height;
+        frame->image = calloc(width*height, 1);
+        frame->filtered = calloc(width*height, 1);
+        if (frame->image == NULL || frame->filtered == NULL) {
+            fprintf(stderr, "Could not allocate star camera frames: %s.\n",
+                    strerror(errno));
+            freeFrames();
+            pthread_mutex_lock(&pipeline.lock);
+            pipeline.running = 0;
+            pthread_mutex_unlock(&pipeline.lock);
+            return -1;
+        }
+        pushFrame(&pipeline.queue[STAGE_CAPTURE], slot);
+    }
+
+    for (; started < NUM_STAGES; started++) {
+        if (pthread_create(&threads[started], NULL, stageWorker,
+                           (void *) (intptr_t) started) != 0) {
+            fprintf(stderr, "Could not start %s stage: %s.\n",
+                    stage_names[started], strerror(errno));
+            break;
+        }
+    }
+
+    int status = 0;
+    while (started == NUM_STAGES && status >= 0) {
+        double asked_ms = pipelineNowMs();
+        pthread_mutex_lock(&pipeline.lock);
+        while (pipeline.queue[STAGE_CAPTURE].count == 0) {
+            pthread_cond_wait(&pipeline.changed, &pipeline.lock);
+        }
+        int slot = popFrame(&pipeline.queue[STAGE_CAPTURE]);
+        pipeline.busy[STAGE_CAPTURE] = 1;
+        pthread_mutex_unlock(&pipeline.lock);
+
+        struct starcam_frame * frame = &pipeline.frames[slot];
+        frame->queued_ms[STAGE_CAPTURE] = asked_ms;
+        frame->blob_count = 0;
+        frame->solve = 0;
+        frame->solved = 0;
+        frame->skipped = SOLVE_NOT_SKIPPED;
+        frame->start_ms[STAGE_CAPTURE] = pipelineNowMs();
+        status = ops->capture(frame, ops->arg);
+        frame->end_ms[STAGE_CAPTURE] = pipelineNowMs();
+
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.busy[STAGE_CAPTURE] = 0;
+        if (status == 1) {
+            frame->seq = ++pipeline.seq;
+            pipeline.stats.captured++;
+            recordStage(STAGE_CAPTURE, frame);
+            passFrame(STAGE_CAPTURE, slot);
+        } else {
+            pushFrame(&pipeline.queue[STAGE_CAPTURE], slot);
+        }
+        pthread_mutex_unlock(&pipeline.lock);
+    }
+
+    // let the other stages finish what was captured, then stop
+    pthread_mutex_lock(&pipeline.lock);
+    pipeline.done[STAGE_CAPTURE] = 1;
+    pthread_cond_broadcast(&pipeline.changed);
+    pthread_mutex_unlock(&pipeline.lock);
+    for (int stage = STAGE_DETECT; stage < started; stage++) {
+        pthread_join(threads[stage], NULL);
+    }
+
+    freeFrames();
+    pthread_mutex_lock(&pipeline.lock);
+    pipeline.running = 0;
+    unsigned long captured = pipeline.stats.captured;
+    pthread_mutex_unlock(&pipeline.lock);
+    return started == NUM_STAGES ? (int) captured : -1;
+}
+
+/* Function to wait until every captured frame has been downlinked, for when
+** capture needs the other stages idle (e.g. auto-focusing, which moves the
+** lens between frames). Only call it from the capture function.
+** Input: None.
+** Output: None.
+*/
+void drainPipeline() {
+    pthread_mutex_lock(&pipeline.lock);
+    while (1) {
+        int idle = 1;
+        for (int stage = STAGE_DETECT; stage < NUM_STAGES; stage++) {
+            if (pipeline.queue[stage].count > 0 || pipeline.busy[stage]) {
+                idle = 0;
+            }
+        }
+        if (idle) {
+            break;
+        }
+        pthread_cond_wait(&pipeline.changed, &pipeline.lock);
+    }
+    pthread_mutex_unlock(&pipeline.lock);
+}
+
+/* Function to get the latency counters of the running or last pipeline.
+** Input: Where to put them.
+** Output: None.
+*/
+void getPipelineStats(struct pipeline_stats * stats) {
+    pthread_mutex_lock(&pipeline.lock);
+    *stats = pipeline.stats;
+    pthread_mutex_unlock(&pipeline.lock);
+}
+
+/* Function to print the latency counters as a table.
+** Input: The file to print to.
+** Output: None.
+*/
+void printPipelineStats(FILE * f) {
+    struct pipeline_stats stats;
+    getPipelineStats(&stats);
+
+    fprintf(f, "%-10s %8s %10s %10s %10s %10s %10s\n", "stage", "frames",
+            "last ms", "mean ms", "max ms", "wait ms", "max wait");
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        struct stage_stats * s = &stats.stages[stage];
+        fprintf(f, "%-10s %8lu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                stage_names[stage], s->frames, s->last_ms, s->mean_ms,
+                s->max_ms, s->mean_wait_ms, s->max_wait_ms);
+    }
+    fprintf(f, "captured %lu, solved %lu, not solved %lu, superseded %lu, "
+            "stale %lu\n", stats.captured, stats.solved, stats.failed,
+            stats.superseded, stats.stale);
+    fprintf(f, "capture to downlink: last %.1f ms, mean %.1f ms, max %.1f "
+            "ms\n", stats.last_latency_ms, stats.mean_latency_ms,
+            stats.max_latency_ms);
+    fflush(f);
+}
+
+static int hasExtension(const char * name, const char * ext) {
+    size_t len = strlen(name), ext_len = strlen(ext);
+    return len > ext_len && strcasecmp(name + len - ext_len, ext) == 0;
+}
+
+static int isFrameFile(const struct dirent * entry) {
+    return hasExtension(entry->d_name, ".raw") ||
+           hasExtension(entry->d_name, ".jpg") ||
+           hasExtension(entry->d_name, ".jpeg");
+}
+
+/* Function to open a directory of recorded frames to replay.
+** Input: The directory to fill in, the path and whether to start over after
+** the last frame.
+** Output: The number of frames, or -1 if there are none or the directory
+** cannot be read.
+*/
+int openFrameDirectory(struct frame_directory * dir, const char * path,
+                       int loop) {
+    memset(dir, 0, sizeof(*dir));
+    dir->num_names = scandir(path, &dir->names, isFrameFile, alphasort);
+    if (dir->num_names < 0) {
+        fprintf(stderr, "Could not read frame directory %s: %s.\n", path,
+                strerror(errno));
+        return -1;
+    }
+    if (dir->num_names == 0) {
+        fprintf(stderr, "No .raw or .jpg frames in %s.\n", path);
+        free(dir->names);
+        return -1;
+    }
+    dir->path = strdup(path);
+    dir->loop = loop;
+    return dir->num_names;
+}
+
+// error handling for JPEG decompression, as for compression in the downlink
+struct frame_jpeg_error {
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmp_buffer;
+};
+
+static void frameJpegError(j_common_ptr cinfo) {
+    struct frame_jpeg_error * err = (struct frame_jpeg_error *) cinfo->err;
+    longjmp(err->setjmp_buffer, 1);
+}
+
+/* Function to decode an 8 bit mono JPEG the size of the frame. */
+static int readJpegFrame(FILE * f, const char * path,
+                         struct starcam_frame * frame) {
+    struct jpeg_decompress_struct cinfo;
+    struct frame_jpeg_error jerr;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = frameJpegError;
+    if (setjmp(jerr.setjmp_buffer)) {
+        fprintf(stderr, "Could not decode %s.\n", path);
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, f);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    jpeg_start_decompress(&cinfo);
+    if ((int) cinfo.output_width != frame->width ||
+        (int) cinfo.output_height != frame->height) {
+        fprintf(stderr, "%s is %ux%u, not %dx%d.\n", path, cinfo.output_width,
+                cinfo.output_height, frame->width, frame->height);
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = (JSAMPROW) (frame->image +
+                                   cinfo.output_scanline*frame->width);
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return 0;
+}
+
+/* Function to read the next recorded frame into a pipeline frame, stamped
+** with the current time as if it had just been captured.
+** Input: The directory and the frame.
+** Output: 1 if a frame was read, 0 after the last frame and -1 if the next
+** file could not be read (it is skipped).
+*/
+int readDirectoryFrame(struct frame_directory * dir,
+                       struct starcam_frame * frame) {
+    if (dir->next >= dir->num_names) {
+        if (!dir->loop) {
+            return 0;
+        }
+        dir->next = 0;
+    }
+    const char * name = dir->names[dir->next++]->d_name;
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir->path, name);
+
+    FILE * f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Could not open %s: %s.\n", path, strerror(errno));
+        return -1;
+    }
+    int ret = 0;
+    size_t size = (size_t) frame->width*frame->height;
+    if (hasExtension(name, ".raw")) {
+        if (fread(frame->image, 1, size, f) != size) {
+            fprintf(stderr, "%s is not a raw %dx%d frame.\n", path,
+                    frame->width, frame->height);
+            ret = -1;
+        }
+    } else {
+        ret = readJpegFrame(f, path, frame);
+    }
+    fclose(f);
+    if (ret < 0) {
+        return -1;
+    }
+
+    gettimeofday(&frame->tv, NULL);
+    gmtime_r(&frame->tv.tv_sec, &frame->tm_info);
+    snprintf(frame->date, sizeof(frame->date), "%.*s",
+             (int) sizeof(frame->date) - 1, path);
+    char * ext = strrchr(frame->date, '.');
+    if (ext != NULL) {
+        *ext = '\0';
+    }
+    return 1;
+}
+
+/* Function to close a directory opened with openFrameDirectory.
+** Input: The directory.
+** Output: None.
+*/
+void closeFrameDirectory(struct frame_directory * dir) {
+    for (int name = 0; name < dir->num_names; name++) {
+        free(dir->names[name]);
+    }
+    free(dir->names);
+    free(dir->path);
+    memset(dir, 0, sizeof(*dir));
+}
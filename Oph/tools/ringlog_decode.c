@@ -0,0 +1,116 @@
+/* Converts the binary data files written by ring_logger back to the text the
+** motor loops used to write, one line per record.
+**
+** Usage: ringlog_decode [-c] file.bin [file.bin ...]
+**   Each file.bin is written to file.txt next to it, or to stdout with -c.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ring_logger.h"
+
+static void printRecord(FILE * out, uint32_t type, const void * record) {
+    if (type == RING_LOG_MOTOR_PV) {
+        const struct motor_pv_record * r = record;
+        fprintf(out, "%lf;%lf;%lf;%lf;%d;%d;%d\n", r->t, r->position,
+                r->velocity, r->current, r->scan, r->turnaround, r->scanning);
+    } else if (type == RING_LOG_LAZISUSAN) {
+        const struct lazisusan_record * r = record;
+        fprintf(out, "%lf;%lf\n", r->t, r->angle);
+    }
+}
+
+/* Function to decode one file.
+** Input: The binary file and the stream to write the text to.
+** Output: Records decoded, or -1 if it is not a file this tool knows.
+*/
+static long decodeFile(const char * path, FILE * out) {
+    struct ring_log_header header;
+    unsigned char record[256];
+    size_t expected = 0;
+    long n = 0;
+    FILE * in = fopen(path, "rb");
+
+    if (in == NULL) {
+        fprintf(stderr, "%s: could not open\n", path);
+        return -1;
+    }
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, RING_LOG_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: not a ring_logger file\n", path);
+        fclose(in);
+        return -1;
+    }
+    if (header.record_type == RING_LOG_MOTOR_PV) {
+        expected = sizeof(struct motor_pv_record);
+    } else if (header.record_type == RING_LOG_LAZISUSAN) {
+        expected = sizeof(struct lazisusan_record);
+    }
+    if (expected == 0 || header.record_size != expected) {
+        fprintf(stderr, "%s: unknown record type %u of %u bytes\n", path,
+                header.record_type, header.record_size);
+        fclose(in);
+        return -1;
+    }
+    while (fread(record, header.record_size, 1, in) == 1) {
+        printRecord(out, header.record_type, record);
+        n++;
+    }
+    fclose(in);
+    return n;
+}
+
+int main(int argc, char ** argv) {
+    int to_stdout = 0;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c")) != -1) {
+        if (opt == 'c') {
+            to_stdout = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [-c] file.bin [file.bin ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-c] file.bin [file.bin ...]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        const char * path = argv[i];
+        size_t len = strlen(path);
+        char txt[len + 5];
+        FILE * out = stdout;
+        long n;
+
+        if (!to_stdout) {
+            if (len > 4 && strcmp(path + len - 4, ".bin") == 0) {
+                len -= 4;
+            }
+            snprintf(txt, sizeof(txt), "%.*s.txt", (int) len, path);
+            out = fopen(txt, "w");
+            if (out == NULL) {
+                fprintf(stderr, "%s: could not open\n", txt);
+                failed = 1;
+                continue;
+            }
+        }
+        n = decodeFile(path, out);
+        if (!to_stdout) {
+            fclose(out);
+            if (n >= 0) {
+                fprintf(stderr, "%s: %ld records to %s\n", path, n, txt);
+            } else {
+                remove(txt);
+            }
+        }
+        if (n < 0) {
+            failed = 1;
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,214 @@
+/* Subscribes to a telemetry server and measures how late the updates are.
+**
+** Sends SUB:<period_ms>[:<deadband>]:<request> to the Oph (port 8002) or Sag
+** (port 8082) telemetry server, sends back the nonce the server answers it
+** with, renews it while it runs and sends UNSUB at the end. For every update it takes the latency from the server's snapshot
+** to its arrival here, which needs the server's clock, so run it on the same
+** machine, and the time since the update before. Prints the latency
+** percentiles and how far the updates strayed from the period.
+**
+** Usage: telemetry_sub [-h host] [-p port] [-r period_ms] [-d deadband]
+**                      [-n updates] [-v] request
+**   request is GROUP:name or BATCH:name,name,...; -v prints every update.
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "telemetry_registry.h"
+#include "telemetry_subscribe.h"
+
+#define RECV_TIMEOUT_MS 100
+
+static struct tel_value values[TEL_MAX_BATCH_CHANNELS];
+
+static double nowS(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static int compareDoubles(const void * a, const void * b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static void printValues(const struct tel_batch_header * header, int n) {
+    printf("%.6f", header->time);
+    for (int i = 0; i < n; i++) {
+        switch (values[i].type) {
+        case TEL_INT:
+            printf(" %d", values[i].i);
+            break;
+        case TEL_ULONG:
+            printf(" %lu", values[i].ul);
+            break;
+        case TEL_FLOAT:
+            printf(" %f", values[i].f);
+            break;
+        case TEL_DOUBLE:
+            printf(" %lf", values[i].d);
+            break;
+        case TEL_STRING:
+            printf(" \"%s\"", values[i].s);
+            break;
+        default:
+            printf(" -");
+            break;
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char * argv[]) {
+    const char * host = "127.0.0.1";
+    int port = 8002;
+    int period_ms = 100;
+    double deadband = -1;
+    int num_updates = 100;
+    int verbose = 0;
+    char request[TEL_SUB_REQUEST_LEN + 64];
+    uint8_t reply[TEL_BATCH_MAX + 1];
+    struct sockaddr_in server;
+    struct timeval tv = {0, RECV_TIMEOUT_MS*1000};
+    double * latency;
+    double * interval;
+    double last_arrival = 0;
+    double renewed;
+    double deadline;
+    int received = 0;
+    int sockfd;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "h:p:r:d:n:v")) != -1) {
+        switch (opt) {
+        case 'h':
+            host = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'r':
+            period_ms = atoi(optarg);
+            break;
+        case 'd':
+            deadband = atof(optarg);
+            break;
+        case 'n':
+            num_updates = atoi(optarg);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind != argc - 1 || period_ms < 1 || num_updates < 1) {
+        fprintf(stderr, "Usage: %s [-h host] [-p port] [-r period_ms] [-d deadband] "
+                "[-n updates] [-v] request\n", argv[0]);
+        return 1;
+    }
+    if (deadband < 0) {
+        snprintf(request, sizeof(request), "%s%d:%s", TEL_SUB_PREFIX, period_ms,
+                 argv[optind]);
+    } else {
+        snprintf(request, sizeof(request), "%s%d:%g:%s", TEL_SUB_PREFIX, period_ms,
+                 deadband, argv[optind]);
+    }
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &server.sin_addr) != 1) {
+        fprintf(stderr, "%s: not an IPv4 address\n", host);
+        return 1;
+    }
+    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0) {
+        perror("socket");
+        return 1;
+    }
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    latency = calloc(num_updates, sizeof(*latency));
+    interval = calloc(num_updates, sizeof(*interval));
+
+    sendto(sockfd, request, strlen(request), 0, (struct sockaddr *) &server,
+           sizeof(server));
+    renewed = nowS(CLOCK_MONOTONIC);
+    // long enough for the updates asked for, plus heartbeats if on change
+    deadline = renewed + 5 + num_updates*(period_ms*1e-3) +
+               (deadband < 0 ? 0 : num_updates*TEL_SUB_HEARTBEAT_MS*1e-3);
+
+    while (received < num_updates && nowS(CLOCK_MONOTONIC) < deadline) {
+        struct tel_batch_header header;
+        int len = recv(sockfd, reply, TEL_BATCH_MAX, 0);
+        double arrival = nowS(CLOCK_MONOTONIC);
+        int n;
+
+        if (arrival - renewed > TEL_SUB_LEASE_S/2) {
+            sendto(sockfd, request, strlen(request), 0,
+                   (struct sockaddr *) &server, sizeof(server));
+            renewed = arrival;
+        }
+        if (len <= 0) {
+            continue;
+        }
+        // the server only pushes once it has its nonce back
+        if (len > (int) strlen(TEL_SUB_NONCE) &&
+            memcmp(reply, TEL_SUB_NONCE, strlen(TEL_SUB_NONCE)) == 0) {
+            sendto(sockfd, reply, len, 0, (struct sockaddr *) &server,
+                   sizeof(server));
+            continue;
+        }
+        n = tel_unpack(reply, len, &header, values, TEL_MAX_BATCH_CHANNELS);
+        if (n < 0) {
+            reply[len] = '\0';
+            fprintf(stderr, "server replied: %s\n", (char *) reply);
+            close(sockfd);
+            return 1;
+        }
+        latency[received] = (nowS(CLOCK_REALTIME) - header.time)*1e3;
+        interval[received] = last_arrival > 0 ? (arrival - last_arrival)*1e3 : 0;
+        last_arrival = arrival;
+        if (verbose) {
+            printValues(&header, n);
+        }
+        received++;
+    }
+
+    sendto(sockfd, TEL_UNSUB, strlen(TEL_UNSUB), 0, (struct sockaddr *) &server,
+           sizeof(server));
+    close(sockfd);
+
+    if (received == 0) {
+        printf("no updates from %s:%d\n", host, port);
+        return 1;
+    }
+    printf("%d updates of %s\n", received, request);
+    qsort(latency, received, sizeof(*latency), compareDoubles);
+    printf("latency   p50 %.3f ms  p99 %.3f ms  max %.3f ms\n",
+           latency[received/2], latency[(int) (received*0.99)],
+           latency[received - 1]);
+    if (received > 1) {
+        double sum = 0;
+
+        // the first has no interval
+        qsort(interval + 1, received - 1, sizeof(*interval), compareDoubles);
+        for (int i = 1; i < received; i++) {
+            sum += interval[i];
+        }
+        printf("interval  mean %.3f ms  min %.3f ms  max %.3f ms (asked for %d ms)\n",
+               sum/(received - 1), interval[1], interval[received - 1], period_ms);
+    }
+    return 0;
+}
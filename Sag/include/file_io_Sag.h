@@ -5,6 +5,7 @@
 #include "gps.h"
 
 #define MAX_UDP_CLIENTS 10  // Maximum number of UDP clients supported
+#define MAX_TELEMETRY_GROUPS 32  // Maximum number of telemetry channel groups
 
 void write_to_log(FILE* logfile, const char* file, const char* function, const char* message);
 char* create_timestamped_log_directory(void);
@@ -70,6 +71,10 @@ typedef struct conf_params {
         int udp_buffer_size;
         char udp_client_ips[MAX_UDP_CLIENTS][16];  // Array of authorized client IPs
         int udp_client_count;                      // Number of authorized clients
+        int sub_min_period_ms;                       // Shortest subscription period
+        char group_names[MAX_TELEMETRY_GROUPS][32];  // Channel groups for GROUP: requests
+        char *group_channels[MAX_TELEMETRY_GROUPS];  // Comma separated channel names
+        int group_count;                             // Number of channel groups
     } telemetry_server;
     struct {
         int enabled;
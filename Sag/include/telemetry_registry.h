@@ -0,0 +1,121 @@
+#ifndef TELEMETRY_REGISTRY_H
+#define TELEMETRY_REGISTRY_H
+
+#include <stdint.h>
+
+/* Telemetry channels by name. Each subsystem registers a static table of
+** channels at startup, and the server finds a request's channel in a hash
+** table built as they are registered, so a request costs the same however
+** many channels there are.
+**
+** Channels that read the same locked state share a source. A source copies
+** the state once per snapshot (tel_snapshot), and every channel read after
+** that uses the copy instead of taking the lock again.
+**
+** A client can also ask for several channels in one datagram, by name
+** ("BATCH:name,name,...") or by a group set up in the config ("GROUP:name"),
+** and get every value back in one binary reply, all read in the same
+** snapshot. The reply is little endian: a struct tel_batch_header (16 bytes,
+** no padding), then for each channel asked for, in order, a uint8 type and
+** its value:
+**   TEL_INT     int32
+**   TEL_ULONG   uint64
+**   TEL_FLOAT   float32
+**   TEL_DOUBLE  float64
+**   TEL_STRING  uint16 length, then the bytes without a terminator
+**   TEL_NONE    nothing, the name is not a channel
+** If the values do not fit in TEL_BATCH_MAX bytes the reply stops at the last
+** one that does, and num_values is less than num_requested.
+*/
+
+#define TEL_STRING_LEN 512
+
+#define TEL_BATCH_PREFIX "BATCH:"
+#define TEL_GROUP_PREFIX "GROUP:"
+#define TEL_BATCH_MAGIC "TLB1"
+#define TEL_BATCH_MAX 8192          // bytes in a reply
+#define TEL_MAX_BATCH_CHANNELS 512  // channels in a request or group
+#define TEL_MAX_GROUPS 32
+#define TEL_GROUP_NAME_LEN 32
+
+enum tel_type {
+    TEL_INT = 0,
+    TEL_ULONG,
+    TEL_FLOAT,
+    TEL_DOUBLE,
+    TEL_STRING,
+    TEL_NONE = 255              // in batch replies only
+};
+
+/* A channel's value, typed by its getter. A channel can give a number when
+** its data is valid and a string such as "N/A" when it is not. */
+struct tel_value {
+    int type;                   // enum tel_type
+    union {
+        int i;
+        unsigned long ul;
+        float f;
+        double d;
+        char s[TEL_STRING_LEN];
+    };
+};
+
+/* State several channels read, copied once per snapshot */
+struct tel_source {
+    void (*refresh)(void);      // copies the state, under its lock if it has one
+    unsigned long generation;   // snapshot it was last copied for
+};
+
+struct tel_channel {
+    const char * name;
+    void (*get)(int index, struct tel_value * out);
+    int index;                  // passed to get, for several of the same thing
+    struct tel_source * source; // refreshed before get, NULL if none
+};
+
+struct tel_batch_header {
+    char magic[4];              // TEL_BATCH_MAGIC
+    uint16_t num_values;
+    uint16_t num_requested;
+    double time;                // [s] since the epoch, when the snapshot was taken
+};
+
+int tel_register(const struct tel_channel * channels, int num_channels);
+const struct tel_channel * tel_lookup(const char * name);
+void tel_snapshot(void);
+void tel_read(const struct tel_channel * channel, struct tel_value * out);
+void tel_get(const struct tel_channel * channel, struct tel_value * out);
+int tel_num_channels(void);
+
+int tel_add_group(const char * name, const char * channels);
+int tel_is_batch(const char * request);
+int tel_batch_check(const char * request);
+int tel_batch(const char * request, uint8_t * reply, int size);
+int tel_unpack(const uint8_t * reply, int len, struct tel_batch_header * header,
+               struct tel_value * values, int max_values);
+int tel_changed(const uint8_t * old, int old_len, const uint8_t * new,
+                int new_len, double deadband);
+
+static inline void tel_set_int(struct tel_value * out, int value) {
+    out->type = TEL_INT;
+    out->i = value;
+}
+
+static inline void tel_set_ulong(struct tel_value * out, unsigned long value) {
+    out->type = TEL_ULONG;
+    out->ul = value;
+}
+
+static inline void tel_set_float(struct tel_value * out, float value) {
+    out->type = TEL_FLOAT;
+    out->f = value;
+}
+
+static inline void tel_set_double(struct tel_value * out, double value) {
+    out->type = TEL_DOUBLE;
+    out->d = value;
+}
+
+void tel_set_string(struct tel_value * out, const char * value);
+
+#endif
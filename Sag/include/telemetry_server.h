@@ -8,6 +8,7 @@
 
 #define TELEMETRY_BUFFER_SIZE 1024
 #define MAX_UDP_CLIENTS 10
+#define MAX_TELEMETRY_GROUPS 32
 
 // Telemetry server configuration structure
 typedef struct {
@@ -18,6 +19,10 @@ typedef struct {
     int udp_buffer_size;
     char udp_client_ips[MAX_UDP_CLIENTS][16];  // Array of authorized client IPs
     int udp_client_count;                      // Number of authorized clients
+    int sub_min_period_ms;                       // Shortest subscription period
+    char group_names[MAX_TELEMETRY_GROUPS][32];  // Channel groups for GROUP: requests
+    char *group_channels[MAX_TELEMETRY_GROUPS];  // Comma separated channel names
+    int group_count;                             // Number of channel groups
 } telemetry_server_config_t;
 
 // Global variables (extern declarations)
@@ -0,0 +1,53 @@
+#ifndef TELEMETRY_SUBSCRIBE_H
+#define TELEMETRY_SUBSCRIBE_H
+
+#include <stdio.h>
+#include <netinet/in.h>
+
+/* Telemetry subscriptions. Instead of polling, a client sends
+**   SUB:<period_ms>:<request>              sent every period_ms
+**   SUB:<period_ms>:<deadband>:<request>   checked every period_ms, sent when
+**                                          a number moved by more than
+**                                          deadband or a string changed
+** where request is a BATCH: or GROUP: request (telemetry_registry.h). The
+** server answers a new or changed subscription with NONCE:<16 hex digits>,
+** and only once the client has sent that back does a timer thread push it
+** the batch reply at that cadence, the first one straight away: the SUB
+** datagram's source address could be forged, and nothing is pushed to an
+** address that has not shown it asked for it. On change subscriptions are
+** also sent every TEL_SUB_HEARTBEAT_MS so the client can tell they are alive.
+** A subscription lasts TEL_SUB_LEASE_S unless the client sends the same SUB
+** again, which needs no new nonce, and UNSUB ends it.
+**
+** Each client address has one subscription (a new SUB replaces it once
+** confirmed), an IP has at most TEL_MAX_SUBS_PER_IP, none is sent more often
+** than the server's min_period_ms, and replies that would go over
+** TEL_SUB_MAX_BPS for the subscription or TEL_SUB_TOTAL_BPS for all of them
+** are skipped until there is room again.
+*/
+
+#define TEL_SUB_PREFIX "SUB:"
+#define TEL_SUB_NONCE "NONCE:"
+#define TEL_UNSUB "UNSUB"
+#define TEL_MAX_SUBS 16
+#define TEL_MAX_SUBS_PER_IP 4
+#define TEL_SUB_LEASE_S 60
+#define TEL_SUB_CONFIRM_MS 2000         // to send the nonce back in
+#define TEL_SUB_HEARTBEAT_MS 5000
+#define TEL_SUB_REQUEST_LEN 1024
+#define TEL_SUB_MAX_BPS 65536           // bytes/s to one subscription
+#define TEL_SUB_TOTAL_BPS 262144        // bytes/s to all of them
+
+/* tel_subscribe results */
+#define TEL_SUB_OK 0
+#define TEL_SUB_CHALLENGED 1    // sent a nonce, nothing is pushed until echoed
+#define TEL_SUB_BAD_REQUEST -1
+#define TEL_SUB_REFUSED -2      // too many subscriptions
+
+int tel_sub_start(int sockfd, int min_period_ms, FILE * log);
+int tel_is_subscription(const char * request);
+int tel_subscribe(const struct sockaddr_in * client, const char * request);
+int tel_num_subscriptions(void);
+void tel_sub_stop(void);
+
+#endif
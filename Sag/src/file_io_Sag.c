@@ -200,6 +200,8 @@ void read_in_config(const char* filepath) {
     config_lookup_int(&cfg, "telemetry_server.port", &config.telemetry_server.port);
     config_lookup_int(&cfg, "telemetry_server.timeout", &config.telemetry_server.timeout);
     config_lookup_int(&cfg, "telemetry_server.udp_buffer_size", &config.telemetry_server.udp_buffer_size);
+    config.telemetry_server.sub_min_period_ms = 100;
+    config_lookup_int(&cfg, "telemetry_server.sub_min_period_ms", &config.telemetry_server.sub_min_period_ms);
     
     if (config_lookup_string(&cfg, "telemetry_server.ip", &tmpstr)) {
         strncpy(config.telemetry_server.ip, tmpstr, sizeof(config.telemetry_server.ip) - 1);
@@ -226,6 +228,53 @@ void read_in_config(const char* filepath) {
         config.telemetry_server.udp_client_count = 0;
     }
 
+    // Read telemetry channel groups, name = [channels]
+    config.telemetry_server.group_count = 0;
+    config_setting_t *tel_groups = config_lookup(&cfg, "telemetry_server.groups");
+    if (tel_groups != NULL && config_setting_is_group(tel_groups)) {
+        int count = config_setting_length(tel_groups);
+        if (count > MAX_TELEMETRY_GROUPS) {
+            count = MAX_TELEMETRY_GROUPS;  // Limit to max supported groups
+        }
+
+        for (int i = 0; i < count; i++) {
+            config_setting_t *group = config_setting_get_elem(tel_groups, i);
+            if (!config_setting_is_array(group)) {
+                fprintf(stderr, "telemetry_server.groups.%s is not a list of channels\n",
+                        config_setting_name(group));
+                continue;
+            }
+
+            // Join the channel names with commas, as in a BATCH: request
+            int n = config_setting_length(group);
+            size_t len = 1;
+            for (int j = 0; j < n; j++) {
+                const char *name = config_setting_get_string_elem(group, j);
+                if (name != NULL) {
+                    len += strlen(name) + 1;
+                }
+            }
+            char *channels = calloc(len, 1);
+            if (channels == NULL) {
+                continue;
+            }
+            for (int j = 0; j < n; j++) {
+                const char *name = config_setting_get_string_elem(group, j);
+                if (name != NULL) {
+                    if (channels[0] != '\0') {
+                        strcat(channels, ",");
+                    }
+                    strcat(channels, name);
+                }
+            }
+
+            int g = config.telemetry_server.group_count++;
+            strncpy(config.telemetry_server.group_names[g], config_setting_name(group), 31);
+            config.telemetry_server.group_names[g][31] = '\0';
+            config.telemetry_server.group_channels[g] = channels;
+        }
+    }
+
     // Read pbob_client section
     config_lookup_int(&cfg, "pbob_client.enabled", &config.pbob_client.enabled);
     config_lookup_int(&cfg, "pbob_client.port", &config.pbob_client.port);
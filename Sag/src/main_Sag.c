@@ -76,6 +76,8 @@ void print_config() {
     printf("  Timeout: %d us\n", config.telemetry_server.timeout);
     printf("  UDP Buffer Size: %d\n", config.telemetry_server.udp_buffer_size);
     printf("  Authorized Clients: %d\n", config.telemetry_server.udp_client_count);
+    printf("  Min Subscription Period: %d ms\n", config.telemetry_server.sub_min_period_ms);
+    printf("  Channel Groups: %d\n", config.telemetry_server.group_count);
     printf("\nPBoB Client settings:\n");
     printf("  Enabled: %s\n", config.pbob_client.enabled ? "Yes" : "No");
     printf("  Server IP: %s\n", config.pbob_client.ip);
@@ -377,6 +379,13 @@ int main(int argc, char* argv[]) {
                     sizeof(tel_config.udp_client_ips[i]) - 1);
             tel_config.udp_client_ips[i][sizeof(tel_config.udp_client_ips[i]) - 1] = '\0';
         }
+        tel_config.sub_min_period_ms = config.telemetry_server.sub_min_period_ms;
+        tel_config.group_count = config.telemetry_server.group_count;
+        for (int i = 0; i < config.telemetry_server.group_count; i++) {
+            memcpy(tel_config.group_names[i], config.telemetry_server.group_names[i],
+                   sizeof(tel_config.group_names[i]));
+            tel_config.group_channels[i] = config.telemetry_server.group_channels[i];
+        }
 
         int tel_init_result = telemetry_server_init(&tel_config);
         if (tel_init_result == 0) {
@@ -0,0 +1,639 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "telemetry_registry.h"
+
+/* Open addressing table of the registered channels, kept at most half full
+** so a lookup is one or two probes. The hash is stored with each channel so
+** a probe only compares names when the hashes match.
+*/
+struct tel_slot {
+    uint32_t hash;
+    const struct tel_channel * channel;
+};
+
+/* Sources and their copies are shared by every request. The server thread
+** and the subscription thread read under this lock (tel_get, tel_batch);
+** tel_snapshot and tel_read are for callers that already hold it or are
+** alone. */
+static pthread_mutex_t read_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct {
+    struct tel_slot * slots;
+    uint32_t capacity;          // a power of two, 0 until the first channel
+    int num_channels;
+    unsigned long generation;   // current snapshot, sources start at 0
+} registry = {
+    .generation = 1,
+};
+
+/* Groups of channels from the config, asked for with GROUP:name */
+static struct tel_group {
+    char name[TEL_GROUP_NAME_LEN];
+    int num_channels;
+    const struct tel_channel ** channels;   // NULL for names that are not channels
+} groups[TEL_MAX_GROUPS];
+static int num_groups;
+
+/* FNV-1a */
+static uint32_t hashName(const char * name) {
+    uint32_t h = 2166136261u;
+
+    while (*name) {
+        h ^= (uint8_t) *name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void insertSlot(struct tel_slot * slots, uint32_t capacity,
+                       uint32_t hash, const struct tel_channel * channel) {
+    uint32_t i = hash & (capacity - 1);
+
+    while (slots[i].channel != NULL) {
+        i = (i + 1) & (capacity - 1);
+    }
+    slots[i].hash = hash;
+    slots[i].channel = channel;
+}
+
+/* Function to make room for more channels.
+** Input: The number of channels the table has to hold.
+** Output: 0 on success, -1 if out of memory.
+*/
+static int growTable(int num_channels) {
+    uint32_t capacity = registry.capacity ? registry.capacity : 64;
+    struct tel_slot * slots;
+
+    while ((uint32_t) num_channels * 2 > capacity) {
+        capacity <<= 1;
+    }
+    if (capacity == registry.capacity) {
+        return 0;
+    }
+    slots = calloc(capacity, sizeof(*slots));
+    if (slots == NULL) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < registry.capacity; i++) {
+        if (registry.slots[i].channel != NULL) {
+            insertSlot(slots, capacity, registry.slots[i].hash,
+                       registry.slots[i].channel);
+        }
+    }
+    free(registry.slots);
+    registry.slots = slots;
+    registry.capacity = capacity;
+    return 0;
+}
+
+/* Function to add a table of channels, at startup before the server runs.
+** The table is used in place, so it has to stay around (a static array).
+** Input: The channels and how many there are.
+** Output: The number added. Channels whose name is already taken are left
+** out.
+*/
+int tel_register(const struct tel_channel * channels, int num_channels) {
+    int added = 0;
+
+    if (growTable(registry.num_channels + num_channels) < 0) {
+        return 0;
+    }
+    for (int i = 0; i < num_channels; i++) {
+        if (tel_lookup(channels[i].name) != NULL) {
+            continue;
+        }
+        insertSlot(registry.slots, registry.capacity,
+                   hashName(channels[i].name), &channels[i]);
+        registry.num_channels++;
+        added++;
+    }
+    return added;
+}
+
+/* Function to find a channel.
+** Input: Its name.
+** Output: The channel, or NULL if there is none by that name.
+*/
+const struct tel_channel * tel_lookup(const char * name) {
+    uint32_t hash;
+    uint32_t i;
+
+    if (registry.capacity == 0) {
+        return NULL;
+    }
+    hash = hashName(name);
+    i = hash & (registry.capacity - 1);
+    while (registry.slots[i].channel != NULL) {
+        if (registry.slots[i].hash == hash &&
+            strcmp(registry.slots[i].channel->name, name) == 0) {
+            return registry.slots[i].channel;
+        }
+        i = (i + 1) & (registry.capacity - 1);
+    }
+    return NULL;
+}
+
+/* Function to start a new snapshot: each source is copied again the first
+** time one of its channels is read after this.
+*/
+void tel_snapshot(void) {
+    registry.generation++;
+}
+
+/* Function to read a channel in the current snapshot.
+** Input: The channel.
+** Output: Its value, in out.
+*/
+void tel_read(const struct tel_channel * channel, struct tel_value * out) {
+    struct tel_source * source = channel->source;
+
+    if (source != NULL && source->generation != registry.generation) {
+        source->refresh();
+        source->generation = registry.generation;
+    }
+    channel->get(channel->index, out);
+}
+
+/* Function to read one channel in a snapshot of its own, safe to call from
+** any thread.
+** Input: The channel.
+** Output: Its value, in out.
+*/
+void tel_get(const struct tel_channel * channel, struct tel_value * out) {
+    pthread_mutex_lock(&read_lock);
+    tel_snapshot();
+    tel_read(channel, out);
+    pthread_mutex_unlock(&read_lock);
+}
+
+int tel_num_channels(void) {
+    return registry.num_channels;
+}
+
+void tel_set_string(struct tel_value * out, const char * value) {
+    out->type = TEL_STRING;
+    snprintf(out->s, sizeof(out->s), "%s", value);
+}
+
+/* Little endian packing, so the ground does not depend on the flight
+** computer's byte order */
+static void putU16(uint8_t * p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void putU32(uint8_t * p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = v >> (8*i);
+    }
+}
+
+static void putU64(uint8_t * p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = v >> (8*i);
+    }
+}
+
+static uint16_t getU16(const uint8_t * p) {
+    return p[0] | (uint16_t) p[1] << 8;
+}
+
+static uint32_t getU32(const uint8_t * p) {
+    uint32_t v = 0;
+
+    for (int i = 0; i < 4; i++) {
+        v |= (uint32_t) p[i] << (8*i);
+    }
+    return v;
+}
+
+static uint64_t getU64(const uint8_t * p) {
+    uint64_t v = 0;
+
+    for (int i = 0; i < 8; i++) {
+        v |= (uint64_t) p[i] << (8*i);
+    }
+    return v;
+}
+
+#define BATCH_HEADER_LEN 16
+
+/* Function to find the channels of a comma separated list of names.
+** Input: The list, room for TEL_MAX_BATCH_CHANNELS channels and a count of
+** unknown names to add to (or NULL).
+** Output: The number of names, or -1 if there are too many. Names that are
+** not channels give NULL, so the other values keep their places.
+*/
+static int parseList(const char * list, const struct tel_channel ** channels,
+                     int * num_unknown) {
+    char name[TEL_STRING_LEN];
+    const char * p = list;
+    int n = 0;
+
+    while (*p) {
+        const char * end;
+        size_t len;
+
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        end = p + strcspn(p, ",");
+        len = end - p;
+        // trailing spaces, and the newline some clients send
+        while (len > 0 && isspace((unsigned char) p[len - 1])) {
+            len--;
+        }
+        if (len > 0) {
+            if (n == TEL_MAX_BATCH_CHANNELS) {
+                return -1;
+            }
+            if (len >= sizeof(name)) {
+                len = sizeof(name) - 1;
+            }
+            memcpy(name, p, len);
+            name[len] = '\0';
+            channels[n] = tel_lookup(name);
+            if (channels[n] == NULL && num_unknown != NULL) {
+                (*num_unknown)++;
+            }
+            n++;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return n;
+}
+
+/* Function to add a named group of channels, at startup before the server
+** runs and after the channels are registered.
+** Input: The group's name and its channels, comma separated.
+** Output: The number of names that are not channels (they read as TEL_NONE),
+** or -1 if the group could not be added.
+*/
+int tel_add_group(const char * name, const char * channels) {
+    const struct tel_channel * list[TEL_MAX_BATCH_CHANNELS];
+    struct tel_group * group;
+    int num_unknown = 0;
+    int n;
+
+    if (num_groups == TEL_MAX_GROUPS || strlen(name) >= TEL_GROUP_NAME_LEN) {
+        return -1;
+    }
+    for (int i = 0; i < num_groups; i++) {
+        if (strcmp(groups[i].name, name) == 0) {
+            return -1;
+        }
+    }
+    n = parseList(channels, list, &num_unknown);
+    if (n <= 0) {
+        return -1;
+    }
+    group = &groups[num_groups];
+    group->channels = malloc(n * sizeof(*group->channels));
+    if (group->channels == NULL) {
+        return -1;
+    }
+    memcpy(group->channels, list, n * sizeof(*group->channels));
+    group->num_channels = n;
+    strcpy(group->name, name);
+    num_groups++;
+    return num_unknown;
+}
+
+static struct tel_group * findGroup(const char * name) {
+    size_t len = strlen(name);
+
+    while (len > 0 && isspace((unsigned char) name[len - 1])) {
+        len--;
+    }
+    for (int i = 0; i < num_groups; i++) {
+        if (strlen(groups[i].name) == len &&
+            strncmp(groups[i].name, name, len) == 0) {
+            return &groups[i];
+        }
+    }
+    return NULL;
+}
+
+int tel_is_batch(const char * request) {
+    return strncmp(request, TEL_BATCH_PREFIX, strlen(TEL_BATCH_PREFIX)) == 0 ||
+           strncmp(request, TEL_GROUP_PREFIX, strlen(TEL_GROUP_PREFIX)) == 0;
+}
+
+/* Function to pack one value.
+** Input: The value and the room left in the reply.
+** Output: The bytes it took, or -1 if it does not fit.
+*/
+static int packValue(const struct tel_value * value, uint8_t * p, int room) {
+    uint32_t u32;
+    uint64_t u64;
+    int len;
+
+    switch (value->type) {
+    case TEL_INT:
+    case TEL_FLOAT:
+        len = 5;
+        break;
+    case TEL_ULONG:
+    case TEL_DOUBLE:
+        len = 9;
+        break;
+    case TEL_STRING:
+        len = 3 + strlen(value->s);
+        break;
+    default:
+        len = 1;
+        break;
+    }
+    if (len > room) {
+        return -1;
+    }
+
+    p[0] = value->type;
+    switch (value->type) {
+    case TEL_INT:
+        putU32(p + 1, (uint32_t) value->i);
+        break;
+    case TEL_FLOAT:
+        memcpy(&u32, &value->f, sizeof(u32));
+        putU32(p + 1, u32);
+        break;
+    case TEL_ULONG:
+        putU64(p + 1, value->ul);
+        break;
+    case TEL_DOUBLE:
+        memcpy(&u64, &value->d, sizeof(u64));
+        putU64(p + 1, u64);
+        break;
+    case TEL_STRING:
+        putU16(p + 1, len - 3);
+        memcpy(p + 3, value->s, len - 3);
+        break;
+    default:
+        p[0] = TEL_NONE;
+        break;
+    }
+    return len;
+}
+
+/* Function to find the channels a batch request asks for.
+** Input: The request, room for TEL_MAX_BATCH_CHANNELS channels, and where to
+** say which list to use.
+** Output: The number of channels, or -1 if the request is not a batch, names
+** too many channels or an unknown group.
+*/
+static int findChannels(const char * request, const struct tel_channel ** list,
+                        const struct tel_channel *** channels) {
+    int n;
+
+    if (strncmp(request, TEL_GROUP_PREFIX, strlen(TEL_GROUP_PREFIX)) == 0) {
+        struct tel_group * group = findGroup(request + strlen(TEL_GROUP_PREFIX));
+
+        if (group == NULL) {
+            return -1;
+        }
+        *channels = group->channels;
+        return group->num_channels;
+    }
+    if (strncmp(request, TEL_BATCH_PREFIX, strlen(TEL_BATCH_PREFIX)) == 0) {
+        n = parseList(request + strlen(TEL_BATCH_PREFIX), list, NULL);
+        *channels = list;
+        return n;
+    }
+    return -1;
+}
+
+/* Function to check a batch request without reading anything.
+** Input: The request.
+** Output: The number of channels it asks for, or -1 as for tel_batch.
+*/
+int tel_batch_check(const char * request) {
+    const struct tel_channel * list[TEL_MAX_BATCH_CHANNELS];
+    const struct tel_channel ** channels;
+
+    return findChannels(request, list, &channels);
+}
+
+/* Function to answer a batch request: every channel asked for, read in one
+** snapshot and packed as described in telemetry_registry.h.
+** Input: The request (BATCH:name,... or GROUP:name) and room for the reply.
+** Output: The length of the reply, or -1 if the request is not a batch, names
+** too many channels or an unknown group.
+*/
+int tel_batch(const char * request, uint8_t * reply, int size) {
+    const struct tel_channel * list[TEL_MAX_BATCH_CHANNELS];
+    const struct tel_channel ** channels;
+    struct tel_value value;
+    struct timespec now;
+    int num_channels = findChannels(request, list, &channels);
+    int num_values = 0;
+    int len = BATCH_HEADER_LEN;
+    uint64_t u64;
+    double t;
+
+    if (num_channels < 0) {
+        return -1;
+    }
+    if (size > TEL_BATCH_MAX) {
+        size = TEL_BATCH_MAX;
+    }
+    if (size < BATCH_HEADER_LEN) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&read_lock);
+    tel_snapshot();
+    clock_gettime(CLOCK_REALTIME, &now);
+    for (int i = 0; i < num_channels; i++) {
+        int n;
+
+        if (channels[i] == NULL) {
+            value.type = TEL_NONE;
+        } else {
+            tel_read(channels[i], &value);
+        }
+        n = packValue(&value, reply + len, size - len);
+        if (n < 0) {
+            break;
+        }
+        len += n;
+        num_values++;
+    }
+    pthread_mutex_unlock(&read_lock);
+
+    memcpy(reply, TEL_BATCH_MAGIC, 4);
+    putU16(reply + 4, num_values);
+    putU16(reply + 6, num_channels);
+    t = now.tv_sec + now.tv_nsec*1e-9;
+    memcpy(&u64, &t, sizeof(u64));
+    putU64(reply + 8, u64);
+    return len;
+}
+
+/* Function to read the next value of a batch reply.
+** Input: The reply and the position of the value.
+** Output: The value, and the position moved past it. Returns -1 if the reply
+** is cut short or the type is unknown.
+*/
+static int unpackValue(const uint8_t * reply, int len, int * pos,
+                       struct tel_value * value) {
+    int p = *pos;
+    uint32_t u32;
+    uint64_t u64;
+    int n;
+
+    if (p >= len) {
+        return -1;
+    }
+    value->type = reply[p++];
+    switch (value->type) {
+    case TEL_INT:
+    case TEL_FLOAT:
+        if (p + 4 > len) {
+            return -1;
+        }
+        u32 = getU32(reply + p);
+        if (value->type == TEL_INT) {
+            value->i = (int32_t) u32;
+        } else {
+            memcpy(&value->f, &u32, sizeof(u32));
+        }
+        p += 4;
+        break;
+    case TEL_ULONG:
+    case TEL_DOUBLE:
+        if (p + 8 > len) {
+            return -1;
+        }
+        u64 = getU64(reply + p);
+        if (value->type == TEL_ULONG) {
+            value->ul = u64;
+        } else {
+            memcpy(&value->d, &u64, sizeof(u64));
+        }
+        p += 8;
+        break;
+    case TEL_STRING:
+        if (p + 2 > len) {
+            return -1;
+        }
+        n = getU16(reply + p);
+        p += 2;
+        if (p + n > len) {
+            return -1;
+        }
+        if (n >= TEL_STRING_LEN) {
+            memcpy(value->s, reply + p, TEL_STRING_LEN - 1);
+            value->s[TEL_STRING_LEN - 1] = '\0';
+        } else {
+            memcpy(value->s, reply + p, n);
+            value->s[n] = '\0';
+        }
+        p += n;
+        break;
+    case TEL_NONE:
+        break;
+    default:
+        return -1;
+    }
+    *pos = p;
+    return 0;
+}
+
+static int readHeader(const uint8_t * reply, int len,
+                      struct tel_batch_header * header) {
+    uint64_t u64;
+
+    if (len < BATCH_HEADER_LEN || memcmp(reply, TEL_BATCH_MAGIC, 4) != 0) {
+        return -1;
+    }
+    memcpy(header->magic, reply, 4);
+    header->num_values = getU16(reply + 4);
+    header->num_requested = getU16(reply + 6);
+    u64 = getU64(reply + 8);
+    memcpy(&header->time, &u64, sizeof(u64));
+    return 0;
+}
+
+/* Function to read a batch reply, for clients.
+** Input: The reply, and room for max_values values.
+** Output: The header, and the values in the order they were asked for.
+** Returns the number of values, or -1 if the reply is not a batch reply or is
+** cut short.
+*/
+int tel_unpack(const uint8_t * reply, int len, struct tel_batch_header * header,
+               struct tel_value * values, int max_values) {
+    int pos = BATCH_HEADER_LEN;
+    int num_values;
+
+    if (readHeader(reply, len, header) < 0) {
+        return -1;
+    }
+    num_values = header->num_values < max_values ? header->num_values : max_values;
+    for (int i = 0; i < num_values; i++) {
+        if (unpackValue(reply, len, &pos, &values[i]) < 0) {
+            return -1;
+        }
+    }
+    return num_values;
+}
+
+static double numberOf(const struct tel_value * value) {
+    switch (value->type) {
+    case TEL_INT:
+        return value->i;
+    case TEL_ULONG:
+        return value->ul;
+    case TEL_FLOAT:
+        return value->f;
+    default:
+        return value->d;
+    }
+}
+
+/* Function to compare two batch replies to the same request.
+** Input: The replies, and how far a number has to move to count.
+** Output: 1 if a number moved by more than deadband, a string or a type
+** changed or the replies hold different channels, 0 if not.
+*/
+int tel_changed(const uint8_t * old, int old_len, const uint8_t * new,
+                int new_len, double deadband) {
+    struct tel_batch_header old_header, new_header;
+    struct tel_value a, b;
+    int old_pos = BATCH_HEADER_LEN;
+    int new_pos = BATCH_HEADER_LEN;
+
+    if (readHeader(old, old_len, &old_header) < 0 ||
+        readHeader(new, new_len, &new_header) < 0 ||
+        old_header.num_values != new_header.num_values) {
+        return 1;
+    }
+    for (int i = 0; i < new_header.num_values; i++) {
+        double diff;
+
+        if (unpackValue(old, old_len, &old_pos, &a) < 0 ||
+            unpackValue(new, new_len, &new_pos, &b) < 0 ||
+            a.type != b.type) {
+            return 1;
+        }
+        if (b.type == TEL_NONE) {
+            continue;
+        }
+        if (b.type == TEL_STRING) {
+            if (strcmp(a.s, b.s) != 0) {
+                return 1;
+            }
+            continue;
+        }
+        diff = numberOf(&b) - numberOf(&a);
+        if (diff > deadband || -diff > deadband) {
+            return 1;
+        }
+    }
+    return 0;
+}
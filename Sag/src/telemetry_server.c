@@ -21,6 +21,8 @@
 #include "system_monitor.h"
 #include "ticc_client.h"
 #include "aquila_status.h"
+#include "telemetry_registry.h"
+#include "telemetry_subscribe.h"
 
 // Global variables
 struct sockaddr_in tel_client_addr;
@@ -133,866 +135,695 @@ static bool is_authorized_client(const char *client_ip) {
     return true;  // Accept all clients
 }
 
-// Process telemetry requests and send appropriate responses
-void telemetry_send_metric(int sockfd, char* id) {
-    // Get client IP for logging
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &tel_client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-    
-    // Note: Normal requests are no longer logged to reduce verbosity
-    // Only errors and unknown requests will be logged
+// Channel getters. Most channels give a value when their data is valid and
+// "N/A" when it is not; expr may use index for a channel of several
+#define VALID_CHANNEL(fn, cond, setter, expr) \
+    static void fn(int index, struct tel_value *out) { \
+        (void)index; \
+        if (cond) { \
+            setter(out, (expr)); \
+        } else { \
+            tel_set_string(out, "N/A"); \
+        } \
+    }
 
-    // GPS telemetry channels
-    if (strcmp(id, "gps_lat") == 0) {
-        gps_data_t gps_data;
-        if (gps_get_data(&gps_data) && gps_data.valid_position) {
-            telemetry_sendDouble(sockfd, gps_data.latitude);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "gps_lon") == 0) {
-        gps_data_t gps_data;
-        if (gps_get_data(&gps_data) && gps_data.valid_position) {
-            telemetry_sendDouble(sockfd, gps_data.longitude);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "gps_alt") == 0) {
-        gps_data_t gps_data;
-        if (gps_get_data(&gps_data) && gps_data.valid_position) {
-            telemetry_sendDouble(sockfd, gps_data.altitude);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "gps_head") == 0) {
-        gps_data_t gps_data;
-        if (gps_get_data(&gps_data) && gps_data.valid_heading) {
-            telemetry_sendDouble(sockfd, gps_data.heading);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "gps_time") == 0) {
-        gps_data_t gps_data;
-        if (gps_get_data(&gps_data)) {
-            char time_str[32];
-            snprintf(time_str, sizeof(time_str), "%04d-%02d-%02d %02d:%02d:%02d",
-                    gps_data.year, gps_data.month, gps_data.day,
-                    gps_data.hour, gps_data.minute, gps_data.second);
-            telemetry_sendString(sockfd, time_str);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "gps_status") == 0) {
-        gps_data_t gps_data;
-        if (gps_get_data(&gps_data)) {
-            char status_str[64];
-            snprintf(status_str, sizeof(status_str), "pos:%s,head:%s",
-                    gps_data.valid_position ? "valid" : "invalid",
-                    gps_data.valid_heading ? "valid" : "invalid");
-            telemetry_sendString(sockfd, status_str);
-        } else {
-            telemetry_sendString(sockfd, "no_data");
-        }
-    } else if (strcmp(id, "gps_logging") == 0) {
-        telemetry_sendInt(sockfd, gps_is_logging() ? 1 : 0);
-    } else if (strcmp(id, "gps_speed") == 0) {
-        gps_data_t gps_data;
-        if (gps_get_data(&gps_data) && gps_data.valid_speed) {
-            telemetry_sendDouble(sockfd, gps_data.speed_ms);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "gps_sats") == 0) {
-        gps_data_t gps_data;
-        if (gps_get_data(&gps_data) && gps_data.valid_satellites) {
-            telemetry_sendInt(sockfd, gps_data.num_satellites);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "GET_GPS") == 0) {
-        // Handle GET_GPS command for compatibility with existing clients
-        gps_data_t gps_data;
-        if (gps_get_data(&gps_data)) {
-            char gps_response[512];  // Increased buffer size for additional parameters
-            
-            // Build response with all GPS parameters
-            char lat_str[32], lon_str[32], alt_str[32], head_str[32], speed_str[32], sats_str[16];
-            
-            // Format position data
-            if (gps_data.valid_position) {
-                snprintf(lat_str, sizeof(lat_str), "%.6f", gps_data.latitude);
-                snprintf(lon_str, sizeof(lon_str), "%.6f", gps_data.longitude);
-                snprintf(alt_str, sizeof(alt_str), "%.1f", gps_data.altitude);
-            } else {
-                strcpy(lat_str, "N/A");
-                strcpy(lon_str, "N/A");
-                strcpy(alt_str, "N/A");
-            }
-            
-            // Format heading data
-            if (gps_data.valid_heading) {
-                snprintf(head_str, sizeof(head_str), "%.2f", gps_data.heading);
-            } else {
-                strcpy(head_str, "N/A");
-            }
-            
-            // Format speed data
-            if (gps_data.valid_speed) {
-                snprintf(speed_str, sizeof(speed_str), "%.3f", gps_data.speed_ms);
-            } else {
-                strcpy(speed_str, "N/A");
-            }
-            
-            // Format satellite data
-            if (gps_data.valid_satellites) {
-                snprintf(sats_str, sizeof(sats_str), "%d", gps_data.num_satellites);
-            } else {
-                strcpy(sats_str, "N/A");
-            }
-            
-            snprintf(gps_response, sizeof(gps_response), 
-                    "gps_lat:%s,gps_lon:%s,gps_alt:%s,gps_head:%s,gps_speed:%s,gps_sats:%s",
-                    lat_str, lon_str, alt_str, head_str, speed_str, sats_str);
-            
-            telemetry_sendString(sockfd, gps_response);
-        } else {
-            telemetry_sendString(sockfd, "gps_lat:N/A,gps_lon:N/A,gps_alt:N/A,gps_head:N/A,gps_speed:N/A,gps_sats:N/A");
-        }
+#define NUM_CHANNELS(table) ((int)(sizeof(table) / sizeof(table[0])))
+
+// GPS telemetry channels, from one gps_get_data copy per request
+static gps_data_t gps_copy;
+static bool gps_ok;
+
+static void refresh_gps(void) {
+    gps_ok = gps_get_data(&gps_copy);
+}
+
+static struct tel_source gps_source = {refresh_gps, 0};
+
+VALID_CHANNEL(get_gps_lat, gps_ok && gps_copy.valid_position, tel_set_double, gps_copy.latitude)
+VALID_CHANNEL(get_gps_lon, gps_ok && gps_copy.valid_position, tel_set_double, gps_copy.longitude)
+VALID_CHANNEL(get_gps_alt, gps_ok && gps_copy.valid_position, tel_set_double, gps_copy.altitude)
+VALID_CHANNEL(get_gps_head, gps_ok && gps_copy.valid_heading, tel_set_double, gps_copy.heading)
+VALID_CHANNEL(get_gps_speed, gps_ok && gps_copy.valid_speed, tel_set_double, gps_copy.speed_ms)
+VALID_CHANNEL(get_gps_sats, gps_ok && gps_copy.valid_satellites, tel_set_int, gps_copy.num_satellites)
+
+static void get_gps_time(int index, struct tel_value *out) {
+    (void)index;
+    if (gps_ok) {
+        out->type = TEL_STRING;
+        snprintf(out->s, sizeof(out->s), "%04d-%02d-%02d %02d:%02d:%02d",
+                gps_copy.year, gps_copy.month, gps_copy.day,
+                gps_copy.hour, gps_copy.minute, gps_copy.second);
+    } else {
+        tel_set_string(out, "N/A");
     }
-    
-    // PR59 TEC controller telemetry channels
-    else if (strcmp(id, "pr59_kp") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            telemetry_sendFloat(sockfd, pr59_data.kp);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pr59_ki") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            telemetry_sendFloat(sockfd, pr59_data.ki);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pr59_kd") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            telemetry_sendFloat(sockfd, pr59_data.kd);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pr59_timestamp") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            telemetry_sendDouble(sockfd, (double)pr59_data.timestamp);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pr59_temp") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            telemetry_sendFloat(sockfd, pr59_data.temperature);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pr59_fet_temp") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            telemetry_sendFloat(sockfd, pr59_data.fet_temperature);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pr59_current") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            telemetry_sendFloat(sockfd, pr59_data.current);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pr59_voltage") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            telemetry_sendFloat(sockfd, pr59_data.voltage);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pr59_power") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            telemetry_sendFloat(sockfd, pr59_data.power);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pr59_running") == 0) {
-        telemetry_sendInt(sockfd, pr59_is_running() ? 1 : 0);
-    } else if (strcmp(id, "pr59_status") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            char status_str[64];
-            const char* thermal_status = pr59_data.is_at_setpoint ? "setpoint" : 
-                                       (pr59_data.is_heating ? "heating" : "cooling");
-            snprintf(status_str, sizeof(status_str), "running:%s,thermal:%s",
-                    pr59_data.is_running ? "yes" : "no", thermal_status);
-            telemetry_sendString(sockfd, status_str);
-        } else {
-            telemetry_sendString(sockfd, "not_running");
-        }
-    } else if (strcmp(id, "pr59_fan_status") == 0) {
-        pr59_data_t pr59_data;
-        if (pr59_get_data(&pr59_data)) {
-            const char* fan_status_str = pr59_get_fan_status_string(pr59_data.fan_status);
-            telemetry_sendString(sockfd, fan_status_str);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
+}
+
+static void get_gps_status(int index, struct tel_value *out) {
+    (void)index;
+    if (gps_ok) {
+        out->type = TEL_STRING;
+        snprintf(out->s, sizeof(out->s), "pos:%s,head:%s",
+                gps_copy.valid_position ? "valid" : "invalid",
+                gps_copy.valid_heading ? "valid" : "invalid");
+    } else {
+        tel_set_string(out, "no_data");
     }
-    
-    // Position sensor telemetry channels
-    else if (strcmp(id, "pos_spi_gyro_rate") == 0) {
-        pos_gyro_spi_sample_t spi_data;
-        double timestamp;
-        if (position_sensors_get_spi_gyro_data(&spi_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, spi_data.rate);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pos_accel1_x") == 0) {
-        pos_accel_sample_t accel_data;
-        double timestamp;
-        if (position_sensors_get_accel_data(0, &accel_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, accel_data.x);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pos_accel1_y") == 0) {
-        pos_accel_sample_t accel_data;
-        double timestamp;
-        if (position_sensors_get_accel_data(0, &accel_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, accel_data.y);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pos_accel1_z") == 0) {
-        pos_accel_sample_t accel_data;
-        double timestamp;
-        if (position_sensors_get_accel_data(0, &accel_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, accel_data.z);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pos_accel2_x") == 0) {
-        pos_accel_sample_t accel_data;
-        double timestamp;
-        if (position_sensors_get_accel_data(1, &accel_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, accel_data.x);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pos_accel2_y") == 0) {
-        pos_accel_sample_t accel_data;
-        double timestamp;
-        if (position_sensors_get_accel_data(1, &accel_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, accel_data.y);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pos_accel2_z") == 0) {
-        pos_accel_sample_t accel_data;
-        double timestamp;
-        if (position_sensors_get_accel_data(1, &accel_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, accel_data.z);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "pos_accel3_x") == 0) {
-        pos_accel_sample_t accel_data;
-        double timestamp;
-        if (position_sensors_get_accel_data(2, &accel_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, accel_data.x);
+}
+
+static void get_gps_logging(int index, struct tel_value *out) {
+    (void)index;
+    tel_set_int(out, gps_is_logging() ? 1 : 0);
+}
+
+// GET_GPS, every GPS value in one reply for existing clients
+static void get_GET_GPS(int index, struct tel_value *out) {
+    (void)index;
+    if (gps_ok) {
+        char lat_str[32], lon_str[32], alt_str[32], head_str[32], speed_str[32], sats_str[16];
+
+        // Format position data
+        if (gps_copy.valid_position) {
+            snprintf(lat_str, sizeof(lat_str), "%.6f", gps_copy.latitude);
+            snprintf(lon_str, sizeof(lon_str), "%.6f", gps_copy.longitude);
+            snprintf(alt_str, sizeof(alt_str), "%.1f", gps_copy.altitude);
         } else {
-            telemetry_sendString(sockfd, "N/A");
+            strcpy(lat_str, "N/A");
+            strcpy(lon_str, "N/A");
+            strcpy(alt_str, "N/A");
         }
-    } else if (strcmp(id, "pos_accel3_y") == 0) {
-        pos_accel_sample_t accel_data;
-        double timestamp;
-        if (position_sensors_get_accel_data(2, &accel_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, accel_data.y);
+
+        // Format heading data
+        if (gps_copy.valid_heading) {
+            snprintf(head_str, sizeof(head_str), "%.2f", gps_copy.heading);
         } else {
-            telemetry_sendString(sockfd, "N/A");
+            strcpy(head_str, "N/A");
         }
-    } else if (strcmp(id, "pos_accel3_z") == 0) {
-        pos_accel_sample_t accel_data;
-        double timestamp;
-        if (position_sensors_get_accel_data(2, &accel_data, &timestamp)) {
-            telemetry_sendFloat(sockfd, accel_data.z);
+
+        // Format speed data
+        if (gps_copy.valid_speed) {
+            snprintf(speed_str, sizeof(speed_str), "%.3f", gps_copy.speed_ms);
         } else {
-            telemetry_sendString(sockfd, "N/A");
+            strcpy(speed_str, "N/A");
         }
-    } else if (strcmp(id, "pos_status") == 0) {
-        if (position_sensors_is_enabled() && position_sensors_is_running()) {
-            pos_sensor_status_t status;
-            if (position_sensors_get_status(&status) == 0) {
-                char status_str[128];
-                snprintf(status_str, sizeof(status_str), "connected:%s,script:%s,data:%s",
-                        status.connected ? "yes" : "no",
-                        status.script_running ? "yes" : "no", 
-                        status.data_active ? "yes" : "no");
-                telemetry_sendString(sockfd, status_str);
-            } else {
-                telemetry_sendString(sockfd, "status_error");
-            }
+
+        // Format satellite data
+        if (gps_copy.valid_satellites) {
+            snprintf(sats_str, sizeof(sats_str), "%d", gps_copy.num_satellites);
         } else {
-            telemetry_sendString(sockfd, "disabled");
+            strcpy(sats_str, "N/A");
         }
-    } else if (strcmp(id, "pos_running") == 0) {
-        telemetry_sendInt(sockfd, position_sensors_is_running() ? 1 : 0);
+
+        out->type = TEL_STRING;
+        snprintf(out->s, sizeof(out->s),
+                "gps_lat:%s,gps_lon:%s,gps_alt:%s,gps_head:%s,gps_speed:%s,gps_sats:%s",
+                lat_str, lon_str, alt_str, head_str, speed_str, sats_str);
+    } else {
+        tel_set_string(out, "gps_lat:N/A,gps_lon:N/A,gps_alt:N/A,gps_head:N/A,gps_speed:N/A,gps_sats:N/A");
     }
-    
-    // System status channels
-    else if (strcmp(id, "uptime") == 0) {
-        // Get system uptime
-        FILE *uptime_file = fopen("/proc/uptime", "r");
-        if (uptime_file) {
-            float uptime_seconds;
-            if (fscanf(uptime_file, "%f", &uptime_seconds) == 1) {
-                telemetry_sendFloat(sockfd, uptime_seconds);
-            } else {
-                telemetry_sendString(sockfd, "N/A");
-            }
-            fclose(uptime_file);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "timestamp") == 0) {
-        telemetry_sendDouble(sockfd, (double)time(NULL));
+}
+
+static const struct tel_channel gps_channels[] = {
+    {"gps_lat", get_gps_lat, 0, &gps_source},
+    {"gps_lon", get_gps_lon, 0, &gps_source},
+    {"gps_alt", get_gps_alt, 0, &gps_source},
+    {"gps_head", get_gps_head, 0, &gps_source},
+    {"gps_time", get_gps_time, 0, &gps_source},
+    {"gps_status", get_gps_status, 0, &gps_source},
+    {"gps_logging", get_gps_logging, 0, NULL},
+    {"gps_speed", get_gps_speed, 0, &gps_source},
+    {"gps_sats", get_gps_sats, 0, &gps_source},
+    {"GET_GPS", get_GET_GPS, 0, &gps_source},
+};
+
+// PR59 TEC controller telemetry channels
+static pr59_data_t pr59_copy;
+static bool pr59_ok;
+
+static void refresh_pr59(void) {
+    pr59_ok = pr59_get_data(&pr59_copy);
+}
+
+static struct tel_source pr59_source = {refresh_pr59, 0};
+
+VALID_CHANNEL(get_pr59_kp, pr59_ok, tel_set_float, pr59_copy.kp)
+VALID_CHANNEL(get_pr59_ki, pr59_ok, tel_set_float, pr59_copy.ki)
+VALID_CHANNEL(get_pr59_kd, pr59_ok, tel_set_float, pr59_copy.kd)
+VALID_CHANNEL(get_pr59_timestamp, pr59_ok, tel_set_double, (double)pr59_copy.timestamp)
+VALID_CHANNEL(get_pr59_temp, pr59_ok, tel_set_float, pr59_copy.temperature)
+VALID_CHANNEL(get_pr59_fet_temp, pr59_ok, tel_set_float, pr59_copy.fet_temperature)
+VALID_CHANNEL(get_pr59_current, pr59_ok, tel_set_float, pr59_copy.current)
+VALID_CHANNEL(get_pr59_voltage, pr59_ok, tel_set_float, pr59_copy.voltage)
+VALID_CHANNEL(get_pr59_power, pr59_ok, tel_set_float, pr59_copy.power)
+VALID_CHANNEL(get_pr59_fan_status, pr59_ok, tel_set_string, pr59_get_fan_status_string(pr59_copy.fan_status))
+
+static void get_pr59_running(int index, struct tel_value *out) {
+    (void)index;
+    tel_set_int(out, pr59_is_running() ? 1 : 0);
+}
+
+static void get_pr59_status(int index, struct tel_value *out) {
+    (void)index;
+    if (pr59_ok) {
+        const char* thermal_status = pr59_copy.is_at_setpoint ? "setpoint" :
+                                   (pr59_copy.is_heating ? "heating" : "cooling");
+        out->type = TEL_STRING;
+        snprintf(out->s, sizeof(out->s), "running:%s,thermal:%s",
+                pr59_copy.is_running ? "yes" : "no", thermal_status);
+    } else {
+        tel_set_string(out, "not_running");
     }
-    
-    // Heater telemetry channels
-    else if (strcmp(id, "heater_running") == 0) {
-        telemetry_sendInt(sockfd, heaters_running);
-    } else if (strcmp(id, "heater_starcam_temp") == 0) {
-        if (heaters_running && heaters[0].temp_valid) {
-            telemetry_sendFloat(sockfd, heaters[0].current_temp);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_starcam_current") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[0].current);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_starcam_state") == 0) {
-        if (heaters_running) {
-            telemetry_sendInt(sockfd, heaters[0].state ? 1 : 0);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_motor_temp") == 0) {
-        if (heaters_running && heaters[1].temp_valid) {
-            telemetry_sendFloat(sockfd, heaters[1].current_temp);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_motor_current") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[1].current);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_motor_state") == 0) {
-        if (heaters_running) {
-            telemetry_sendInt(sockfd, heaters[1].state ? 1 : 0);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_ethernet_temp") == 0) {
-        if (heaters_running && heaters[2].temp_valid) {
-            telemetry_sendFloat(sockfd, heaters[2].current_temp);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_ethernet_current") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[2].current);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_ethernet_state") == 0) {
-        if (heaters_running) {
-            telemetry_sendInt(sockfd, heaters[2].state ? 1 : 0);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_lockpin_temp") == 0) {
-        if (heaters_running && heaters[3].temp_valid) {
-            telemetry_sendFloat(sockfd, heaters[3].current_temp);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_lockpin_current") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[3].current);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_lockpin_state") == 0) {
-        if (heaters_running) {
-            telemetry_sendInt(sockfd, heaters[3].state ? 1 : 0);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_spare_temp") == 0) {
-        if (heaters_running && heaters[4].temp_valid) {
-            telemetry_sendFloat(sockfd, heaters[4].current_temp);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_spare_current") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[4].current);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_spare_state") == 0) {
-        if (heaters_running) {
-            telemetry_sendInt(sockfd, heaters[4].state ? 1 : 0);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
+}
+
+static const struct tel_channel pr59_channels[] = {
+    {"pr59_kp", get_pr59_kp, 0, &pr59_source},
+    {"pr59_ki", get_pr59_ki, 0, &pr59_source},
+    {"pr59_kd", get_pr59_kd, 0, &pr59_source},
+    {"pr59_timestamp", get_pr59_timestamp, 0, &pr59_source},
+    {"pr59_temp", get_pr59_temp, 0, &pr59_source},
+    {"pr59_fet_temp", get_pr59_fet_temp, 0, &pr59_source},
+    {"pr59_current", get_pr59_current, 0, &pr59_source},
+    {"pr59_voltage", get_pr59_voltage, 0, &pr59_source},
+    {"pr59_power", get_pr59_power, 0, &pr59_source},
+    {"pr59_running", get_pr59_running, 0, NULL},
+    {"pr59_status", get_pr59_status, 0, &pr59_source},
+    {"pr59_fan_status", get_pr59_fan_status, 0, &pr59_source},
+};
+
+// Position sensor telemetry channels, the gyro and all three accelerometers
+// copied together
+static pos_gyro_spi_sample_t spi_copy;
+static bool spi_ok;
+static pos_accel_sample_t accel_copy[3];
+static bool accel_ok[3];
+
+static void refresh_pos(void) {
+    double timestamp;
+
+    spi_ok = position_sensors_get_spi_gyro_data(&spi_copy, &timestamp);
+    for (int i = 0; i < 3; i++) {
+        accel_ok[i] = position_sensors_get_accel_data(i, &accel_copy[i], &timestamp);
+    }
+}
+
+static struct tel_source pos_source = {refresh_pos, 0};
+
+VALID_CHANNEL(get_pos_spi_gyro_rate, spi_ok, tel_set_float, spi_copy.rate)
+VALID_CHANNEL(get_pos_accel_x, accel_ok[index], tel_set_float, accel_copy[index].x)
+VALID_CHANNEL(get_pos_accel_y, accel_ok[index], tel_set_float, accel_copy[index].y)
+VALID_CHANNEL(get_pos_accel_z, accel_ok[index], tel_set_float, accel_copy[index].z)
+
+static void get_pos_status(int index, struct tel_value *out) {
+    (void)index;
+    if (position_sensors_is_enabled() && position_sensors_is_running()) {
+        pos_sensor_status_t status;
+        if (position_sensors_get_status(&status) == 0) {
+            out->type = TEL_STRING;
+            snprintf(out->s, sizeof(out->s), "connected:%s,script:%s,data:%s",
+                    status.connected ? "yes" : "no",
+                    status.script_running ? "yes" : "no",
+                    status.data_active ? "yes" : "no");
+        } else {
+            tel_set_string(out, "status_error");
         }
-    } else if (strcmp(id, "heater_total_current") == 0) {
-        if (heaters_running) {
-            float total_current = 0.0;
-            for (int i = 0; i < NUM_HEATERS; i++) {
-                total_current += heaters[i].current;
-            }
-            telemetry_sendFloat(sockfd, total_current);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
+    } else {
+        tel_set_string(out, "disabled");
+    }
+}
+
+static void get_pos_running(int index, struct tel_value *out) {
+    (void)index;
+    tel_set_int(out, position_sensors_is_running() ? 1 : 0);
+}
+
+static const struct tel_channel pos_channels[] = {
+    {"pos_spi_gyro_rate", get_pos_spi_gyro_rate, 0, &pos_source},
+    {"pos_accel1_x", get_pos_accel_x, 0, &pos_source},
+    {"pos_accel1_y", get_pos_accel_y, 0, &pos_source},
+    {"pos_accel1_z", get_pos_accel_z, 0, &pos_source},
+    {"pos_accel2_x", get_pos_accel_x, 1, &pos_source},
+    {"pos_accel2_y", get_pos_accel_y, 1, &pos_source},
+    {"pos_accel2_z", get_pos_accel_z, 1, &pos_source},
+    {"pos_accel3_x", get_pos_accel_x, 2, &pos_source},
+    {"pos_accel3_y", get_pos_accel_y, 2, &pos_source},
+    {"pos_accel3_z", get_pos_accel_z, 2, &pos_source},
+    {"pos_status", get_pos_status, 0, NULL},
+    {"pos_running", get_pos_running, 0, NULL},
+};
+
+// System status channels
+static void get_uptime(int index, struct tel_value *out) {
+    (void)index;
+    FILE *uptime_file = fopen("/proc/uptime", "r");
+    float uptime_seconds;
+
+    tel_set_string(out, "N/A");
+    if (uptime_file) {
+        if (fscanf(uptime_file, "%f", &uptime_seconds) == 1) {
+            tel_set_float(out, uptime_seconds);
         }
-    
+        fclose(uptime_file);
+    }
+}
+
+static void get_timestamp(int index, struct tel_value *out) {
+    (void)index;
+    tel_set_double(out, (double)time(NULL));
+}
+
+static const struct tel_channel status_channels[] = {
+    {"uptime", get_uptime, 0, NULL},
+    {"timestamp", get_timestamp, 0, NULL},
+};
+
+// Heater telemetry channels, index is the heater
+static void get_heater_running(int index, struct tel_value *out) {
+    (void)index;
+    tel_set_int(out, heaters_running);
+}
+
+VALID_CHANNEL(get_heater_temp, heaters_running && heaters[index].temp_valid, tel_set_float, heaters[index].current_temp)
+VALID_CHANNEL(get_heater_current, heaters_running, tel_set_float, heaters[index].current)
+VALID_CHANNEL(get_heater_state, heaters_running, tel_set_int, heaters[index].state ? 1 : 0)
+VALID_CHANNEL(get_heater_temp_low, heaters_running, tel_set_float, heaters[index].temp_low)
+VALID_CHANNEL(get_heater_temp_high, heaters_running, tel_set_float, heaters[index].temp_high)
+
+static void get_heater_total_current(int index, struct tel_value *out) {
+    (void)index;
+    if (heaters_running) {
+        float total_current = 0.0;
+        for (int i = 0; i < NUM_HEATERS; i++) {
+            total_current += heaters[i].current;
+        }
+        tel_set_float(out, total_current);
+    } else {
+        tel_set_string(out, "N/A");
+    }
+}
+
+static const struct tel_channel heater_channels[] = {
+    {"heater_running", get_heater_running, 0, NULL},
+    {"heater_starcam_temp", get_heater_temp, 0, NULL},
+    {"heater_starcam_current", get_heater_current, 0, NULL},
+    {"heater_starcam_state", get_heater_state, 0, NULL},
+    {"heater_motor_temp", get_heater_temp, 1, NULL},
+    {"heater_motor_current", get_heater_current, 1, NULL},
+    {"heater_motor_state", get_heater_state, 1, NULL},
+    {"heater_ethernet_temp", get_heater_temp, 2, NULL},
+    {"heater_ethernet_current", get_heater_current, 2, NULL},
+    {"heater_ethernet_state", get_heater_state, 2, NULL},
+    {"heater_lockpin_temp", get_heater_temp, 3, NULL},
+    {"heater_lockpin_current", get_heater_current, 3, NULL},
+    {"heater_lockpin_state", get_heater_state, 3, NULL},
+    {"heater_spare_temp", get_heater_temp, 4, NULL},
+    {"heater_spare_current", get_heater_current, 4, NULL},
+    {"heater_spare_state", get_heater_state, 4, NULL},
+    {"heater_total_current", get_heater_total_current, 0, NULL},
     // Heater temperature range telemetry channels
-    } else if (strcmp(id, "heater_starcam_temp_low") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[0].temp_low);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_starcam_temp_high") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[0].temp_high);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_motor_temp_low") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[1].temp_low);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_motor_temp_high") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[1].temp_high);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_ethernet_temp_low") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[2].temp_low);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_ethernet_temp_high") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[2].temp_high);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_lockpin_temp_low") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[3].temp_low);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "heater_lockpin_temp_high") == 0) {
-        if (heaters_running) {
-            telemetry_sendFloat(sockfd, heaters[3].temp_high);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
+    {"heater_starcam_temp_low", get_heater_temp_low, 0, NULL},
+    {"heater_starcam_temp_high", get_heater_temp_high, 0, NULL},
+    {"heater_motor_temp_low", get_heater_temp_low, 1, NULL},
+    {"heater_motor_temp_high", get_heater_temp_high, 1, NULL},
+    {"heater_ethernet_temp_low", get_heater_temp_low, 2, NULL},
+    {"heater_ethernet_temp_high", get_heater_temp_high, 2, NULL},
+    {"heater_lockpin_temp_low", get_heater_temp_low, 3, NULL},
+    {"heater_lockpin_temp_high", get_heater_temp_high, 3, NULL},
+};
+
+// VLBI telemetry channels
+#define VLBI_OK (vlbi_status_valid && vlbi_client_is_enabled())
+
+VALID_CHANNEL(get_vlbi_running, VLBI_OK, tel_set_int, global_vlbi_status.is_running ? 1 : 0)
+VALID_CHANNEL(get_vlbi_stage, VLBI_OK, tel_set_string,
+              global_vlbi_status.stage[0] ? global_vlbi_status.stage : "unknown")
+VALID_CHANNEL(get_vlbi_packets, VLBI_OK, tel_set_int, global_vlbi_status.packets_captured)
+VALID_CHANNEL(get_vlbi_data_mb, VLBI_OK, tel_set_double, global_vlbi_status.data_size_mb)
+VALID_CHANNEL(get_vlbi_connection, VLBI_OK, tel_set_string,
+              global_vlbi_status.connection_status[0] ? global_vlbi_status.connection_status : "unknown")
+VALID_CHANNEL(get_vlbi_errors, VLBI_OK, tel_set_int, global_vlbi_status.error_count)
+VALID_CHANNEL(get_vlbi_pid, VLBI_OK && global_vlbi_status.is_running, tel_set_int, global_vlbi_status.pid)
+VALID_CHANNEL(get_vlbi_last_update, VLBI_OK, tel_set_string,
+              global_vlbi_status.last_update[0] ? global_vlbi_status.last_update : global_vlbi_status.timestamp)
+
+// GET_VLBI, comprehensive VLBI status
+static void get_GET_VLBI(int index, struct tel_value *out) {
+    (void)index;
+    if (VLBI_OK) {
+        out->type = TEL_STRING;
+        snprintf(out->s, sizeof(out->s),
+                "vlbi_running:%d,vlbi_stage:%s,vlbi_packets:%d,vlbi_data_mb:%.2f,vlbi_connection:%s,vlbi_errors:%d",
+                global_vlbi_status.is_running ? 1 : 0,
+                global_vlbi_status.stage[0] ? global_vlbi_status.stage : "unknown",
+                global_vlbi_status.packets_captured,
+                global_vlbi_status.data_size_mb,
+                global_vlbi_status.connection_status[0] ? global_vlbi_status.connection_status : "unknown",
+                global_vlbi_status.error_count);
+    } else {
+        tel_set_string(out, "vlbi_running:N/A,vlbi_stage:N/A,vlbi_packets:N/A,vlbi_data_mb:N/A,vlbi_connection:N/A,vlbi_errors:N/A");
     }
-    
-    // VLBI telemetry channels
-    else if (strcmp(id, "vlbi_running") == 0) {
-        if (vlbi_status_valid && vlbi_client_is_enabled()) {
-            telemetry_sendInt(sockfd, global_vlbi_status.is_running ? 1 : 0);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "vlbi_stage") == 0) {
-        if (vlbi_status_valid && vlbi_client_is_enabled()) {
-            telemetry_sendString(sockfd, global_vlbi_status.stage[0] ? global_vlbi_status.stage : "unknown");
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "vlbi_packets") == 0) {
-        if (vlbi_status_valid && vlbi_client_is_enabled()) {
-            telemetry_sendInt(sockfd, global_vlbi_status.packets_captured);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "vlbi_data_mb") == 0) {
-        if (vlbi_status_valid && vlbi_client_is_enabled()) {
-            telemetry_sendDouble(sockfd, global_vlbi_status.data_size_mb);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "vlbi_connection") == 0) {
-        if (vlbi_status_valid && vlbi_client_is_enabled()) {
-            telemetry_sendString(sockfd, global_vlbi_status.connection_status[0] ? global_vlbi_status.connection_status : "unknown");
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "vlbi_errors") == 0) {
-        if (vlbi_status_valid && vlbi_client_is_enabled()) {
-            telemetry_sendInt(sockfd, global_vlbi_status.error_count);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "vlbi_pid") == 0) {
-        if (vlbi_status_valid && vlbi_client_is_enabled() && global_vlbi_status.is_running) {
-            telemetry_sendInt(sockfd, global_vlbi_status.pid);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "vlbi_last_update") == 0) {
-        if (vlbi_status_valid && vlbi_client_is_enabled()) {
-            telemetry_sendString(sockfd, global_vlbi_status.last_update[0] ? global_vlbi_status.last_update : global_vlbi_status.timestamp);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "GET_VLBI") == 0) {
-        // Handle GET_VLBI command for comprehensive VLBI status
-        if (vlbi_status_valid && vlbi_client_is_enabled()) {
-            char vlbi_response[512];
-            snprintf(vlbi_response, sizeof(vlbi_response), 
-                    "vlbi_running:%d,vlbi_stage:%s,vlbi_packets:%d,vlbi_data_mb:%.2f,vlbi_connection:%s,vlbi_errors:%d",
-                    global_vlbi_status.is_running ? 1 : 0,
-                    global_vlbi_status.stage[0] ? global_vlbi_status.stage : "unknown",
-                    global_vlbi_status.packets_captured,
-                    global_vlbi_status.data_size_mb,
-                    global_vlbi_status.connection_status[0] ? global_vlbi_status.connection_status : "unknown",
-                    global_vlbi_status.error_count);
-            telemetry_sendString(sockfd, vlbi_response);
-        } else {
-            telemetry_sendString(sockfd, "vlbi_running:N/A,vlbi_stage:N/A,vlbi_packets:N/A,vlbi_data_mb:N/A,vlbi_connection:N/A,vlbi_errors:N/A");
-        }
+}
+
+static const struct tel_channel vlbi_channels[] = {
+    {"vlbi_running", get_vlbi_running, 0, NULL},
+    {"vlbi_stage", get_vlbi_stage, 0, NULL},
+    {"vlbi_packets", get_vlbi_packets, 0, NULL},
+    {"vlbi_data_mb", get_vlbi_data_mb, 0, NULL},
+    {"vlbi_connection", get_vlbi_connection, 0, NULL},
+    {"vlbi_errors", get_vlbi_errors, 0, NULL},
+    {"vlbi_pid", get_vlbi_pid, 0, NULL},
+    {"vlbi_last_update", get_vlbi_last_update, 0, NULL},
+    {"GET_VLBI", get_GET_VLBI, 0, NULL},
+};
+
+// System Monitor telemetry channels, copied under the monitor's lock once
+// per request
+static struct {
+    bool valid;
+    float cpu_temp_celsius;
+    float cpu_usage_percent;
+    float memory_used_gb;
+    float memory_total_gb;
+    char memory_used_str[32];
+    char memory_total_str[32];
+    char ssd_used[32];
+    char ssd_total[32];
+    char ssd_mount_path[128];
+    int ssd_mounted;
+} sys_copy;
+
+static void refresh_sys(void) {
+    sys_copy.valid = system_monitor_running;
+    if (!sys_copy.valid) {
+        return;
     }
-    
-    // System Monitor telemetry channels
-    else if (strcmp(id, "sag_sys_cpu_temp") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendFloat(sockfd, sys_monitor.cpu_temp_celsius);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "sag_sys_cpu_usage") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendFloat(sockfd, sys_monitor.cpu_usage_percent);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "sag_sys_mem_used") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendFloat(sockfd, sys_monitor.memory_used_gb);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "sag_sys_mem_total") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendFloat(sockfd, sys_monitor.memory_total_gb);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "sag_sys_mem_used_str") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendString(sockfd, sys_monitor.memory_used_str);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "sag_sys_mem_total_str") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendString(sockfd, sys_monitor.memory_total_str);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "sag_sys_ssd_mounted") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendInt(sockfd, sys_monitor.ssd_mounted);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "sag_sys_ssd_used") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendString(sockfd, sys_monitor.ssd_used);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "sag_sys_ssd_total") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendString(sockfd, sys_monitor.ssd_total);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "sag_sys_ssd_path") == 0) {
-        if (system_monitor_running) {
-            pthread_mutex_lock(&sys_monitor.data_mutex);
-            telemetry_sendString(sockfd, sys_monitor.ssd_mount_path);
-            pthread_mutex_unlock(&sys_monitor.data_mutex);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
+    pthread_mutex_lock(&sys_monitor.data_mutex);
+    sys_copy.cpu_temp_celsius = sys_monitor.cpu_temp_celsius;
+    sys_copy.cpu_usage_percent = sys_monitor.cpu_usage_percent;
+    sys_copy.memory_used_gb = sys_monitor.memory_used_gb;
+    sys_copy.memory_total_gb = sys_monitor.memory_total_gb;
+    memcpy(sys_copy.memory_used_str, sys_monitor.memory_used_str, sizeof(sys_copy.memory_used_str));
+    memcpy(sys_copy.memory_total_str, sys_monitor.memory_total_str, sizeof(sys_copy.memory_total_str));
+    memcpy(sys_copy.ssd_used, sys_monitor.ssd_used, sizeof(sys_copy.ssd_used));
+    memcpy(sys_copy.ssd_total, sys_monitor.ssd_total, sizeof(sys_copy.ssd_total));
+    memcpy(sys_copy.ssd_mount_path, sys_monitor.ssd_mount_path, sizeof(sys_copy.ssd_mount_path));
+    sys_copy.ssd_mounted = sys_monitor.ssd_mounted;
+    pthread_mutex_unlock(&sys_monitor.data_mutex);
+}
+
+static struct tel_source sys_source = {refresh_sys, 0};
+
+VALID_CHANNEL(get_sag_sys_cpu_temp, sys_copy.valid, tel_set_float, sys_copy.cpu_temp_celsius)
+VALID_CHANNEL(get_sag_sys_cpu_usage, sys_copy.valid, tel_set_float, sys_copy.cpu_usage_percent)
+VALID_CHANNEL(get_sag_sys_mem_used, sys_copy.valid, tel_set_float, sys_copy.memory_used_gb)
+VALID_CHANNEL(get_sag_sys_mem_total, sys_copy.valid, tel_set_float, sys_copy.memory_total_gb)
+VALID_CHANNEL(get_sag_sys_mem_used_str, sys_copy.valid, tel_set_string, sys_copy.memory_used_str)
+VALID_CHANNEL(get_sag_sys_mem_total_str, sys_copy.valid, tel_set_string, sys_copy.memory_total_str)
+VALID_CHANNEL(get_sag_sys_ssd_mounted, sys_copy.valid, tel_set_int, sys_copy.ssd_mounted)
+VALID_CHANNEL(get_sag_sys_ssd_used, sys_copy.valid, tel_set_string, sys_copy.ssd_used)
+VALID_CHANNEL(get_sag_sys_ssd_total, sys_copy.valid, tel_set_string, sys_copy.ssd_total)
+VALID_CHANNEL(get_sag_sys_ssd_path, sys_copy.valid, tel_set_string, sys_copy.ssd_mount_path)
+
+static const struct tel_channel sys_channels[] = {
+    {"sag_sys_cpu_temp", get_sag_sys_cpu_temp, 0, &sys_source},
+    {"sag_sys_cpu_usage", get_sag_sys_cpu_usage, 0, &sys_source},
+    {"sag_sys_mem_used", get_sag_sys_mem_used, 0, &sys_source},
+    {"sag_sys_mem_total", get_sag_sys_mem_total, 0, &sys_source},
+    {"sag_sys_mem_used_str", get_sag_sys_mem_used_str, 0, &sys_source},
+    {"sag_sys_mem_total_str", get_sag_sys_mem_total_str, 0, &sys_source},
+    {"sag_sys_ssd_mounted", get_sag_sys_ssd_mounted, 0, &sys_source},
+    {"sag_sys_ssd_used", get_sag_sys_ssd_used, 0, &sys_source},
+    {"sag_sys_ssd_total", get_sag_sys_ssd_total, 0, &sys_source},
+    {"sag_sys_ssd_path", get_sag_sys_ssd_path, 0, &sys_source},
+};
+
+// TICC telemetry channels
+static ticc_status_t ticc_copy;
+static bool ticc_enabled;
+static bool ticc_ok;
+
+static void refresh_ticc(void) {
+    ticc_enabled = ticc_client_is_enabled();
+    ticc_ok = ticc_enabled && ticc_get_status(&ticc_copy) == 0;
+}
+
+static struct tel_source ticc_source = {refresh_ticc, 0};
+
+VALID_CHANNEL(get_ticc_timestamp, ticc_ok && ticc_copy.is_logging && ticc_copy.last_measurement_timestamp > 0,
+              tel_set_double, ticc_copy.last_measurement_timestamp)
+VALID_CHANNEL(get_ticc_interval, ticc_ok && ticc_copy.is_logging, tel_set_double, ticc_copy.last_measurement)
+VALID_CHANNEL(get_ticc_logging, ticc_ok, tel_set_int, ticc_copy.is_logging ? 1 : 0)
+VALID_CHANNEL(get_ticc_measurement_count, ticc_ok, tel_set_int, ticc_copy.measurement_count)
+VALID_CHANNEL(get_ticc_current_file, ticc_ok && ticc_copy.is_logging, tel_set_string,
+              ticc_copy.current_file[0] ? ticc_copy.current_file : "N/A")
+
+static void get_ticc_status(int index, struct tel_value *out) {
+    (void)index;
+    if (!ticc_enabled) {
+        tel_set_string(out, "disabled");
+    } else if (!ticc_ok) {
+        tel_set_string(out, "error");
+    } else {
+        out->type = TEL_STRING;
+        snprintf(out->s, sizeof(out->s), "logging:%s,configured:%s,measurements:%d",
+                ticc_copy.is_logging ? "yes" : "no",
+                ticc_copy.is_configured ? "yes" : "no",
+                ticc_copy.measurement_count);
     }
-    
-    // TICC telemetry channels
-    else if (strcmp(id, "ticc_timestamp") == 0) {
-        if (ticc_client_is_enabled()) {
-            ticc_status_t ticc_status;
-            if (ticc_get_status(&ticc_status) == 0 && ticc_status.is_logging && ticc_status.last_measurement_timestamp > 0) {
-                telemetry_sendDouble(sockfd, ticc_status.last_measurement_timestamp);
-            } else {
-                telemetry_sendString(sockfd, "N/A");
-            }
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "ticc_interval") == 0) {
-        if (ticc_client_is_enabled()) {
-            ticc_status_t ticc_status;
-            if (ticc_get_status(&ticc_status) == 0 && ticc_status.is_logging) {
-                telemetry_sendDouble(sockfd, ticc_status.last_measurement);
-            } else {
-                telemetry_sendString(sockfd, "N/A");
-            }
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "ticc_logging") == 0) {
-        if (ticc_client_is_enabled()) {
-            ticc_status_t ticc_status;
-            if (ticc_get_status(&ticc_status) == 0) {
-                telemetry_sendInt(sockfd, ticc_status.is_logging ? 1 : 0);
-            } else {
-                telemetry_sendString(sockfd, "N/A");
-            }
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "ticc_measurement_count") == 0) {
-        if (ticc_client_is_enabled()) {
-            ticc_status_t ticc_status;
-            if (ticc_get_status(&ticc_status) == 0) {
-                telemetry_sendInt(sockfd, ticc_status.measurement_count);
-            } else {
-                telemetry_sendString(sockfd, "N/A");
-            }
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "ticc_current_file") == 0) {
-        if (ticc_client_is_enabled()) {
-            ticc_status_t ticc_status;
-            if (ticc_get_status(&ticc_status) == 0 && ticc_status.is_logging) {
-                telemetry_sendString(sockfd, ticc_status.current_file[0] ? ticc_status.current_file : "N/A");
-            } else {
-                telemetry_sendString(sockfd, "N/A");
-            }
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "ticc_status") == 0) {
-        if (ticc_client_is_enabled()) {
-            ticc_status_t ticc_status;
-            if (ticc_get_status(&ticc_status) == 0) {
-                char status_str[128];
-                snprintf(status_str, sizeof(status_str), "logging:%s,configured:%s,measurements:%d",
-                        ticc_status.is_logging ? "yes" : "no",
-                        ticc_status.is_configured ? "yes" : "no",
-                        ticc_status.measurement_count);
-                telemetry_sendString(sockfd, status_str);
-            } else {
-                telemetry_sendString(sockfd, "error");
-            }
-        } else {
-            telemetry_sendString(sockfd, "disabled");
-        }
-    } else if (strcmp(id, "GET_TICC") == 0) {
-        // Handle GET_TICC command for comprehensive TICC status
-        if (ticc_client_is_enabled()) {
-            ticc_status_t ticc_status;
-            if (ticc_get_status(&ticc_status) == 0) {
-                char ticc_response[512];
-                
-                // Format timestamp and interval
-                char timestamp_str[32], interval_str[32];
-                if (ticc_status.is_logging && ticc_status.last_measurement_timestamp > 0) {
-                    snprintf(timestamp_str, sizeof(timestamp_str), "%.3f", ticc_status.last_measurement_timestamp);
-                    snprintf(interval_str, sizeof(interval_str), "%.11f", ticc_status.last_measurement);
-                } else {
-                    strcpy(timestamp_str, "N/A");
-                    strcpy(interval_str, "N/A");
-                }
-                
-                snprintf(ticc_response, sizeof(ticc_response), 
-                        "ticc_timestamp:%s,ticc_interval:%s,ticc_logging:%d,ticc_measurement_count:%d",
-                        timestamp_str, interval_str,
-                        ticc_status.is_logging ? 1 : 0,
-                        ticc_status.measurement_count);
-                
-                telemetry_sendString(sockfd, ticc_response);
-            } else {
-                telemetry_sendString(sockfd, "ticc_timestamp:N/A,ticc_interval:N/A,ticc_logging:N/A,ticc_measurement_count:N/A");
-            }
-        } else {
-            telemetry_sendString(sockfd, "ticc_timestamp:N/A,ticc_interval:N/A,ticc_logging:N/A,ticc_measurement_count:N/A");
+}
+
+// GET_TICC, comprehensive TICC status
+static void get_GET_TICC(int index, struct tel_value *out) {
+    (void)index;
+    if (ticc_ok) {
+        // Format timestamp and interval
+        char timestamp_str[32], interval_str[32];
+        if (ticc_copy.is_logging && ticc_copy.last_measurement_timestamp > 0) {
+            snprintf(timestamp_str, sizeof(timestamp_str), "%.3f", ticc_copy.last_measurement_timestamp);
+            snprintf(interval_str, sizeof(interval_str), "%.11f", ticc_copy.last_measurement);
+        } else {
+            strcpy(timestamp_str, "N/A");
+            strcpy(interval_str, "N/A");
         }
+
+        out->type = TEL_STRING;
+        snprintf(out->s, sizeof(out->s),
+                "ticc_timestamp:%s,ticc_interval:%s,ticc_logging:%d,ticc_measurement_count:%d",
+                timestamp_str, interval_str,
+                ticc_copy.is_logging ? 1 : 0,
+                ticc_copy.measurement_count);
+    } else {
+        tel_set_string(out, "ticc_timestamp:N/A,ticc_interval:N/A,ticc_logging:N/A,ticc_measurement_count:N/A");
     }
-    
-    // Aquila Backend System telemetry channels
-    else if (strcmp(id, "aquila_ssd1_mounted") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendInt(sockfd, aquila_status.ssd1_mounted ? 1 : 0);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_ssd1_used_gb") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendFloat(sockfd, aquila_status.ssd1_used_gb);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_ssd1_total_gb") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendFloat(sockfd, aquila_status.ssd1_total_gb);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_ssd1_percent") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendFloat(sockfd, aquila_status.ssd1_percent_used);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_ssd2_mounted") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendInt(sockfd, aquila_status.ssd2_mounted ? 1 : 0);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_ssd2_used_gb") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendFloat(sockfd, aquila_status.ssd2_used_gb);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_ssd2_total_gb") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendFloat(sockfd, aquila_status.ssd2_total_gb);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_ssd2_percent") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendFloat(sockfd, aquila_status.ssd2_percent_used);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_cpu_temp") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendFloat(sockfd, aquila_status.cpu_temp_celsius);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_memory_percent") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            telemetry_sendFloat(sockfd, aquila_status.memory_percent_used);
-        } else {
-            telemetry_sendString(sockfd, "N/A");
-        }
-    } else if (strcmp(id, "aquila_status") == 0) {
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            char status_str[256];
-            snprintf(status_str, sizeof(status_str), 
-                    "ssd1:%s(%.1f%%), ssd2:%s(%.1f%%), cpu:%.1f°C, mem:%.1f%%",
-                    aquila_status.ssd1_mounted ? "mounted" : "unmounted", aquila_status.ssd1_percent_used,
-                    aquila_status.ssd2_mounted ? "mounted" : "unmounted", aquila_status.ssd2_percent_used,
-                    aquila_status.cpu_temp_celsius, aquila_status.memory_percent_used);
-            telemetry_sendString(sockfd, status_str);
-        } else {
-            telemetry_sendString(sockfd, "no_data");
-        }
-    } else if (strcmp(id, "GET_AQUILA") == 0) {
-        // Handle GET_AQUILA command for comprehensive aquila status
-        aquila_status_t aquila_status;
-        if (aquila_status_get_data(&aquila_status) == 0) {
-            char aquila_response[512];
-            snprintf(aquila_response, sizeof(aquila_response), 
-                    "aquila_ssd1_mounted:%d,aquila_ssd1_percent:%.1f,aquila_ssd1_used_gb:%.1f,aquila_ssd1_total_gb:%.1f,"
-                    "aquila_ssd2_mounted:%d,aquila_ssd2_percent:%.1f,aquila_ssd2_used_gb:%.1f,aquila_ssd2_total_gb:%.1f,"
-                    "aquila_cpu_temp:%.1f,aquila_memory_percent:%.1f",
-                    aquila_status.ssd1_mounted, aquila_status.ssd1_percent_used, aquila_status.ssd1_used_gb, aquila_status.ssd1_total_gb,
-                    aquila_status.ssd2_mounted, aquila_status.ssd2_percent_used, aquila_status.ssd2_used_gb, aquila_status.ssd2_total_gb,
-                    aquila_status.cpu_temp_celsius, aquila_status.memory_percent_used);
-            telemetry_sendString(sockfd, aquila_response);
-        } else {
-            telemetry_sendString(sockfd, "aquila_ssd1_mounted:N/A,aquila_ssd1_percent:N/A,aquila_ssd1_used_gb:N/A,aquila_ssd1_total_gb:N/A,"
-                                        "aquila_ssd2_mounted:N/A,aquila_ssd2_percent:N/A,aquila_ssd2_used_gb:N/A,aquila_ssd2_total_gb:N/A,"
-                                        "aquila_cpu_temp:N/A,aquila_memory_percent:N/A");
+}
+
+static const struct tel_channel ticc_channels[] = {
+    {"ticc_timestamp", get_ticc_timestamp, 0, &ticc_source},
+    {"ticc_interval", get_ticc_interval, 0, &ticc_source},
+    {"ticc_logging", get_ticc_logging, 0, &ticc_source},
+    {"ticc_measurement_count", get_ticc_measurement_count, 0, &ticc_source},
+    {"ticc_current_file", get_ticc_current_file, 0, &ticc_source},
+    {"ticc_status", get_ticc_status, 0, &ticc_source},
+    {"GET_TICC", get_GET_TICC, 0, &ticc_source},
+};
+
+// Aquila Backend System telemetry channels
+static aquila_status_t aquila_copy;
+static bool aquila_ok;
+
+static void refresh_aquila(void) {
+    aquila_ok = aquila_status_get_data(&aquila_copy) == 0;
+}
+
+static struct tel_source aquila_source = {refresh_aquila, 0};
+
+VALID_CHANNEL(get_aquila_ssd1_mounted, aquila_ok, tel_set_int, aquila_copy.ssd1_mounted ? 1 : 0)
+VALID_CHANNEL(get_aquila_ssd1_used_gb, aquila_ok, tel_set_float, aquila_copy.ssd1_used_gb)
+VALID_CHANNEL(get_aquila_ssd1_total_gb, aquila_ok, tel_set_float, aquila_copy.ssd1_total_gb)
+VALID_CHANNEL(get_aquila_ssd1_percent, aquila_ok, tel_set_float, aquila_copy.ssd1_percent_used)
+VALID_CHANNEL(get_aquila_ssd2_mounted, aquila_ok, tel_set_int, aquila_copy.ssd2_mounted ? 1 : 0)
+VALID_CHANNEL(get_aquila_ssd2_used_gb, aquila_ok, tel_set_float, aquila_copy.ssd2_used_gb)
+VALID_CHANNEL(get_aquila_ssd2_total_gb, aquila_ok, tel_set_float, aquila_copy.ssd2_total_gb)
+VALID_CHANNEL(get_aquila_ssd2_percent, aquila_ok, tel_set_float, aquila_copy.ssd2_percent_used)
+VALID_CHANNEL(get_aquila_cpu_temp, aquila_ok, tel_set_float, aquila_copy.cpu_temp_celsius)
+VALID_CHANNEL(get_aquila_memory_percent, aquila_ok, tel_set_float, aquila_copy.memory_percent_used)
+
+static void get_aquila_status(int index, struct tel_value *out) {
+    (void)index;
+    if (aquila_ok) {
+        out->type = TEL_STRING;
+        snprintf(out->s, sizeof(out->s),
+                "ssd1:%s(%.1f%%), ssd2:%s(%.1f%%), cpu:%.1f°C, mem:%.1f%%",
+                aquila_copy.ssd1_mounted ? "mounted" : "unmounted", aquila_copy.ssd1_percent_used,
+                aquila_copy.ssd2_mounted ? "mounted" : "unmounted", aquila_copy.ssd2_percent_used,
+                aquila_copy.cpu_temp_celsius, aquila_copy.memory_percent_used);
+    } else {
+        tel_set_string(out, "no_data");
+    }
+}
+
+// GET_AQUILA, comprehensive aquila status
+static void get_GET_AQUILA(int index, struct tel_value *out) {
+    (void)index;
+    if (aquila_ok) {
+        out->type = TEL_STRING;
+        snprintf(out->s, sizeof(out->s),
+                "aquila_ssd1_mounted:%d,aquila_ssd1_percent:%.1f,aquila_ssd1_used_gb:%.1f,aquila_ssd1_total_gb:%.1f,"
+                "aquila_ssd2_mounted:%d,aquila_ssd2_percent:%.1f,aquila_ssd2_used_gb:%.1f,aquila_ssd2_total_gb:%.1f,"
+                "aquila_cpu_temp:%.1f,aquila_memory_percent:%.1f",
+                aquila_copy.ssd1_mounted, aquila_copy.ssd1_percent_used, aquila_copy.ssd1_used_gb, aquila_copy.ssd1_total_gb,
+                aquila_copy.ssd2_mounted, aquila_copy.ssd2_percent_used, aquila_copy.ssd2_used_gb, aquila_copy.ssd2_total_gb,
+                aquila_copy.cpu_temp_celsius, aquila_copy.memory_percent_used);
+    } else {
+        tel_set_string(out, "aquila_ssd1_mounted:N/A,aquila_ssd1_percent:N/A,aquila_ssd1_used_gb:N/A,aquila_ssd1_total_gb:N/A,"
+                            "aquila_ssd2_mounted:N/A,aquila_ssd2_percent:N/A,aquila_ssd2_used_gb:N/A,aquila_ssd2_total_gb:N/A,"
+                            "aquila_cpu_temp:N/A,aquila_memory_percent:N/A");
+    }
+}
+
+static const struct tel_channel aquila_channels[] = {
+    {"aquila_ssd1_mounted", get_aquila_ssd1_mounted, 0, &aquila_source},
+    {"aquila_ssd1_used_gb", get_aquila_ssd1_used_gb, 0, &aquila_source},
+    {"aquila_ssd1_total_gb", get_aquila_ssd1_total_gb, 0, &aquila_source},
+    {"aquila_ssd1_percent", get_aquila_ssd1_percent, 0, &aquila_source},
+    {"aquila_ssd2_mounted", get_aquila_ssd2_mounted, 0, &aquila_source},
+    {"aquila_ssd2_used_gb", get_aquila_ssd2_used_gb, 0, &aquila_source},
+    {"aquila_ssd2_total_gb", get_aquila_ssd2_total_gb, 0, &aquila_source},
+    {"aquila_ssd2_percent", get_aquila_ssd2_percent, 0, &aquila_source},
+    {"aquila_cpu_temp", get_aquila_cpu_temp, 0, &aquila_source},
+    {"aquila_memory_percent", get_aquila_memory_percent, 0, &aquila_source},
+    {"aquila_status", get_aquila_status, 0, &aquila_source},
+    {"GET_AQUILA", get_GET_AQUILA, 0, &aquila_source},
+};
+
+// Register every subsystem's channels. Future telemetry channels are added
+// with a table above and a line here
+static void telemetry_register_channels(void) {
+    char log_msg[128];
+
+    tel_register(gps_channels, NUM_CHANNELS(gps_channels));
+    tel_register(pr59_channels, NUM_CHANNELS(pr59_channels));
+    tel_register(pos_channels, NUM_CHANNELS(pos_channels));
+    tel_register(status_channels, NUM_CHANNELS(status_channels));
+    tel_register(heater_channels, NUM_CHANNELS(heater_channels));
+    tel_register(vlbi_channels, NUM_CHANNELS(vlbi_channels));
+    tel_register(sys_channels, NUM_CHANNELS(sys_channels));
+    tel_register(ticc_channels, NUM_CHANNELS(ticc_channels));
+    tel_register(aquila_channels, NUM_CHANNELS(aquila_channels));
+
+    snprintf(log_msg, sizeof(log_msg), "%d telemetry channels registered", tel_num_channels());
+    write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_register_channels", log_msg);
+
+    // Channel groups from the config, for GROUP: requests
+    for (int i = 0; i < server_config.group_count; i++) {
+        int unknown = tel_add_group(server_config.group_names[i], server_config.group_channels[i]);
+        if (unknown < 0) {
+            snprintf(log_msg, sizeof(log_msg), "Could not add channel group %s", server_config.group_names[i]);
+            write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_register_channels", log_msg);
+        } else if (unknown > 0) {
+            snprintf(log_msg, sizeof(log_msg), "Channel group %s has %d unknown channels",
+                     server_config.group_names[i], unknown);
+            write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_register_channels", log_msg);
         }
     }
-    
-    // Future telemetry channels can be added here
-    // Examples:
-    // else if (strcmp(id, "system_temp") == 0) { /* Add system temperature */ }
-    // else if (strcmp(id, "battery_voltage") == 0) { /* Add battery monitoring */ }
-    // else if (strcmp(id, "disk_usage") == 0) { /* Add disk usage monitoring */ }
-    else {
+}
+
+// Send one channel's value in the format of its type
+static void telemetry_send_value(int sockfd, const struct tel_value *value) {
+    char string_sample[32];
+
+    switch (value->type) {
+    case TEL_INT:
+        telemetry_sendInt(sockfd, value->i);
+        break;
+    case TEL_ULONG:
+        snprintf(string_sample, sizeof(string_sample), "%lu", value->ul);
+        telemetry_sendString(sockfd, string_sample);
+        break;
+    case TEL_FLOAT:
+        telemetry_sendFloat(sockfd, value->f);
+        break;
+    case TEL_DOUBLE:
+        telemetry_sendDouble(sockfd, value->d);
+        break;
+    default:
+        telemetry_sendString(sockfd, value->s);
+        break;
+    }
+}
+
+// Answer BATCH:name,... and GROUP:name with every value in one packed reply
+static void telemetry_send_batch(int sockfd, char* request) {
+    uint8_t reply[TEL_BATCH_MAX];
+    int len = tel_batch(request, reply, sizeof(reply));
+
+    if (len < 0) {
+        char client_ip[INET_ADDRSTRLEN];
+        char log_msg[256];
+        inet_ntop(AF_INET, &tel_client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
+        snprintf(log_msg, sizeof(log_msg), "Received bad batch request: '%.128s' from %s", request, client_ip);
+        write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_send_batch", log_msg);
+        telemetry_sendString(sockfd, "ERROR:UNKNOWN_REQUEST");
+        return;
+    }
+    sendto(sockfd, reply, len, MSG_CONFIRM,
+           (const struct sockaddr *) &tel_client_addr, sizeof(tel_client_addr));
+}
+
+// Add, renew or end a subscription; its updates come from the subscription thread
+static void telemetry_subscribe(int sockfd, char* request) {
+    char client_ip[INET_ADDRSTRLEN];
+    char log_msg[256];
+    int result;
+
+    inet_ntop(AF_INET, &tel_client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
+    if (!is_authorized_client(client_ip)) {
+        snprintf(log_msg, sizeof(log_msg), "Refused subscription from unauthorized client %s", client_ip);
+        write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_subscribe", log_msg);
+        telemetry_sendString(sockfd, "ERROR:UNAUTHORIZED");
+        return;
+    }
+
+    result = tel_subscribe(&tel_client_addr, request);
+    if (result == TEL_SUB_BAD_REQUEST) {
+        snprintf(log_msg, sizeof(log_msg), "Received bad subscription: '%.128s' from %s", request, client_ip);
+        write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_subscribe", log_msg);
+        telemetry_sendString(sockfd, "ERROR:UNKNOWN_REQUEST");
+    } else if (result == TEL_SUB_REFUSED) {
+        snprintf(log_msg, sizeof(log_msg), "Refused subscription from %s, too many subscriptions", client_ip);
+        write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_subscribe", log_msg);
+        telemetry_sendString(sockfd, "ERROR:TOO_MANY_SUBSCRIPTIONS");
+    }
+}
+
+// Process telemetry requests and send appropriate responses
+void telemetry_send_metric(int sockfd, char* id) {
+    const struct tel_channel *channel;
+    struct tel_value value;
+
+    if (tel_is_batch(id)) {
+        telemetry_send_batch(sockfd, id);
+        return;
+    }
+    if (tel_is_subscription(id)) {
+        telemetry_subscribe(sockfd, id);
+        return;
+    }
+
+    // Note: Normal requests are not logged to reduce verbosity
+    // Only errors and unknown requests will be logged
+    channel = tel_lookup(id);
+    if (channel == NULL) {
         // Unknown request
+        char client_ip[INET_ADDRSTRLEN];
         char log_msg[256];
+        inet_ntop(AF_INET, &tel_client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
         snprintf(log_msg, sizeof(log_msg), "Received unknown request: '%s' from %s", id, client_ip);
         write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_send_metric", log_msg);
         telemetry_sendString(sockfd, "ERROR:UNKNOWN_REQUEST");
+        return;
     }
+
+    tel_get(channel, &value);
+    telemetry_send_value(sockfd, &value);
 }
 
 // Main telemetry server thread function
@@ -1004,6 +835,10 @@ void* telemetry_server_thread(void* arg) {
 
     if (tel_server_running) {
         write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_server_thread", "Telemetry server thread started");
+
+        if (tel_sub_start(sockfd, server_config.sub_min_period_ms, telemetry_server_log) < 0) {
+            write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_server_thread", "Could not start the subscription thread");
+        }
         
         while (!stop_telemetry_server) {
             telemetry_sock_listen(sockfd, buffer);
@@ -1020,6 +855,7 @@ void* telemetry_server_thread(void* arg) {
         }
         
         write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_server_thread", "Shutting down telemetry server");
+        tel_sub_stop();
         tel_server_running = 0;
         stop_telemetry_server = 0;
         close(sockfd);
@@ -1053,6 +889,10 @@ int telemetry_server_init(const telemetry_server_config_t *config) {
         return -1;
     }
     
+    if (tel_num_channels() == 0) {
+        telemetry_register_channels();
+    }
+
     server_initialized = true;
     write_to_log(telemetry_server_log, "telemetry_server.c", "telemetry_server_init", "Telemetry server initialized");
     
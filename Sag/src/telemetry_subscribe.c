@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "telemetry_registry.h"
+#include "telemetry_subscribe.h"
+
+struct tel_sub {
+    int active;                         // confirmed and being pushed
+    int pending;                        // waiting for its nonce back
+    struct sockaddr_in client;
+    char request[TEL_SUB_REQUEST_LEN];  // BATCH: or GROUP: request
+    long period_ns;
+    double deadband;                    // < 0 to send every period
+    struct timespec next;               // when it is next checked
+    struct timespec last_sent;
+    struct timespec expires;
+    uint8_t last[TEL_BATCH_MAX];        // reply last sent, for the deadband
+    int last_len;
+    double tokens;                      // bytes it may send now
+    struct timespec refilled;
+    // the subscription asked for, until the client echoes the nonce
+    uint64_t nonce;
+    struct timespec confirm_by;
+    char pending_request[TEL_SUB_REQUEST_LEN];
+    long pending_period_ns;
+    double pending_deadband;
+};
+
+static struct {
+    struct tel_sub subs[TEL_MAX_SUBS];
+    uint8_t reply[TEL_BATCH_MAX];
+    int sockfd;
+    long min_period_ns;
+    double tokens;                      // bytes all of them may send now
+    struct timespec refilled;
+    FILE * log;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;                // on CLOCK_MONOTONIC
+    pthread_t thread;
+    int running;
+    int stop;
+} subscriptions = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static long long diffNs(const struct timespec * a, const struct timespec * b) {
+    return (a->tv_sec - b->tv_sec)*1000000000LL + (a->tv_nsec - b->tv_nsec);
+}
+
+static void addNs(struct timespec * t, long long ns) {
+    ns += t->tv_nsec;
+    t->tv_sec += ns/1000000000LL;
+    t->tv_nsec = ns % 1000000000LL;
+    if (t->tv_nsec < 0) {
+        t->tv_sec--;
+        t->tv_nsec += 1000000000LL;
+    }
+}
+
+/* Function to take a reply's bytes from a budget that refills at bps and
+** can save up a second of it.
+** Input: The budget, its rate and the time.
+** Output: None (void).
+*/
+static void refill(double * tokens, struct timespec * refilled, double bps,
+                   const struct timespec * now) {
+    *tokens += diffNs(now, refilled)*1e-9*bps;
+    if (*tokens > bps) {
+        *tokens = bps;
+    }
+    *refilled = *now;
+}
+
+static void logSub(const char * func, const struct tel_sub * sub,
+                   const char * msg) {
+    char ip[INET_ADDRSTRLEN];
+
+    if (subscriptions.log == NULL) {
+        return;
+    }
+    inet_ntop(AF_INET, &sub->client.sin_addr, ip, sizeof(ip));
+    fprintf(subscriptions.log, "[%ld][telemetry_subscribe.c][%s] %s:%d %s\n",
+            time(NULL), func, ip, ntohs(sub->client.sin_port), msg);
+    fflush(subscriptions.log);
+}
+
+/* Function to check a subscription and send it if it is due and, for an on
+** change subscription, something changed. Called with the lock held.
+** Input: The subscription and the time.
+** Output: Its next time, moved on by a period. Returns -1 if it has to end.
+*/
+static int serviceSub(struct tel_sub * sub, const struct timespec * now) {
+    uint8_t * reply = subscriptions.reply;
+    int len;
+    int send;
+
+    if (diffNs(now, &sub->next) < 0) {
+        return 0;
+    }
+    len = tel_batch(sub->request, reply, TEL_BATCH_MAX);
+    if (len < 0) {
+        return -1;
+    }
+    send = sub->deadband < 0 || sub->last_len == 0 ||
+           diffNs(now, &sub->last_sent) >= TEL_SUB_HEARTBEAT_MS*1000000LL ||
+           tel_changed(sub->last, sub->last_len, reply, len, sub->deadband);
+    refill(&sub->tokens, &sub->refilled, TEL_SUB_MAX_BPS, now);
+    refill(&subscriptions.tokens, &subscriptions.refilled, TEL_SUB_TOTAL_BPS, now);
+    // over the budget, so skip it: what changed goes in the next one there
+    // is room for
+    if (send && (sub->tokens < len || subscriptions.tokens < len)) {
+        send = 0;
+    }
+    if (send) {
+        sub->tokens -= len;
+        subscriptions.tokens -= len;
+        sendto(subscriptions.sockfd, reply, len, 0,
+               (const struct sockaddr *) &sub->client, sizeof(sub->client));
+        memcpy(sub->last, reply, len);
+        sub->last_len = len;
+        sub->last_sent = *now;
+    }
+
+    // stay on the period's grid, but do not catch up after a stall
+    addNs(&sub->next, sub->period_ns);
+    if (diffNs(&sub->next, now) <= 0) {
+        sub->next = *now;
+        addNs(&sub->next, sub->period_ns);
+    }
+    return 0;
+}
+
+static void * subscriptionThread(void * arg) {
+    (void) arg;
+
+    pthread_mutex_lock(&subscriptions.lock);
+    while (!subscriptions.stop) {
+        struct timespec now, wake;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        wake = now;
+        addNs(&wake, 1000000000LL);
+        for (int i = 0; i < TEL_MAX_SUBS; i++) {
+            struct tel_sub * sub = &subscriptions.subs[i];
+
+            if (!sub->active) {
+                continue;
+            }
+            if (diffNs(&now, &sub->expires) >= 0) {
+                sub->active = 0;
+                logSub("subscriptionThread", sub, "subscription expired");
+                continue;
+            }
+            if (serviceSub(sub, &now) < 0) {
+                sub->active = 0;
+                logSub("subscriptionThread", sub, "subscription ended, its request no longer works");
+                continue;
+            }
+            if (diffNs(&sub->next, &wake) < 0) {
+                wake = sub->next;
+            }
+            if (diffNs(&sub->expires, &wake) < 0) {
+                wake = sub->expires;
+            }
+        }
+        pthread_cond_timedwait(&subscriptions.wake, &subscriptions.lock, &wake);
+    }
+    pthread_mutex_unlock(&subscriptions.lock);
+    return NULL;
+}
+
+/* Function to start pushing subscriptions.
+** Input: The server's socket, which the updates are sent from, the shortest
+** period a client may ask for and where to log (or NULL).
+** Output: 0 on success, -1 if the thread could not be started.
+*/
+int tel_sub_start(int sockfd, int min_period_ms, FILE * log) {
+    pthread_condattr_t attr;
+
+    if (subscriptions.running) {
+        return 0;
+    }
+    subscriptions.sockfd = sockfd;
+    subscriptions.min_period_ns = (min_period_ms > 0 ? min_period_ms : 1)*1000000L;
+    subscriptions.log = log;
+    subscriptions.stop = 0;
+    subscriptions.tokens = TEL_SUB_TOTAL_BPS;
+    clock_gettime(CLOCK_MONOTONIC, &subscriptions.refilled);
+    memset(subscriptions.subs, 0, sizeof(subscriptions.subs));
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&subscriptions.wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&subscriptions.thread, NULL, subscriptionThread, NULL) != 0) {
+        pthread_cond_destroy(&subscriptions.wake);
+        return -1;
+    }
+    subscriptions.running = 1;
+    return 0;
+}
+
+int tel_is_subscription(const char * request) {
+    size_t len = strlen(TEL_UNSUB);
+
+    return strncmp(request, TEL_SUB_PREFIX, strlen(TEL_SUB_PREFIX)) == 0 ||
+           strncmp(request, TEL_SUB_NONCE, strlen(TEL_SUB_NONCE)) == 0 ||
+           (strncmp(request, TEL_UNSUB, len) == 0 &&
+            (request[len] == '\0' || isspace((unsigned char) request[len])));
+}
+
+static int sameClient(const struct sockaddr_in * a, const struct sockaddr_in * b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+/* Function to tell if a slot holds a subscription or one being confirmed. */
+static int inUse(const struct tel_sub * sub, const struct timespec * now) {
+    return sub->active || (sub->pending && diffNs(now, &sub->confirm_by) < 0);
+}
+
+static uint64_t newNonce(void) {
+    uint64_t nonce;
+    struct timespec ts;
+
+    if (getrandom(&nonce, sizeof(nonce), GRND_NONBLOCK) == sizeof(nonce)) {
+        return nonce;
+    }
+    // no entropy yet this early in boot, still nothing a forger sees
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_nsec << 32) ^ (uint64_t) ts.tv_sec ^
+           ((uint64_t) rand() << 16);
+}
+
+/* Function to end a client's subscription. Called with the lock held. */
+static void unsubscribe(const struct sockaddr_in * client) {
+    for (int i = 0; i < TEL_MAX_SUBS; i++) {
+        struct tel_sub * sub = &subscriptions.subs[i];
+
+        if (!sameClient(&sub->client, client)) {
+            continue;
+        }
+        if (sub->active) {
+            logSub("tel_subscribe", sub, "unsubscribed");
+        }
+        sub->active = 0;
+        sub->pending = 0;
+    }
+}
+
+/* Function to start the subscription a client asked for once it sends its
+** nonce back. Called with the lock held.
+** Input: The client's address and its NONCE: reply.
+** Output: TEL_SUB_OK, or TEL_SUB_BAD_REQUEST if it is not the nonce sent
+** to that address or came too late.
+*/
+static int confirm(const struct sockaddr_in * client, const char * reply,
+                   const struct timespec * now) {
+    const char * p = reply + strlen(TEL_SUB_NONCE);
+    char * end;
+    uint64_t nonce = strtoull(p, &end, 16);
+
+    if (end == p) {
+        return TEL_SUB_BAD_REQUEST;
+    }
+    for (int i = 0; i < TEL_MAX_SUBS; i++) {
+        struct tel_sub * sub = &subscriptions.subs[i];
+
+        if (!sub->pending || !sameClient(&sub->client, client)) {
+            continue;
+        }
+        if (diffNs(now, &sub->confirm_by) >= 0 || sub->nonce != nonce) {
+            return TEL_SUB_BAD_REQUEST;
+        }
+        memcpy(sub->request, sub->pending_request, sizeof(sub->request));
+        sub->period_ns = sub->pending_period_ns;
+        sub->deadband = sub->pending_deadband;
+        sub->next = *now;
+        sub->last_len = 0;
+        sub->tokens = TEL_SUB_MAX_BPS;
+        sub->refilled = *now;
+        sub->expires = *now;
+        sub->expires.tv_sec += TEL_SUB_LEASE_S;
+        sub->pending = 0;
+        sub->active = 1;
+        logSub("tel_subscribe", sub, "subscribed");
+        pthread_cond_signal(&subscriptions.wake);
+        return TEL_SUB_OK;
+    }
+    return TEL_SUB_BAD_REQUEST;
+}
+
+/* Function to add, renew or end a client's subscription.
+** Input: The client's address and its SUB:, NONCE: or UNSUB request.
+** Output: TEL_SUB_OK, TEL_SUB_CHALLENGED if a new or changed subscription was
+** sent a nonce to echo, TEL_SUB_BAD_REQUEST if the request cannot be read,
+** asks for channels that do not work as a batch or has the wrong nonce, or
+** TEL_SUB_REFUSED if the client or the server has too many subscriptions.
+*/
+int tel_subscribe(const struct sockaddr_in * client, const char * request) {
+    struct tel_sub * sub = NULL;
+    struct timespec now;
+    const char * p;
+    char * end;
+    char challenge[32];
+    long period_ms;
+    long period_ns;
+    double deadband = -1;
+    int from_ip = 0;
+    int result;
+
+    if (!subscriptions.running) {
+        return TEL_SUB_REFUSED;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (strncmp(request, TEL_SUB_NONCE, strlen(TEL_SUB_NONCE)) == 0) {
+        pthread_mutex_lock(&subscriptions.lock);
+        result = confirm(client, request, &now);
+        pthread_mutex_unlock(&subscriptions.lock);
+        return result;
+    }
+    if (strncmp(request, TEL_SUB_PREFIX, strlen(TEL_SUB_PREFIX)) != 0) {
+        pthread_mutex_lock(&subscriptions.lock);
+        unsubscribe(client);
+        pthread_mutex_unlock(&subscriptions.lock);
+        return TEL_SUB_OK;
+    }
+
+    // SUB:<period_ms>[:<deadband>]:<request>
+    p = request + strlen(TEL_SUB_PREFIX);
+    period_ms = strtol(p, &end, 10);
+    if (end == p || *end != ':' || period_ms <= 0) {
+        return TEL_SUB_BAD_REQUEST;
+    }
+    p = end + 1;
+    if (!tel_is_batch(p)) {
+        deadband = strtod(p, &end);
+        if (end == p || *end != ':' || deadband < 0) {
+            return TEL_SUB_BAD_REQUEST;
+        }
+        p = end + 1;
+    }
+    if (strlen(p) >= TEL_SUB_REQUEST_LEN || tel_batch_check(p) <= 0) {
+        return TEL_SUB_BAD_REQUEST;
+    }
+    period_ns = period_ms*1000000L;
+    if (period_ns < subscriptions.min_period_ns) {
+        period_ns = subscriptions.min_period_ns;
+    }
+
+    pthread_mutex_lock(&subscriptions.lock);
+    for (int i = 0; i < TEL_MAX_SUBS; i++) {
+        struct tel_sub * s = &subscriptions.subs[i];
+
+        if (!inUse(s, &now)) {
+            continue;
+        }
+        if (sameClient(&s->client, client)) {
+            sub = s;
+            break;
+        }
+        if (s->client.sin_addr.s_addr == client->sin_addr.s_addr) {
+            from_ip++;
+        }
+    }
+
+    // the same subscription again only renews it, and keeps its cadence
+    if (sub != NULL && sub->active && strcmp(sub->request, p) == 0 &&
+        sub->deadband == deadband && sub->period_ns == period_ns) {
+        sub->expires = now;
+        sub->expires.tv_sec += TEL_SUB_LEASE_S;
+        pthread_cond_signal(&subscriptions.wake);
+        pthread_mutex_unlock(&subscriptions.lock);
+        return TEL_SUB_OK;
+    }
+
+    if (sub == NULL) {
+        if (from_ip >= TEL_MAX_SUBS_PER_IP) {
+            pthread_mutex_unlock(&subscriptions.lock);
+            return TEL_SUB_REFUSED;
+        }
+        for (int i = 0; i < TEL_MAX_SUBS && sub == NULL; i++) {
+            if (!inUse(&subscriptions.subs[i], &now)) {
+                sub = &subscriptions.subs[i];
+                memset(sub, 0, sizeof(*sub));
+                sub->client = *client;
+            }
+        }
+        if (sub == NULL) {
+            pthread_mutex_unlock(&subscriptions.lock);
+            return TEL_SUB_REFUSED;
+        }
+    }
+
+    // a new or changed subscription waits for the client to echo a nonce,
+    // and the one it has (if any) carries on until then
+    snprintf(sub->pending_request, sizeof(sub->pending_request), "%s", p);
+    sub->pending_period_ns = period_ns;
+    sub->pending_deadband = deadband;
+    sub->nonce = newNonce();
+    sub->confirm_by = now;
+    addNs(&sub->confirm_by, TEL_SUB_CONFIRM_MS*1000000LL);
+    sub->pending = 1;
+    snprintf(challenge, sizeof(challenge), "%s%016llx", TEL_SUB_NONCE,
+             (unsigned long long) sub->nonce);
+    sendto(subscriptions.sockfd, challenge, strlen(challenge), 0,
+           (const struct sockaddr *) client, sizeof(*client));
+    pthread_mutex_unlock(&subscriptions.lock);
+    return TEL_SUB_CHALLENGED;
+}
+
+int tel_num_subscriptions(void) {
+    int n = 0;
+
+    pthread_mutex_lock(&subscriptions.lock);
+    for (int i = 0; i < TEL_MAX_SUBS; i++) {
+        n += subscriptions.subs[i].active;
+    }
+    pthread_mutex_unlock(&subscriptions.lock);
+    return n;
+}
+
+/* Function to stop the subscription thread and drop every subscription,
+** before the server's socket is closed.
+*/
+void tel_sub_stop(void) {
+    if (!subscriptions.running) {
+        return;
+    }
+    pthread_mutex_lock(&subscriptions.lock);
+    subscriptions.stop = 1;
+    pthread_cond_signal(&subscriptions.wake);
+    pthread_mutex_unlock(&subscriptions.lock);
+    pthread_join(subscriptions.thread, NULL);
+    pthread_cond_destroy(&subscriptions.wake);
+    memset(subscriptions.subs, 0, sizeof(subscriptions.subs));
+    subscriptions.running = 0;
+}
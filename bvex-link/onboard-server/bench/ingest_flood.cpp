@@ -0,0 +1,255 @@
+// Downlink send jitter while port 3000's onboard telemetry server is flooded
+// with samples.
+//
+// Runs the onboard telemetry recv server and the send server in process on
+// loopback, each on its own strand, with the io_service run by 1 and by
+// num_io_threads threads. Flood threads send encoded samples for 100
+// metrics as fast as they can while a large sample keeps the downlink busy.
+// Jitter is how late each downlink datagram arrives after the previous one,
+// compared to the time the previous one takes at the configured bps. The
+// burst allowance is 0, so the pacer never makes up for a late send.
+//
+// The ingest path logs every sample to stdout, so results go to stderr:
+//
+// Usage: bench_ingest_flood [seconds] [flood_threads] [num_io_threads] [bps]
+//        > /dev/null
+
+#include "../src/command.hpp"
+#include "../src/sample.hpp"
+#include "../src/server/onboard_telemetry_recv_server.hpp"
+#include "../src/server/send_server.hpp"
+#include "../src/telemetry.hpp"
+#include <algorithm>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <pb_encode.h>
+#include <pb_generated/sample.pb.h>
+#include <thread>
+#include <vector>
+
+using boost::asio::ip::udp;
+using bench_clock = std::chrono::steady_clock;
+
+constexpr size_t PKT_SIZE = 1000;
+constexpr unsigned int NUM_FLOOD_METRICS = 100;
+// arrivals in the first part of a run are not measured
+constexpr std::chrono::milliseconds WARM_UP = std::chrono::milliseconds(200);
+
+// Sample whose encoded data is a fixed byte string
+class BlobSample : public SampleData
+{
+  public:
+    BlobSample(size_t size)
+        : SampleData(SampleMetadata{.metric_id = "blob", .timestamp = 1.0f}),
+          data_(size, 0x5a)
+    {
+    }
+    std::vector<uint8_t> encode_data() override { return data_; }
+    std::vector<uint8_t> encode_response() override { return {}; }
+
+  private:
+    std::vector<uint8_t> data_;
+};
+
+struct Arrival {
+    bench_clock::time_point at;
+    size_t size;
+};
+
+struct RunResult {
+    double achieved_bps;
+    // how late each datagram arrived, in us
+    std::vector<double> lateness_us;
+    size_t num_flood_sent;
+};
+
+static void flood(unsigned short port, unsigned int flood_thread,
+                  const std::atomic<bool>& running, std::atomic<size_t>& sent)
+{
+    boost::asio::io_service io_service;
+    udp::socket socket(io_service, udp::endpoint(udp::v4(), 0));
+    udp::endpoint target(boost::asio::ip::address_v4::loopback(), port);
+    uint8_t buffer[Sample_size];
+    for(int32_t i = 0; running; i++) {
+        Sample sample = Sample_init_zero;
+        std::snprintf(sample.metric_id, sizeof(sample.metric_id),
+                      "flood_%u_%u", flood_thread,
+                      static_cast<unsigned int>(i) % NUM_FLOOD_METRICS);
+        sample.timestamp = 1.0f;
+        sample.which_data = Sample_primitive_tag;
+        sample.data.primitive.which_value = primitive_Primitive_int_val_tag;
+        sample.data.primitive.value.int_val = i;
+        pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
+        if(!pb_encode(&stream, Sample_fields, &sample)) {
+            std::fprintf(stderr, "Encoding flood sample failed\n");
+            return;
+        }
+        boost::system::error_code error;
+        socket.send_to(boost::asio::buffer(buffer, stream.bytes_written),
+                       target, 0, error);
+        sent++;
+    }
+}
+
+static RunResult run(double seconds, unsigned int flood_threads,
+                     unsigned int num_io_threads, size_t bps)
+{
+    Command command(bps, PKT_SIZE);
+    command.set_burst_size(0);
+    command.set_frame_format(SampleFrameFormat::binary);
+    // no acks come in, so let every chunk of the sample be in flight
+    command.set_window_size(1u << 20);
+    command.add_sample(std::make_unique<BlobSample>(
+        static_cast<size_t>(static_cast<double>(bps) / 8.0 * (seconds + 1))));
+    Telemetry telemetry(command);
+
+    boost::asio::io_service io_service;
+    udp::socket onboard_socket(
+        boost::asio::make_strand(io_service),
+        udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    onboard_socket.set_option(
+        boost::asio::socket_base::receive_buffer_size(8 * 1024 * 1024));
+    OnboardTelemetryRecvServer onboard_server(onboard_socket, command);
+
+    // downlink target, read by a plain blocking thread
+    boost::asio::io_service recv_io_service;
+    udp::socket downlink_socket(
+        recv_io_service,
+        udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    udp::endpoint target_endpoint = downlink_socket.local_endpoint();
+    udp::socket send_socket(
+        boost::asio::make_strand(io_service),
+        udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    unsigned short send_port = send_socket.local_endpoint().port();
+
+    std::vector<Arrival> arrivals;
+    arrivals.reserve(static_cast<size_t>(
+        static_cast<double>(bps) / 8.0 / PKT_SIZE * (seconds + 1) * 2));
+    std::thread recv_thread([&]() {
+        std::vector<uint8_t> buffer(65536);
+        udp::endpoint sender;
+        while(true) {
+            size_t size = downlink_socket.receive_from(
+                boost::asio::buffer(buffer), sender);
+            if(sender.port() != send_port) {
+                return; // stop datagram from the main thread
+            }
+            arrivals.push_back({.at = bench_clock::now(), .size = size});
+        }
+    });
+
+    SendServer send_server(send_socket, target_endpoint, telemetry, command);
+    std::vector<std::thread> io_threads;
+    for(unsigned int i = 0; i < num_io_threads; i++) {
+        io_threads.emplace_back([&io_service]() { io_service.run(); });
+    }
+
+    std::atomic<bool> flooding{true};
+    std::atomic<size_t> num_flood_sent{0};
+    std::vector<std::thread> flood_workers;
+    unsigned short onboard_port = onboard_socket.local_endpoint().port();
+    for(unsigned int i = 0; i < flood_threads; i++) {
+        flood_workers.emplace_back(flood, onboard_port, i,
+                                   std::cref(flooding),
+                                   std::ref(num_flood_sent));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    flooding = false;
+    for(std::thread& flood_thread : flood_workers) {
+        flood_thread.join();
+    }
+    io_service.stop();
+    for(std::thread& io_thread : io_threads) {
+        io_thread.join();
+    }
+    udp::socket stop_socket(recv_io_service, udp::endpoint(udp::v4(), 0));
+    stop_socket.send_to(boost::asio::buffer("stop", 4), target_endpoint);
+    recv_thread.join();
+
+    RunResult result = {.achieved_bps = 0.0,
+                        .lateness_us = {},
+                        .num_flood_sent = num_flood_sent};
+    if(arrivals.empty()) {
+        return result;
+    }
+    size_t first = 0;
+    while(first < arrivals.size() &&
+          arrivals[first].at - arrivals[0].at < WARM_UP) {
+        first++;
+    }
+    size_t bytes = 0;
+    for(size_t i = first + 1; i < arrivals.size(); i++) {
+        double interval_us = std::chrono::duration<double, std::micro>(
+                                 arrivals[i].at - arrivals[i - 1].at)
+                                 .count();
+        double expected_us = static_cast<double>(arrivals[i - 1].size) * 8.0 *
+                             1e6 / static_cast<double>(bps);
+        result.lateness_us.push_back(interval_us - expected_us);
+        bytes += arrivals[i - 1].size;
+    }
+    if(first + 1 < arrivals.size()) {
+        result.achieved_bps = static_cast<double>(bytes) * 8.0 /
+                              std::chrono::duration<double>(
+                                  arrivals.back().at - arrivals[first].at)
+                                  .count();
+    }
+    return result;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if(values.empty()) {
+        return 0.0;
+    }
+    size_t index =
+        static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(index),
+                     values.end());
+    return values[index];
+}
+
+int main(int argc, char* argv[])
+{
+    double seconds = 2.0;
+    unsigned int flood_threads = 2;
+    unsigned int num_io_threads = 4;
+    size_t bps = 10000000;
+    if(argc > 1) {
+        seconds = std::atof(argv[1]);
+    }
+    if(argc > 2) {
+        flood_threads = static_cast<unsigned int>(std::atoi(argv[2]));
+    }
+    if(argc > 3) {
+        num_io_threads = static_cast<unsigned int>(std::atoi(argv[3]));
+    }
+    if(argc > 4) {
+        bps = static_cast<size_t>(std::atoll(argv[4]));
+    }
+
+    std::fprintf(stderr, "%zu bps, %zu byte packets, %.1f s per run\n", bps,
+                 PKT_SIZE, seconds);
+    std::fprintf(stderr, "%10s %8s %14s %12s %12s %12s %12s\n", "io threads",
+                 "flood", "achieved bps", "p50 us", "p99 us", "max us",
+                 "flood pkts");
+    for(unsigned int io_threads : {1u, num_io_threads}) {
+        for(unsigned int flooders : {0u, flood_threads}) {
+            RunResult result = run(seconds, flooders, io_threads, bps);
+            std::fprintf(
+                stderr, "%10u %8u %14.0f %12.1f %12.1f %12.1f %12zu\n",
+                io_threads, flooders, result.achieved_bps,
+                percentile(result.lateness_us, 0.5),
+                percentile(result.lateness_us, 0.99),
+                percentile(result.lateness_us, 1.0), result.num_flood_sent);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Datagrams per second RecvServer takes in from a local sender.
+//
+// A sender thread sends datagrams of pkt_size bytes to a loopback RecvServer
+// as fast as it can for each batch size. The legacy row models the receive
+// path RecvServer replaced, one datagram per wakeup copied into a fresh
+// heap allocated vector for the handler.
+//
+// Usage: bench_recv_pps [pkt_size] [seconds]
+
+#include "../src/server/recv_server.hpp"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+using boost::asio::ip::udp;
+using bench_clock = std::chrono::steady_clock;
+
+struct RunResult {
+    double sent_pps;
+    double recvd_pps;
+};
+
+static RunResult run(unsigned int batch_size, bool legacy, size_t pkt_size,
+                     double seconds)
+{
+    boost::asio::io_service io_service;
+    udp::socket listen_socket(
+        io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    listen_socket.set_option(
+        boost::asio::socket_base::receive_buffer_size(8 * 1024 * 1024));
+    udp::endpoint target = listen_socket.local_endpoint();
+
+    size_t num_recvd = 0;
+    size_t bytes_recvd = 0;
+    RecvServer recv_server(
+        listen_socket,
+        [&num_recvd, &bytes_recvd, legacy](std::span<const uint8_t> message) {
+            if(legacy) {
+                auto copy = std::make_unique<std::vector<uint8_t>>(
+                    message.begin(), message.end());
+                bytes_recvd += copy->size();
+            } else {
+                bytes_recvd += message.size();
+            }
+            num_recvd++;
+        },
+        4096, batch_size);
+
+    std::atomic<bool> sending{true};
+    size_t num_sent = 0;
+    std::thread sender([&]() {
+        boost::asio::io_service sender_io_service;
+        udp::socket socket(sender_io_service, udp::endpoint(udp::v4(), 0));
+        std::vector<uint8_t> pkt(pkt_size, 0x5a);
+        boost::system::error_code error;
+        while(sending) {
+            socket.send_to(boost::asio::buffer(pkt), target, 0, error);
+            num_sent++;
+        }
+    });
+
+    boost::asio::steady_timer stop_timer(io_service);
+    stop_timer.expires_after(std::chrono::duration_cast<bench_clock::duration>(
+        std::chrono::duration<double>(seconds)));
+    stop_timer.async_wait(
+        [&io_service](const boost::system::error_code&) { io_service.stop(); });
+    bench_clock::time_point start = bench_clock::now();
+    io_service.run();
+    double elapsed =
+        std::chrono::duration<double>(bench_clock::now() - start).count();
+    sending = false;
+    sender.join();
+
+    return {.sent_pps = static_cast<double>(num_sent) / elapsed,
+            .recvd_pps = static_cast<double>(num_recvd) / elapsed};
+}
+
+int main(int argc, char* argv[])
+{
+    size_t pkt_size = 100;
+    double seconds = 1.0;
+    if(argc > 1) {
+        pkt_size = static_cast<size_t>(std::atoi(argv[1]));
+    }
+    if(argc > 2) {
+        seconds = std::atof(argv[2]);
+    }
+
+    std::printf("%zu byte datagrams, %.1f s per run\n", pkt_size, seconds);
+    std::printf("%12s %14s %14s\n", "batch", "sent pps", "recvd pps");
+    RunResult legacy = run(1, true, pkt_size, seconds);
+    std::printf("%12s %14.0f %14.0f\n", "legacy", legacy.sent_pps,
+                legacy.recvd_pps);
+    for(unsigned int batch_size : {1u, 8u, 32u, 64u}) {
+        RunResult result = run(batch_size, false, pkt_size, seconds);
+        std::printf("%12u %14.0f %14.0f\n", batch_size, result.sent_pps,
+                    result.recvd_pps);
+    }
+    return 0;
+}
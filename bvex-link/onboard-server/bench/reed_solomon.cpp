@@ -0,0 +1,92 @@
+// Reed-Solomon erasure code throughput for the block shapes used on the
+// downlink.
+//
+// For each (data, parity) shape, reports encode throughput over the data
+// bytes, and decode throughput when as many data chunks as there are parity
+// chunks are lost, the worst case the code can rebuild.
+//
+// Usage: bench_reed_solomon [chunk_size] [iterations]
+
+#include "../src/utils/reed_solomon.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <span>
+#include <vector>
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    size_t chunk_size = 1360;
+    unsigned int iterations = 200;
+    if(argc > 1) {
+        chunk_size = static_cast<size_t>(std::atoi(argv[1]));
+    }
+    if(argc > 2) {
+        iterations = static_cast<unsigned int>(std::atoi(argv[2]));
+    }
+    struct Shape {
+        unsigned int num_data;
+        unsigned int num_parity;
+    };
+    const Shape shapes[] = {{16, 2}, {32, 4}, {32, 8}, {64, 16}, {128, 32}};
+
+    std::printf("chunk size %zu bytes, %u iterations\n", chunk_size,
+                iterations);
+    std::printf("%6s %7s %14s %14s\n", "data", "parity", "encode MB/s",
+                "decode MB/s");
+    for(const Shape& shape : shapes) {
+        ReedSolomon reed_solomon(shape.num_data, shape.num_parity);
+        unsigned int num_shards = shape.num_data + shape.num_parity;
+        std::vector<std::vector<uint8_t>> shards(
+            num_shards, std::vector<uint8_t>(chunk_size));
+        for(unsigned int i = 0; i < shape.num_data; i++) {
+            for(size_t b = 0; b < chunk_size; b++) {
+                shards[i][b] = static_cast<uint8_t>(i * 131 + b * 7 + 17);
+            }
+        }
+        std::vector<std::span<const uint8_t>> data(
+            shards.begin(), shards.begin() + shape.num_data);
+        std::vector<std::span<uint8_t>> parity(
+            shards.begin() + shape.num_data, shards.end());
+        std::vector<std::span<uint8_t>> all(shards.begin(), shards.end());
+
+        auto start = bench_clock::now();
+        for(unsigned int i = 0; i < iterations; i++) {
+            reed_solomon.encode(data, parity);
+        }
+        double encode_seconds = seconds_since(start);
+
+        // lose the first num_parity data chunks
+        std::vector<bool> present(num_shards, true);
+        for(unsigned int i = 0; i < shape.num_parity; i++) {
+            present[i] = false;
+        }
+        unsigned int failures = 0;
+        start = bench_clock::now();
+        for(unsigned int i = 0; i < iterations; i++) {
+            if(!reed_solomon.reconstruct(all, present)) {
+                failures++;
+            }
+        }
+        double decode_seconds = seconds_since(start);
+
+        double data_mb = static_cast<double>(chunk_size * shape.num_data) *
+                         iterations / 1e6;
+        std::printf("%6u %7u %14.1f %14.1f\n", shape.num_data,
+                    shape.num_parity, data_mb / encode_seconds,
+                    data_mb / decode_seconds);
+        if(failures > 0) {
+            std::printf("%u decodes failed\n", failures);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Compares the JSON and binary sample frame encoders.
+//
+// For each payload size, reports encode throughput and bytes on wire per
+// frame, plus binary decode throughput.
+//
+// Usage: bench_sample_frame [iterations]
+
+#include <codec/downlink-tm-enc/binary_sample_frame.hpp>
+#include <codec/downlink-tm-enc/sample_frame.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+using bench_clock = std::chrono::steady_clock;
+
+static SampleFrameData make_frame(const std::vector<uint8_t>& payload,
+                                  unsigned int seqnum)
+{
+    return SampleFrameData{.metric_id = "starcam_image",
+                           .timestamp = 1718000000.0f,
+                           .data_type = "file",
+                           .sample_id = 1234,
+                           .num_segments = 4096,
+                           .seqnum = seqnum,
+                           .data = payload};
+}
+
+static double seconds_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int iterations = 20000;
+    if(argc > 1) {
+        iterations = static_cast<unsigned int>(std::atoi(argv[1]));
+    }
+    const size_t payload_sizes[] = {8, 64, 256, 1024, 1400};
+
+    std::printf("%8s %12s %12s %14s %14s %14s\n", "payload", "json B/frm",
+                "bin B/frm", "json MB/s", "bin enc MB/s", "bin dec MB/s");
+    for(size_t payload_size : payload_sizes) {
+        std::vector<uint8_t> payload(payload_size);
+        for(size_t i = 0; i < payload_size; i++) {
+            payload[i] = static_cast<uint8_t>(i * 31 + 7);
+        }
+        SampleFrameData frame = make_frame(payload, 1);
+        size_t sink = 0;
+
+        auto start = bench_clock::now();
+        size_t json_bytes = 0;
+        for(unsigned int i = 0; i < iterations; i++) {
+            frame.seqnum = i;
+            std::vector<uint8_t> encoded = encode_sample_frame(frame);
+            json_bytes += encoded.size();
+        }
+        double json_seconds = seconds_since(start);
+
+        MetricIdInterner interner;
+        start = bench_clock::now();
+        size_t binary_bytes = 0;
+        for(unsigned int i = 0; i < iterations; i++) {
+            frame.seqnum = i;
+            std::vector<uint8_t> encoded =
+                encode_binary_sample_frame(frame, interner);
+            binary_bytes += encoded.size();
+        }
+        double binary_seconds = seconds_since(start);
+
+        // decode a frame that carries the metric id so the table is primed,
+        // then time decoding of a typical unannounced frame
+        MetricIdTable table;
+        MetricIdInterner decode_interner;
+        frame.seqnum = 0;
+        decode_binary_sample_frame(
+            encode_binary_sample_frame(frame, decode_interner), table);
+        frame.seqnum = 1;
+        std::vector<uint8_t> to_decode =
+            encode_binary_sample_frame(frame, decode_interner);
+        start = bench_clock::now();
+        for(unsigned int i = 0; i < iterations; i++) {
+            auto decoded = decode_binary_sample_frame(to_decode, table);
+            sink += decoded ? decoded->data.size() : 0;
+        }
+        double decode_seconds = seconds_since(start);
+
+        double payload_mb =
+            static_cast<double>(payload_size) * iterations / 1e6;
+        std::printf("%8zu %12.1f %12.1f %14.1f %14.1f %14.1f\n", payload_size,
+                    static_cast<double>(json_bytes) / iterations,
+                    static_cast<double>(binary_bytes) / iterations,
+                    payload_mb / json_seconds, payload_mb / binary_seconds,
+                    payload_mb / decode_seconds);
+        if(sink == 1) {
+            std::printf("\n"); // keep the decode loop from being elided
+        }
+    }
+    return 0;
+}
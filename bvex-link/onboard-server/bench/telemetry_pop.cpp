@@ -0,0 +1,123 @@
+// Sweeps the number of metrics against the latency of picking the next
+// downlink packet.
+//
+// Compares the deficit round robin scheduler used by Telemetry::pop with a
+// model of the round robin it replaced, which visited every metric in turn
+// through a string keyed std::map and recursed past idle ones.
+//
+// Usage: bench_telemetry_pop [pops_per_run]
+
+#include "../src/utils/drr_scheduler.hpp"
+#include "../src/utils/outgoing_frame.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+using bench_clock = std::chrono::steady_clock;
+
+// fraction of metrics that have something to send
+constexpr size_t ACTIVE_ONE_IN = 20;
+constexpr size_t PKT_SIZE = 1000;
+
+static bool is_busy(size_t metric) { return metric % ACTIVE_ONE_IN == 0; }
+
+static bool write_pkt(size_t metric, OutgoingFrame& frame)
+{
+    if(!is_busy(metric)) {
+        return false;
+    }
+    frame.header.resize(PKT_SIZE);
+    return true;
+}
+
+// Model of the replaced MetricIterator + metric_token_counts_ round robin
+class LegacyRoundRobin
+{
+  public:
+    LegacyRoundRobin(size_t num_metrics)
+    {
+        for(size_t i = 0; i < num_metrics; i++) {
+            std::string id = "metric_id_" + std::to_string(i);
+            metrics_.emplace(id, i);
+        }
+        it_ = metrics_.begin();
+    }
+
+    bool pop(OutgoingFrame& frame, unsigned int retry_depth = 0)
+    {
+        auto current = it_;
+        if(++it_ == metrics_.end()) {
+            it_ = metrics_.begin();
+        }
+        std::string metric_id = current->first;
+        if(token_counts_.find(metric_id) == token_counts_.end()) {
+            token_counts_[metric_id] = 1;
+        }
+        int& tokens = token_counts_[metric_id];
+        token_counts_[metric_id]++;
+        if(tokens >= 1 && write_pkt(current->second, frame)) {
+            tokens = 0;
+            return true;
+        }
+        tokens++;
+        if(retry_depth < metrics_.size()) {
+            return pop(frame, retry_depth + 1);
+        }
+        return false;
+    }
+
+  private:
+    std::map<std::string, size_t> metrics_;
+    std::map<std::string, size_t>::iterator it_;
+    std::map<std::string, int> token_counts_;
+};
+
+static double ns_per_pop(bench_clock::time_point start, unsigned int pops)
+{
+    return std::chrono::duration<double, std::nano>(bench_clock::now() -
+                                                    start)
+               .count() /
+           pops;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int pops = 100000;
+    if(argc > 1) {
+        pops = static_cast<unsigned int>(std::atoi(argv[1]));
+    }
+    const size_t metric_counts[] = {10, 100, 1000, 5000};
+
+    std::printf("1 in %zu metrics active, %u pops per run\n", ACTIVE_ONE_IN,
+                pops);
+    std::printf("%8s %16s %16s\n", "metrics", "legacy ns/pop", "drr ns/pop");
+    for(size_t num_metrics : metric_counts) {
+        OutgoingFrame frame;
+
+        LegacyRoundRobin legacy(num_metrics);
+        auto start = bench_clock::now();
+        for(unsigned int i = 0; i < pops; i++) {
+            legacy.pop(frame);
+        }
+        double legacy_ns = ns_per_pop(start, pops);
+
+        // idle metrics are visited once, then stay off the active list
+        // until a new sample activates them
+        DrrScheduler scheduler(PKT_SIZE);
+        for(size_t i = 0; i < num_metrics; i++) {
+            scheduler.activate(scheduler.add_flow());
+        }
+        start = bench_clock::now();
+        for(unsigned int i = 0; i < pops; i++) {
+            scheduler.pop(frame, write_pkt);
+        }
+        double drr_ns = ns_per_pop(start, pops);
+
+        std::printf("%8zu %16.1f %16.1f\n", num_metrics, legacy_ns, drr_ns);
+    }
+    return 0;
+}
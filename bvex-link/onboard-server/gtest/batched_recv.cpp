@@ -0,0 +1,65 @@
+#include "../src/server/recv_server.hpp"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <span>
+#include <string>
+#include <vector>
+
+using boost::asio::ip::udp;
+using namespace std::chrono_literals;
+
+// Send num_msgs numbered datagrams, plus one too large for the ring buffers,
+// to a RecvServer with the given batch size and return what it handled
+static std::vector<std::string> recv_all(unsigned int batch_size,
+                                         unsigned int num_msgs)
+{
+    boost::asio::io_service io_service;
+    udp::socket listen_socket(
+        io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    listen_socket.set_option(
+        boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+    udp::socket send_socket(io_service, udp::endpoint(udp::v4(), 0));
+
+    std::vector<std::string> recvd;
+    RecvServer recv_server(
+        listen_socket,
+        [&recvd, &io_service, num_msgs](std::span<const uint8_t> message) {
+            recvd.emplace_back(message.begin(), message.end());
+            if(recvd.size() == num_msgs) {
+                io_service.stop();
+            }
+        },
+        64, batch_size);
+
+    // queued before the server first runs, so the first batch drains them
+    for(unsigned int i = 0; i < num_msgs; i++) {
+        std::string msg = "message " + std::to_string(i);
+        send_socket.send_to(boost::asio::buffer(msg),
+                            listen_socket.local_endpoint());
+        if(i == num_msgs / 2) {
+            std::vector<uint8_t> too_large(100, 0);
+            send_socket.send_to(boost::asio::buffer(too_large),
+                                listen_socket.local_endpoint());
+        }
+    }
+    boost::asio::steady_timer timeout(io_service);
+    timeout.expires_after(5s);
+    timeout.async_wait(
+        [&io_service](const boost::system::error_code&) { io_service.stop(); });
+    io_service.run();
+    return recvd;
+}
+
+TEST(BatchedRecvTest, EveryDatagramHandledInOrder)
+{
+    for(unsigned int batch_size : {1u, 8u, 32u}) {
+        std::vector<std::string> recvd = recv_all(batch_size, 100);
+        ASSERT_EQ(recvd.size(), 100u) << "batch size " << batch_size;
+        for(unsigned int i = 0; i < recvd.size(); i++) {
+            EXPECT_EQ(recvd[i], "message " + std::to_string(i))
+                << "batch size " << batch_size;
+        }
+    }
+}
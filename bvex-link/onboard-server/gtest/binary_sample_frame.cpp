@@ -0,0 +1,159 @@
+#include <codec/downlink-tm-enc/binary_sample_frame.hpp>
+#include <codec/downlink-tm-enc/frame_encoder.hpp>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static SampleFrameData make_frame(std::string_view metric_id,
+                                  unsigned int seqnum,
+                                  std::span<const uint8_t> data)
+{
+    return SampleFrameData{.metric_id = metric_id,
+                           .timestamp = 1234.5f,
+                           .data_type = "file",
+                           .sample_id = 300,
+                           .num_segments = 1000,
+                           .seqnum = seqnum,
+                           .data = data};
+}
+
+static const std::vector<uint8_t> ONE_BYTE = {1};
+
+TEST(BinarySampleFrameTest, RoundTrip)
+{
+    MetricIdInterner interner;
+    MetricIdTable table;
+    std::vector<uint8_t> payload = {0, 1, 2, 255, 254, 128, 127};
+
+    auto encoded = encode_binary_sample_frame(
+        make_frame("starcam_image", 0, payload), interner);
+    auto decoded = decode_binary_sample_frame(encoded, table);
+
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->metric_id, "starcam_image");
+    EXPECT_FLOAT_EQ(decoded->timestamp, 1234.5f);
+    EXPECT_EQ(decoded->data_type, "file");
+    EXPECT_EQ(decoded->sample_id, 300u);
+    EXPECT_EQ(decoded->num_segments, 1000u);
+    EXPECT_EQ(decoded->seqnum, 0u);
+    EXPECT_EQ(std::vector<uint8_t>(decoded->data.begin(), decoded->data.end()),
+              payload);
+}
+
+TEST(BinarySampleFrameTest, CustomDataTypeRoundTrip)
+{
+    MetricIdInterner interner;
+    MetricIdTable table;
+    SampleFrameData frame = make_frame("gps_lat", 0, ONE_BYTE);
+    frame.data_type = "histogram";
+
+    // decoded frame views into encoded, so it must stay alive
+    auto encoded = encode_binary_sample_frame(frame, interner);
+    auto decoded = decode_binary_sample_frame(encoded, table);
+
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->data_type, "histogram");
+}
+
+TEST(BinarySampleFrameTest, StreamedFileHasItsOwnCode)
+{
+    MetricIdInterner interner;
+    MetricIdTable table;
+    SampleFrameData frame = make_frame("starcam_image", 0, ONE_BYTE);
+    frame.data_type = "file_stream";
+
+    auto encoded = encode_binary_sample_frame(frame, interner);
+    auto decoded = decode_binary_sample_frame(encoded, table);
+
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->data_type, "file_stream");
+    // a known data type is a code in the flags, not a string in the header
+    SampleFrameData custom = make_frame("starcam_image", 0, ONE_BYTE);
+    custom.data_type = "file_strean";
+    MetricIdInterner custom_interner;
+    EXPECT_LT(encoded.size(),
+              encode_binary_sample_frame(custom, custom_interner).size());
+}
+
+TEST(BinarySampleFrameTest, UnannouncedHandleIsDropped)
+{
+    MetricIdInterner interner(16);
+    MetricIdTable table;
+
+    // first frame announces the metric id, but the receiver misses it
+    encode_binary_sample_frame(make_frame("gps_lat", 0, ONE_BYTE), interner);
+    auto encoded = encode_binary_sample_frame(
+        make_frame("gps_lat", 1, ONE_BYTE), interner);
+
+    EXPECT_FALSE(decode_binary_sample_frame(encoded, table).has_value());
+}
+
+TEST(BinarySampleFrameTest, MetricIdIsReannounced)
+{
+    const unsigned int announce_interval = 4;
+    MetricIdInterner interner(announce_interval);
+    MetricIdTable table;
+
+    // receiver misses every frame until the periodic re-announcement
+    for(unsigned int seqnum = 0; seqnum <= announce_interval; seqnum++) {
+        encode_binary_sample_frame(
+            make_frame("gps_lat", seqnum + 1, ONE_BYTE), interner);
+    }
+    auto encoded = encode_binary_sample_frame(
+        make_frame("gps_lat", 99, ONE_BYTE), interner);
+    auto decoded = decode_binary_sample_frame(encoded, table);
+
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->metric_id, "gps_lat");
+}
+
+TEST(BinarySampleFrameTest, HeaderIsCompact)
+{
+    MetricIdInterner interner;
+    encode_binary_sample_frame(make_frame("starcam_image", 0, {}), interner);
+
+    // unannounced frame: 6 byte fixed header, 1 byte handle, 2 byte
+    // sample_id, 2 byte num_segments, 1 byte seqnum, then payload
+    std::vector<uint8_t> payload(1000, 0xAB);
+    auto encoded =
+        encode_binary_sample_frame(make_frame("starcam_image", 5, payload),
+                                   interner);
+    EXPECT_EQ(encoded.size(), 12 + payload.size());
+}
+
+TEST(BinarySampleFrameTest, TruncatedFrameIsRejected)
+{
+    MetricIdInterner interner;
+    MetricIdTable table;
+    auto encoded =
+        encode_binary_sample_frame(make_frame("gps_lat", 0, {}), interner);
+
+    for(size_t size = 0; size < encoded.size(); size++) {
+        std::span<const uint8_t> truncated(encoded.data(), size);
+        EXPECT_FALSE(decode_binary_sample_frame(truncated, table).has_value())
+            << "size " << size;
+    }
+}
+
+TEST(BinarySampleFrameTest, EncoderSelectsFormat)
+{
+    const std::vector<uint8_t> payload = {1, 2, 3};
+    SampleFrameEncoder encoder;
+    std::vector<uint8_t> json_header;
+    auto json_payload =
+        encoder.encode(make_frame("gps_lat", 0, payload), json_header);
+    EXPECT_EQ(json_header.front(), '{');
+    EXPECT_TRUE(json_payload.empty());
+
+    encoder.set_format(SampleFrameFormat::binary);
+    std::vector<uint8_t> binary_header;
+    auto binary_payload =
+        encoder.encode(make_frame("gps_lat", 0, payload), binary_header);
+    EXPECT_EQ(binary_header.front(), BINARY_SAMPLE_FRAME_MAGIC);
+    EXPECT_EQ(binary_payload.data(), payload.data());
+    EXPECT_LT(binary_header.size() + binary_payload.size(), json_header.size());
+}
@@ -0,0 +1,118 @@
+#include "../src/command.hpp"
+#include "../src/sample.hpp"
+#include "../src/telemetry.hpp"
+#include "../src/utils/outgoing_frame.hpp"
+#include <atomic>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr unsigned int NUM_INGEST_THREADS = 4;
+constexpr unsigned int METRICS_PER_THREAD = 50;
+constexpr int32_t SAMPLES_PER_METRIC = 200;
+
+static std::string metric_name(unsigned int thread, unsigned int metric)
+{
+    return "metric_" + std::to_string(thread) + "_" + std::to_string(metric);
+}
+
+// Ingest, drain and requests run on their own threads, as they do when the
+// io_service is run by a thread pool
+TEST(ConcurrentCommandTest, IngestWhileDrainingAndAnswering)
+{
+    Command command(100000000, 1400);
+    std::atomic<unsigned int> num_ingesting{NUM_INGEST_THREADS};
+
+    std::vector<std::thread> ingest_threads;
+    for(unsigned int t = 0; t < NUM_INGEST_THREADS; t++) {
+        ingest_threads.emplace_back([&command, &num_ingesting, t]() {
+            for(int32_t value = 0; value < SAMPLES_PER_METRIC; value++) {
+                for(unsigned int m = 0; m < METRICS_PER_THREAD; m++) {
+                    command.add_sample(std::make_unique<PrimitiveSample>(
+                        SampleMetadata{.metric_id = metric_name(t, m),
+                                       .timestamp = 1.0f},
+                        value));
+                }
+            }
+            num_ingesting--;
+        });
+    }
+
+    size_t num_frames = 0;
+    std::thread drain_thread([&command, &num_ingesting, &num_frames]() {
+        Telemetry telemetry(command);
+        OutgoingFrame frame;
+        while(num_ingesting > 0) {
+            if(telemetry.pop(frame)) {
+                num_frames++;
+            }
+        }
+        while(telemetry.pop(frame)) {
+            num_frames++;
+        }
+    });
+
+    size_t num_responses = 0;
+    std::thread request_thread([&command, &num_ingesting, &num_responses]() {
+        while(num_ingesting > 0) {
+            if(command.get_latest_sample_response(metric_name(0, 0))) {
+                num_responses++;
+            }
+        }
+    });
+
+    for(std::thread& ingest_thread : ingest_threads) {
+        ingest_thread.join();
+    }
+    drain_thread.join();
+    request_thread.join();
+
+    ASSERT_EQ(command.get_num_metrics(),
+              NUM_INGEST_THREADS * METRICS_PER_THREAD);
+    // every metric was activated by its first sample, and no ack came in
+    // to let it move on to a later one
+    EXPECT_GE(num_frames, NUM_INGEST_THREADS * METRICS_PER_THREAD);
+    EXPECT_GT(num_responses, 0u);
+
+    PrimitiveSample last_sample(
+        SampleMetadata{.metric_id = "", .timestamp = 1.0f},
+        SAMPLES_PER_METRIC - 1);
+    for(unsigned int t = 0; t < NUM_INGEST_THREADS; t++) {
+        for(unsigned int m = 0; m < METRICS_PER_THREAD; m++) {
+            std::optional<std::vector<uint8_t>> response =
+                command.get_latest_sample_response(metric_name(t, m));
+            ASSERT_TRUE(response.has_value()) << metric_name(t, m);
+            EXPECT_EQ(*response, last_sample.encode_response())
+                << metric_name(t, m);
+        }
+    }
+}
+
+TEST(ConcurrentCommandTest, NewSampleWhileBusyIsSentAfterAck)
+{
+    Command command(100000000, 1400);
+    Telemetry telemetry(command);
+    OutgoingFrame frame;
+    SampleMetadata metadata = {.metric_id = "gps_lat", .timestamp = 1.0f};
+
+    command.add_sample(std::make_unique<PrimitiveSample>(metadata, 1));
+    ASSERT_TRUE(telemetry.pop(frame));
+    // the first sample is still in flight, so the second waits in the
+    // metric's slot, and a third replaces it there
+    command.add_sample(std::make_unique<PrimitiveSample>(metadata, 2));
+    command.add_sample(std::make_unique<PrimitiveSample>(metadata, 3));
+    EXPECT_FALSE(telemetry.pop(frame));
+
+    MetricHandle handle = *command.find_metric("gps_lat");
+    command.handle_ack(
+        Ack{.metric = handle, .sample_id = 1, .ranges = {{0, 0}}});
+    ASSERT_TRUE(telemetry.pop(frame));
+    command.handle_ack(
+        Ack{.metric = handle, .sample_id = 2, .ranges = {{0, 0}}});
+    // only the latest sample is kept, so nothing is left to send
+    EXPECT_FALSE(telemetry.pop(frame));
+}
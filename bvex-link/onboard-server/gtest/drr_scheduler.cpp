@@ -0,0 +1,121 @@
+#include "../src/utils/drr_scheduler.hpp"
+#include "../src/utils/outgoing_frame.hpp"
+#include <cstddef>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <vector>
+
+// Fake metric source: every flow has packets_left packets of pkt_size bytes
+struct FakeFlows {
+    std::vector<size_t> pkt_sizes;
+    std::vector<int> packets_left;
+    std::vector<size_t> bytes_sent;
+    std::vector<int> calls;
+
+    FakeFlows(size_t num_flows, size_t pkt_size, int packets)
+        : pkt_sizes(num_flows, pkt_size), packets_left(num_flows, packets),
+          bytes_sent(num_flows, 0), calls(num_flows, 0)
+    {
+    }
+
+    bool get_pkt(FlowId flow, OutgoingFrame& frame)
+    {
+        calls[flow]++;
+        if(packets_left[flow] == 0) {
+            return false;
+        }
+        packets_left[flow]--;
+        frame.header.assign(pkt_sizes[flow], 0);
+        frame.payload = {};
+        bytes_sent[flow] += pkt_sizes[flow];
+        return true;
+    }
+};
+
+static bool pop(DrrScheduler& scheduler, FakeFlows& flows,
+                OutgoingFrame& frame)
+{
+    return scheduler.pop(frame, [&flows](FlowId flow, OutgoingFrame& f) {
+        return flows.get_pkt(flow, f);
+    });
+}
+
+TEST(DrrSchedulerTest, IdleFlowsAreNeverVisited)
+{
+    DrrScheduler scheduler(1000);
+    FakeFlows flows(1000, 100, -1);
+    for(size_t i = 0; i < 1000; i++) {
+        scheduler.add_flow();
+    }
+    scheduler.activate(10);
+    scheduler.activate(500);
+
+    OutgoingFrame frame;
+    for(int i = 0; i < 100; i++) {
+        ASSERT_TRUE(pop(scheduler, flows, frame));
+    }
+    for(size_t flow = 0; flow < 1000; flow++) {
+        if(flow != 10 && flow != 500) {
+            EXPECT_EQ(flows.calls[flow], 0) << "flow " << flow;
+        }
+    }
+    EXPECT_EQ(flows.bytes_sent[10], flows.bytes_sent[500]);
+}
+
+TEST(DrrSchedulerTest, SharesFollowTokenThreshold)
+{
+    DrrScheduler scheduler(400);
+    FakeFlows flows(2, 100, -1);
+    FlowId fast = scheduler.add_flow(1);
+    FlowId slow = scheduler.add_flow(4);
+    scheduler.activate(fast);
+    scheduler.activate(slow);
+
+    OutgoingFrame frame;
+    for(int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(pop(scheduler, flows, frame));
+    }
+    EXPECT_EQ(flows.bytes_sent[fast], 4 * flows.bytes_sent[slow]);
+}
+
+TEST(DrrSchedulerTest, PacketsLargerThanQuantumShareFairly)
+{
+    DrrScheduler scheduler(100);
+    FakeFlows flows(2, 1000, -1);
+    flows.pkt_sizes[1] = 250;
+    scheduler.activate(scheduler.add_flow());
+    scheduler.activate(scheduler.add_flow());
+
+    OutgoingFrame frame;
+    for(int i = 0; i < 500; i++) {
+        ASSERT_TRUE(pop(scheduler, flows, frame));
+    }
+    // equal weights get equal bytes, within one packet
+    long difference = static_cast<long>(flows.bytes_sent[0]) -
+                      static_cast<long>(flows.bytes_sent[1]);
+    EXPECT_LE(std::abs(difference), 1000);
+}
+
+TEST(DrrSchedulerTest, EmptyFlowIsDeactivatedAndReactivated)
+{
+    DrrScheduler scheduler(1000);
+    FakeFlows flows(1, 100, 2);
+    FlowId flow = scheduler.add_flow();
+    scheduler.activate(flow);
+
+    OutgoingFrame frame;
+    EXPECT_TRUE(pop(scheduler, flows, frame));
+    EXPECT_TRUE(pop(scheduler, flows, frame));
+    EXPECT_FALSE(pop(scheduler, flows, frame));
+    EXPECT_FALSE(scheduler.is_active(flow));
+    EXPECT_EQ(scheduler.get_num_active(), 0u);
+
+    // nothing active, so get_pkt is not called again
+    int calls = flows.calls[flow];
+    EXPECT_FALSE(pop(scheduler, flows, frame));
+    EXPECT_EQ(flows.calls[flow], calls);
+
+    flows.packets_left[flow] = 1;
+    scheduler.activate(flow);
+    EXPECT_TRUE(pop(scheduler, flows, frame));
+}
@@ -0,0 +1,321 @@
+#include "../src/sample.hpp"
+#include "../src/utils/chunker.hpp"
+#include "../src/utils/mapped_file.hpp"
+#include "../src/utils/outgoing_frame.hpp"
+#include "../src/utils/sample_transmitter.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using json = nlohmann::json;
+
+// File sample that keeps the mapping it hands to the transmitter, so a test
+// can see what has been released
+class WatchedFileSample : public FileSample
+{
+  public:
+    using FileSample::FileSample;
+
+    std::shared_ptr<MappedFile> map_file() override
+    {
+        mapped = FileSample::map_file();
+        return mapped;
+    }
+
+    std::shared_ptr<MappedFile> mapped;
+};
+
+class FileStreamTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        file_path_ = std::filesystem::temp_directory_path() /
+                     "onboard_server_file_stream.bin";
+        file_bytes_.resize(FILE_SIZE);
+        for(size_t i = 0; i < FILE_SIZE; i++) {
+            file_bytes_[i] = static_cast<uint8_t>(i * 131 + 17);
+        }
+        std::ofstream file(file_path_, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(file_bytes_.data()),
+                   static_cast<std::streamsize>(file_bytes_.size()));
+    }
+
+    void TearDown() override { std::filesystem::remove(file_path_); }
+
+    // not a multiple of the chunk size, so the last chunk is short
+    static constexpr size_t FILE_SIZE = 300 * 1024 + 123;
+    static constexpr size_t CHUNK_SIZE = 1000;
+    std::filesystem::path file_path_;
+    std::vector<uint8_t> file_bytes_;
+};
+
+TEST_F(FileStreamTest, MissingFileIsNotMapped)
+{
+    EXPECT_EQ(MappedFile::open(file_path_.string() + ".missing"), nullptr);
+}
+
+TEST_F(FileStreamTest, EmptyFileMapsToNoBytes)
+{
+    std::filesystem::path empty_path = file_path_.string() + ".empty";
+    std::ofstream(empty_path, std::ios::binary).close();
+    std::shared_ptr<MappedFile> file = MappedFile::open(empty_path.string());
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(file->bytes().size(), 0u);
+    std::filesystem::remove(empty_path);
+}
+
+TEST_F(FileStreamTest, HeaderChunkThenFileChunks)
+{
+    FileSample sample(
+        SampleMetadata{.metric_id = "starcam_image", .timestamp = 1.0f},
+        file_path_.string(), "png");
+    std::shared_ptr<MappedFile> file = sample.map_file();
+    ASSERT_NE(file, nullptr);
+    Chunker chunker(sample.encode_header(file->bytes().size()), file,
+                    CHUNK_SIZE);
+
+    Chunk header_chunk = chunker.get_chunk(0);
+    EXPECT_EQ(header_chunk.offset, 0u);
+    json header = json::parse(header_chunk.data);
+    EXPECT_EQ(header["extension"], "png");
+    EXPECT_EQ(header["size"], FILE_SIZE);
+
+    ASSERT_EQ(chunker.get_num_chunks(),
+              1 + (FILE_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    EXPECT_EQ(chunker.get_data_size(), header_chunk.data.size() + FILE_SIZE);
+
+    // the ground puts every chunk at its offset and gets the header followed
+    // by the file
+    std::vector<uint8_t> reassembled(chunker.get_data_size());
+    for(SeqNum seqnum = 0; seqnum < chunker.get_num_chunks(); seqnum++) {
+        Chunk chunk = chunker.get_chunk(seqnum);
+        ASSERT_LE(chunk.data.size(), CHUNK_SIZE);
+        ASSERT_LE(chunk.offset + chunk.data.size(), reassembled.size());
+        std::copy(chunk.data.begin(), chunk.data.end(),
+                  reassembled.begin() + static_cast<long>(chunk.offset));
+    }
+    long header_size = static_cast<long>(header_chunk.data.size());
+    std::vector<uint8_t> file_part(reassembled.begin() + header_size,
+                                   reassembled.end());
+    EXPECT_EQ(file_part, file_bytes_);
+}
+
+TEST_F(FileStreamTest, AckedChunksAreReleased)
+{
+    auto sample = std::make_shared<WatchedFileSample>(
+        SampleMetadata{.metric_id = "starcam_image", .timestamp = 1.0f},
+        file_path_.string(), "png");
+    std::shared_ptr<SampleData> next_sample = sample;
+    std::string data_type;
+    SampleTransmitter transmitter(
+        [&next_sample]() { return std::exchange(next_sample, nullptr); },
+        // the transmitter takes 40 bytes of IP and UDP overhead off
+        []() { return CHUNK_SIZE + 40; }, []() { return 64u; },
+        [&data_type](const SampleFrameData& sample_frame_data,
+                     std::vector<uint8_t>& header) {
+            data_type = sample_frame_data.data_type;
+            header.clear();
+            return sample_frame_data.data;
+        },
+        "starcam_image");
+    transmitter.set_stream_files(true);
+    ArqClock::time_point now{};
+    OutgoingFrame frame;
+
+    // the window is sent, header chunk first
+    for(SeqNum seqnum = 0; seqnum < 64; seqnum++) {
+        ASSERT_TRUE(transmitter.get_pkt(frame, now));
+    }
+    EXPECT_FALSE(transmitter.get_pkt(frame, now));
+    EXPECT_EQ(data_type, "file_stream");
+    ASSERT_NE(sample->mapped, nullptr);
+    EXPECT_EQ(sample->mapped->get_released_until(), 0u);
+
+    transmitter.handle_ack({{.first = 0, .last = 63}}, 1, now);
+    // file chunks 0 to 62 were acked, released down to a page boundary
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    EXPECT_EQ(sample->mapped->get_released_until(),
+              63 * CHUNK_SIZE / page_size * page_size);
+
+    // chunks after the released pages still read the file's bytes
+    ASSERT_TRUE(transmitter.get_pkt(frame, now));
+    std::span<const uint8_t> expected(file_bytes_.data() + 63 * CHUNK_SIZE,
+                                      CHUNK_SIZE);
+    EXPECT_TRUE(std::equal(frame.payload.begin(), frame.payload.end(),
+                           expected.begin(), expected.end()));
+}
+
+TEST_F(FileStreamTest, TruncatedFileIsDropped)
+{
+    std::filesystem::path next_path = file_path_.string() + ".next";
+    std::filesystem::copy_file(
+        file_path_, next_path,
+        std::filesystem::copy_options::overwrite_existing);
+    std::vector<std::shared_ptr<SampleData>> samples = {
+        std::make_shared<FileSample>(
+            SampleMetadata{.metric_id = "starcam_image", .timestamp = 1.0f},
+            file_path_.string(), "png"),
+        std::make_shared<FileSample>(
+            SampleMetadata{.metric_id = "starcam_image", .timestamp = 2.0f},
+            next_path.string(), "png")};
+    size_t next_sample = 0;
+    SampleId sample_id = 0;
+    SampleTransmitter transmitter(
+        [&samples, &next_sample]() -> std::shared_ptr<SampleData> {
+            if(next_sample == samples.size()) {
+                return nullptr;
+            }
+            return samples[next_sample++];
+        },
+        []() { return CHUNK_SIZE + 40; }, []() { return 64u; },
+        [&sample_id](const SampleFrameData& sample_frame_data,
+                     std::vector<uint8_t>& header) {
+            sample_id = sample_frame_data.sample_id;
+            // touch every byte, as the JSON frame encoding does, so a read
+            // past the end of the truncated file would raise SIGBUS
+            header.assign(sample_frame_data.data.begin(),
+                          sample_frame_data.data.end());
+            return std::span<const uint8_t>();
+        },
+        "starcam_image");
+    transmitter.set_stream_files(true);
+    ArqClock::time_point now{};
+    OutgoingFrame frame;
+
+    for(int i = 0; i < 32; i++) {
+        ASSERT_TRUE(transmitter.get_pkt(frame, now));
+    }
+    EXPECT_EQ(sample_id, 1u);
+
+    // the producer rewrites the file while half the window is still unsent
+    std::filesystem::resize_file(file_path_, 0);
+    ASSERT_TRUE(transmitter.get_pkt(frame, now));
+    EXPECT_EQ(sample_id, 2u);
+    // acks of the dropped sample are ignored
+    transmitter.handle_ack({{.first = 0, .last = 31}}, 1, now);
+
+    // the next sample is sent whole
+    std::vector<uint8_t> file_part;
+    for(int i = 0; i < 63; i++) {
+        ASSERT_TRUE(transmitter.get_pkt(frame, now));
+        file_part.insert(file_part.end(), frame.header.begin(),
+                         frame.header.end());
+    }
+    EXPECT_TRUE(std::equal(file_part.begin(), file_part.end(),
+                           file_bytes_.begin()));
+    std::filesystem::remove(next_path);
+}
+
+TEST_F(FileStreamTest, FilesAreSentWholeUnlessStreaming)
+{
+    std::shared_ptr<SampleData> next_sample = std::make_shared<FileSample>(
+        SampleMetadata{.metric_id = "starcam_image", .timestamp = 1.0f},
+        file_path_.string(), "png");
+    std::string data_type;
+    unsigned int num_segments = 0;
+    SampleTransmitter transmitter(
+        [&next_sample]() { return std::exchange(next_sample, nullptr); },
+        []() { return CHUNK_SIZE + 40; }, []() { return 64u; },
+        [&data_type, &num_segments](const SampleFrameData& sample_frame_data,
+                                    std::vector<uint8_t>& header) {
+            data_type = sample_frame_data.data_type;
+            num_segments = sample_frame_data.num_segments;
+            header.clear();
+            return sample_frame_data.data;
+        },
+        "starcam_image");
+    ArqClock::time_point now{};
+    OutgoingFrame frame;
+
+    ASSERT_TRUE(transmitter.get_pkt(frame, now));
+    EXPECT_EQ(data_type, "file");
+    // the whole {"extension", "data"} encoding, not a header chunk and the
+    // raw file
+    EXPECT_GT(num_segments, 1 + (FILE_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    std::string start = "{\"data\":[";
+    ASSERT_GE(frame.payload.size(), start.size());
+    EXPECT_TRUE(std::equal(start.begin(), start.end(), frame.payload.begin()));
+}
+
+TEST_F(FileStreamTest, ReadGuardCatchesTruncation)
+{
+    std::shared_ptr<MappedFile> file = MappedFile::open(file_path_.string());
+    ASSERT_NE(file, nullptr);
+    std::vector<uint8_t> copy(FILE_SIZE);
+    {
+        MappedFile::ReadGuard guard(file.get());
+        std::copy(file->bytes().begin(), file->bytes().end(), copy.begin());
+        EXPECT_FALSE(guard.faulted());
+    }
+    EXPECT_EQ(copy, file_bytes_);
+
+    std::filesystem::resize_file(file_path_, FILE_SIZE / 2);
+    {
+        MappedFile::ReadGuard guard(file.get());
+        std::copy(file->bytes().begin(), file->bytes().end(), copy.begin());
+        EXPECT_TRUE(guard.faulted());
+    }
+    // a new guard starts clean
+    MappedFile::ReadGuard guard(file.get());
+    EXPECT_FALSE(guard.faulted());
+}
+
+TEST_F(FileStreamTest, TruncationFoundWithoutReading)
+{
+    std::filesystem::path next_path = file_path_.string() + ".next";
+    std::filesystem::copy_file(
+        file_path_, next_path,
+        std::filesystem::copy_options::overwrite_existing);
+    std::vector<std::shared_ptr<SampleData>> samples = {
+        std::make_shared<FileSample>(
+            SampleMetadata{.metric_id = "starcam_image", .timestamp = 1.0f},
+            file_path_.string(), "png"),
+        std::make_shared<FileSample>(
+            SampleMetadata{.metric_id = "starcam_image", .timestamp = 2.0f},
+            next_path.string(), "png")};
+    size_t next_sample = 0;
+    SampleId sample_id = 0;
+    SampleTransmitter transmitter(
+        [&samples, &next_sample]() -> std::shared_ptr<SampleData> {
+            if(next_sample == samples.size()) {
+                return nullptr;
+            }
+            return samples[next_sample++];
+        },
+        []() { return CHUNK_SIZE + 40; }, []() { return 64u; },
+        // like the binary frame encoding, only the kernel reads the payload
+        [&sample_id](const SampleFrameData& sample_frame_data,
+                     std::vector<uint8_t>& header) {
+            sample_id = sample_frame_data.sample_id;
+            header.clear();
+            return sample_frame_data.data;
+        },
+        "starcam_image");
+    transmitter.set_stream_files(true);
+    ArqClock::time_point now{};
+    OutgoingFrame frame;
+
+    for(int i = 0; i < 32; i++) {
+        ASSERT_TRUE(transmitter.get_pkt(frame, now));
+    }
+    std::filesystem::resize_file(file_path_, 0);
+
+    // the size is not checked on every packet
+    ASSERT_TRUE(transmitter.get_pkt(frame, now));
+    EXPECT_EQ(sample_id, 1u);
+    // but is once a retransmit timeout has passed
+    now += std::chrono::seconds(2);
+    ASSERT_TRUE(transmitter.get_pkt(frame, now));
+    EXPECT_EQ(sample_id, 2u);
+    std::filesystem::remove(next_path);
+}
@@ -0,0 +1,50 @@
+#include "../src/command.hpp"
+#include "../src/metric_registry.hpp"
+#include "../src/sample.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+
+TEST(MetricRegistryTest, HandlesAreDenseAndStable)
+{
+    MetricRegistry registry;
+    EXPECT_EQ(registry.intern("gps_lat"), 0u);
+    EXPECT_EQ(registry.intern("gps_lon"), 1u);
+    EXPECT_EQ(registry.intern("gps_lat"), 0u);
+    EXPECT_EQ(registry.size(), 2u);
+
+    const MetricId& first = registry.get_metric_id(0);
+    for(int i = 0; i < 1000; i++) {
+        registry.intern("metric_" + std::to_string(i));
+    }
+    // references stay valid as metrics are added
+    EXPECT_EQ(first, "gps_lat");
+    EXPECT_EQ(&first, &registry.get_metric_id(0));
+}
+
+TEST(MetricRegistryTest, FindDoesNotIntern)
+{
+    MetricRegistry registry;
+    EXPECT_FALSE(registry.find("gps_lat").has_value());
+    EXPECT_EQ(registry.size(), 0u);
+
+    MetricHandle handle = registry.intern("gps_lat");
+    ASSERT_TRUE(registry.find("gps_lat").has_value());
+    EXPECT_EQ(*registry.find("gps_lat"), handle);
+}
+
+TEST(MetricRegistryTest, CommandResolvesMetricIdsAtTheEdge)
+{
+    Command command(10000, 1000);
+    SampleMetadata metadata = {.metric_id = "gps_lat", .timestamp = 1.0f};
+    command.add_sample(std::make_unique<PrimitiveSample>(metadata, 1));
+
+    std::optional<MetricHandle> handle = command.find_metric("gps_lat");
+    ASSERT_TRUE(handle.has_value());
+    EXPECT_FALSE(command.find_metric("gps_lon").has_value());
+
+    // a second sample for the same metric reuses its handle
+    command.add_sample(std::make_unique<PrimitiveSample>(metadata, 2));
+    EXPECT_EQ(command.get_num_metrics(), 1u);
+    EXPECT_EQ(command.find_metric("gps_lat"), handle);
+}
@@ -0,0 +1,141 @@
+#include "../src/utils/chunker.hpp"
+#include "../src/utils/reed_solomon.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+static std::vector<uint8_t> make_data(size_t size, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(size);
+    for(uint8_t& byte : data) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return data;
+}
+
+TEST(ReedSolomonTest, AnyDataShardsRebuildTheRest)
+{
+    const unsigned int num_data = 10;
+    const unsigned int num_parity = 4;
+    const size_t shard_size = 64;
+    ReedSolomon reed_solomon(num_data, num_parity);
+
+    std::vector<std::vector<uint8_t>> original;
+    for(unsigned int i = 0; i < num_data; i++) {
+        original.push_back(make_data(shard_size, i));
+    }
+    std::vector<std::vector<uint8_t>> parity(
+        num_parity, std::vector<uint8_t>(shard_size));
+    std::vector<std::span<const uint8_t>> data_spans(original.begin(),
+                                                     original.end());
+    std::vector<std::span<uint8_t>> parity_spans(parity.begin(), parity.end());
+    reed_solomon.encode(data_spans, parity_spans);
+
+    std::mt19937 rng(7);
+    for(int trial = 0; trial < 200; trial++) {
+        // lose num_parity random shards
+        std::vector<bool> present(num_data + num_parity, true);
+        std::vector<unsigned int> order(num_data + num_parity);
+        for(unsigned int i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), rng);
+        std::vector<std::vector<uint8_t>> shards = original;
+        shards.insert(shards.end(), parity.begin(), parity.end());
+        for(unsigned int i = 0; i < num_parity; i++) {
+            present[order[i]] = false;
+            std::fill(shards[order[i]].begin(), shards[order[i]].end(), 0);
+        }
+
+        std::vector<std::span<uint8_t>> shard_spans(shards.begin(),
+                                                    shards.end());
+        ASSERT_TRUE(reed_solomon.reconstruct(shard_spans, present));
+        for(unsigned int i = 0; i < num_data; i++) {
+            ASSERT_EQ(shards[i], original[i]) << "trial " << trial;
+        }
+    }
+}
+
+TEST(ReedSolomonTest, TooFewShardsFail)
+{
+    ReedSolomon reed_solomon(4, 2);
+    std::vector<std::vector<uint8_t>> shards(6, std::vector<uint8_t>(8));
+    std::vector<std::span<uint8_t>> shard_spans(shards.begin(), shards.end());
+    std::vector<bool> present = {false, false, false, true, true, true};
+    EXPECT_FALSE(reed_solomon.reconstruct(shard_spans, present));
+    EXPECT_THROW(ReedSolomon(200, 57), std::invalid_argument);
+}
+
+// Rebuild the data of an erasure coded chunker from the chunks it holds,
+// the way the ground does
+static std::vector<uint8_t> rebuild(Chunker& chunker,
+                                    const std::vector<bool>& received,
+                                    size_t chunk_size)
+{
+    FecParams fec = chunker.get_fec();
+    ReedSolomon reed_solomon(fec.block_size, fec.num_parity);
+    std::vector<uint8_t> data;
+    for(unsigned int block = 0;
+        chunker.get_block_start(block) < chunker.get_num_chunks(); block++) {
+        unsigned int num_data = chunker.get_block_num_data(block);
+        SeqNum start = chunker.get_block_start(block);
+        std::vector<std::vector<uint8_t>> shards(
+            fec.block_size + fec.num_parity,
+            std::vector<uint8_t>(chunk_size, 0));
+        std::vector<bool> present(shards.size(), false);
+        for(unsigned int i = 0; i < shards.size(); i++) {
+            // zero padding of a short block counts as recieved
+            bool padding = i >= num_data && i < fec.block_size;
+            unsigned int index = i < fec.block_size ? i : i - fec.block_size +
+                                                              num_data;
+            if(padding) {
+                present[i] = true;
+            } else if(received[start + index]) {
+                Chunk chunk = chunker.get_chunk(start + index);
+                std::copy(chunk.data.begin(), chunk.data.end(),
+                          shards[i].begin());
+                present[i] = true;
+            }
+        }
+        std::vector<std::span<uint8_t>> shard_spans(shards.begin(),
+                                                    shards.end());
+        if(!reed_solomon.reconstruct(shard_spans, present)) {
+            return {};
+        }
+        for(unsigned int i = 0; i < num_data; i++) {
+            data.insert(data.end(), shards[i].begin(), shards[i].end());
+        }
+    }
+    data.resize(chunker.get_data_size());
+    return data;
+}
+
+TEST(ReedSolomonTest, ChunkerRebuildsSampleFromAnyBlockSizeChunks)
+{
+    const size_t chunk_size = 100;
+    // 25 data chunks, the last one short: blocks of 8, 8, 8 and 1
+    std::vector<uint8_t> original = make_data(2450, 3);
+    Chunker chunker(original, chunk_size,
+                    FecParams{.block_size = 8, .num_parity = 3});
+    ASSERT_EQ(chunker.get_num_chunks(), 25u + 4 * 3);
+    EXPECT_EQ(chunker.get_block_num_data(3), 1u);
+    EXPECT_EQ(chunker.get_chunk(chunker.get_block_start(3)).data.size(), 50u);
+
+    // lose up to num_parity chunks of every block
+    std::vector<bool> received(chunker.get_num_chunks(), true);
+    std::mt19937 rng(11);
+    for(unsigned int block = 0; block < 4; block++) {
+        SeqNum start = chunker.get_block_start(block);
+        unsigned int num_chunks = chunker.get_block_num_chunks(block);
+        for(unsigned int lost = 0; lost < 3; lost++) {
+            received[start + rng() % num_chunks] = false;
+        }
+    }
+    EXPECT_EQ(rebuild(chunker, received, chunk_size), original);
+}
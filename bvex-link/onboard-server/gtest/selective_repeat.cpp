@@ -0,0 +1,380 @@
+#include "../src/sample.hpp"
+#include "../src/utils/chunker.hpp"
+#include "../src/utils/outgoing_frame.hpp"
+#include "../src/utils/sample_transmitter.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <memory>
+#include <queue>
+#include <random>
+#include <span>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// Sample whose encoded data is a fixed byte string
+class BlobSample : public SampleData
+{
+  public:
+    BlobSample(size_t size)
+        : SampleData(SampleMetadata{.metric_id = "blob", .timestamp = 1.0f}),
+          data_(size)
+    {
+        for(size_t i = 0; i < size; i++) {
+            data_[i] = static_cast<uint8_t>(i * 131 + 17);
+        }
+    }
+    std::vector<uint8_t> encode_data() override { return data_; }
+    std::vector<uint8_t> encode_response() override { return {}; }
+
+  private:
+    std::vector<uint8_t> data_;
+};
+
+// Header carrying only the seqnum, so the link simulation measures the ARQ
+// rather than a frame format
+static std::span<const uint8_t> encode_seqnum_frame(
+    const SampleFrameData& sample_frame_data, std::vector<uint8_t>& header)
+{
+    header.resize(4);
+    for(unsigned int i = 0; i < 4; i++) {
+        header[i] = static_cast<uint8_t>(sample_frame_data.seqnum >> (8 * i));
+    }
+    return sample_frame_data.data;
+}
+
+static SeqNum decode_seqnum(const OutgoingFrame& frame)
+{
+    SeqNum seqnum = 0;
+    for(unsigned int i = 0; i < 4; i++) {
+        seqnum |= static_cast<SeqNum>(frame.header[i]) << (8 * i);
+    }
+    return seqnum;
+}
+
+constexpr FecParams NO_FEC = {.block_size = 0, .num_parity = 0};
+
+// Transmitter for one sample of sample_size bytes in chunks of chunk_size
+static std::unique_ptr<SampleTransmitter>
+make_transmitter(size_t sample_size, size_t chunk_size,
+                 unsigned int window_size, FecParams fec = NO_FEC)
+{
+    auto sample = std::make_shared<BlobSample>(sample_size);
+    auto transmitter = std::make_unique<SampleTransmitter>(
+        [sample]() mutable -> std::shared_ptr<SampleData> {
+            return std::exchange(sample, nullptr);
+        },
+        // the transmitter takes 40 bytes of IP and UDP overhead off
+        [chunk_size]() { return chunk_size + 40; },
+        [window_size]() { return window_size; }, encode_seqnum_frame,
+        "blob");
+    transmitter->set_fec(fec);
+    return transmitter;
+}
+
+static std::vector<SeqNumRange> ack_of(std::vector<SeqNum> seqnums)
+{
+    std::vector<SeqNumRange> ranges;
+    for(SeqNum seqnum : seqnums) {
+        ranges.push_back({.first = seqnum, .last = seqnum});
+    }
+    return ranges;
+}
+
+TEST(SelectiveRepeatTest, BitmapRanges)
+{
+    std::vector<SeqNumRange> ranges;
+    // bits 0-2, 9 and 14-15
+    const uint8_t bitmap[] = {0b00000111, 0b11000010};
+    append_bitmap_ranges(100, bitmap, ranges);
+
+    ASSERT_EQ(ranges.size(), 3u);
+    EXPECT_EQ(ranges[0].first, 100u);
+    EXPECT_EQ(ranges[0].last, 102u);
+    EXPECT_EQ(ranges[1].first, 109u);
+    EXPECT_EQ(ranges[1].last, 109u);
+    EXPECT_EQ(ranges[2].first, 114u);
+    EXPECT_EQ(ranges[2].last, 115u);
+}
+
+TEST(SelectiveRepeatTest, WindowLimitsChunksInFlight)
+{
+    auto transmitter = make_transmitter(100 * 10, 10, 8);
+    ArqClock::time_point now{};
+    OutgoingFrame frame;
+
+    for(SeqNum seqnum = 0; seqnum < 8; seqnum++) {
+        ASSERT_TRUE(transmitter->get_pkt(frame, now));
+        EXPECT_EQ(decode_seqnum(frame), seqnum);
+    }
+    EXPECT_FALSE(transmitter->get_pkt(frame, now));
+
+    // acking past the lowest unacked chunk does not move the window
+    transmitter->handle_ack(ack_of({1, 2, 3}), 1, now);
+    EXPECT_FALSE(transmitter->get_pkt(frame, now));
+
+    transmitter->handle_ack(ack_of({0}), 1, now);
+    for(SeqNum seqnum = 8; seqnum < 12; seqnum++) {
+        ASSERT_TRUE(transmitter->get_pkt(frame, now));
+        EXPECT_EQ(decode_seqnum(frame), seqnum);
+    }
+    EXPECT_FALSE(transmitter->get_pkt(frame, now));
+}
+
+TEST(SelectiveRepeatTest, AckedChunksAreNotResent)
+{
+    auto transmitter = make_transmitter(10 * 10, 10, 16);
+    ArqClock::time_point start{};
+    OutgoingFrame frame;
+
+    for(int i = 0; i < 10; i++) {
+        ASSERT_TRUE(transmitter->get_pkt(frame, start));
+    }
+    transmitter->handle_ack(ack_of({0, 2, 4, 6, 8}), 1, start + 100ms);
+    EXPECT_EQ(transmitter->get_num_unacked(), 5u);
+
+    // no timer has expired yet, so nothing is resent
+    EXPECT_FALSE(transmitter->get_pkt(frame, start + 100ms));
+
+    // as the timers expire only the unacked chunks are resent, oldest first
+    ArqClock::duration rto = transmitter->get_rtt_estimator().get_rto();
+    std::vector<SeqNum> resent;
+    for(ArqClock::time_point later = start + 100ms;
+        resent.size() < 5 && later < start + 60s; later += 10ms) {
+        while(transmitter->get_pkt(frame, later)) {
+            resent.push_back(decode_seqnum(frame));
+        }
+    }
+    EXPECT_EQ(resent, (std::vector<SeqNum>{1, 3, 5, 7, 9}));
+    // the expiry backed off the timeout
+    EXPECT_GT(transmitter->get_rtt_estimator().get_rto(), rto);
+}
+
+TEST(SelectiveRepeatTest, RetransmitTimeoutFollowsRtt)
+{
+    auto transmitter = make_transmitter(100 * 10, 10, 100);
+    ArqClock::time_point now{};
+    OutgoingFrame frame;
+
+    for(SeqNum seqnum = 0; seqnum < 100; seqnum++) {
+        ASSERT_TRUE(transmitter->get_pkt(frame, now));
+        transmitter->handle_ack(ack_of({seqnum}), 1, now + 200ms);
+        now += 1ms;
+    }
+    ASSERT_TRUE(transmitter->get_rtt_estimator().get_srtt().has_value());
+    EXPECT_EQ(*transmitter->get_rtt_estimator().get_srtt(), 200ms);
+    EXPECT_GE(transmitter->get_rtt_estimator().get_rto(), 200ms);
+    EXPECT_LT(transmitter->get_rtt_estimator().get_rto(), 250ms);
+}
+
+TEST(SelectiveRepeatTest, RebuildableBlockNeedsNoMoreChunks)
+{
+    // 2 blocks of 4 data and 2 parity chunks
+    auto transmitter = make_transmitter(8 * 10, 10, 64,
+                                        {.block_size = 4, .num_parity = 2});
+    ArqClock::time_point now{};
+    OutgoingFrame frame;
+
+    for(SeqNum seqnum = 0; seqnum < 6; seqnum++) {
+        ASSERT_TRUE(transmitter->get_pkt(frame, now));
+    }
+    EXPECT_EQ(transmitter->get_num_unacked(), 12u);
+
+    // any 4 chunks of the first block, here with two data chunks lost
+    transmitter->handle_ack(ack_of({0, 2, 4, 5}), 1, now);
+    EXPECT_EQ(transmitter->get_num_unacked(), 6u);
+
+    // the second block is sent next and nothing of the first is resent
+    ArqClock::time_point later = now + 20s;
+    std::vector<SeqNum> sent;
+    while(transmitter->get_pkt(frame, later)) {
+        sent.push_back(decode_seqnum(frame));
+    }
+    EXPECT_EQ(sent, (std::vector<SeqNum>{6, 7, 8, 9, 10, 11}));
+}
+
+struct LinkResult {
+    bool complete;
+    double goodput_bps;
+    // sends per data chunk, counting parity chunk sends
+    double sends_per_chunk;
+};
+
+// Simulates downlinking one sample over a link of the given rate and one way
+// delay that drops data and ack packets independently with probability loss.
+// The receiver acks every data packet with a cumulative ack and a selective
+// ack bitmap of what it holds past that. With erasure coding on, a block is
+// complete once as many of its chunks as it has data chunks are recieved.
+static LinkResult run_lossy_link(double loss, size_t sample_size,
+                                 size_t chunk_size, unsigned int window_size,
+                                 double link_bps,
+                                 ArqClock::duration one_way_delay,
+                                 FecParams fec = NO_FEC)
+{
+    struct Arrival {
+        ArqClock::time_point at;
+        bool is_ack;
+        SeqNum seqnum;
+        std::vector<SeqNumRange> ranges;
+
+        bool operator>(const Arrival& other) const { return at > other.at; }
+    };
+
+    auto transmitter =
+        make_transmitter(sample_size, chunk_size, window_size, fec);
+    std::mt19937 rng(1234);
+    std::bernoulli_distribution dropped(loss);
+    std::priority_queue<Arrival, std::vector<Arrival>, std::greater<>> link;
+
+    // same chunk layout as the transmitter's
+    Chunker layout(std::vector<uint8_t>(sample_size), chunk_size, fec);
+    SeqNum num_chunks = layout.get_num_chunks();
+    size_t num_data_chunks = (sample_size + chunk_size - 1) / chunk_size;
+    std::vector<bool> received(num_chunks, false);
+    std::vector<unsigned int> block_received(
+        layout.get_block(num_chunks - 1) + 1, 0);
+    unsigned int num_blocks_complete = 0;
+    SeqNum cumulative = 0;
+
+    ArqClock::time_point start{};
+    ArqClock::time_point now = start;
+    const ArqClock::time_point give_up = start + 1000s;
+    size_t num_sends = 0;
+    OutgoingFrame frame;
+
+    auto complete = [&]() {
+        return num_blocks_complete == block_received.size();
+    };
+    while(!complete() && now < give_up) {
+        while(!link.empty() && link.top().at <= now) {
+            Arrival arrival = link.top();
+            link.pop();
+            if(arrival.is_ack) {
+                transmitter->handle_ack(arrival.ranges, 1, arrival.at);
+                continue;
+            }
+            if(!received[arrival.seqnum]) {
+                received[arrival.seqnum] = true;
+                unsigned int block = layout.get_block(arrival.seqnum);
+                block_received[block]++;
+                if(block_received[block] == layout.get_block_num_data(block)) {
+                    num_blocks_complete++;
+                }
+                if(complete()) {
+                    now = arrival.at;
+                    break;
+                }
+            }
+            while(cumulative < num_chunks && received[cumulative]) {
+                cumulative++;
+            }
+            std::vector<uint8_t> bitmap(64, 0);
+            for(size_t bit = 0;
+                bit < bitmap.size() * 8 && cumulative + bit < num_chunks;
+                bit++) {
+                if(received[cumulative + bit]) {
+                    bitmap[bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+                }
+            }
+            std::vector<SeqNumRange> ranges;
+            if(cumulative > 0) {
+                ranges.push_back({.first = 0, .last = cumulative - 1});
+            }
+            append_bitmap_ranges(cumulative, bitmap, ranges);
+            if(!dropped(rng)) {
+                link.push(Arrival{.at = arrival.at + one_way_delay,
+                                  .is_ack = true,
+                                  .seqnum = 0,
+                                  .ranges = std::move(ranges)});
+            }
+        }
+        if(complete()) {
+            break;
+        }
+
+        if(transmitter->get_pkt(frame, now)) {
+            num_sends++;
+            now += std::chrono::duration_cast<ArqClock::duration>(
+                std::chrono::duration<double>(
+                    static_cast<double>(frame.size() * 8) / link_bps));
+            if(!dropped(rng)) {
+                link.push(Arrival{.at = now + one_way_delay,
+                                  .is_ack = false,
+                                  .seqnum = decode_seqnum(frame),
+                                  .ranges = {}});
+            }
+        } else {
+            // idle until the next arrival or retransmit timer
+            std::optional<ArqClock::time_point> next =
+                transmitter->get_next_timeout();
+            if(!link.empty() && (!next || link.top().at < *next)) {
+                next = link.top().at;
+            }
+            if(!next) {
+                break;
+            }
+            now = std::max(now, *next);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(now - start).count();
+    return LinkResult{.complete = complete(),
+                      .goodput_bps =
+                          static_cast<double>(sample_size * 8) / seconds,
+                      .sends_per_chunk =
+                          static_cast<double>(num_sends) /
+                          static_cast<double>(num_data_chunks)};
+}
+
+TEST(SelectiveRepeatTest, LossyLinkGoodput)
+{
+    const size_t sample_size = 1 << 20;
+    const size_t chunk_size = 1000;
+    const double link_bps = 1e6;
+    const double loss_rates[] = {0.01, 0.10, 0.30};
+
+    std::printf("%8s %14s %12s %12s\n", "loss", "goodput kbps", "efficiency",
+                "sends/chunk");
+    for(double loss : loss_rates) {
+        LinkResult result = run_lossy_link(loss, sample_size, chunk_size, 256,
+                                           link_bps, 20ms);
+        double efficiency = result.goodput_bps / link_bps;
+        std::printf("%7.0f%% %14.1f %12.3f %12.3f\n", loss * 100,
+                    result.goodput_bps / 1e3, efficiency,
+                    result.sends_per_chunk);
+
+        ASSERT_TRUE(result.complete) << "loss " << loss;
+        // selective repeat only resends what was lost, so each chunk takes
+        // about 1 / (1 - loss) sends, with some slack for lost acks
+        EXPECT_LT(result.sends_per_chunk, 1.2 / (1 - loss)) << "loss " << loss;
+        EXPECT_GT(efficiency, 0.85 * (1 - loss)) << "loss " << loss;
+    }
+}
+
+TEST(SelectiveRepeatTest, ErasureCodingSavesRoundTripsOnLongLinks)
+{
+    // a long link where each retransmit round costs much more than sending
+    const size_t sample_size = 256 * 1000;
+    const size_t chunk_size = 1000;
+    const double link_bps = 1e6;
+    const double loss = 0.10;
+    const ArqClock::duration one_way_delay = 1s;
+
+    LinkResult arq = run_lossy_link(loss, sample_size, chunk_size, 1024,
+                                    link_bps, one_way_delay);
+    LinkResult fec =
+        run_lossy_link(loss, sample_size, chunk_size, 1024, link_bps,
+                       one_way_delay, {.block_size = 32, .num_parity = 8});
+    std::printf("%8s %14s %12s\n", "mode", "goodput kbps", "sends/chunk");
+    std::printf("%8s %14.1f %12.3f\n", "arq", arq.goodput_bps / 1e3,
+                arq.sends_per_chunk);
+    std::printf("%8s %14.1f %12.3f\n", "arq+fec", fec.goodput_bps / 1e3,
+                fec.sends_per_chunk);
+
+    ASSERT_TRUE(arq.complete);
+    ASSERT_TRUE(fec.complete);
+    EXPECT_GT(fec.goodput_bps, arq.goodput_bps);
+}
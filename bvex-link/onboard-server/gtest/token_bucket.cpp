@@ -0,0 +1,234 @@
+#include "../src/command.hpp"
+#include "../src/sample.hpp"
+#include "../src/server/send_server.hpp"
+#include "../src/telemetry.hpp"
+#include "../src/utils/token_bucket.hpp"
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <gtest/gtest.h>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+using boost::asio::ip::udp;
+
+constexpr size_t RATES_BPS[] = {1000, 10000, 100000, 1000000, 10000000};
+
+// Send num_packets through the bucket on a simulated clock, waking late by
+// up to max_lateness for each send, and return the achieved bps
+static double simulate_rate(TokenBucket& bucket, size_t num_packets,
+                            const std::vector<size_t>& packet_sizes,
+                            std::chrono::nanoseconds max_lateness)
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int64_t> lateness(0, max_lateness.count());
+    PacerClock::time_point start{};
+    PacerClock::time_point now = start;
+    size_t bytes_sent = 0;
+    for(size_t i = 0; i < num_packets; i++) {
+        now = bucket.get_send_time(now) +
+              std::chrono::nanoseconds(lateness(rng));
+        if(i == 0) {
+            start = now;
+        }
+        size_t size = packet_sizes[i % packet_sizes.size()];
+        bucket.consume(size, now);
+        bytes_sent += size;
+    }
+    // the rate is set by when the bucket lets the next packet out
+    double elapsed_s =
+        std::chrono::duration<double>(bucket.get_send_time(now) - start)
+            .count();
+    return static_cast<double>(bytes_sent) * 8.0 / elapsed_s;
+}
+
+TEST(TokenBucketTest, RateIsExactForAnyPacketSize)
+{
+    std::printf("%10s %10s %14s %12s\n", "bps", "pkt bytes", "achieved bps",
+                "error");
+    for(size_t bps : RATES_BPS) {
+        for(std::vector<size_t> sizes :
+            {std::vector<size_t>{64}, std::vector<size_t>{1400},
+             std::vector<size_t>{97, 1400, 513}}) {
+            TokenBucket bucket(bps, 0);
+            double achieved = simulate_rate(bucket, 3000, sizes, 0ns);
+            double error = std::abs(achieved - static_cast<double>(bps)) /
+                           static_cast<double>(bps);
+            std::printf("%10zu %10zu %14.1f %12.2e\n", bps, sizes[0],
+                        achieved, error);
+            // only the nanosecond rounding of the last packet is lost
+            EXPECT_LT(error, 1e-6) << bps << " bps";
+        }
+    }
+}
+
+TEST(TokenBucketTest, LateWakeupsWithinBurstKeepRate)
+{
+    for(size_t bps : RATES_BPS) {
+        size_t burst = 4 * 1400;
+        TokenBucket bucket(bps, burst);
+        // waking up to one packet time late never runs through the burst
+        // allowance, so no send time is lost
+        std::chrono::nanoseconds packet_time(1400 * 8 * 1000000000ull / bps);
+        double achieved = simulate_rate(bucket, 3000, {1400}, packet_time);
+        // the first burst goes out early, everything after keeps the rate
+        double expected = static_cast<double>(3000 * 1400 * 8) /
+                          (static_cast<double>((3000 * 1400 - burst) * 8) /
+                           static_cast<double>(bps));
+        EXPECT_NEAR(achieved, expected, expected * 1e-6) << bps << " bps";
+    }
+}
+
+TEST(TokenBucketTest, IdleBucketAllowsOnlyBurst)
+{
+    TokenBucket bucket(8000, 3000); // 1000 bytes per second
+    PacerClock::time_point now{};
+    bucket.consume(1000, now);
+    // a long idle period banks no more than the burst
+    now += 100s;
+    size_t sent_back_to_back = 0;
+    while(bucket.get_send_time(now) <= now) {
+        bucket.consume(1000, now);
+        sent_back_to_back += 1000;
+    }
+    EXPECT_EQ(sent_back_to_back, 4000u);
+    EXPECT_EQ(bucket.get_send_time(now), now + 1s);
+}
+
+// Sample whose encoded data is a fixed byte string
+class BlobSample : public SampleData
+{
+  public:
+    BlobSample(size_t size)
+        : SampleData(SampleMetadata{.metric_id = "blob", .timestamp = 1.0f}),
+          data_(size, 0x5a)
+    {
+    }
+    std::vector<uint8_t> encode_data() override { return data_; }
+    std::vector<uint8_t> encode_response() override { return {}; }
+
+  private:
+    std::vector<uint8_t> data_;
+};
+
+constexpr std::chrono::milliseconds MEASURE_AFTER = 200ms;
+
+struct LoopbackResult {
+    double achieved_bps;
+    double reported_bps;
+};
+
+// Run a SendServer at bps for duration to a loopback socket and measure the
+// rate the datagrams arrive at, from MEASURE_AFTER past the first one so the
+// initial burst is not counted
+static LoopbackResult run_loopback(size_t bps,
+                                   std::chrono::milliseconds duration,
+                                   unsigned int batch_size, size_t burst_size)
+{
+    // about ten packets a second at low rates, full size ones above
+    Command command(bps, std::min<size_t>(1400, bps / 80));
+    command.set_burst_size(burst_size);
+    // no acks come in, so let every chunk of the sample be in flight
+    command.set_window_size(1u << 20);
+    command.add_sample(std::make_unique<BlobSample>(
+        static_cast<size_t>(static_cast<double>(bps) / 8.0 * 2.0) + 100000));
+    Telemetry telemetry(command);
+
+    boost::asio::io_service io_service;
+    udp::socket recv_socket(
+        io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    recv_socket.set_option(
+        boost::asio::socket_base::receive_buffer_size(8 * 1024 * 1024));
+    udp::endpoint target_endpoint = recv_socket.local_endpoint();
+    udp::socket send_socket(io_service, udp::endpoint(udp::v4(), 0));
+
+    std::vector<uint8_t> recv_buffer(65536);
+    size_t num_recieved = 0;
+    size_t bytes_measured = 0;
+    size_t last_size = 0;
+    std::chrono::steady_clock::time_point first_arrival;
+    std::optional<std::chrono::steady_clock::time_point> measure_start;
+    std::chrono::steady_clock::time_point last_arrival;
+    udp::endpoint sender;
+    std::function<void(const boost::system::error_code&, size_t)> on_recv =
+        [&](const boost::system::error_code& error, size_t size) {
+            if(error) {
+                return;
+            }
+            std::chrono::steady_clock::time_point now =
+                std::chrono::steady_clock::now();
+            if(num_recieved++ == 0) {
+                first_arrival = now;
+            }
+            if(!measure_start && now - first_arrival >= MEASURE_AFTER) {
+                measure_start = now;
+            }
+            if(measure_start) {
+                bytes_measured += size;
+                last_arrival = now;
+                last_size = size;
+            }
+            recv_socket.async_receive_from(boost::asio::buffer(recv_buffer),
+                                           sender, on_recv);
+        };
+    recv_socket.async_receive_from(boost::asio::buffer(recv_buffer), sender,
+                                   on_recv);
+
+    SendServer send_server(send_socket, target_endpoint, telemetry, command,
+                           batch_size);
+    boost::asio::steady_timer stop_timer(io_service);
+    stop_timer.expires_after(duration);
+    stop_timer.async_wait([&](const boost::system::error_code&) {
+        io_service.stop();
+    });
+    io_service.run();
+
+    // the pacer waits for a datagram's bytes after sending it, so the time
+    // between the first and last datagram is spent on all but the last one
+    bytes_measured -= last_size;
+    double elapsed_s =
+        std::chrono::duration<double>(last_arrival - *measure_start).count();
+    return {.achieved_bps =
+                static_cast<double>(bytes_measured) * 8.0 / elapsed_s,
+            .reported_bps = send_server.get_achieved_bps()};
+}
+
+TEST(SendServerPacingTest, LoopbackRateMatchesBps)
+{
+    std::printf("%10s %14s %10s\n", "bps", "achieved bps", "error");
+    for(size_t bps : {10000ul, 100000ul, 1000000ul, 10000000ul}) {
+        // low rates send about ten packets a second, so run them longer
+        std::chrono::milliseconds duration = bps < 1000000 ? 2500ms : 1200ms;
+        // 10ms of burst covers timer wakeup latency
+        LoopbackResult result = run_loopback(bps, duration, 1, bps / 800);
+        double error =
+            std::abs(result.achieved_bps - static_cast<double>(bps)) /
+            static_cast<double>(bps);
+        std::printf("%10zu %14.1f %10.4f\n", bps, result.achieved_bps, error);
+        EXPECT_LT(error, 0.03) << bps << " bps";
+        // the last stats period saw the same rate, up to one packet at the
+        // rates with few packets per period
+        if(bps >= 1000000) {
+            EXPECT_NEAR(result.reported_bps, static_cast<double>(bps),
+                        0.05 * static_cast<double>(bps))
+                << bps << " bps";
+        }
+    }
+}
+
+#ifdef __linux__
+TEST(SendServerPacingTest, BatchedSendsKeepRate)
+{
+    size_t bps = 10000000;
+    LoopbackResult result = run_loopback(bps, 1200ms, 8, 8 * 1400);
+    EXPECT_NEAR(result.achieved_bps, static_cast<double>(bps),
+                0.03 * static_cast<double>(bps));
+}
+#endif
@@ -0,0 +1,168 @@
+#include "../src/command.hpp"
+#include "../src/sample.hpp"
+#include "../src/server/send_server.hpp"
+#include "../src/telemetry.hpp"
+#include "../src/utils/outgoing_frame.hpp"
+#include <algorithm>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <new>
+#include <span>
+#include <string>
+#include <vector>
+
+using boost::asio::ip::udp;
+using namespace std::chrono_literals;
+
+// Count every heap allocation made while counting_allocations is set.
+// Replacing the global operator new affects the whole test binary, so only
+// the code between enabling and disabling counting is measured.
+static std::atomic<bool> counting_allocations{false};
+static std::atomic<size_t> allocation_count{0};
+
+void* operator new(std::size_t size)
+{
+    if(counting_allocations) {
+        allocation_count++;
+    }
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if(ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t /*size*/) noexcept
+{
+    std::free(ptr);
+}
+
+class ZeroCopySendTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        file_path_ = std::filesystem::temp_directory_path() /
+                     "onboard_server_zero_copy_send.bin";
+        std::ofstream file(file_path_, std::ios::binary);
+        for(size_t i = 0; i < FILE_SIZE; i++) {
+            file.put(static_cast<char>(i * 131 + 17));
+        }
+    }
+
+    void TearDown() override { std::filesystem::remove(file_path_); }
+
+    static constexpr size_t FILE_SIZE = 2 * 1024 * 1024;
+    std::filesystem::path file_path_;
+};
+
+TEST_F(ZeroCopySendTest, FileSamplePacketsDoNotAllocate)
+{
+    Command command(100000, 1400);
+    command.set_frame_format(SampleFrameFormat::binary);
+    command.set_file_streaming(true);
+    // no acks come in, so let every chunk of the sample be in flight
+    command.set_window_size(4096);
+    // longer than the small string optimization buffer, so any copy of the
+    // metric id per packet would show up as an allocation
+    command.add_sample(std::make_unique<FileSample>(
+        SampleMetadata{.metric_id = "starcam_full_frame_image",
+                       .timestamp = 1.0f},
+        file_path_.string(), "bin"));
+    Telemetry telemetry(command);
+    OutgoingFrame frame;
+
+    // first pops map the file, send its header chunk and grow the reused
+    // header buffer
+    for(int i = 0; i < 4; i++) {
+        ASSERT_TRUE(telemetry.pop(frame));
+    }
+    std::span<const uint8_t> last_payload = frame.payload;
+
+    const int num_packets = 2000;
+    size_t bytes_sent = 0;
+    allocation_count = 0;
+    counting_allocations = true;
+    for(int i = 0; i < num_packets; i++) {
+        if(!telemetry.pop(frame)) {
+            break;
+        }
+        bytes_sent += frame.size();
+        // chunks are sent in order, so each payload must follow on from the
+        // last in the mapped file rather than be a copy
+        if(frame.payload.data() !=
+           last_payload.data() + last_payload.size()) {
+            counting_allocations = false;
+            FAIL() << "payload does not view into the mapped file";
+        }
+        last_payload = frame.payload;
+    }
+    counting_allocations = false;
+
+    EXPECT_EQ(allocation_count, 0u);
+    EXPECT_GT(bytes_sent, static_cast<size_t>(num_packets) * 1000);
+}
+
+#ifdef __linux__
+TEST_F(ZeroCopySendTest, BatchedSendsDoNotAllocate)
+{
+    // faster than loopback, so the pacer always lets a whole batch out and
+    // the single packet path is never taken
+    Command command(100000000000, 1400);
+    command.set_burst_size(64 * 1400);
+    command.set_frame_format(SampleFrameFormat::binary);
+    command.set_file_streaming(true);
+    // no acks come in, so let every chunk of the sample be in flight
+    command.set_window_size(4096);
+    command.add_sample(std::make_unique<FileSample>(
+        SampleMetadata{.metric_id = "starcam_full_frame_image",
+                       .timestamp = 1.0f},
+        file_path_.string(), "bin"));
+    Telemetry telemetry(command);
+
+    boost::asio::io_service io_service;
+    // never read, the datagrams are dropped once its buffer is full
+    udp::socket recv_socket(
+        io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    udp::endpoint target_endpoint = recv_socket.local_endpoint();
+    udp::socket send_socket(io_service, udp::endpoint(udp::v4(), 0));
+    SendServer send_server(send_socket, target_endpoint, telemetry, command,
+                           8);
+
+    // first batches map the file, send its header chunk and grow the reused
+    // header buffers of every frame of the batch
+    while(send_server.get_bytes_sent() < 64 * 1024) {
+        ASSERT_EQ(io_service.run_one_for(1s), 1u);
+    }
+
+    const size_t bytes_to_send = 1024 * 1024;
+    size_t start_bytes = send_server.get_bytes_sent();
+    size_t largest_step = 0;
+    allocation_count = 0;
+    counting_allocations = true;
+    while(send_server.get_bytes_sent() < start_bytes + bytes_to_send) {
+        size_t bytes_before = send_server.get_bytes_sent();
+        if(io_service.run_one_for(1s) == 0) {
+            break;
+        }
+        largest_step = std::max(largest_step,
+                                send_server.get_bytes_sent() - bytes_before);
+    }
+    counting_allocations = false;
+
+    EXPECT_EQ(allocation_count, 0u);
+    EXPECT_GE(send_server.get_bytes_sent(), start_bytes + bytes_to_send);
+    // more than one datagram went out in a single handler, so the batched
+    // path was the one measured
+    EXPECT_GT(largest_step, 1400u);
+}
+#endif
@@ -0,0 +1,304 @@
+#include "binary_sample_frame.hpp"
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    // data type codes stored in the low bits of the flags byte
+    enum DataTypeCode : uint8_t {
+        DATA_TYPE_CUSTOM = 0,
+        DATA_TYPE_PRIMITIVE = 1,
+        DATA_TYPE_FILE = 2,
+        DATA_TYPE_FILE_STREAM = 3,
+    };
+
+    constexpr uint8_t DATA_TYPE_MASK = 0x03;
+    constexpr uint8_t FLAG_HAS_METRIC_ID = 0x04;
+    constexpr uint8_t FLAG_HAS_FEC = 0x08;
+    constexpr unsigned int VERSION_SHIFT = 4;
+
+    uint8_t data_type_code(std::string_view data_type)
+    {
+        if(data_type == "primitive") {
+            return DATA_TYPE_PRIMITIVE;
+        } else if(data_type == "file") {
+            return DATA_TYPE_FILE;
+        } else if(data_type == "file_stream") {
+            return DATA_TYPE_FILE_STREAM;
+        }
+        return DATA_TYPE_CUSTOM;
+    }
+
+    void put_varint(std::vector<uint8_t>& out, uint32_t value)
+    {
+        while(value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void put_string(std::vector<uint8_t>& out, std::string_view str)
+    {
+        put_varint(out, static_cast<uint32_t>(str.size()));
+        out.insert(out.end(), str.begin(), str.end());
+    }
+
+    // Reads from a frame, tracking the read position. Any read past the end
+    // marks the reader as failed instead of throwing.
+    class FrameReader
+    {
+      public:
+        FrameReader(std::span<const uint8_t> frame) : frame_(frame), pos_(0)
+        {
+        }
+
+        bool ok() const { return ok_; }
+
+        uint8_t get_u8()
+        {
+            if(pos_ >= frame_.size()) {
+                ok_ = false;
+                return 0;
+            }
+            return frame_[pos_++];
+        }
+
+        uint32_t get_u32_le()
+        {
+            uint32_t value = 0;
+            for(unsigned int i = 0; i < 4; i++) {
+                value |= static_cast<uint32_t>(get_u8()) << (8 * i);
+            }
+            return value;
+        }
+
+        uint32_t get_varint()
+        {
+            uint32_t value = 0;
+            for(unsigned int shift = 0; shift < 35; shift += 7) {
+                uint8_t byte = get_u8();
+                value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                if((byte & 0x80) == 0) {
+                    return value;
+                }
+            }
+            ok_ = false; // varint longer than 5 bytes
+            return 0;
+        }
+
+        std::string_view get_string()
+        {
+            uint32_t size = get_varint();
+            if(!ok_ || size > frame_.size() - pos_) {
+                ok_ = false;
+                return {};
+            }
+            std::string_view str(
+                reinterpret_cast<const char*>(frame_.data() + pos_), size);
+            pos_ += size;
+            return str;
+        }
+
+        std::span<const uint8_t> rest() const { return frame_.subspan(pos_); }
+
+      private:
+        std::span<const uint8_t> frame_;
+        size_t pos_;
+        bool ok_ = true;
+    };
+} // namespace
+
+MetricIdInterner::MetricIdInterner(unsigned int announce_interval)
+    : announce_interval_(announce_interval)
+{
+}
+
+uint32_t MetricIdInterner::intern(std::string_view metric_id)
+{
+    auto it = handles_.find(metric_id);
+    if(it != handles_.end()) {
+        return it->second;
+    }
+    uint32_t handle = static_cast<uint32_t>(metric_ids_.size());
+    handles_.emplace(std::string(metric_id), handle);
+    metric_ids_.emplace_back(metric_id);
+    // force announcement on the first frame
+    frames_since_announce_.push_back(announce_interval_);
+    return handle;
+}
+
+bool MetricIdInterner::should_announce(uint32_t handle, uint32_t seqnum)
+{
+    unsigned int& frames = frames_since_announce_.at(handle);
+    if(seqnum == 0 || frames >= announce_interval_) {
+        frames = 0;
+        return true;
+    }
+    frames++;
+    return false;
+}
+
+const std::string& MetricIdInterner::get_metric_id(uint32_t handle) const
+{
+    return metric_ids_.at(handle);
+}
+
+void MetricIdTable::learn(uint32_t handle, std::string_view metric_id)
+{
+    if(handle >= metric_ids_.size()) {
+        metric_ids_.resize(handle + 1);
+    }
+    // only reassign on change, so views from earlier frames stay valid
+    if(!metric_ids_[handle] || *metric_ids_[handle] != metric_id) {
+        metric_ids_[handle] = std::string(metric_id);
+    }
+}
+
+const std::string* MetricIdTable::lookup(uint32_t handle) const
+{
+    if(handle >= metric_ids_.size() || !metric_ids_[handle]) {
+        return nullptr;
+    }
+    return &*metric_ids_[handle];
+}
+
+void encode_binary_sample_frame_header(const SampleFrameData& sample_frame_data,
+                                       MetricIdInterner& interner,
+                                       std::vector<uint8_t>& header)
+{
+    uint32_t handle = interner.intern(sample_frame_data.metric_id);
+    bool announce = interner.should_announce(handle, sample_frame_data.seqnum);
+    uint8_t type_code = data_type_code(sample_frame_data.data_type);
+
+    header.clear();
+    // room for the largest header of this metric, so a reused header buffer
+    // stops growing after the first frame rather than on the first announce
+    // with a longer seqnum
+    header.reserve(BINARY_SAMPLE_FRAME_MAX_HEADER_SIZE +
+                   sample_frame_data.metric_id.size() + 5 +
+                   sample_frame_data.data_type.size() + 5);
+
+    uint8_t flags =
+        static_cast<uint8_t>(BINARY_SAMPLE_FRAME_VERSION << VERSION_SHIFT) |
+        type_code;
+    if(announce) {
+        flags |= FLAG_HAS_METRIC_ID;
+    }
+    if(sample_frame_data.fec_num_parity > 0) {
+        flags |= FLAG_HAS_FEC;
+    }
+    header.push_back(BINARY_SAMPLE_FRAME_MAGIC);
+    header.push_back(flags);
+
+    uint32_t timestamp_bits = std::bit_cast<uint32_t>(
+        static_cast<float>(sample_frame_data.timestamp));
+    for(unsigned int i = 0; i < 4; i++) {
+        header.push_back(static_cast<uint8_t>(timestamp_bits >> (8 * i)));
+    }
+
+    put_varint(header, handle);
+    put_varint(header, sample_frame_data.sample_id);
+    put_varint(header, sample_frame_data.num_segments);
+    put_varint(header, sample_frame_data.seqnum);
+    if(flags & FLAG_HAS_FEC) {
+        put_varint(header, sample_frame_data.fec_block_size);
+        put_varint(header, sample_frame_data.fec_num_parity);
+        put_varint(header, sample_frame_data.data_size);
+    }
+    if(announce) {
+        put_string(header, sample_frame_data.metric_id);
+    }
+    if(type_code == DATA_TYPE_CUSTOM) {
+        put_string(header, sample_frame_data.data_type);
+    }
+}
+
+std::vector<uint8_t> encode_binary_sample_frame(
+    const SampleFrameData& sample_frame_data, MetricIdInterner& interner)
+{
+    std::vector<uint8_t> frame;
+    frame.reserve(BINARY_SAMPLE_FRAME_MAX_HEADER_SIZE +
+                  sample_frame_data.metric_id.size() + 5 +
+                  sample_frame_data.data.size());
+    encode_binary_sample_frame_header(sample_frame_data, interner, frame);
+    frame.insert(frame.end(), sample_frame_data.data.begin(),
+                 sample_frame_data.data.end());
+    return frame;
+}
+
+std::optional<SampleFrameData> decode_binary_sample_frame(
+    std::span<const uint8_t> frame, MetricIdTable& table)
+{
+    FrameReader reader(frame);
+    if(reader.get_u8() != BINARY_SAMPLE_FRAME_MAGIC) {
+        return std::nullopt;
+    }
+    uint8_t flags = reader.get_u8();
+    if((flags >> VERSION_SHIFT) != BINARY_SAMPLE_FRAME_VERSION) {
+        return std::nullopt;
+    }
+    float timestamp = std::bit_cast<float>(reader.get_u32_le());
+    uint32_t handle = reader.get_varint();
+    uint32_t sample_id = reader.get_varint();
+    uint32_t num_segments = reader.get_varint();
+    uint32_t seqnum = reader.get_varint();
+    uint32_t fec_block_size = 0;
+    uint32_t fec_num_parity = 0;
+    uint32_t data_size = 0;
+    if(flags & FLAG_HAS_FEC) {
+        fec_block_size = reader.get_varint();
+        fec_num_parity = reader.get_varint();
+        data_size = reader.get_varint();
+    }
+    if(flags & FLAG_HAS_METRIC_ID) {
+        std::string_view metric_id = reader.get_string();
+        if(reader.ok()) {
+            table.learn(handle, metric_id);
+        }
+    }
+
+    std::string_view data_type;
+    switch(flags & DATA_TYPE_MASK) {
+    case DATA_TYPE_PRIMITIVE:
+        data_type = "primitive";
+        break;
+    case DATA_TYPE_FILE:
+        data_type = "file";
+        break;
+    case DATA_TYPE_FILE_STREAM:
+        data_type = "file_stream";
+        break;
+    case DATA_TYPE_CUSTOM:
+        data_type = reader.get_string();
+        break;
+    default:
+        return std::nullopt;
+    }
+
+    if(!reader.ok()) {
+        return std::nullopt;
+    }
+    const std::string* metric_id = table.lookup(handle);
+    if(metric_id == nullptr) {
+        return std::nullopt;
+    }
+
+    return SampleFrameData{.metric_id = *metric_id,
+                           .timestamp = timestamp,
+                           .data_type = data_type,
+                           .sample_id = sample_id,
+                           .num_segments = num_segments,
+                           .seqnum = seqnum,
+                           .data = reader.rest(),
+                           .fec_block_size = fec_block_size,
+                           .fec_num_parity = fec_num_parity,
+                           .data_size = data_size};
+}
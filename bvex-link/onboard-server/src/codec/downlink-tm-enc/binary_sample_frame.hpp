@@ -0,0 +1,131 @@
+#pragma once
+
+#include "sample_frame.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*!
+   Binary sample frame layout (all multi-byte fixed fields little endian):
+
+   | field        | size            | notes                                  |
+   |--------------|-----------------|----------------------------------------|
+   | magic        | 1               | BINARY_SAMPLE_FRAME_MAGIC              |
+   | flags        | 1               | high nibble version, see FrameFlag     |
+   | timestamp    | 4               | IEEE-754 float                         |
+   | metric_handle| varint          | interned metric id                     |
+   | sample_id    | varint          |                                        |
+   | num_segments | varint          |                                        |
+   | seqnum       | varint          |                                        |
+   | fec          | 3 varints       | only if FrameFlag::has_fec: block_size,|
+   |              |                 | num_parity, data_size                  |
+   | metric_id    | varint len + n  | only if FrameFlag::has_metric_id       |
+   | data_type    | varint len + n  | only if data type code is custom       |
+   | payload      | rest of frame   | raw chunk bytes                        |
+
+   The payload is not length prefixed, its length is implied by the datagram
+   size.
+ */
+
+constexpr uint8_t BINARY_SAMPLE_FRAME_MAGIC = 0xB5;
+constexpr uint8_t BINARY_SAMPLE_FRAME_VERSION = 1;
+constexpr size_t BINARY_SAMPLE_FRAME_FIXED_HEADER_SIZE = 6;
+
+// Upper bound on header bytes excluding metric id and custom data type
+// strings: fixed header + 7 varints of at most 5 bytes each.
+constexpr size_t BINARY_SAMPLE_FRAME_MAX_HEADER_SIZE =
+    BINARY_SAMPLE_FRAME_FIXED_HEADER_SIZE + 7 * 5;
+
+/**
+ * @brief Hands out dense integer handles for metric id strings on the
+ * encoding side, and decides which frames carry the full metric id so the
+ * ground can learn the mapping.
+ *
+ * Every metric id is announced on its first frame, on the first segment of
+ * every sample, and once every announce_interval frames after that, so a
+ * receiver that misses an announcement (or restarts) relearns it quickly.
+ */
+class MetricIdInterner
+{
+  public:
+    MetricIdInterner(unsigned int announce_interval = 16);
+
+    // Get the handle of metric_id, assigning a new one if first seen
+    uint32_t intern(std::string_view metric_id);
+
+    // Whether the next frame for handle should carry the full metric id.
+    // Advances the announcement counter of handle.
+    bool should_announce(uint32_t handle, uint32_t seqnum);
+
+    const std::string& get_metric_id(uint32_t handle) const;
+
+  private:
+    // lets handles_ be searched by string_view without building a string
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const
+        {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    unsigned int announce_interval_;
+    std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>>
+        handles_;
+    std::vector<std::string> metric_ids_;
+    std::vector<unsigned int> frames_since_announce_;
+};
+
+/**
+ * @brief Decoding side of MetricIdInterner. Learns handle:metric_id pairs
+ * from frames that carry the full metric id.
+ */
+class MetricIdTable
+{
+  public:
+    void learn(uint32_t handle, std::string_view metric_id);
+
+    // returns nullptr if handle has not been announced yet
+    const std::string* lookup(uint32_t handle) const;
+
+  private:
+    std::vector<std::optional<std::string>> metric_ids_;
+};
+
+/**
+ * @brief Encodes the header of a binary sample frame into header.
+ *
+ * The frame on the wire is header followed by sample_frame_data.data, so the
+ * payload can be sent straight from the sample's buffer with scatter-gather
+ * IO. header is cleared first and its capacity reused, so once it has grown
+ * to fit a header this does not allocate.
+ */
+void encode_binary_sample_frame_header(const SampleFrameData& sample_frame_data,
+                                       MetricIdInterner& interner,
+                                       std::vector<uint8_t>& header);
+
+/**
+ * @brief Encodes a sample frame into the compact binary frame format as one
+ * contiguous buffer.
+ *
+ * @param sample_frame_data The frame to encode.
+ * @param interner Interner shared by all frames sent on the same link.
+ * @return Encoded frame bytes.
+ */
+std::vector<uint8_t> encode_binary_sample_frame(
+    const SampleFrameData& sample_frame_data, MetricIdInterner& interner);
+
+/**
+ * @brief Decodes a frame produced by encode_binary_sample_frame.
+ *
+ * Returns std::nullopt if the frame is malformed, or if its metric handle
+ * has not been announced to table yet. The returned frame views into frame
+ * and table, and is only valid while both are.
+ */
+std::optional<SampleFrameData> decode_binary_sample_frame(
+    std::span<const uint8_t> frame, MetricIdTable& table);
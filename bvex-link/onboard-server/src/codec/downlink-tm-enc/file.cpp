@@ -1,7 +1,6 @@
 #include "file.hpp"
 #include <cstdint>
 #include <fstream>
-#include <iterator>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
@@ -16,15 +15,28 @@ std::vector<uint8_t> encode_file(const std::string& file_path,
 
     std::vector<uint8_t> file_data;
 
-    std::ifstream file(file_path, std::ios::binary);
+    std::ifstream file(file_path, std::ios::binary | std::ios::ate);
     if(file) {
-        file.unsetf(std::ios::skipws);
-        file_data.insert(file_data.begin(),
-                         std::istream_iterator<uint8_t>(file),
-                         std::istream_iterator<uint8_t>());
+        // read in one go rather than a byte at a time
+        std::streamsize size = file.tellg();
+        file.seekg(0);
+        file_data.resize(static_cast<size_t>(size));
+        file.read(reinterpret_cast<char*>(file_data.data()), size);
+        file_data.resize(static_cast<size_t>(file.gcount()));
     }
     file_frame["data"] = file_data;
     std::string file_frame_string = file_frame.dump();
     return std::vector<uint8_t>(file_frame_string.begin(),
                                 file_frame_string.end());
+}
+
+std::vector<uint8_t> encode_file_header(const std::string& extension,
+                                        size_t file_size)
+{
+    json file_header;
+    file_header["extension"] = extension;
+    file_header["size"] = file_size;
+    std::string file_header_string = file_header.dump();
+    return std::vector<uint8_t>(file_header_string.begin(),
+                                file_header_string.end());
 }
\ No newline at end of file
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 #include <string>
 
 std::vector<uint8_t> encode_file(const std::string& file_path,
-                                 const std::string& extension);
\ No newline at end of file
+                                 const std::string& extension);
+
+// Header of a streamed file, sent as its own chunk ahead of the file's raw
+// bytes
+std::vector<uint8_t> encode_file_header(const std::string& extension,
+                                        size_t file_size);
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "frame_encoder.hpp"
+#include "binary_sample_frame.hpp"
+#include "sample_frame.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+std::optional<SampleFrameFormat> parse_sample_frame_format(
+    const std::string& format)
+{
+    if(format == "json") {
+        return SampleFrameFormat::json;
+    } else if(format == "binary") {
+        return SampleFrameFormat::binary;
+    }
+    return std::nullopt;
+}
+
+SampleFrameEncoder::SampleFrameEncoder(SampleFrameFormat format)
+    : format_(format), interner_()
+{
+}
+
+std::span<const uint8_t> SampleFrameEncoder::encode(
+    const SampleFrameData& sample_frame_data, std::vector<uint8_t>& header)
+{
+    switch(format_) {
+    case SampleFrameFormat::binary:
+        encode_binary_sample_frame_header(sample_frame_data, interner_,
+                                          header);
+        return sample_frame_data.data;
+    case SampleFrameFormat::json:
+    default:
+        header = encode_sample_frame(sample_frame_data);
+        return {};
+    }
+}
+
+SampleFrameFormat SampleFrameEncoder::get_format() { return format_; }
+
+void SampleFrameEncoder::set_format(SampleFrameFormat format)
+{
+    format_ = format;
+}
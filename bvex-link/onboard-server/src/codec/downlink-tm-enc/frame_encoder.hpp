@@ -0,0 +1,48 @@
+#pragma once
+
+#include "binary_sample_frame.hpp"
+#include "sample_frame.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Wire formats a sample frame can be downlinked in
+enum class SampleFrameFormat {
+    json,   // self describing JSON object, see encode_sample_frame
+    binary, // compact binary frame, see encode_binary_sample_frame
+};
+
+// Parses "json" or "binary", returns std::nullopt for anything else
+std::optional<SampleFrameFormat> parse_sample_frame_format(
+    const std::string& format);
+
+/**
+ * @brief Encodes sample frames in the currently selected wire format.
+ *
+ * Owns the metric id interner used by the binary format, so one encoder must
+ * be shared by every frame sent over the same link.
+ */
+class SampleFrameEncoder
+{
+  public:
+    SampleFrameEncoder(SampleFrameFormat format = SampleFrameFormat::json);
+
+    /**
+     * @brief Encode sample_frame_data into header.
+     *
+     * @return The payload bytes to send after header. Empty if the format
+     * embeds the payload in the header.
+     */
+    std::span<const uint8_t> encode(const SampleFrameData& sample_frame_data,
+                                    std::vector<uint8_t>& header);
+
+    SampleFrameFormat get_format();
+
+    void set_format(SampleFrameFormat format);
+
+  private:
+    SampleFrameFormat format_;
+    MetricIdInterner interner_;
+};
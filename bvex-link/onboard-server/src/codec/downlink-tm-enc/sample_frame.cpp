@@ -16,7 +16,13 @@ std::vector<uint8_t> encode_sample_frame(
     sample_frame["data_type"] = sample_frame_data.data_type;
     sample_frame["segment"]["num_segments"] = sample_frame_data.num_segments;
     sample_frame["segment"]["seqnum"] = sample_frame_data.seqnum;
-    sample_frame["segment"]["data"] = *sample_frame_data.data;
+    sample_frame["segment"]["data"] = std::vector<uint8_t>(
+        sample_frame_data.data.begin(), sample_frame_data.data.end());
+    if(sample_frame_data.fec_num_parity > 0) {
+        sample_frame["fec"]["block_size"] = sample_frame_data.fec_block_size;
+        sample_frame["fec"]["num_parity"] = sample_frame_data.fec_num_parity;
+        sample_frame["fec"]["data_size"] = sample_frame_data.data_size;
+    }
     std::string json_sample_frame = sample_frame.dump();
     auto byte_data = std::vector<uint8_t>(json_sample_frame.begin(), json_sample_frame.end());
     return byte_data;
@@ -2,18 +2,34 @@
 
 #include <boost/shared_ptr.hpp>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+/**
+ * @brief One segment of a sample, as sent in a single downlink datagram.
+ *
+ * All fields are views so a frame can be built per packet without
+ * allocating. The referenced strings and bytes must outlive the frame.
+ */
 struct SampleFrameData {
-    std::string metric_id;
+    std::string_view metric_id;
     float timestamp;
-    std::string data_type;
+    std::string_view data_type;
     unsigned int sample_id;
     unsigned int num_segments;
     unsigned int seqnum;
-    std::unique_ptr<std::vector<uint8_t>> data;
+    std::span<const uint8_t> data;
+    // Erasure coding of the sample, see FecParams. fec_num_parity is 0 if
+    // the sample is not erasure coded. data_size is the sample's size in
+    // bytes excluding parity, so the ground can strip the zero padding of
+    // a rebuilt last chunk.
+    unsigned int fec_block_size = 0;
+    unsigned int fec_num_parity = 0;
+    unsigned int data_size = 0;
 };
 
-std::vector<uint8_t> encode_sample_frame(const SampleFrameData& sample_frame_data);
\ No newline at end of file
+std::vector<uint8_t> encode_sample_frame(const SampleFrameData& sample_frame_data);
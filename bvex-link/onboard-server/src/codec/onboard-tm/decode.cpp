@@ -5,13 +5,14 @@
 #include <memory>
 #include <optional>
 #include <pb_decode.h>
+#include <span>
 #include <string>
 #include <vector>
 
 // returning ptr to SampleData is necessary here because
 // it allows us to use polymorphism and return classes
 // derived from the abstract class SampleData
-std::optional<Sample> decode_payload(std::vector<uint8_t> payload)
+std::optional<Sample> decode_payload(std::span<const uint8_t> payload)
 {
     Sample sample = Sample_init_zero;
 
@@ -3,8 +3,8 @@
 #include "pb_generated/sample.pb.h"
 #include <cstdint>
 #include <memory>
-#include <vector>
 #include <optional>
+#include <span>
+#include <vector>
 
-std::optional<Sample> decode_payload(
-    std::vector<uint8_t> payload);
+std::optional<Sample> decode_payload(std::span<const uint8_t> payload);
@@ -1,13 +1,22 @@
 #include "command.hpp"
+#include "metric_registry.hpp"
 #include "sample.hpp"
+#include <algorithm>
+#include <cassert>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
+#include <utility>
 #include <vector>
 
 Command::Command(size_t init_bps, size_t init_max_packet_size)
-    : bps_(init_bps), max_packet_size_(init_max_packet_size)
+    : bps_(init_bps), burst_size_(4 * init_max_packet_size),
+      max_packet_size_(init_max_packet_size),
+      window_size_(DEFAULT_ARQ_WINDOW_SIZE), stream_files_(false),
+      scheduler_(init_max_packet_size)
 {
 }
 
@@ -17,81 +26,128 @@ void Command::add_sample(std::unique_ptr<SampleData> sample)
         throw std::invalid_argument("SampleData cannot be null");
     }
 
-    std::string metric_id = sample->metadata.metric_id;
 #ifdef DEBUG_ADD_SAMPLE
-    std::cout << "New sample for metric id: \"" << metric_id
+    std::cout << "New sample for metric id: \"" << sample->metadata.metric_id
               << "\". Timestamp: " << sample->metadata.timestamp << std::endl;
 #endif
-    if(metric_exists(metric_id)) {
-        MetricInfo* metric_info = &metrics_[metric_id];
-        metric_info->latest_sample = std::move(sample);
-        metric_info->latest_downlinked = false;
-    } else {
+    {
+        std::shared_lock metrics_lock(metrics_mutex_);
+        std::optional<MetricHandle> handle =
+            registry_.find(sample->metadata.metric_id);
+        if(handle) {
+            store_sample(metrics_[*handle], std::move(sample));
+            return;
+        }
+    }
+    add_new_metric(std::move(sample));
+}
+
+void Command::add_new_metric(std::unique_ptr<SampleData> sample)
+{
+    std::lock_guard downlink_lock(downlink_mutex_);
+    std::unique_lock metrics_lock(metrics_mutex_);
+    MetricHandle handle = registry_.intern(sample->metadata.metric_id);
+    if(handle < metrics_.size()) {
+        // added by another thread since add_sample looked
+        store_sample(metrics_[handle], std::move(sample));
+        return;
+    }
 #ifdef DEBUG_ADD_SAMPLE
-        std::cout << "New metric id \"" << metric_id
-                  << "\". Timestamp: " << sample->metadata.timestamp
-                  << std::endl;
+    std::cout << "New metric id \"" << sample->metadata.metric_id
+              << "\". Timestamp: " << sample->metadata.timestamp << std::endl;
 #endif
-        // Create metric_info, populate it with data from sample
-        MetricInfo metric_info{
-            .metric_id = metric_id,
-            .token_threshold = 1,
-            .latest_sample = std::move(sample),
-            .latest_downlinked = false,
-            .sample_transmitter = std::make_unique<SampleTransmitter>(
-                [this, metric_id]() { return get_new_sample(metric_id); },
-                [this]() { return get_max_packet_size(); }, metric_id)};
+    // Create metric_info, populate it with data from sample
+    FlowId flow_id = scheduler_.add_flow(1);
+    assert(flow_id == handle);
+    MetricInfo& metric_info = metrics_.emplace_back();
+    metric_info.handle = handle;
+    metric_info.token_threshold = 1;
+    metric_info.sample_transmitter = std::make_unique<SampleTransmitter>(
+        [this, &metric_info]() { return get_new_sample(metric_info); },
+        [this]() { return get_max_packet_size(); },
+        [this]() { return get_window_size(); },
+        [this](const SampleFrameData& sample_frame_data,
+               std::vector<uint8_t>& header) {
+            return encode_frame(sample_frame_data, header);
+        },
+        registry_.get_metric_id(handle));
+    metric_info.sample_transmitter->set_stream_files(stream_files_);
+    metric_info.wake_at = std::nullopt;
 
-        // add metric_id:metric_info to map
-        metrics_.emplace(metric_id, std::move(metric_info));
-    }
+    std::shared_ptr<SampleData> shared_sample = std::move(sample);
+    metric_info.latest_sample.store(shared_sample);
+    metric_info.pending_sample.store(std::move(shared_sample));
+    // a metric has at most one live wakeup, so this keeps scheduling
+    // wakeups from allocating
+    wakeups_.reserve(2 * metrics_.size());
+    scheduler_.activate(handle);
 }
 
-std::shared_ptr<SampleData> Command::get_new_sample(MetricId metric_id)
+void Command::store_sample(MetricInfo& metric_info,
+                           std::shared_ptr<SampleData> sample)
 {
-    // If metric exists and has sample
-    if(metric_exists(metric_id) && !metrics_[metric_id].latest_downlinked) {
-        return metrics_[metric_id].latest_sample;
-    } else {
-        // return nullptr to signify invalid metric or
-        // no new sample
-        return nullptr;
+    metric_info.latest_sample.store(sample);
+    metric_info.pending_sample.store(std::move(sample));
+    // queue the metric once, however many samples come in before the next
+    // pop_pkt
+    if(!metric_info.ready.exchange(true)) {
+        std::lock_guard ready_lock(ready_mutex_);
+        ready_.push_back(metric_info.handle);
     }
 }
 
+std::shared_ptr<SampleData> Command::get_new_sample(MetricInfo& metric_info)
+{
+    // nullptr signifies no new sample
+    return metric_info.pending_sample.exchange(nullptr);
+}
+
 std::optional<std::vector<uint8_t>> Command::get_latest_sample_response(
-    MetricId metric_id)
+    const MetricId& metric_id)
 {
-    if(metric_exists(metric_id)) {
+    std::shared_ptr<SampleData> sample;
+    {
+        std::shared_lock metrics_lock(metrics_mutex_);
+        std::optional<MetricHandle> handle = registry_.find(metric_id);
+        if(handle) {
 #ifdef DEBUG_GET_LATEST_SAMPLE_RESPONSE
-        std::cout << "metric id found." << std::endl;
+            std::cout << "metric id found." << std::endl;
 #endif
-        return metrics_[metric_id].latest_sample->encode_response();
-    } else {
+            sample = metrics_[*handle].latest_sample.load();
+        } else {
 #ifdef DEBUG_GET_LATEST_SAMPLE_RESPONSE
-        std::cout << "metric id not found: \"" << metric_id << "\"."
-                  << std::endl;
-        if(!metrics_.empty()) {
-            std::cout << "current metric ids: " << std::endl;
-            for(auto const& pair : metrics_) {
-                std::cout << "\"" << pair.first << "\"\n" << std::endl;
+            std::cout << "metric id not found: \"" << metric_id << "\"."
+                      << std::endl;
+            if(!metrics_.empty()) {
+                std::cout << "current metric ids: " << std::endl;
+                for(auto const& metric_info : metrics_) {
+                    std::cout << "\""
+                              << registry_.get_metric_id(metric_info.handle)
+                              << "\"\n"
+                              << std::endl;
+                }
+                std::cout << "\n" << std::endl;
+            } else {
+                std::cout << "metrics_ empty" << std::endl;
             }
-            std::cout << "\n" << std::endl;
-        } else {
-            std::cout << "metrics_ empty" << std::endl;
-        }
 #endif
-        return std::nullopt;
+            return std::nullopt;
+        }
     }
+    // encode outside the lock, the sample is kept alive by our reference
+    return sample->encode_response();
 }
 
-void Command::handle_ack(Ack ack)
+void Command::handle_ack(const Ack& ack)
 {
-    if(metric_exists(ack.metric_id)) {
-        metrics_[ack.metric_id].sample_transmitter->handle_ack(ack.seqnums,
-                                                               ack.sample_id);
+    std::lock_guard downlink_lock(downlink_mutex_);
+    std::shared_lock metrics_lock(metrics_mutex_);
+    if(ack.metric < metrics_.size()) {
+        metrics_[ack.metric].sample_transmitter->handle_ack(
+            ack.ranges, ack.sample_id, ArqClock::now());
+        scheduler_.activate(ack.metric);
     } else {
-        std::cerr << "Metric not found: " << ack.metric_id << std::endl;
+        std::cerr << "Metric not found: " << ack.metric << std::endl;
     }
 }
 
@@ -99,76 +155,157 @@ size_t Command::get_max_packet_size() { return max_packet_size_; }
 
 void Command::set_max_packet_size(size_t max_packet_size)
 {
+    std::lock_guard downlink_lock(downlink_mutex_);
     max_packet_size_ = max_packet_size;
+    scheduler_.set_base_quantum(max_packet_size);
 };
 
-size_t Command::get_bps() { return bps_; }
+bool Command::set_token_threshold(const MetricId& metric_id,
+                                  unsigned int token_threshold)
+{
+    std::lock_guard downlink_lock(downlink_mutex_);
+    std::shared_lock metrics_lock(metrics_mutex_);
+    std::optional<MetricHandle> handle = registry_.find(metric_id);
+    if(!handle) {
+        return false;
+    }
+    metrics_[*handle].token_threshold = token_threshold;
+    scheduler_.set_token_threshold(*handle, token_threshold);
+    return true;
+}
 
-void Command::set_bps(size_t bps) { bps_ = bps; }
+bool Command::set_fec(const MetricId& metric_id, FecParams fec)
+{
+    if(fec.num_parity > 0 &&
+       (fec.block_size == 0 || fec.block_size + fec.num_parity > 256)) {
+        return false;
+    }
+    std::lock_guard downlink_lock(downlink_mutex_);
+    std::shared_lock metrics_lock(metrics_mutex_);
+    std::optional<MetricHandle> handle = registry_.find(metric_id);
+    if(!handle) {
+        return false;
+    }
+    metrics_[*handle].sample_transmitter->set_fec(fec);
+    return true;
+}
 
-size_t Command::get_num_metrics() { return metrics_.size(); }
+void Command::set_file_streaming(bool stream_files)
+{
+    std::lock_guard downlink_lock(downlink_mutex_);
+    std::shared_lock metrics_lock(metrics_mutex_);
+    stream_files_ = stream_files;
+    for(MetricInfo& metric_info : metrics_) {
+        metric_info.sample_transmitter->set_stream_files(stream_files);
+    }
+}
 
-bool Command::metric_exists(MetricId metric_id)
+bool Command::pop_pkt(OutgoingFrame& frame, ArqClock::time_point now)
 {
-    return metrics_.find(metric_id) != metrics_.end();
+    std::lock_guard downlink_lock(downlink_mutex_);
+    std::shared_lock metrics_lock(metrics_mutex_);
+    wake_metrics(now);
+    return scheduler_.pop(
+        frame, [this, now](FlowId flow_id, OutgoingFrame& flow_frame) {
+            return get_metric_pkt(flow_id, flow_frame, now);
+        });
 }
 
-MetricIterator Command::get_metric_iterator()
+bool Command::get_metric_pkt(MetricHandle metric, OutgoingFrame& frame,
+                             ArqClock::time_point now)
 {
-    auto begin = [this]() { return metrics_.begin(); };
-    auto end = [this]() { return metrics_.end(); };
-    return MetricIterator(begin, end);
+    MetricInfo& metric_info = metrics_.at(metric);
+    if(metric_info.sample_transmitter == nullptr) {
+        // signify no new sample
+        return false;
+    }
+    if(metric_info.sample_transmitter->get_pkt(frame, now)) {
+        return true;
+    }
+    // the scheduler drops the metric until it is activated again, so wake
+    // it when its earliest retransmit timer expires
+    std::optional<ArqClock::time_point> timeout =
+        metric_info.sample_transmitter->get_next_timeout();
+    if(timeout && (!metric_info.wake_at || *timeout < *metric_info.wake_at)) {
+        metric_info.wake_at = timeout;
+        wakeups_.push_back(Wakeup{.at = *timeout, .metric = metric});
+        std::push_heap(wakeups_.begin(), wakeups_.end(), wakes_later);
+    }
+    return false;
 }
 
-MetricIterator::MetricIterator(
-    std::function<std::map<MetricId, MetricInfo>::iterator()>
-        get_begin_iterator,
-    std::function<std::map<MetricId, MetricInfo>::iterator()> get_end_iterator)
-    : get_begin_iterator(get_begin_iterator),
-      get_end_iterator(get_end_iterator),
-      current_iterator_(get_begin_iterator())
+bool Command::wakes_later(const Wakeup& a, const Wakeup& b)
 {
+    return a.at > b.at;
 }
 
-std::optional<SampleInfo> MetricIterator::get_next_metric_sample()
+void Command::wake_metrics(ArqClock::time_point now)
 {
-    // condition can be true because metrics starts off empty
-    if(!is_iterator_valid()) {
-        if(metrics_empty()) {
-            return std::nullopt;
-        }
-        current_iterator_ = get_begin_iterator();
+    {
+        std::lock_guard ready_lock(ready_mutex_);
+        std::swap(ready_, ready_drain_);
     }
+    for(MetricHandle metric : ready_drain_) {
+        // cleared before activating, so a sample stored from here on queues
+        // the metric again
+        metrics_[metric].ready.store(false);
+        scheduler_.activate(metric);
+    }
+    ready_drain_.clear();
 
-    auto return_iter = current_iterator_;
-    auto get_pkt = [return_iter]() -> std::optional<std::vector<uint8_t>> {
-        if(return_iter->second.sample_transmitter != nullptr) {
-            return return_iter->second.sample_transmitter->get_pkt();
-        } else {
-            // signify no new sample
-            return std::nullopt;
+    while(!wakeups_.empty() && wakeups_.front().at <= now) {
+        std::pop_heap(wakeups_.begin(), wakeups_.end(), wakes_later);
+        Wakeup wakeup = wakeups_.back();
+        wakeups_.pop_back();
+        MetricInfo& metric_info = metrics_[wakeup.metric];
+        if(metric_info.wake_at != wakeup.at) {
+            continue; // superseded by an earlier wakeup
         }
-    };
-
-    ++current_iterator_;
-    if(!is_iterator_valid()) {
-        // iterator has incremented past end, roll back to start
-        current_iterator_ = get_begin_iterator();
+        metric_info.wake_at = std::nullopt;
+        scheduler_.activate(wakeup.metric);
     }
+}
 
-    return SampleInfo{
-        .metric_id = return_iter->first,
-        .token_threshold = return_iter->second.token_threshold,
-        .get_pkt = get_pkt,
-    };
+void Command::set_frame_format(SampleFrameFormat format)
+{
+    std::lock_guard downlink_lock(downlink_mutex_);
+    frame_encoder_.set_format(format);
 }
 
-bool MetricIterator::is_iterator_valid()
+std::span<const uint8_t> Command::encode_frame(
+    const SampleFrameData& sample_frame_data, std::vector<uint8_t>& header)
 {
-    return current_iterator_ != get_end_iterator();
+    return frame_encoder_.encode(sample_frame_data, header);
 }
 
-bool MetricIterator::metrics_empty()
+unsigned int Command::get_window_size() { return window_size_; }
+
+void Command::set_window_size(unsigned int window_size)
 {
-    return get_begin_iterator() == get_end_iterator();
-}
\ No newline at end of file
+    window_size_ = std::max(window_size, 1u);
+}
+
+size_t Command::get_bps() { return bps_; }
+
+void Command::set_bps(size_t bps) { bps_ = bps; }
+
+size_t Command::get_burst_size() { return burst_size_; }
+
+void Command::set_burst_size(size_t burst_size) { burst_size_ = burst_size; }
+
+size_t Command::get_num_metrics()
+{
+    std::shared_lock metrics_lock(metrics_mutex_);
+    return metrics_.size();
+}
+
+bool Command::metric_exists(const MetricId& metric_id)
+{
+    return find_metric(metric_id).has_value();
+}
+
+std::optional<MetricHandle> Command::find_metric(const MetricId& metric_id)
+{
+    std::shared_lock metrics_lock(metrics_mutex_);
+    return registry_.find(metric_id);
+}
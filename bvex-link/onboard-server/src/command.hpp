@@ -1,84 +1,100 @@
 #pragma once
 
+#include "metric_registry.hpp"
 #include "sample.hpp"
+#include "utils/drr_scheduler.hpp"
+#include "utils/outgoing_frame.hpp"
 #include "utils/sample_transmitter.hpp"
+#include <atomic>
+#include <chrono>
+#include <codec/downlink-tm-enc/frame_encoder.hpp>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <iterator>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <set>
+#include <shared_mutex>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 class SampleTransmitter;
 
 struct Ack {
-    MetricId metric_id;
+    MetricHandle metric;
     uint32_t sample_id;
-    std::vector<uint32_t> seqnums;
+    // acked seqnums, from explicit lists, ranges or selective ack bitmaps
+    std::vector<SeqNumRange> ranges;
 };
 
 /**
  * @brief Struct to hold information about a metric.
+ *
+ * The sample slots are swapped atomically, so ingest never waits on the
+ * downlink. Every other field is only touched by the downlink side.
  */
 struct MetricInfo {
-    // Unique of the metric
-    MetricId metric_id;
-    // Amount of bps dedicated to metric telemetry data
-    // Value in range [0-1]
+    // Handle of the metric, also its flow id in the downlink scheduler
+    MetricHandle handle;
+    // Inverse weight of the metric's share of the downlink bps. A metric
+    // with token_threshold n gets 1/n of the share of one with threshold 1.
     unsigned int token_threshold;
-    // Latest sample of this metric recieved.
-    // can be null if no sample has been recieved or if nullified after
-    // pop_new_sample
-    std::shared_ptr<SampleData> latest_sample;
+    // Latest sample of this metric recieved, answers requests
+    std::atomic<std::shared_ptr<SampleData>> latest_sample;
 
-    // whether the latest_sample has already been downlinked
-    bool latest_downlinked;
+    // Latest sample if it has not been downlinked yet, taken by the
+    // metric's transmitter when it starts a new sample
+    std::atomic<std::shared_ptr<SampleData>> pending_sample;
 
-    std::unique_ptr<SampleTransmitter> sample_transmitter;
-};
-
-struct SampleInfo {
-    MetricId metric_id;
-    unsigned int token_threshold;
-    std::function<std::optional<std::vector<uint8_t>>()> get_pkt;
-};
-
-class MetricIterator
-{
-  public:
-    MetricIterator(std::function<std::map<MetricId, MetricInfo>::iterator()>
-                       get_begin_iterator,
-                   std::function<std::map<MetricId, MetricInfo>::iterator()>
-                       get_end_iterator);
-
-    std::optional<SampleInfo> get_next_metric_sample();
+    // whether the metric is queued for the downlink to activate
+    std::atomic<bool> ready;
 
-  private:
-    bool metrics_empty();
-    bool is_iterator_valid();
+    std::unique_ptr<SampleTransmitter> sample_transmitter;
 
-    std::function<std::map<MetricId, MetricInfo>::iterator()>
-        get_begin_iterator;
-    std::function<std::map<MetricId, MetricInfo>::iterator()> get_end_iterator;
-    std::map<MetricId, MetricInfo>::iterator current_iterator_;
+    // when the metric is due to be woken for a retransmit, if it is waiting
+    std::optional<ArqClock::time_point> wake_at;
 };
 
+/**
+ * @brief Metric state and link settings shared by every server.
+ *
+ * Safe to use from several threads at once. Samples of known metrics are
+ * ingested with an atomic swap into the metric's slot and a short lock on
+ * the ready queue, so a burst of incoming samples does not hold up the
+ * downlink. The downlink side (scheduler, transmitters, retransmit timers)
+ * is guarded by one mutex taken by pop_pkt and the telecommands that change
+ * it. New metrics take both locks, which only happens once per metric.
+ */
 class Command
 {
   public:
     Command(size_t init_bps, size_t init_max_packet_size);
     // void add_tc_json(const std::string& telecommands_json);
 
-    void handle_ack(Ack ack);
+    /**
+     * @brief Mark the acked chunks of a metric as recieved and reactivate
+     * the metric, as the ack may have opened its window.
+     */
+    void handle_ack(const Ack& ack);
 
     size_t get_bps();
 
     void set_bps(size_t bps);
 
+    /**
+     * @brief Bytes the downlink may send back to back above the bps after
+     * being idle.
+     */
+    size_t get_burst_size();
+
+    void set_burst_size(size_t burst_size);
+
     /**
      * @brief Adds a sample to the internal data structure.
      * @param sample Shared pointer to the sample data to be added.
@@ -90,43 +106,173 @@ class Command
      * metric id. Returns std::nullopt if the metric does not exist
      */
     std::optional<std::vector<uint8_t>> get_latest_sample_response(
-        MetricId metric_id);
+        const MetricId& metric_id);
 
     size_t get_num_metrics();
 
     void print_all_metric_ids();
 
-    bool metric_exists(MetricId metric_id);
+    bool metric_exists(const MetricId& metric_id);
+
+    /**
+     * @brief Get the handle of a metric id, for use at the edges where
+     * metric ids come in as strings. Returns std::nullopt if the metric has
+     * never had a sample.
+     */
+    std::optional<MetricHandle> find_metric(const MetricId& metric_id);
 
     size_t get_max_packet_size();
 
     void set_max_packet_size(size_t max_packet_size);
 
-    MetricIterator get_metric_iterator();
+    unsigned int get_window_size();
+
+    /**
+     * @brief Set the number of chunks each metric may have in flight past its
+     * lowest unacked chunk.
+     */
+    void set_window_size(unsigned int window_size);
+
+    /**
+     * @brief Select the wire format used for all downlinked sample frames.
+     */
+    void set_frame_format(SampleFrameFormat format);
+
+    /**
+     * @brief Set the inverse downlink weight of a metric.
+     *
+     * @return false if the metric does not exist.
+     */
+    bool set_token_threshold(const MetricId& metric_id,
+                             unsigned int token_threshold);
+
+    /**
+     * @brief Set the erasure coding redundancy of a metric, applied from its
+     * next sample on. Every block of fec.block_size data chunks gets
+     * fec.num_parity parity chunks, 0 turns erasure coding off.
+     *
+     * @return false if the metric does not exist or a block would have more
+     * than 256 chunks.
+     */
+    bool set_fec(const MetricId& metric_id, FecParams fec);
+
+    /**
+     * @brief Stream the file samples of every metric, from each one's next
+     * sample on, as a header chunk followed by the file's raw bytes with the
+     * data type "file_stream". Off by default, when file samples are sent
+     * whole as "file". Erasure coded samples are always sent whole.
+     */
+    void set_file_streaming(bool stream_files);
+
+    /**
+     * @brief Write the next downlink packet into frame, picked by the deficit
+     * round robin scheduler over the metrics with something to send.
+     *
+     * Metrics with new samples and metrics whose retransmit timers expired
+     * since the last call are activated first.
+     *
+     * @return false if no metric has a packet to send.
+     */
+    bool pop_pkt(OutgoingFrame& frame, ArqClock::time_point now);
 
   private:
+    /**
+     * @brief Write the next packet of the metric into frame. Returns false
+     * if the metric has nothing to send. Needs downlink_mutex_ and a shared
+     * lock on metrics_mutex_.
+     *
+     * A metric that is waiting on a retransmit timer is scheduled to be
+     * woken by wake_metrics once the timer expires.
+     *
+     * @param metric Handle of the metric, which is also its scheduler flow id.
+     */
+    bool get_metric_pkt(MetricHandle metric, OutgoingFrame& frame,
+                        ArqClock::time_point now);
+
+    /**
+     * @brief Encode a sample frame in the currently selected wire format.
+     * Needs downlink_mutex_.
+     *
+     * @see SampleFrameEncoder::encode
+     */
+    std::span<const uint8_t> encode_frame(
+        const SampleFrameData& sample_frame_data, std::vector<uint8_t>& header);
+
+    /**
+     * @brief Activate every metric with a new sample or whose retransmit
+     * timer has expired. Needs downlink_mutex_ and a shared lock on
+     * metrics_mutex_.
+     */
+    void wake_metrics(ArqClock::time_point now);
+
     /**
      * @brief Get the latest sample data recieved for the given
-     * metric ID if it has not already been downlinked and mark it as
+     * metric if it has not already been downlinked and mark it as
      * downlinked. Returns nullptr if the latest sample has already been
      * downlinked.
      *
-     * @param metric_id ID of the metric.
+     * @param metric_info The metric's info.
      * @return SampleData if available.
      */
-    std::shared_ptr<SampleData> get_new_sample(MetricId metric_id);
+    std::shared_ptr<SampleData> get_new_sample(MetricInfo& metric_info);
+
+    // Create the metric of sample, or store the sample if another thread
+    // created it first
+    void add_new_metric(std::unique_ptr<SampleData> sample);
 
-    size_t bps_;
-    size_t max_packet_size_;
+    // Store a sample of an existing metric and queue the metric for the
+    // downlink to activate
+    void store_sample(MetricInfo& metric_info,
+                      std::shared_ptr<SampleData> sample);
+
+    struct Wakeup {
+        ArqClock::time_point at;
+        MetricHandle metric;
+    };
+
+    // heap order for wakeups_, so the earliest wakeup is at the front
+    static bool wakes_later(const Wakeup& a, const Wakeup& b);
+
+    std::atomic<size_t> bps_;
+    std::atomic<size_t> burst_size_;
+    std::atomic<size_t> max_packet_size_;
+    std::atomic<unsigned int> window_size_;
+    // applied to new metrics, guarded by downlink_mutex_
+    bool stream_files_;
     // std::vector<std::string> telecommands_;
 
+    // Locking order is downlink_mutex_, then metrics_mutex_, then
+    // ready_mutex_.
+
+    // guards registry_ and the shape of metrics_, exclusive only while a
+    // metric is added
+    std::shared_mutex metrics_mutex_;
+
+    MetricRegistry registry_;
+
     /**
-     * @brief Stores metric_id:metric_info* pairs.
+     * @brief Metric info of every metric, indexed by metric handle.
      *
-     * std::map is used here because it can be iterated through in order,
-     * and added to without iterator invalidation.
-     *
-     * @see https://en.cppreference.com/w/cpp/container#Iterator_invalidation
+     * A deque so that adding a metric does not move the others, transmitters
+     * and ingest hold references to their MetricInfo.
      */
-    std::map<MetricId, MetricInfo> metrics_;
+    std::deque<MetricInfo> metrics_;
+
+    // guards everything the downlink touches per packet
+    std::mutex downlink_mutex_;
+
+    SampleFrameEncoder frame_encoder_;
+
+    // flow ids are metric handles, flows are added in handle order
+    DrrScheduler scheduler_;
+
+    // min heap on Wakeup::at of the metrics waiting on a retransmit timer.
+    // An entry is stale if it does not match its metric's wake_at.
+    std::vector<Wakeup> wakeups_;
+
+    std::mutex ready_mutex_;
+    // metrics with a new sample, to be activated by the next pop_pkt
+    std::vector<MetricHandle> ready_;
+    // swapped with ready_ by pop_pkt, so neither reallocates in steady state
+    std::vector<MetricHandle> ready_drain_;
 };
@@ -4,24 +4,47 @@
 #include "server/send_server.hpp"
 #include "server/telecommand_recv_server.hpp"
 #include "telemetry.hpp"
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #ifndef REQUEST_SERVER_PORT
 #define REQUEST_SERVER_PORT "8080"
 #endif
 
+#ifndef ONBOARD_TELEMETRY_RECV_BATCH_SIZE
+#define ONBOARD_TELEMETRY_RECV_BATCH_SIZE 32
+#endif
+
+// 1 sends every downlink packet on its own, more hands up to that many
+// packets the pacer allows at once to the OS in one sendmmsg call
+#ifndef DOWNLINK_SEND_BATCH_SIZE
+#define DOWNLINK_SEND_BATCH_SIZE 1
+#endif
+
 using boost::asio::ip::udp;
 
 int main(int argc, char* argv[])
 {
     try {
-        if(argc != 3) {
+        if(argc != 3 && argc != 4) {
             std::cerr << "Usage: " << argv[0]
-                      << " <target_address> <target_port>\n";
+                      << " <target_address> <target_port> [num_threads]\n";
             return 1;
         }
+        // threads running the io_service. Every server runs on its own
+        // strand, so with more than one a burst of onboard telemetry does
+        // not hold up the downlink or requests.
+        unsigned int num_threads = 1;
+        if(argc == 4) {
+            num_threads = static_cast<unsigned int>(std::stoul(argv[3]));
+            if(num_threads == 0) {
+                num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+        }
 
         std::string target_address_str = argv[1];
         boost::asio::ip::address target_address;
@@ -53,15 +76,17 @@ int main(int argc, char* argv[])
         boost::asio::io_service io_service;
 
         udp::socket onboard_telemetry_listen_socket(
-            io_service, udp::endpoint(udp::v4(),
-            onboard_telemetry_recv_port));
+            boost::asio::make_strand(io_service),
+            udp::endpoint(udp::v4(), onboard_telemetry_recv_port));
         // enable SO_REUSEADDR to fix address already in use after crash
         onboard_telemetry_listen_socket.set_option(
             boost::asio::socket_base::reuse_address(true));
+        // every bcp process pushes samples here, so pull them in batches
         OnboardTelemetryRecvServer onboard_telemetry_recv_server(
-            onboard_telemetry_listen_socket, command);
+            onboard_telemetry_listen_socket, command, 4096,
+            ONBOARD_TELEMETRY_RECV_BATCH_SIZE);
 
-        udp::socket requests_socket(io_service,
+        udp::socket requests_socket(boost::asio::make_strand(io_service),
                                     udp::endpoint(udp::v4(), requests_port));
         // enable SO_REUSEADDR to fix address already in use after crash
         requests_socket.set_option(
@@ -71,7 +96,8 @@ int main(int argc, char* argv[])
                                        &command, std::placeholders::_1));
 
         udp::socket telecommand_listen_socket(
-            io_service, udp::endpoint(udp::v4(), telecommand_recv_port));
+            boost::asio::make_strand(io_service),
+            udp::endpoint(udp::v4(), telecommand_recv_port));
         // enable SO_REUSEADDR to fix address already in use after crash
         telecommand_listen_socket.set_option(
             boost::asio::socket_base::reuse_address(true));
@@ -79,15 +105,31 @@ int main(int argc, char* argv[])
         telecommand_recv_server(telecommand_listen_socket,
                                                       command);
 
-        udp::socket send_socket(io_service,
+        udp::socket send_socket(boost::asio::make_strand(io_service),
                                 udp::endpoint(udp::v4(), send_port));
         // enable SO_REUSEADDR to fix address already in use after crash
         send_socket.set_option(boost::asio::socket_base::reuse_address(true));
         udp::endpoint target_endpoint(target_address, target_port);
-        SendServer send_server(io_service, send_socket, target_endpoint,
-                               telemetry, command);
-                               
-        io_service.run();
+        SendServer send_server(send_socket, target_endpoint, telemetry,
+                               command, DOWNLINK_SEND_BATCH_SIZE);
+
+        // an exception in any handler stops every thread
+        auto run_io_service = [&io_service]() {
+            try {
+                io_service.run();
+            } catch(std::exception& e) {
+                std::cerr << e.what() << std::endl;
+                io_service.stop();
+            }
+        };
+        std::vector<std::thread> io_threads;
+        for(unsigned int i = 1; i < num_threads; i++) {
+            io_threads.emplace_back(run_io_service);
+        }
+        run_io_service();
+        for(std::thread& io_thread : io_threads) {
+            io_thread.join();
+        }
     } catch(std::exception& e) {
         std::cerr << e.what() << std::endl;
     }
@@ -0,0 +1,33 @@
+#include "metric_registry.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+
+MetricHandle MetricRegistry::intern(std::string_view metric_id)
+{
+    auto it = handles_.find(metric_id);
+    if(it != handles_.end()) {
+        return it->second;
+    }
+    MetricHandle handle = static_cast<MetricHandle>(metric_ids_.size());
+    metric_ids_.emplace_back(metric_id);
+    handles_.emplace(metric_ids_.back(), handle);
+    return handle;
+}
+
+std::optional<MetricHandle> MetricRegistry::find(
+    std::string_view metric_id) const
+{
+    auto it = handles_.find(metric_id);
+    if(it == handles_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+const MetricId& MetricRegistry::get_metric_id(MetricHandle handle) const
+{
+    return metric_ids_.at(handle);
+}
+
+size_t MetricRegistry::size() const { return metric_ids_.size(); }
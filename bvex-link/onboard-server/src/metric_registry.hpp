@@ -0,0 +1,51 @@
+#pragma once
+
+#include "sample.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Dense integer handle of a metric, assigned the first time it is seen
+typedef uint32_t MetricHandle;
+
+/**
+ * @brief Maps metric id strings to dense handles.
+ *
+ * Metric ids are only hashed at the edges, when a sample or request comes
+ * in. Everything past that indexes flat vectors by handle. Handles are
+ * never reused and metric ids are never removed, so references returned by
+ * get_metric_id stay valid for the registry's lifetime.
+ */
+class MetricRegistry
+{
+  public:
+    // Get the handle of metric_id, assigning the next one if first seen
+    MetricHandle intern(std::string_view metric_id);
+
+    // Get the handle of metric_id without assigning one
+    std::optional<MetricHandle> find(std::string_view metric_id) const;
+
+    const MetricId& get_metric_id(MetricHandle handle) const;
+
+    size_t size() const;
+
+  private:
+    // lets handles_ be searched by string_view without building a string
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const
+        {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    std::unordered_map<MetricId, MetricHandle, StringHash, std::equal_to<>>
+        handles_;
+    // deque so references to ids stay valid as metrics are added
+    std::deque<MetricId> metric_ids_;
+};
@@ -26,6 +26,16 @@ std::vector<uint8_t> FileSample::encode_data()
     return encode_file(file_path, file_extension);
 };
 
+std::shared_ptr<MappedFile> FileSample::map_file()
+{
+    return MappedFile::open(file_path);
+}
+
+std::vector<uint8_t> FileSample::encode_header(size_t file_size)
+{
+    return encode_file_header(file_extension, file_size);
+}
+
 std::vector<uint8_t> FileSample::encode_response()
 {
     return encode_failure_response(metadata.metric_id);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "codec/primitive.hpp"
+#include "utils/mapped_file.hpp"
 #include <cstdint>
 #include <ctime>
 #include <memory>
@@ -21,10 +22,25 @@ class SampleData
   public:
     const SampleMetadata metadata;
     const std::string type;
-    SampleData(SampleMetadata metadata) : metadata(metadata) {}
+    SampleData(SampleMetadata metadata, std::string type = "")
+        : metadata(metadata), type(type)
+    {
+    }
     virtual ~SampleData() = default;
     virtual std::vector<uint8_t> encode_data() = 0;
 
+    // Map the file the sample is streamed from, so it is chunked in place
+    // after the header from encode_header rather than encoded whole by
+    // encode_data. Returns nullptr if the sample is not streamed or the file
+    // cannot be mapped.
+    virtual std::shared_ptr<MappedFile> map_file() { return nullptr; }
+
+    // Header chunk sent ahead of the mapped file's bytes
+    virtual std::vector<uint8_t> encode_header(size_t /*file_size*/)
+    {
+        return {};
+    }
+
     // returns nullptr if not implemented or error
     virtual std::vector<uint8_t> encode_response() = 0;
 };
@@ -33,9 +49,8 @@ class PrimitiveSample : public SampleData
 {
   public:
     const PrimitiveValue value;
-    const std::string type = "primitive";
     PrimitiveSample(SampleMetadata metadata, PrimitiveValue value)
-        : SampleData(metadata), value(value)
+        : SampleData(metadata, "primitive"), value(value)
     {
     }
     std::vector<uint8_t> encode_data() override;
@@ -47,14 +62,15 @@ class FileSample : public SampleData
   public:
     const std::string file_path;
     const std::string file_extension;
-    const std::string type = "file";
     FileSample(SampleMetadata metadata, std::string file_path,
                std::string file_extension)
-        : SampleData(metadata), file_path(file_path),
+        : SampleData(metadata, "file"), file_path(file_path),
           file_extension(file_extension)
     {
     }
 
     std::vector<uint8_t> encode_data() override;
     std::vector<uint8_t> encode_response() override;
+    std::shared_ptr<MappedFile> map_file() override;
+    std::vector<uint8_t> encode_header(size_t file_size) override;
 };
\ No newline at end of file
@@ -6,11 +6,12 @@
 #include <memory>
 
 OnboardTelemetryRecvServer::OnboardTelemetryRecvServer(
-    udp::socket& listen_socket, Command& command, std::size_t buffer_size)
+    udp::socket& listen_socket, Command& command, std::size_t buffer_size,
+    unsigned int batch_size)
     : recv_server_(listen_socket,
                    std::bind(&OnboardTelemetryRecvServer::handle_message, this,
                              std::placeholders::_1),
-                   buffer_size),
+                   buffer_size, batch_size),
       command_(command) {};
 
 std::unique_ptr<SampleData> sample_struct_to_sample_data(Sample sample)
@@ -71,13 +72,13 @@ std::unique_ptr<SampleData> sample_struct_to_sample_data(Sample sample)
 }
 
 void OnboardTelemetryRecvServer::handle_message(
-    std::unique_ptr<std::vector<uint8_t>> message)
+    std::span<const uint8_t> message)
 {
 #ifdef DEBUG_ONBOARD_RECV_SERVER
-    std::cout << "Received onboard telemetry message of " << message->size()
+    std::cout << "Received onboard telemetry message of " << message.size()
               << " bytes." << std::endl;
 #endif
-    std::optional<Sample> sample = decode_payload(*message);
+    std::optional<Sample> sample = decode_payload(message);
     if(sample) {
 #ifdef DEBUG_ONBOARD_RECV_SERVER
         std::cout << "Message decoded to Sample succesfully." << std::endl;
@@ -4,15 +4,21 @@
 #include "recv_server.hpp"
 #include <boost/asio.hpp>
 #include <memory>
+#include <span>
 
 class OnboardTelemetryRecvServer
 {
   public:
+    /**
+     * @param batch_size Most datagrams recieved per wakeup, see RecvServer.
+     */
     OnboardTelemetryRecvServer(udp::socket& listen_socket, Command& command,
-                               std::size_t buffer_size = 4096);
+                               std::size_t buffer_size = 4096,
+                               unsigned int batch_size = 1);
 
   private:
-    void handle_message(std::unique_ptr<std::vector<uint8_t>> message);
+    // message is a view into the recv ring, only valid during the call
+    void handle_message(std::span<const uint8_t> message);
     RecvServer recv_server_;
     Command& command_;
 };
\ No newline at end of file
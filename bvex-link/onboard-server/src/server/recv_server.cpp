@@ -1,20 +1,44 @@
 #include "recv_server.hpp"
+#include <algorithm>
 #include <boost/bind/bind.hpp>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <string>
 
 using boost::asio::ip::udp;
 
-RecvServer::RecvServer(
-    udp::socket& listen_socket,
-    std::function<void(std::unique_ptr<std::vector<uint8_t>>)> message_handler,
-    std::size_t buffer_size)
+RecvServer::RecvServer(udp::socket& listen_socket,
+                       MessageHandler message_handler,
+                       std::size_t buffer_size, unsigned int batch_size)
     : socket_(listen_socket), message_handler_(message_handler),
       buffer_size_(buffer_size),
-      recv_buffer_(buffer_size) // initialize buffer with buffer_size bytes
+#ifdef __linux__
+      batch_size_(std::max(batch_size, 1u)),
+#else
+      batch_size_(1),
+#endif
+      // initialize the ring with batch_size_ buffers of buffer_size bytes
+      recv_ring_(batch_size_ * buffer_size)
 {
+#ifdef __linux__
+    iovecs_.resize(batch_size_);
+    msgs_.resize(batch_size_);
+    for(unsigned int i = 0; i < batch_size_; i++) {
+        std::span<uint8_t> buffer = slot(i);
+        iovecs_[i] = {.iov_base = buffer.data(), .iov_len = buffer.size()};
+        msgs_[i] = {};
+        msgs_[i].msg_hdr.msg_iov = &iovecs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+    // datagrams may already be queued, and the socket is only reported
+    // readable again when more arrive, so start by draining it
+    boost::asio::post(socket_.get_executor(), [this]() { recv_batch(); });
+#else
+    (void)batch_size;
     start_recv();
+#endif
 }
 
 /**
@@ -24,24 +48,20 @@ RecvServer::RecvServer(
  */
 void RecvServer::start_recv()
 {
-    // remote_endpoint recieves the endpoint of the sender
-    // in async_receive_from. It is not used, but required to be passed
-    // into the async_receive_from method.
-    udp::endpoint remote_endpoint;
-
     // function to call handle_recv, passing it error code and
     // the number of bytes received
     auto on_recv = boost::bind(&RecvServer::handle_recv, this,
                                boost::asio::placeholders::error,
                                boost::asio::placeholders::bytes_transferred);
 
+    std::span<uint8_t> buffer = slot(0);
     socket_.async_receive_from(
-        boost::asio::buffer(&recv_buffer_[0], buffer_size_), remote_endpoint,
+        boost::asio::buffer(buffer.data(), buffer.size()), remote_endpoint_,
         on_recv);
 }
 
 /**
- * passes bytes_received bytes of buffer to message_handler_
+ * passes a view of bytes_received bytes of buffer to message_handler_
  */
 void RecvServer::handle_recv(const boost::system::error_code& error,
                              std::size_t bytes_received /*bytes_transferred*/)
@@ -49,13 +69,7 @@ void RecvServer::handle_recv(const boost::system::error_code& error,
     // We will get error boost::asio::error::message_size
     // if the message is too big to fit in the buffer
     if(!error) {
-        // char *received_data(recv_buffer_.data());
-        // Must use unique ptr to give ownership to the caller
-        std::unique_ptr<std::vector<uint8_t>> message =
-            std::make_unique<std::vector<uint8_t>>(
-                recv_buffer_.begin(), recv_buffer_.begin() + bytes_received);
-        message_handler_(std::move(message));
-
+        message_handler_(slot(0).first(bytes_received));
     } else {
         std::cerr << "Error code" << error.to_string()
                   << "on receive msg: " << error.message() << std::endl;
@@ -63,4 +77,62 @@ void RecvServer::handle_recv(const boost::system::error_code& error,
 
     // recurse
     start_recv();
-}
\ No newline at end of file
+}
+
+void RecvServer::recv_batch()
+{
+#ifdef __linux__
+    int num_recvd =
+        recvmmsg(socket_.native_handle(), msgs_.data(), batch_size_,
+                 MSG_DONTWAIT, nullptr);
+    if(num_recvd < 0) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cerr << "recvmmsg failed: " << std::strerror(errno)
+                      << std::endl;
+        }
+        wait_readable();
+        return;
+    }
+    for(int i = 0; i < num_recvd; i++) {
+        mmsghdr& msg = msgs_[static_cast<unsigned int>(i)];
+        if(msg.msg_hdr.msg_flags & MSG_TRUNC) {
+            std::cerr << "Dropped datagram larger than " << buffer_size_
+                      << " bytes" << std::endl;
+        } else {
+            message_handler_(
+                slot(static_cast<unsigned int>(i)).first(msg.msg_len));
+        }
+        // recvmmsg only sets the flags, clear them for the next batch
+        msg.msg_hdr.msg_flags = 0;
+    }
+    if(static_cast<unsigned int>(num_recvd) == batch_size_) {
+        // more may be queued. Let other handlers run before draining them,
+        // without waiting for a readiness event that may not come.
+        boost::asio::post(socket_.get_executor(), [this]() { recv_batch(); });
+    } else {
+        wait_readable();
+    }
+#endif
+}
+
+void RecvServer::wait_readable()
+{
+    socket_.async_wait(udp::socket::wait_read,
+                       [this](const boost::system::error_code& error) {
+                           if(error == boost::asio::error::operation_aborted) {
+                               return; // socket closed
+                           }
+                           if(error) {
+                               std::cerr << "Error code" << error.to_string()
+                                         << "on wait for msg: "
+                                         << error.message() << std::endl;
+                           }
+                           recv_batch();
+                       });
+}
+
+std::span<uint8_t> RecvServer::slot(unsigned int index)
+{
+    return std::span<uint8_t>(recv_ring_).subspan(index * buffer_size_,
+                                                  buffer_size_);
+}
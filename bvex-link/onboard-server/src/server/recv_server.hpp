@@ -2,28 +2,63 @@
 
 #include <boost/asio.hpp>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <span>
 #include <vector>
 
 #include "../command.hpp"
 
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 using boost::asio::ip::udp;
 
+/**
+ * @brief Recieves datagrams on a socket and passes each one to a handler.
+ *
+ * Datagrams are recieved into a ring of batch_size preallocated buffers of
+ * buffer_size bytes, and the handler gets a view into the ring that is only
+ * valid until it returns. On Linux every wakeup pulls up to batch_size
+ * datagrams with one recvmmsg call, and datagrams larger than buffer_size
+ * are dropped. Elsewhere datagrams are recieved one at a time with asio, and
+ * larger ones are truncated.
+ */
 class RecvServer
 {
   public:
-    RecvServer(udp::socket& listen_socket,
-               std::function<void(std::unique_ptr<std::vector<uint8_t>>)>
-                   message_handler,
-               std::size_t buffer_size = 4096);
+    typedef std::function<void(std::span<const uint8_t>)> MessageHandler;
+
+    RecvServer(udp::socket& listen_socket, MessageHandler message_handler,
+               std::size_t buffer_size = 4096, unsigned int batch_size = 1);
 
   private:
     void start_recv();
     void handle_recv(const boost::system::error_code& error,
                      std::size_t bytes_recvd);
 
+    // Recieve and handle up to batch_size_ datagrams, then wait for more
+    void recv_batch();
+
+    // Call recv_batch once the socket is readable
+    void wait_readable();
+
+    // view of a buffer of the ring
+    std::span<uint8_t> slot(unsigned int index);
+
     udp::socket& socket_;
-    std::function<void(std::unique_ptr<std::vector<uint8_t>>)> message_handler_;
+    MessageHandler message_handler_;
     std::size_t buffer_size_;
-    std::vector<uint8_t> recv_buffer_;
+    unsigned int batch_size_;
+    // batch_size_ buffers of buffer_size_ bytes, back to back
+    std::vector<uint8_t> recv_ring_;
+    // sender of the last datagram, required by async_receive_from but unused
+    udp::endpoint remote_endpoint_;
+#ifdef __linux__
+    // one per ring buffer, pointing at it
+    std::vector<iovec> iovecs_;
+    std::vector<mmsghdr> msgs_;
+#endif
 };
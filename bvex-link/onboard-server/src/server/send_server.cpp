@@ -1,7 +1,12 @@
 #include "send_server.hpp"
 
+#include "../sample.hpp"
+#include <algorithm>
+#include <array>
 #include <boost/asio.hpp>
 #include <boost/bind/bind.hpp>
+#include <cerrno>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <memory>
@@ -14,35 +19,90 @@ constexpr std::chrono::milliseconds MAX_WAIT_TIME = 1000ms;
 constexpr std::chrono::milliseconds MIN_WAIT_TIME =
     1ms; // Set wait to <= 0 to disable backoff
 
-// std::unique_ptr<std::string> get_message()
-// {
-//     return std::unique_ptr<std::string>(new std::string("Hello"));
-// }
+// How often the achieved bps is measured and reported
+constexpr std::chrono::milliseconds STATS_PERIOD = 1000ms;
 
-SendServer::SendServer(boost::asio::io_service& io_service, udp::socket& socket,
-                       udp::endpoint& target_endpoint, Telemetry& telemetry,
-                       Command& command)
+SendServer::SendServer(udp::socket& socket, udp::endpoint& target_endpoint,
+                       Telemetry& telemetry, Command& command,
+                       unsigned int batch_size)
     : socket_(socket), target_endpoint_(target_endpoint), telemetry_(telemetry),
-      command_(command), schedule_send_timer_(io_service),
-      backoff_timer_(io_service), current_wait_time_(MIN_WAIT_TIME)
+      command_(command),
+#ifdef __linux__
+      batch_size_(std::max(batch_size, 1u)),
+#else
+      batch_size_(1),
+#endif
+      frames_(batch_size_),
+      pacer_(command.get_bps(), command.get_burst_size()),
+      schedule_send_timer_(socket.get_executor()),
+      backoff_timer_(socket.get_executor()), current_wait_time_(MIN_WAIT_TIME),
+      stats_timer_(socket.get_executor()), bytes_sent_(0),
+      period_start_bytes_(0), period_start_(PacerClock::now()),
+      achieved_bps_(0.0)
 {
+#ifdef __linux__
+    iovecs_.resize(2 * batch_size_);
+    msgs_.resize(batch_size_);
+    for(unsigned int i = 0; i < batch_size_; i++) {
+        msgs_[i] = {};
+        msgs_[i].msg_hdr.msg_iov = &iovecs_[2 * i];
+        msgs_[i].msg_hdr.msg_iovlen = 2;
+    }
+#endif
+    stats_timer_.expires_after(STATS_PERIOD);
+    stats_timer_.async_wait(boost::bind(&SendServer::report_rate, this));
     SendServer::start_send();
 }
 
+size_t SendServer::get_bytes_sent() const { return bytes_sent_; }
+
+double SendServer::get_achieved_bps() const { return achieved_bps_; }
+
 void SendServer::start_send()
 {
-    std::optional<std::vector<uint8_t>> message = telemetry_.pop();
-    if(message) {
-        auto message_ptr = std::make_shared<std::vector<uint8_t>>(*message);
+    // pick up bps and burst changes from telecommands
+    pacer_.set_bps(command_.get_bps());
+    pacer_.set_burst(command_.get_burst_size());
+
+    PacerClock::time_point now = PacerClock::now();
+    PacerClock::time_point send_time = pacer_.get_send_time(now);
+    if(send_time > now) {
+        // the timer's clock is the pacer's clock, so wait for the exact send
+        // time rather than rounding to whole milliseconds
+        schedule_send_timer_.expires_at(send_time);
+        schedule_send_timer_.async_wait(
+            boost::bind(&SendServer::start_send, this));
+        return;
+    }
+
+    // pop as many packets as the pacer allows right now, at least one
+    size_t num_frames = 0;
+    while(num_frames < batch_size_ &&
+          (num_frames == 0 || pacer_.get_send_time(now) <= now) &&
+          telemetry_.pop(frames_[num_frames])) {
+        pacer_.consume(frames_[num_frames].size(), now);
+        num_frames++;
+    }
+
+    if(num_frames > 1) {
+        current_wait_time_ = MIN_WAIT_TIME; // reset exponential backoff
+        send_batch(num_frames);
+    } else if(num_frames == 1) {
         current_wait_time_ = MIN_WAIT_TIME; // reset exponential backoff
+        OutgoingFrame& frame = frames_[0];
 
-        // calls this.handle_send, giving
-        // it the shared_ptr to the message
-        // once the data is handed off to the OS
-        // networking stack for transmission
+        // header and payload are gathered into one datagram by the OS, so
+        // the payload is sent straight from the sample's encoded data
+        std::array<boost::asio::const_buffer, 2> buffers = {
+            boost::asio::buffer(frame.header),
+            boost::asio::buffer(frame.payload.data(), frame.payload.size())};
+
+        // calls this.handle_send once the data is handed off to the OS
+        // networking stack for transmission. frames_ is not touched again
+        // until then, which keeps the buffers valid.
         socket_.async_send_to(
-            boost::asio::buffer(*message_ptr), target_endpoint_,
-            boost::bind(&SendServer::handle_send, this, message_ptr,
+            buffers, target_endpoint_,
+            boost::bind(&SendServer::handle_send, this,
                         boost::asio::placeholders::error,
                         boost::asio::placeholders::bytes_transferred));
     } else {
@@ -77,38 +137,125 @@ void SendServer::start_send()
 }
 
 // Handles
-void SendServer::handle_send(std::shared_ptr<std::vector<uint8_t>> /*message*/,
-                             const boost::system::error_code& error,
+void SendServer::handle_send(const boost::system::error_code& error,
                              std::size_t sent_size /*bytes_transferred*/)
 {
     if(error) {
         std::cerr << "Error code" << error.to_string()
                   << "on receive msg: " << error.message() << std::endl;
     }
-    // Schedule sending of next packet, given the number of bytes sent
-    SendServer::schedule_send(sent_size);
+    bytes_sent_ += sent_size;
+#ifdef DEBUG
+    std::cout << "Sent " << sent_size << " bytes to port "
+              << target_endpoint_.port() << std::endl;
+#endif
+    // the pacer already holds the time this packet takes at our desired
+    // bps, so start_send waits for it before sending the next one
+    SendServer::start_send();
+}
+
+void SendServer::send_batch(std::size_t num_frames)
+{
+#ifdef __linux__
+    for(std::size_t i = 0; i < num_frames; i++) {
+        OutgoingFrame& frame = frames_[i];
+        iovecs_[2 * i] = {.iov_base = frame.header.data(),
+                          .iov_len = frame.header.size()};
+        iovecs_[2 * i + 1] = {
+            .iov_base = const_cast<uint8_t*>(frame.payload.data()),
+            .iov_len = frame.payload.size()};
+        msgs_[i].msg_hdr.msg_name = target_endpoint_.data();
+        msgs_[i].msg_hdr.msg_namelen =
+            static_cast<socklen_t>(target_endpoint_.size());
+        msgs_[i].msg_len = 0;
+    }
+    send_batch_from(0, num_frames);
+#else
+    // batch_size_ is always 1 without sendmmsg
+    (void)num_frames;
+#endif
 }
 
-// At the point this is called, we have already waited for async_send_to_ to
-// give the packet to the OS. Given the number of bytes sent in the last packet
-// and our desired bps, calculate the time until the next packet
-// can be sent assuming the OS sends the previous packet at
-// our desired bps. Then, schedule the next packet to be sent
-// at that time. Of course, the OS may have delays in sending the packet
-// for whatever reason, so we may need to add add additional delay to
-// ensure we don't lose the packet, given a hard cap of bps.
-void SendServer::schedule_send(std::size_t sent_size)
+void SendServer::send_batch_from(std::size_t num_sent, std::size_t num_frames)
 {
-    auto bits_sent = sent_size * 8;
-    auto seconds_until_sent = bits_sent / command_.get_bps();
-    auto interval = std::chrono::milliseconds(seconds_until_sent * 1000);
+#ifdef __linux__
+    // sendmmsg is not wrapped by asio, so wait for the socket to be writable
+    // and then hand every datagram of the batch to the OS in one syscall
+    socket_.async_wait(
+        udp::socket::wait_write,
+        [this, num_sent,
+         num_frames](const boost::system::error_code& wait_error) mutable {
+            if(wait_error) {
+                std::cerr << "Error code" << wait_error.to_string()
+                          << "on send batch: " << wait_error.message()
+                          << std::endl;
+                start_send();
+                return;
+            }
+            while(num_sent < num_frames) {
+                // never block the strand, a full socket buffer is waited
+                // out with async_wait instead
+                int sent =
+                    sendmmsg(socket_.native_handle(), &msgs_[num_sent],
+                             static_cast<unsigned int>(num_frames - num_sent),
+                             MSG_DONTWAIT);
+                if(sent < 0 && errno == EINTR) {
+                    continue;
+                }
+                if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    // the pacer already counted these frames, so send them
+                    // once there is room rather than drop them
+                    send_batch_from(num_sent, num_frames);
+                    return;
+                }
+                if(sent <= 0) {
+                    std::cerr << "sendmmsg failed, dropping "
+                              << num_frames - num_sent << " packets"
+                              << std::endl;
+                    break;
+                }
+                for(int i = 0; i < sent; i++) {
+                    bytes_sent_ += msgs_[num_sent + i].msg_len;
+                }
+                num_sent += static_cast<std::size_t>(sent);
+            }
 #ifdef DEBUG
-    std::cout << "Sent " << sent_size << " bytes to port "
-              << target_endpoint_.port() << std::endl;
-    std::cout << "Waiting " << std::to_string(interval.count())
-              << "ms to send next packet" << std::endl;
+            std::cout << "Sent batch of " << num_sent << " packets to port "
+                      << target_endpoint_.port() << std::endl;
 #endif
-    // Set the timer's expiry time relative to now.
-    schedule_send_timer_.expires_after(interval);
-    schedule_send_timer_.async_wait(boost::bind(&SendServer::start_send, this));
-}
\ No newline at end of file
+            start_send();
+        });
+#else
+    (void)num_sent;
+    (void)num_frames;
+#endif
+}
+
+void SendServer::report_rate()
+{
+    PacerClock::time_point now = PacerClock::now();
+    double period_s =
+        std::chrono::duration<double>(now - period_start_).count();
+    if(period_s > 0.0) {
+        achieved_bps_ =
+            static_cast<double>(bytes_sent_ - period_start_bytes_) * 8.0 /
+            period_s;
+    }
+    period_start_ = now;
+    period_start_bytes_ = bytes_sent_;
+
+    float timestamp = std::chrono::duration<float>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+    command_.add_sample(std::make_unique<PrimitiveSample>(
+        SampleMetadata{.metric_id = "onboard_server_achieved_bps",
+                       .timestamp = timestamp},
+        achieved_bps_));
+    command_.add_sample(std::make_unique<PrimitiveSample>(
+        SampleMetadata{.metric_id = "onboard_server_configured_bps",
+                       .timestamp = timestamp},
+        static_cast<int64_t>(pacer_.get_bps())));
+
+    stats_timer_.expires_at(stats_timer_.expiry() + STATS_PERIOD);
+    stats_timer_.async_wait(boost::bind(&SendServer::report_rate, this));
+}
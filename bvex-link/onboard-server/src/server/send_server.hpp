@@ -2,9 +2,19 @@
 
 #include "../command.hpp"
 #include "../telemetry.hpp"
+#include "../utils/outgoing_frame.hpp"
+#include "../utils/token_bucket.hpp"
 #include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
 #include <memory>
 #include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 
 using boost::asio::ip::udp;
 
@@ -15,15 +25,20 @@ using boost::asio::ip::udp;
         SendServer -> start_send;
 
         start_send -> handle_send;
-        start_send -> socket_;
-        start_send -> io_service_;
-        start_send -> recv_buffer_;
+        start_send -> send_batch;
+        start_send -> pacer_;
+        start_send -> schedule_send_timer_;
+        start_send -> backoff_timer_;
+
+        send_batch -> send_batch_from;
+        send_batch_from -> socket_;
+        send_batch_from -> send_batch_from;
+        send_batch_from -> start_send;
 
-        handle_send -> schedule_send;
+        handle_send -> start_send;
 
-        schedule_send -> start_send;
-        schedule_send -> timer_;
-        schedule_send -> command_;
+        report_rate -> command_;
+        report_rate -> stats_timer_;
    }
    \enddot
  */
@@ -32,9 +47,15 @@ using boost::asio::ip::udp;
  * @brief Sends telemetry data packets to a remote endpoint.
  *
  * Gets telemetry packets from the telemetry object and sends them
- * asynchronously from localhost:source_port to target_address:target_port using
- * the provided io_service. The send rate is capped by the command object's max
- * bps.
+ * asynchronously from localhost:source_port to target_address:target_port on
+ * the socket's executor. Give the socket a strand when the io_service is run
+ * by several threads, the timers share it. The send rate is capped by the command object's max
+ * bps, paced by a token bucket that allows the command object's burst size to
+ * go out back to back after an idle period.
+ *
+ * Every second the achieved and configured bps are added to the command
+ * object as the samples onboard_server_achieved_bps and
+ * onboard_server_configured_bps, so they are downlinked like any other metric.
  */
 class SendServer
 {
@@ -42,37 +63,65 @@ class SendServer
     /**
      * @brief Construct a new SendServer object
      *
-     * @param io_service The io_service to use for async network IO operations.
+     * @param socket The socket to send from, its executor runs every handler
+     * of the server.
      * @param telemetry The telemetry object to get data from.
      * @param command The command object to get the bps from.
      * @param source_port The port to send from.
      * @param target_address The address to send to.
      * @param target_port The port to send to.
+     * @param batch_size Most packets handed to the OS in one sendmmsg call.
+     * Only used on Linux, elsewhere every packet is sent on its own.
      */
-    SendServer(boost::asio::io_service& io_service, udp::socket& socket,
-               udp::endpoint& target_endpoint, Telemetry& telemetry,
-               Command& command);
+    SendServer(udp::socket& socket, udp::endpoint& target_endpoint,
+               Telemetry& telemetry, Command& command,
+               unsigned int batch_size = 1);
+
+    // Bytes handed to the OS since construction
+    size_t get_bytes_sent() const;
+
+    // bps achieved over the last stats period, 0 before the first one ends
+    double get_achieved_bps() const;
 
   private:
     udp::socket& socket_;
     udp::endpoint& target_endpoint_;
     Telemetry& telemetry_;
     Command& command_;
-    std::vector<char> recv_buffer_;
+    unsigned int batch_size_;
+    // frames currently being sent, reused for every batch. frames_[0] is
+    // the only one used when batch_size_ is 1.
+    std::vector<OutgoingFrame> frames_;
+#ifdef __linux__
+    // header and payload of each of frames_, and the message sending them,
+    // allocated once so batches allocate nothing
+    std::vector<iovec> iovecs_;
+    std::vector<mmsghdr> msgs_;
+#endif
+    TokenBucket pacer_;
     boost::asio::steady_timer schedule_send_timer_;
     boost::asio::steady_timer backoff_timer_;
     std::chrono::milliseconds
         current_wait_time_; /* time to wait in ms if telemetry.pop() gives no
                                result*/
 
+    boost::asio::steady_timer stats_timer_;
+    size_t bytes_sent_;
+    // bytes_sent_ and time at the start of the current stats period
+    size_t period_start_bytes_;
+    PacerClock::time_point period_start_;
+    double achieved_bps_;
+
     /**
-     * @brief Sends the next telemetry data packet async, then calls
-     * handle_send() on completion.
-     *
-     * Calls telemetry_.pop() to get the next telemetry data packet, then sends
-     * it async to remote_endpoint_. Gives handle_send the shared_ptr to the
-     * message, the boost error code, and the number of bytes sent.
+     * @brief Sends the next telemetry data packets async once the pacer
+     * allows it.
      *
+     * If the pacer would not allow a send yet, waits on schedule_send_timer_
+     * until it does. Otherwise calls telemetry_.pop() to write the next
+     * packet into frames_[0] and sends its header and payload async to
+     * remote_endpoint_ as one datagram, then calls handle_send(). With
+     * batching, pops as many packets as the pacer allows up to batch_size_
+     * and hands them to send_batch() instead.
      */
     void start_send();
 
@@ -80,24 +129,34 @@ class SendServer
      * @brief Handles the completion of the async packet send called by
      * start_send.
      *
-     * Reads out errors if there were any, then calls schedule_send().
+     * Reads out errors if there were any, then calls start_send() for the
+     * next packet.
      *
-     * @param message Shared ptr to the message that was sent.
      * @param error The error code resulting from the send operation.
      * @param sent_size The number of bytes sent.
      */
-    void handle_send(std::shared_ptr<std::vector<uint8_t>> message,
-                     const boost::system::error_code& error,
+    void handle_send(const boost::system::error_code& error,
                      std::size_t sent_size);
 
     /**
-     * @brief Schedules the next call of self.start_send() to happen after OS
-     * finishes sending previous packet.
-     *
-     * Calculates send time based on the number of bytes sent in the previous
-     * packet and command_.get_bps().
+     * @brief Sends frames_[0, num_frames) with one sendmmsg call once the
+     * socket is writable, then calls start_send().
+     */
+    void send_batch(std::size_t num_frames);
+
+    /**
+     * @brief Waits for the socket to be writable and sends the batch's
+     * messages from num_sent on.
      *
-     * @param sent_size The number of bytes sent in the previous packet.
+     * If the socket buffer fills up part way, waits again and carries on
+     * from the first message not sent. Frames are only dropped on other
+     * errors. Calls start_send() once the batch is done.
+     */
+    void send_batch_from(std::size_t num_sent, std::size_t num_frames);
+
+    /**
+     * @brief Ends the current stats period, adding the achieved and
+     * configured bps to the command object, and starts the next one.
      */
-    void schedule_send(std::size_t sent_size);
-};
\ No newline at end of file
+    void report_rate();
+};
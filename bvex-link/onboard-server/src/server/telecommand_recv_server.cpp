@@ -1,11 +1,71 @@
 #include "telecommand_recv_server.hpp"
 #include "recv_server.hpp"
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <vector>
 
 using json = nlohmann::json;
 
+namespace
+{
+    std::optional<std::vector<uint8_t>> hex_to_bytes(const std::string& hex)
+    {
+        if(hex.size() % 2 != 0) {
+            return std::nullopt;
+        }
+        std::vector<uint8_t> bytes;
+        bytes.reserve(hex.size() / 2);
+        for(size_t i = 0; i < hex.size(); i += 2) {
+            try {
+                bytes.push_back(static_cast<uint8_t>(
+                    std::stoul(hex.substr(i, 2), nullptr, 16)));
+            } catch(const std::exception&) {
+                return std::nullopt;
+            }
+        }
+        return bytes;
+    }
+
+    // Collect the acked seqnums of an ack telecommand. Any combination of
+    // "seqnums" (list), "ranges" (inclusive [first, last] pairs),
+    // "cumulative" (every seqnum below it) and "bitmap" (hex selective ack
+    // bitmap, bit i acks cumulative + i) may be given.
+    std::vector<SeqNumRange> parse_ack_ranges(const json& ack)
+    {
+        std::vector<SeqNumRange> ranges;
+        if(ack.contains("seqnums")) {
+            for(uint32_t seqnum : ack["seqnums"].get<std::vector<uint32_t>>()) {
+                ranges.push_back({.first = seqnum, .last = seqnum});
+            }
+        }
+        if(ack.contains("ranges")) {
+            for(const json& range : ack["ranges"]) {
+                ranges.push_back(
+                    {.first = range.at(0), .last = range.at(1)});
+            }
+        }
+        SeqNum cumulative = ack.value("cumulative", 0u);
+        if(cumulative > 0) {
+            ranges.push_back({.first = 0, .last = cumulative - 1});
+        }
+        if(ack.contains("bitmap")) {
+            std::optional<std::vector<uint8_t>> bitmap =
+                hex_to_bytes(ack["bitmap"]);
+            if(bitmap) {
+                append_bitmap_ranges(cumulative, *bitmap, ranges);
+            } else {
+                std::cerr << "Invalid ack bitmap: " << ack["bitmap"]
+                          << std::endl;
+            }
+        }
+        return ranges;
+    }
+} // namespace
+
 TelecommandRecvServer::TelecommandRecvServer(udp::socket& listen_socket,
                                              Command& command,
                                              std::size_t buffer_size)
@@ -15,26 +75,63 @@ TelecommandRecvServer::TelecommandRecvServer(udp::socket& listen_socket,
                    buffer_size),
       command_(command) {};
 
-void TelecommandRecvServer::handle_message(
-    std::unique_ptr<std::vector<uint8_t>> message)
+void TelecommandRecvServer::handle_message(std::span<const uint8_t> message)
 {
-    std::string message_str(message->begin(), message->end());
+    std::string message_str(message.begin(), message.end());
     json telecommand = json::parse(message_str);
     std::cout << telecommand << std::endl;
     if(telecommand.contains("ack")) {
-        std::vector<int32_t> seqnums_int =
-            telecommand["ack"]["seqnums"].get<std::vector<int32_t>>();
-        std::vector<uint32_t> seqnums(seqnums_int.begin(), seqnums_int.end());
-        Ack ack = {.metric_id = telecommand["ack"]["metric_id"],
+        std::string metric_id = telecommand["ack"]["metric_id"];
+        // resolve the metric id once here, past this point it is a handle
+        std::optional<MetricHandle> metric = command_.find_metric(metric_id);
+        if(!metric) {
+            std::cerr << "Metric not found: " << metric_id << std::endl;
+            return;
+        }
+        Ack ack = {.metric = *metric,
                    .sample_id = telecommand["ack"]["sample_id"],
-                   .seqnums = seqnums};
-        command_.handle_ack(std::move(ack));
+                   .ranges = parse_ack_ranges(telecommand["ack"])};
+        command_.handle_ack(ack);
     } else if(telecommand.contains("set_bps")) {
         command_.set_bps(telecommand["set_bps"]["bps"]);
         std::cout << "SET BPS" << std::endl;
+    } else if(telecommand.contains("set_burst_size")) {
+        command_.set_burst_size(telecommand["set_burst_size"]["burst_size"]);
     } else if(telecommand.contains("set_max_pkt_size")) {
         command_.set_max_packet_size(
             telecommand["set_max_pkt_size"]["max_pkt_size"]);
+    } else if(telecommand.contains("set_window_size")) {
+        command_.set_window_size(
+            telecommand["set_window_size"]["window_size"]);
+    } else if(telecommand.contains("set_token_threshold")) {
+        std::string metric_id =
+            telecommand["set_token_threshold"]["metric_id"];
+        if(!command_.set_token_threshold(
+               metric_id,
+               telecommand["set_token_threshold"]["token_threshold"])) {
+            std::cerr << "Metric not found: " << metric_id << std::endl;
+        }
+    } else if(telecommand.contains("set_fec")) {
+        std::string metric_id = telecommand["set_fec"]["metric_id"];
+        FecParams fec = {
+            .block_size = telecommand["set_fec"].value("block_size", 32u),
+            .num_parity = telecommand["set_fec"]["num_parity"]};
+        if(!command_.set_fec(metric_id, fec)) {
+            std::cerr << "Invalid erasure coding for metric: " << metric_id
+                      << std::endl;
+        }
+    } else if(telecommand.contains("set_file_streaming")) {
+        command_.set_file_streaming(
+            telecommand["set_file_streaming"]["enabled"]);
+    } else if(telecommand.contains("set_frame_format")) {
+        std::string format_str = telecommand["set_frame_format"]["format"];
+        std::optional<SampleFrameFormat> format =
+            parse_sample_frame_format(format_str);
+        if(format) {
+            command_.set_frame_format(*format);
+        } else {
+            std::cerr << "Unknown frame format: " << format_str << std::endl;
+        }
     } else {
         std::cerr << "Telecommand not recognized: " << message_str << std::endl;
     }
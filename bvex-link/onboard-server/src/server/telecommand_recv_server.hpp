@@ -4,6 +4,7 @@
 #include "recv_server.hpp"
 #include <boost/asio.hpp>
 #include <memory>
+#include <span>
 
 class TelecommandRecvServer
 {
@@ -12,7 +13,8 @@ class TelecommandRecvServer
                           std::size_t buffer_size = 4096);
 
   private:
-    void handle_message(std::unique_ptr<std::vector<uint8_t>> message);
+    // message is a view into the recv ring, only valid during the call
+    void handle_message(std::span<const uint8_t> message);
     RecvServer recv_server_;
     Command& command_;
 };
\ No newline at end of file
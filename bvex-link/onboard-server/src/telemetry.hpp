@@ -2,6 +2,7 @@
 
 #include "command.hpp"
 #include "sample.hpp"
+#include "utils/outgoing_frame.hpp"
 #include <map>
 #include <memory>
 #include <set>
@@ -20,12 +21,16 @@ class Telemetry
      * The max size of the
      * data is limited to this.command_.get_max_packet_size()
      *
-     * @return ptr to raw bytes of sample frame packet.
+     * Metrics are served by the command's deficit round robin scheduler, so
+     * the cost of a pop does not grow with the number of idle metrics.
+     * Metrics whose retransmit timers expired since the last pop are woken
+     * first.
+     *
+     * @param frame Reused frame the packet is written into.
+     * @return false if no metric has a packet to send.
      */
-    std::optional<std::vector<uint8_t>> pop(unsigned int retry_depth = 0);
+    bool pop(OutgoingFrame& frame);
 
   private:
     Command& command_;
-    std::map<MetricId, int> metric_token_counts_;
-    MetricIterator metric_iter_;
 };
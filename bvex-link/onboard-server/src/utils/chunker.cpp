@@ -1,18 +1,85 @@
 #include "chunker.hpp"
+#include "reed_solomon.hpp"
+#include <algorithm>
 #include <cmath>
 #include <memory>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
-Chunker::Chunker(std::vector<uint8_t>&& data,
+namespace
+{
+    // Owns the bytes of a streamed file's chunks
+    struct FileStream {
+        std::vector<uint8_t> header;
+        std::shared_ptr<MappedFile> file;
+    };
+} // namespace
+
+Chunker::Chunker(std::shared_ptr<const std::vector<uint8_t>> data,
                  size_t max_chunk_size)
-    : data_(std::move(data)), normal_chunk_size_(max_chunk_size)
+    : normal_chunk_size_(max_chunk_size),
+      fec_({.block_size = 0, .num_parity = 0})
+{
+    if(data == nullptr || data->size() == 0) {
+        throw std::invalid_argument("Data cannot be empty");
+    }
+    data_ = std::span<const uint8_t>(*data);
+    owner_ = std::move(data);
+    data_size_ = data_.size();
+    num_data_chunks_ = static_cast<unsigned int>(
+        (data_size_ + max_chunk_size - 1) / max_chunk_size);
+    num_chunks_ = num_data_chunks_;
+}
+
+Chunker::Chunker(std::vector<uint8_t> data, size_t max_chunk_size,
+                 FecParams fec)
+    : normal_chunk_size_(max_chunk_size), fec_(fec)
 {
-    if(data_.size() == 0) {
+    if(data.size() == 0) {
         throw std::invalid_argument("Data cannot be empty");
     }
-    num_chunks_ = static_cast<unsigned int>(
-        (data_.size() + max_chunk_size - 1) / max_chunk_size);
+    if(fec_.num_parity > 0 &&
+       (fec_.block_size == 0 || fec_.block_size + fec_.num_parity > 256)) {
+        throw std::invalid_argument(
+            "Erasure coded blocks need 1 to 256 chunks");
+    }
+    data_size_ = data.size();
+    num_data_chunks_ = static_cast<unsigned int>(
+        (data_size_ + max_chunk_size - 1) / max_chunk_size);
+    num_chunks_ = num_data_chunks_;
+    if(fec_.num_parity > 0) {
+        unsigned int num_blocks =
+            (num_data_chunks_ + fec_.block_size - 1) / fec_.block_size;
+        num_chunks_ += num_blocks * fec_.num_parity;
+        encode_parity(data);
+    }
+    auto owner =
+        std::make_shared<const std::vector<uint8_t>>(std::move(data));
+    data_ = std::span<const uint8_t>(*owner);
+    owner_ = std::move(owner);
+}
+
+Chunker::Chunker(std::vector<uint8_t> header, std::shared_ptr<MappedFile> file,
+                 size_t max_chunk_size)
+    : file_(file), normal_chunk_size_(max_chunk_size),
+      fec_({.block_size = 0, .num_parity = 0})
+{
+    if(header.size() == 0 || header.size() > max_chunk_size) {
+        throw std::invalid_argument("Header must fit in one chunk");
+    }
+    if(file_ == nullptr) {
+        throw std::invalid_argument("File cannot be null");
+    }
+    auto stream = std::make_shared<const FileStream>(
+        FileStream{.header = std::move(header), .file = file_});
+    header_ = std::span<const uint8_t>(stream->header);
+    data_ = file_->bytes();
+    owner_ = std::move(stream);
+    data_size_ = data_.size();
+    num_data_chunks_ = static_cast<unsigned int>(
+        (data_size_ + max_chunk_size - 1) / max_chunk_size);
+    num_chunks_ = num_data_chunks_ + 1;
 }
 
 Chunk Chunker::get_chunk(SeqNum seq_num)
@@ -21,26 +88,130 @@ Chunk Chunker::get_chunk(SeqNum seq_num)
         throw std::out_of_range("Sequence number out of range");
     }
 
+    if(!header_.empty()) {
+        if(seq_num == 0) {
+            return Chunk{0, 0, header_};
+        }
+        size_t offset = get_chunk_offset(seq_num - 1);
+        size_t size = get_chunk_size(seq_num - 1);
+        return Chunk{seq_num, header_.size() + offset,
+                     data_.subspan(offset, size)};
+    }
+
     size_t offset = get_chunk_offset(seq_num);
     size_t size = get_chunk_size(seq_num);
 
-    auto chunk_data = std::make_unique<std::vector<uint8_t>>(
-        data_.begin() + offset, data_.begin() + offset + size);
-
-    return Chunk{seq_num, offset, std::move(chunk_data)};
+    return Chunk{seq_num, offset, data_.subspan(offset, size)};
 }
 
 unsigned int Chunker::get_num_chunks() { return num_chunks_; }
 
+std::shared_ptr<const void> Chunker::get_owner() { return owner_; }
+
+void Chunker::release_below(SeqNum seq_num)
+{
+    if(file_ == nullptr || seq_num <= 1) {
+        return;
+    }
+    file_->release_until(static_cast<size_t>(seq_num - 1) *
+                         normal_chunk_size_);
+}
+
+bool Chunker::is_truncated()
+{
+    return file_ != nullptr && file_->is_truncated();
+}
+
+const MappedFile* Chunker::get_file() { return file_.get(); }
+
+size_t Chunker::get_data_size() { return header_.size() + data_size_; }
+
+FecParams Chunker::get_fec() { return fec_; }
+
+unsigned int Chunker::get_block(SeqNum seq_num)
+{
+    if(fec_.num_parity == 0) {
+        return 0;
+    }
+    return seq_num / (fec_.block_size + fec_.num_parity);
+}
+
+SeqNum Chunker::get_block_start(unsigned int block)
+{
+    return block * (fec_.block_size + fec_.num_parity);
+}
+
+unsigned int Chunker::get_block_num_data(unsigned int block)
+{
+    if(fec_.num_parity == 0) {
+        return num_data_chunks_;
+    }
+    unsigned int first_data_chunk = block * fec_.block_size;
+    return std::min(fec_.block_size, num_data_chunks_ - first_data_chunk);
+}
+
+unsigned int Chunker::get_block_num_chunks(unsigned int block)
+{
+    return get_block_num_data(block) + fec_.num_parity;
+}
+
 size_t Chunker::get_chunk_offset(SeqNum seq_num)
 {
-    return seq_num * normal_chunk_size_;
+    if(fec_.num_parity == 0) {
+        return seq_num * normal_chunk_size_;
+    }
+    unsigned int block = get_block(seq_num);
+    unsigned int index = seq_num - get_block_start(block);
+    unsigned int num_data = get_block_num_data(block);
+    if(index < num_data) {
+        return (block * fec_.block_size + index) * normal_chunk_size_;
+    }
+    // parity chunks are stored after the data, in block order
+    size_t parity_chunk = block * fec_.num_parity + (index - num_data);
+    return data_size_ + parity_chunk * normal_chunk_size_;
 }
 
 size_t Chunker::get_chunk_size(SeqNum seq_num)
 {
-    if(seq_num == num_chunks_ - 1) {
-        return data_.size() - get_chunk_offset(seq_num);
+    size_t offset = get_chunk_offset(seq_num);
+    if(offset < data_size_) {
+        // only the last data chunk can be short
+        return std::min(normal_chunk_size_, data_size_ - offset);
     }
     return normal_chunk_size_;
-}
\ No newline at end of file
+}
+
+void Chunker::encode_parity(std::vector<uint8_t>& data)
+{
+    ReedSolomon reed_solomon(fec_.block_size, fec_.num_parity);
+    unsigned int num_blocks =
+        (num_data_chunks_ + fec_.block_size - 1) / fec_.block_size;
+    data.resize(data_size_ +
+                num_blocks * fec_.num_parity * normal_chunk_size_);
+
+    std::vector<std::span<const uint8_t>> data_chunks(fec_.block_size);
+    std::vector<std::span<uint8_t>> parity_chunks(fec_.num_parity);
+    for(unsigned int block = 0; block < num_blocks; block++) {
+        unsigned int num_data = get_block_num_data(block);
+        for(unsigned int i = 0; i < fec_.block_size; i++) {
+            // chunks past the end of the data are zero padding
+            if(i < num_data) {
+                size_t offset =
+                    (block * fec_.block_size + i) * normal_chunk_size_;
+                data_chunks[i] = std::span<const uint8_t>(
+                    data.data() + offset,
+                    std::min(normal_chunk_size_, data_size_ - offset));
+            } else {
+                data_chunks[i] = {};
+            }
+        }
+        for(unsigned int j = 0; j < fec_.num_parity; j++) {
+            size_t offset =
+                data_size_ +
+                (block * fec_.num_parity + j) * normal_chunk_size_;
+            parity_chunks[j] =
+                std::span<uint8_t>(data.data() + offset, normal_chunk_size_);
+        }
+        reed_solomon.encode(data_chunks, parity_chunks);
+    }
+}
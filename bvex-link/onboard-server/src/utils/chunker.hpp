@@ -1,47 +1,131 @@
 #pragma once
 
 #include "../sample.hpp"
+#include "mapped_file.hpp"
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
 typedef uint32_t SeqNum;
 
+/**
+ * @brief Erasure coding of a chunker's data.
+ *
+ * Data chunks are grouped into blocks of block_size, the last block possibly
+ * shorter, and every block is followed by num_parity Reed-Solomon parity
+ * chunks. A block is sent as its data chunks then its parity chunks, so
+ * seqnums of block b start at b * (block_size + num_parity). The short last
+ * block is coded as if padded with zero chunks, and the last data chunk as
+ * if padded with zeros to the normal chunk size, so the ground can rebuild
+ * any block from any block_size chunks of it, counting the padding as
+ * recieved.
+ */
+struct FecParams {
+    unsigned int block_size;
+    // 0 disables erasure coding
+    unsigned int num_parity;
+};
+
 // Represents a segment of a greater piece of data
 struct Chunk {
     SeqNum seq_num; // Unique to each chunk for a given piece of data
     size_t offset;  // byte offset of the chunk in the data
-    std::unique_ptr<std::vector<uint8_t>> data; // The data segment of the chunk
+    std::span<const uint8_t> data; // view of the data segment of the chunk
 };
 
 // Represents a piece of data that has been segmented
 class Chunker
 {
   public:
-    Chunker(std::vector<uint8_t>&& data, size_t max_chunk_size);
+    Chunker(std::shared_ptr<const std::vector<uint8_t>> data,
+            size_t max_chunk_size);
+
+    // Chunk data with erasure coding. The parity chunks are appended to data.
+    Chunker(std::vector<uint8_t> data, size_t max_chunk_size, FecParams fec);
+
+    // Chunk a mapped file in place, after a header chunk. Seqnum 0 is the
+    // whole header, which must fit in one chunk, and seqnum i is file chunk
+    // i - 1. Offsets and the data size count the header, so the ground gets
+    // the header followed by the file.
+    Chunker(std::vector<uint8_t> header, std::shared_ptr<MappedFile> file,
+            size_t max_chunk_size);
 
     // get chunk by its unique sequence number
     // seq_num must be in the range [0, num_chunks)
+    // The chunk views into the chunker's data, see get_data.
     Chunk get_chunk(SeqNum seq_num);
 
-    // get the total number of chunks
+    // get the total number of chunks, including parity chunks
     unsigned int get_num_chunks();
 
+    // get the number of bytes of data, with the header but excluding parity
+    size_t get_data_size();
+
+    // num_parity is 0 if the data is not erasure coded
+    FecParams get_fec();
+
+    // get the erasure coding block of a chunk
+    unsigned int get_block(SeqNum seq_num);
+
+    // get the seqnum of the first chunk of a block
+    SeqNum get_block_start(unsigned int block);
+
+    // get the number of data chunks in a block, excluding zero padding
+    unsigned int get_block_num_data(unsigned int block);
+
+    // get the number of chunks in a block, data and parity
+    unsigned int get_block_num_chunks(unsigned int block);
+
+    // get the owner of the bytes chunks view into, hold on to it to keep
+    // chunks valid after the chunker is destroyed
+    std::shared_ptr<const void> get_owner();
+
+    // Chunks below seq_num have been acked and will not be sent again, so a
+    // mapped file's pages under them can be dropped from memory
+    void release_below(SeqNum seq_num);
+
+    // Whether the chunker's mapped file was truncated, so its chunks can no
+    // longer be read. Always false for data in memory.
+    bool is_truncated();
+
+    // the mapped file chunks view into, nullptr if the data is in memory
+    const MappedFile* get_file();
+
   private:
     // get the byte offset of the chunk in the data
     size_t get_chunk_offset(SeqNum seq_num);
 
+    // append the parity chunks of every block to data
+    void encode_parity(std::vector<uint8_t>& data);
+
     // get the size of the chunk in bytes
     size_t get_chunk_size(SeqNum seq_num);
 
-    // the piece of data that we get the segments from
-    std::vector<uint8_t> data_;
+    // keeps the bytes of header_ and data_ alive
+    std::shared_ptr<const void> owner_;
+
+    // the piece of data that we get the segments from, with parity chunks
+    std::span<const uint8_t> data_;
+
+    // sent as seqnum 0 ahead of data_, empty if there is none
+    std::span<const uint8_t> header_;
+
+    // the file data_ views, nullptr if the data is in memory
+    std::shared_ptr<MappedFile> file_;
 
     // the size of each chunk possibly excluding the last one
     size_t normal_chunk_size_;
 
     // the total number of chunks
     unsigned int num_chunks_;
+
+    // bytes of data before the parity chunks
+    size_t data_size_;
+
+    unsigned int num_data_chunks_;
+
+    FecParams fec_;
 };
@@ -0,0 +1,108 @@
+#include "drr_scheduler.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+DrrScheduler::DrrScheduler(size_t base_quantum)
+    : base_quantum_(base_quantum), flows_(), token_thresholds_(),
+      head_(NO_FLOW), num_active_(0)
+{
+}
+
+FlowId DrrScheduler::add_flow(unsigned int token_threshold)
+{
+    FlowId flow = static_cast<FlowId>(flows_.size());
+    flows_.push_back(Flow{.quantum = quantum_for(token_threshold),
+                          .deficit = 0,
+                          .active = false,
+                          .in_turn = false,
+                          .next = NO_FLOW,
+                          .prev = NO_FLOW});
+    token_thresholds_.push_back(token_threshold);
+    return flow;
+}
+
+void DrrScheduler::set_token_threshold(FlowId flow,
+                                       unsigned int token_threshold)
+{
+    token_thresholds_.at(flow) = token_threshold;
+    flows_[flow].quantum = quantum_for(token_threshold);
+}
+
+void DrrScheduler::set_base_quantum(size_t base_quantum)
+{
+    base_quantum_ = base_quantum;
+    for(FlowId flow = 0; flow < flows_.size(); flow++) {
+        flows_[flow].quantum = quantum_for(token_thresholds_[flow]);
+    }
+}
+
+void DrrScheduler::activate(FlowId flow)
+{
+    Flow& new_flow = flows_.at(flow);
+    if(new_flow.active) {
+        return;
+    }
+    new_flow.active = true;
+    new_flow.in_turn = false;
+    new_flow.deficit = 0;
+    if(head_ == NO_FLOW) {
+        new_flow.next = flow;
+        new_flow.prev = flow;
+        head_ = flow;
+    } else {
+        // insert at the tail, just before head_
+        FlowId tail = flows_[head_].prev;
+        new_flow.next = head_;
+        new_flow.prev = tail;
+        flows_[tail].next = flow;
+        flows_[head_].prev = flow;
+    }
+    num_active_++;
+}
+
+bool DrrScheduler::is_active(FlowId flow) const
+{
+    return flows_.at(flow).active;
+}
+
+size_t DrrScheduler::get_num_active() const { return num_active_; }
+
+size_t DrrScheduler::get_num_flows() const { return flows_.size(); }
+
+void DrrScheduler::deactivate(FlowId flow)
+{
+    Flow& old_flow = flows_[flow];
+    if(!old_flow.active) {
+        return;
+    }
+    if(old_flow.next == flow) {
+        head_ = NO_FLOW;
+    } else {
+        flows_[old_flow.prev].next = old_flow.next;
+        flows_[old_flow.next].prev = old_flow.prev;
+        if(head_ == flow) {
+            head_ = old_flow.next;
+        }
+    }
+    // idle flows do not bank credit, as in standard DRR
+    old_flow.active = false;
+    old_flow.in_turn = false;
+    old_flow.deficit = 0;
+    old_flow.next = NO_FLOW;
+    old_flow.prev = NO_FLOW;
+    num_active_--;
+}
+
+void DrrScheduler::next_turn()
+{
+    flows_[head_].in_turn = false;
+    head_ = flows_[head_].next;
+}
+
+long DrrScheduler::quantum_for(unsigned int token_threshold) const
+{
+    size_t threshold = std::max(token_threshold, 1u);
+    return static_cast<long>(std::max<size_t>(base_quantum_ / threshold, 1));
+}
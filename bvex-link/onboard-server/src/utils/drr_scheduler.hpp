@@ -0,0 +1,111 @@
+#pragma once
+
+#include "outgoing_frame.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+typedef uint32_t FlowId;
+
+/**
+ * @brief Deficit round robin scheduler over the metrics that have something
+ * to send.
+ *
+ * Every metric is a flow with a byte quantum of base_quantum /
+ * token_threshold, so a metric with token_threshold n gets 1/n of the link
+ * share of a metric with token_threshold 1. Only active flows are kept in the
+ * round robin list, so idle metrics cost nothing per pop. A flow becomes
+ * active through activate() and is dropped from the list as soon as it has
+ * nothing to send.
+ *
+ * Packet sizes are only known after a packet has been built, so a flow may
+ * send while its deficit is positive and the packet size is subtracted
+ * afterwards. A flow that overdraws waits proportionally more rounds.
+ */
+class DrrScheduler
+{
+  public:
+    DrrScheduler(size_t base_quantum);
+
+    // Register a new, inactive flow. Flow ids are dense, starting at 0.
+    FlowId add_flow(unsigned int token_threshold = 1);
+
+    void set_token_threshold(FlowId flow, unsigned int token_threshold);
+
+    // Quantum of a flow with token_threshold 1, normally the max packet size
+    void set_base_quantum(size_t base_quantum);
+
+    // Add flow to the round robin list if it is not already in it
+    void activate(FlowId flow);
+
+    bool is_active(FlowId flow) const;
+
+    size_t get_num_active() const;
+
+    size_t get_num_flows() const;
+
+    /**
+     * @brief Write the next packet into frame.
+     *
+     * @param get_pkt Callable bool(FlowId, OutgoingFrame&) that writes the
+     * flow's next packet into the frame, or returns false if the flow has
+     * nothing to send.
+     * @return false if no active flow had anything to send.
+     */
+    template <typename GetPkt> bool pop(OutgoingFrame& frame, GetPkt&& get_pkt);
+
+  private:
+    static constexpr FlowId NO_FLOW = static_cast<FlowId>(-1);
+
+    struct Flow {
+        long quantum;
+        long deficit;
+        bool active;
+        // whether the quantum of the current round has been added
+        bool in_turn;
+        // neighbours in the circular list of active flows
+        FlowId next;
+        FlowId prev;
+    };
+
+    void deactivate(FlowId flow);
+
+    // end the turn of the head flow and move on to the next one
+    void next_turn();
+
+    long quantum_for(unsigned int token_threshold) const;
+
+    size_t base_quantum_;
+    std::vector<Flow> flows_;
+    std::vector<unsigned int> token_thresholds_;
+    FlowId head_;
+    size_t num_active_;
+};
+
+template <typename GetPkt>
+bool DrrScheduler::pop(OutgoingFrame& frame, GetPkt&& get_pkt)
+{
+    while(head_ != NO_FLOW) {
+        Flow& flow = flows_[head_];
+        if(!flow.in_turn) {
+            flow.deficit += flow.quantum;
+            flow.in_turn = true;
+        }
+        if(flow.deficit <= 0) {
+            // still paying off an earlier overdraw
+            next_turn();
+            continue;
+        }
+        FlowId flow_id = head_;
+        if(!get_pkt(flow_id, frame)) {
+            deactivate(flow_id);
+            continue;
+        }
+        flow.deficit -= static_cast<long>(frame.size());
+        if(flow.deficit <= 0) {
+            next_turn();
+        }
+        return true;
+    }
+    return false;
+}
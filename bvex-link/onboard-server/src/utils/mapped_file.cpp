@@ -0,0 +1,169 @@
+#include "mapped_file.hpp"
+#include <cstdint>
+#include <fcntl.h>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // the bytes the current thread's ReadGuard covers, empty if none
+    thread_local const uint8_t* guarded_begin = nullptr;
+    thread_local const uint8_t* guarded_end = nullptr;
+    thread_local volatile sig_atomic_t guard_faulted = 0;
+
+    struct sigaction previous_sigbus;
+    uintptr_t page_size;
+    std::once_flag sigbus_handler_installed;
+
+    void handle_sigbus(int /*sig*/, siginfo_t* info, void* /*context*/)
+    {
+        const uint8_t* addr = static_cast<const uint8_t*>(info->si_addr);
+        if(guarded_begin != nullptr && addr >= guarded_begin &&
+           addr < guarded_end) {
+            // zeros in place of the pages past the file's end, so the read
+            // that faulted carries on and no other page of them faults
+            void* start = reinterpret_cast<void*>(
+                reinterpret_cast<uintptr_t>(addr) & ~(page_size - 1));
+            size_t length = static_cast<size_t>(
+                guarded_end - static_cast<const uint8_t*>(start));
+            if(mmap(start, length, PROT_READ,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1,
+                    0) != MAP_FAILED) {
+                guard_faulted = 1;
+                return;
+            }
+        }
+        // not a guarded read, the faulting access runs again and gets the
+        // previous handler or the default action
+        sigaction(SIGBUS, &previous_sigbus, nullptr);
+    }
+
+    void install_sigbus_handler()
+    {
+        page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        struct sigaction action = {};
+        action.sa_sigaction = handle_sigbus;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, &previous_sigbus);
+    }
+} // namespace
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path)
+{
+    std::call_once(sigbus_handler_installed, install_sigbus_handler);
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        std::cerr << "Could not open " << path << std::endl;
+        return nullptr;
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        std::cerr << path << " is not a regular file" << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    size_t size = static_cast<size_t>(file_stat.st_size);
+    uint8_t* data = nullptr;
+    // an empty file cannot be mapped, it is just no bytes
+    if(size > 0) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping == MAP_FAILED) {
+            std::cerr << "Could not map " << path << std::endl;
+            close(fd);
+            return nullptr;
+        }
+        data = static_cast<uint8_t*>(mapping);
+        // chunks are sent in order, so read ahead of them
+        madvise(mapping, size, MADV_SEQUENTIAL);
+    } else {
+        // nothing is read from an empty file, so there is no size to check
+        close(fd);
+        fd = -1;
+    }
+    return std::shared_ptr<MappedFile>(new MappedFile(fd, data, size));
+}
+
+MappedFile::MappedFile(int fd, uint8_t* data, size_t size)
+    : fd_(fd), data_(data), size_(size), released_until_(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    if(data_ != nullptr) {
+        munmap(data_, size_);
+    }
+    if(fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+std::span<const uint8_t> MappedFile::bytes() const
+{
+    return std::span<const uint8_t>(data_, size_);
+}
+
+void MappedFile::release_until(size_t end)
+{
+    if(end > size_) {
+        end = size_;
+    }
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    // the page holding end may still be needed by the next chunk
+    size_t released_end = end == size_ ? end : end / page_size * page_size;
+    if(released_end <= released_until_) {
+        return;
+    }
+    // the mapping starts on a page boundary, so released_until_ stays on one
+    // until the end of the file
+    madvise(data_ + released_until_, released_end - released_until_,
+            MADV_DONTNEED);
+    released_until_ = released_end;
+}
+
+size_t MappedFile::get_released_until() const { return released_until_; }
+
+bool MappedFile::is_truncated() const
+{
+    if(fd_ < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if(fstat(fd_, &file_stat) != 0) {
+        return true;
+    }
+    return static_cast<size_t>(file_stat.st_size) < size_;
+}
+
+MappedFile::ReadGuard::ReadGuard(const MappedFile* file)
+    : active_(file != nullptr && file->data_ != nullptr)
+{
+    if(!active_) {
+        return;
+    }
+    guard_faulted = 0;
+    guarded_end = file->data_ + file->size_;
+    guarded_begin = file->data_;
+}
+
+MappedFile::ReadGuard::~ReadGuard()
+{
+    if(active_) {
+        guarded_begin = nullptr;
+        guarded_end = nullptr;
+    }
+}
+
+bool MappedFile::ReadGuard::faulted() const
+{
+    return active_ && guard_faulted != 0;
+}
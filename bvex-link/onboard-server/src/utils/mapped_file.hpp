@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+
+/**
+ * @brief A file mapped read only into memory, so it can be chunked in place.
+ *
+ * Pages are only read from the file when a chunk viewing them is sent, and
+ * pages of acked chunks are dropped again with release_until, so a file
+ * being downlinked holds about the ARQ window in memory rather than all of
+ * it. Reading a page past the end of a file truncated while mapped raises
+ * SIGBUS, so bytes are only read by the process under a ReadGuard.
+ */
+class MappedFile
+{
+  public:
+    // Map the file at path. Returns nullptr if it cannot be opened or mapped.
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<const uint8_t> bytes() const;
+
+    /**
+     * @brief While alive, a SIGBUS raised by the calling thread reading the
+     * file's bytes maps zeros over the rest of the mapping and is recorded,
+     * rather than killing the process.
+     *
+     * The read that faulted carries on over the zeros, so whatever was read
+     * under the guard must be thrown away if faulted() is true. Guards do
+     * not nest. A null file guards nothing.
+     */
+    class ReadGuard
+    {
+      public:
+        explicit ReadGuard(const MappedFile* file);
+        ~ReadGuard();
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        // Whether the file was found truncated while guarded
+        bool faulted() const;
+
+      private:
+        bool active_;
+    };
+
+    // Drop the pages that lie entirely before byte end from memory. They are
+    // read back from the file if touched again.
+    void release_until(size_t end);
+
+    // Bytes before this have been released
+    size_t get_released_until() const;
+
+    // Whether the file is now shorter than when it was mapped, or can no
+    // longer be checked. Its bytes must not be read once it is.
+    bool is_truncated() const;
+
+  private:
+    MappedFile(int fd, uint8_t* data, size_t size);
+
+    // kept open to check the file's size, -1 for an empty file
+    int fd_;
+    uint8_t* data_;
+    size_t size_;
+    size_t released_until_;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+/**
+ * @brief A downlink datagram, as a header followed by a payload view.
+ *
+ * The datagram is sent with scatter-gather IO so the payload is never copied
+ * next to the header. SendServer reuses one OutgoingFrame for every packet,
+ * so header keeps its capacity between packets.
+ */
+struct OutgoingFrame {
+    std::vector<uint8_t> header;
+
+    // view into the bytes owned by payload_owner, may be empty
+    std::span<const uint8_t> payload;
+
+    // keeps the bytes payload views alive until the datagram has been sent
+    std::shared_ptr<const void> payload_owner;
+
+    size_t size() const { return header.size() + payload.size(); }
+};
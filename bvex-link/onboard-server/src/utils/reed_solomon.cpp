@@ -0,0 +1,223 @@
+#include "reed_solomon.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    // GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1
+    constexpr unsigned int GF_POLYNOMIAL = 0x11D;
+
+    struct GaloisTables {
+        // exp is doubled so exp[log a + log b] needs no modulo
+        std::array<uint8_t, 512> exp;
+        std::array<uint8_t, 256> log;
+        // mul[a][b] = a * b, rows are used as lookup tables for a fixed
+        // coefficient
+        std::array<std::array<uint8_t, 256>, 256> mul;
+
+        GaloisTables() : exp(), log(), mul()
+        {
+            unsigned int x = 1;
+            for(unsigned int i = 0; i < 255; i++) {
+                exp[i] = static_cast<uint8_t>(x);
+                log[x] = static_cast<uint8_t>(i);
+                x <<= 1;
+                if(x & 0x100) {
+                    x ^= GF_POLYNOMIAL;
+                }
+            }
+            for(unsigned int i = 255; i < exp.size(); i++) {
+                exp[i] = exp[i - 255];
+            }
+            for(unsigned int a = 1; a < 256; a++) {
+                for(unsigned int b = 1; b < 256; b++) {
+                    mul[a][b] = exp[log[a] + log[b]];
+                }
+            }
+        }
+    };
+
+    const GaloisTables& tables()
+    {
+        static const GaloisTables galois_tables;
+        return galois_tables;
+    }
+
+    uint8_t gf_mul(uint8_t a, uint8_t b) { return tables().mul[a][b]; }
+
+    uint8_t gf_inv(uint8_t a)
+    {
+        if(a == 0) {
+            throw std::domain_error("Zero has no inverse in GF(2^8)");
+        }
+        return tables().exp[255 - tables().log[a]];
+    }
+
+    // out ^= coefficient * in, over the bytes of in
+    void mul_add(uint8_t coefficient, std::span<const uint8_t> in,
+                 std::span<uint8_t> out)
+    {
+        if(coefficient == 0) {
+            return;
+        }
+        const std::array<uint8_t, 256>& row = tables().mul[coefficient];
+        for(size_t i = 0; i < in.size(); i++) {
+            out[i] ^= row[in[i]];
+        }
+    }
+
+    // Invert the size x size row major matrix in place by Gauss-Jordan
+    // elimination. Returns false if it is singular.
+    bool invert(std::vector<uint8_t>& matrix, unsigned int size)
+    {
+        std::vector<uint8_t> inverse(size * size, 0);
+        for(unsigned int i = 0; i < size; i++) {
+            inverse[i * size + i] = 1;
+        }
+        for(unsigned int col = 0; col < size; col++) {
+            unsigned int pivot = col;
+            while(pivot < size && matrix[pivot * size + col] == 0) {
+                pivot++;
+            }
+            if(pivot == size) {
+                return false;
+            }
+            if(pivot != col) {
+                for(unsigned int k = 0; k < size; k++) {
+                    std::swap(matrix[pivot * size + k],
+                              matrix[col * size + k]);
+                    std::swap(inverse[pivot * size + k],
+                              inverse[col * size + k]);
+                }
+            }
+            uint8_t scale = gf_inv(matrix[col * size + col]);
+            for(unsigned int k = 0; k < size; k++) {
+                matrix[col * size + k] =
+                    gf_mul(matrix[col * size + k], scale);
+                inverse[col * size + k] =
+                    gf_mul(inverse[col * size + k], scale);
+            }
+            for(unsigned int row = 0; row < size; row++) {
+                uint8_t factor = matrix[row * size + col];
+                if(row == col || factor == 0) {
+                    continue;
+                }
+                for(unsigned int k = 0; k < size; k++) {
+                    matrix[row * size + k] ^=
+                        gf_mul(factor, matrix[col * size + k]);
+                    inverse[row * size + k] ^=
+                        gf_mul(factor, inverse[col * size + k]);
+                }
+            }
+        }
+        matrix = std::move(inverse);
+        return true;
+    }
+} // namespace
+
+ReedSolomon::ReedSolomon(unsigned int num_data, unsigned int num_parity)
+    : num_data_(num_data), num_parity_(num_parity)
+{
+    if(num_data == 0 || num_data + num_parity > 256) {
+        throw std::invalid_argument(
+            "Reed-Solomon needs 1 to 256 shards and at least one data shard");
+    }
+    generator_.assign((num_data + num_parity) * num_data, 0);
+    for(unsigned int i = 0; i < num_data; i++) {
+        generator_[i * num_data + i] = 1;
+    }
+    // Cauchy matrix 1 / (x_j + y_i) with x_j = num_data + j and y_i = i,
+    // all distinct so no denominator is zero
+    for(unsigned int j = 0; j < num_parity; j++) {
+        for(unsigned int i = 0; i < num_data; i++) {
+            generator_[(num_data + j) * num_data + i] =
+                gf_inv(static_cast<uint8_t>((num_data + j) ^ i));
+        }
+    }
+}
+
+unsigned int ReedSolomon::get_num_data() const { return num_data_; }
+
+unsigned int ReedSolomon::get_num_parity() const { return num_parity_; }
+
+void ReedSolomon::encode(std::span<const std::span<const uint8_t>> data,
+                         std::span<const std::span<uint8_t>> parity) const
+{
+    if(data.size() != num_data_ || parity.size() != num_parity_) {
+        throw std::invalid_argument("Wrong number of shards");
+    }
+    for(unsigned int j = 0; j < num_parity_; j++) {
+        std::fill(parity[j].begin(), parity[j].end(), 0);
+        std::span<const uint8_t> row = generator_row(num_data_ + j);
+        for(unsigned int i = 0; i < num_data_; i++) {
+            if(data[i].size() > parity[j].size()) {
+                throw std::invalid_argument(
+                    "Data shard larger than parity shard");
+            }
+            mul_add(row[i], data[i], parity[j]);
+        }
+    }
+}
+
+bool ReedSolomon::reconstruct(std::span<const std::span<uint8_t>> shards,
+                              const std::vector<bool>& present) const
+{
+    unsigned int num_shards = num_data_ + num_parity_;
+    if(shards.size() != num_shards || present.size() != num_shards) {
+        throw std::invalid_argument("Wrong number of shards");
+    }
+
+    // rebuild from the first num_data present shards
+    std::vector<unsigned int> used;
+    bool missing_data = false;
+    for(unsigned int shard = 0; shard < num_shards; shard++) {
+        if(present[shard] && used.size() < num_data_) {
+            used.push_back(shard);
+        }
+        if(shard < num_data_ && !present[shard]) {
+            missing_data = true;
+        }
+    }
+    if(!missing_data) {
+        return true;
+    }
+    if(used.size() < num_data_) {
+        return false;
+    }
+
+    // used shards = submatrix * data, so data = submatrix^-1 * used shards
+    std::vector<uint8_t> decode_matrix(num_data_ * num_data_);
+    for(unsigned int r = 0; r < num_data_; r++) {
+        std::span<const uint8_t> row = generator_row(used[r]);
+        std::copy(row.begin(), row.end(),
+                  decode_matrix.begin() + r * num_data_);
+    }
+    if(!invert(decode_matrix, num_data_)) {
+        return false; // unreachable for a Cauchy generator
+    }
+
+    size_t shard_size = shards[used[0]].size();
+    for(unsigned int i = 0; i < num_data_; i++) {
+        if(present[i]) {
+            continue;
+        }
+        std::vector<uint8_t> rebuilt(shard_size, 0);
+        for(unsigned int r = 0; r < num_data_; r++) {
+            mul_add(decode_matrix[i * num_data_ + r], shards[used[r]],
+                    rebuilt);
+        }
+        std::copy(rebuilt.begin(), rebuilt.end(), shards[i].begin());
+    }
+    return true;
+}
+
+std::span<const uint8_t> ReedSolomon::generator_row(unsigned int shard) const
+{
+    return std::span<const uint8_t>(generator_).subspan(shard * num_data_,
+                                                        num_data_);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Systematic Reed-Solomon erasure code over GF(2^8).
+ *
+ * num_data data shards are sent as is, followed by num_parity parity shards.
+ * Any num_data of the num_data + num_parity shards rebuild the data shards.
+ * Parity rows of the generator matrix form a Cauchy matrix, so every square
+ * submatrix of the generator is invertible. num_data + num_parity must be at
+ * most 256.
+ */
+class ReedSolomon
+{
+  public:
+    ReedSolomon(unsigned int num_data, unsigned int num_parity);
+
+    unsigned int get_num_data() const;
+
+    unsigned int get_num_parity() const;
+
+    /**
+     * @brief Compute the parity shards of data.
+     *
+     * Data shards may be shorter than the parity shards, missing bytes are
+     * taken to be zero. Every parity shard must have the same size.
+     *
+     * @param data num_data data shards.
+     * @param parity num_parity parity shards, overwritten.
+     */
+    void encode(std::span<const std::span<const uint8_t>> data,
+                std::span<const std::span<uint8_t>> parity) const;
+
+    /**
+     * @brief Rebuild missing data shards in place from any num_data present
+     * shards.
+     *
+     * @param shards num_data + num_parity shards of equal size, data first.
+     * @param present which shards hold recieved data.
+     * @return false if fewer than num_data shards are present.
+     */
+    bool reconstruct(std::span<const std::span<uint8_t>> shards,
+                     const std::vector<bool>& present) const;
+
+  private:
+    // Row of the generator matrix for shard index, num_data coefficients
+    std::span<const uint8_t> generator_row(unsigned int shard) const;
+
+    unsigned int num_data_;
+    unsigned int num_parity_;
+    // identity rows followed by the Cauchy parity rows, row major
+    std::vector<uint8_t> generator_;
+};
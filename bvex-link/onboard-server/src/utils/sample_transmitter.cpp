@@ -1,25 +1,99 @@
 #include "sample_transmitter.hpp"
 #include "chunker.hpp"
-#include <boost/iterator/counting_iterator.hpp>
+#include <algorithm>
+#include <chrono>
 #include <codec/downlink-tm-enc/sample_frame.hpp>
 #include <functional>
 #include <iostream>
-#include <iterator>
 #include <memory>
+#include <optional>
 #include <vector>
 
 #define IPV4_OVERHEAD 20
 #define UDP_OVERHEAD 20
 
+// Lets us use s and ms after literal numbers
+using namespace std::chrono_literals;
+
+// retransmit timeout before the first RTT sample
+constexpr ArqClock::duration INITIAL_RTO = 1s;
+constexpr ArqClock::duration MIN_RTO = 50ms;
+constexpr ArqClock::duration MAX_RTO = 10s;
+// lower bound on the variance term, so a steady RTT does not give an RTO
+// right at the RTT
+constexpr ArqClock::duration RTO_CLOCK_GRANULARITY = 1ms;
+
+void append_bitmap_ranges(SeqNum base, std::span<const uint8_t> bitmap,
+                          std::vector<SeqNumRange>& ranges)
+{
+    bool in_run = false;
+    SeqNum run_first = 0;
+    for(size_t bit = 0; bit < bitmap.size() * 8; bit++) {
+        bool set = (bitmap[bit / 8] >> (bit % 8)) & 1;
+        SeqNum seqnum = base + static_cast<SeqNum>(bit);
+        if(set && !in_run) {
+            in_run = true;
+            run_first = seqnum;
+        } else if(!set && in_run) {
+            in_run = false;
+            ranges.push_back({.first = run_first, .last = seqnum - 1});
+        }
+    }
+    if(in_run) {
+        ranges.push_back(
+            {.first = run_first,
+             .last = base + static_cast<SeqNum>(bitmap.size() * 8 - 1)});
+    }
+}
+
+RttEstimator::RttEstimator()
+    : has_sample_(false), srtt_(0), rttvar_(0), rto_(INITIAL_RTO)
+{
+}
+
+void RttEstimator::add_sample(ArqClock::duration rtt)
+{
+    if(!has_sample_) {
+        has_sample_ = true;
+        srtt_ = rtt;
+        rttvar_ = rtt / 2;
+    } else {
+        ArqClock::duration error = srtt_ > rtt ? srtt_ - rtt : rtt - srtt_;
+        rttvar_ = (3 * rttvar_ + error) / 4;
+        srtt_ = (7 * srtt_ + rtt) / 8;
+    }
+    rto_ = std::clamp(srtt_ + std::max(RTO_CLOCK_GRANULARITY, 4 * rttvar_),
+                      MIN_RTO, MAX_RTO);
+}
+
+void RttEstimator::backoff() { rto_ = std::min(2 * rto_, MAX_RTO); }
+
+ArqClock::duration RttEstimator::get_rto() const { return rto_; }
+
+std::optional<ArqClock::duration> RttEstimator::get_srtt() const
+{
+    if(!has_sample_) {
+        return std::nullopt;
+    }
+    return srtt_;
+}
+
 SampleTransmitter::SampleTransmitter(
     std::function<std::shared_ptr<SampleData>()> get_new_sample,
-    std::function<size_t()> get_max_pkt_size, MetricId metric_id)
+    std::function<size_t()> get_max_pkt_size,
+    std::function<unsigned int()> get_window_size,
+    std::function<std::span<const uint8_t>(const SampleFrameData&,
+                                           std::vector<uint8_t>&)>
+        encode_frame,
+    std::string_view metric_id)
     : get_new_sample_(get_new_sample), get_max_pkt_size_(get_max_pkt_size),
-      sample_metadata_({
-          .metric_id = metric_id,
-          .timestamp = 0.0f,
-      }),
-      sample_id_(0), sample_chunker_(nullptr), unacked_seqnums_() {};
+      get_window_size_(get_window_size), encode_frame_(encode_frame),
+      metric_id_(metric_id), timestamp_(0.0f), sample_id_(0),
+      sample_chunker_(nullptr), fec_({.block_size = 0, .num_parity = 0}),
+      stream_files_(false),
+      chunks_(), block_num_acked_(), num_unacked_(0), window_base_(0),
+      next_new_(0), in_flight_head_(NO_SEQNUM),
+      in_flight_tail_(NO_SEQNUM) {};
 
 bool SampleTransmitter::set_new_sample()
 {
@@ -32,20 +106,46 @@ bool SampleTransmitter::set_new_sample()
         size_t max_segment_size = get_max_pkt_size_() - overhead;
 
         data_type_ = sample->type;
-        sample_metadata_ = sample->metadata;
+        timestamp_ = sample->metadata.timestamp;
 
-        sample_chunker_ = std::make_unique<Chunker>(
-            Chunker(std::move(sample->encode_data()), max_segment_size));
+        // erasure coding needs the whole data in memory for the parity, so
+        // only samples sent without it are streamed
+        std::shared_ptr<MappedFile> file =
+            fec_.num_parity > 0 || !stream_files_ ? nullptr
+                                                  : sample->map_file();
+        if(file != nullptr) {
+            // the ground has to tell the streamed layout from a whole file
+            data_type_ = STREAMED_FILE_DATA_TYPE;
+        }
+        if(fec_.num_parity > 0) {
+            sample_chunker_ = std::make_unique<Chunker>(
+                sample->encode_data(), max_segment_size, fec_);
+        } else if(file != nullptr) {
+            sample_chunker_ = std::make_unique<Chunker>(
+                sample->encode_header(file->bytes().size()), file,
+                max_segment_size);
+        } else {
+            sample_chunker_ = std::make_unique<Chunker>(
+                std::make_shared<const std::vector<uint8_t>>(
+                    sample->encode_data()),
+                max_segment_size);
+        }
         unsigned int num_chunks = sample_chunker_->get_num_chunks();
 
-        // set all seqnums to unacked
-        unacked_seqnums_.clear();
-        std::copy(boost::counting_iterator<int>(0),
-                  boost::counting_iterator<int>(num_chunks),
-                  std::inserter(unacked_seqnums_, unacked_seqnums_.end()));
-
-        // set iterator to first unacked seqnum
-        unacked_seqnums_itr_ = unacked_seqnums_.begin();
+        // set all seqnums to unsent and unacked
+        chunks_.assign(num_chunks, ChunkState{.sent_at = {},
+                                              .num_sends = 0,
+                                              .acked = false,
+                                              .next = NO_SEQNUM,
+                                              .prev = NO_SEQNUM});
+        block_num_acked_.assign(
+            sample_chunker_->get_block(num_chunks - 1) + 1, 0);
+        num_unacked_ = num_chunks;
+        window_base_ = 0;
+        next_new_ = 0;
+        in_flight_head_ = NO_SEQNUM;
+        in_flight_tail_ = NO_SEQNUM;
+        last_size_check_ = std::nullopt;
 
         // increment to next sample id
         sample_id_++;
@@ -54,63 +154,231 @@ bool SampleTransmitter::set_new_sample()
     }
 }
 
-std::optional<std::vector<uint8_t>> SampleTransmitter::get_pkt()
+bool SampleTransmitter::get_pkt(OutgoingFrame& frame, ArqClock::time_point now)
 {
-    if(sample_chunker_ == nullptr || unacked_seqnums_.size() == 0) {
+    if(sample_chunker_ == nullptr || num_unacked_ == 0) {
         // Get a new sample to downlink
         bool got_new_sample = set_new_sample();
         if(!got_new_sample) {
-            return std::nullopt;
+            return false;
+        }
+    }
+
+    // frames whose payload only the kernel reads never fault, their sends
+    // fail instead, so check the file's size now and then as well. It can
+    // still shrink after the check, which the read guard below covers.
+    if(!last_size_check_ || now - *last_size_check_ >= rtt_.get_rto()) {
+        last_size_check_ = now;
+        if(sample_chunker_->is_truncated()) {
+            std::cerr << "File of " << metric_id_ << " sample "
+                      << sample_id_ << " was truncated, dropping it"
+                      << std::endl;
+            drop_sample();
+            return get_pkt(frame, now);
+        }
+    }
+
+    // the oldest chunk in flight has the earliest timer, resend it first
+    SeqNum seq_num;
+    if(in_flight_head_ != NO_SEQNUM &&
+       now - chunks_[in_flight_head_].sent_at >= rtt_.get_rto()) {
+        seq_num = in_flight_head_;
+        if(!last_backoff_ || now - *last_backoff_ >= rtt_.get_rto()) {
+            rtt_.backoff();
+            last_backoff_ = now;
         }
+    } else if(next_new_ < chunks_.size() &&
+              next_new_ - window_base_ < get_window_size_()) {
+        seq_num = next_new_++;
+    } else {
+        // window full and no timer expired
+        return false;
     }
-    unsigned int seq_num = get_itr_val();
+    send_chunk(seq_num, now);
+
     Chunk chunk = sample_chunker_->get_chunk(seq_num);
-    increment_itr();
-    SampleFrameData segment_data = {.metric_id = sample_metadata_.metric_id,
-                                    .timestamp = sample_metadata_.timestamp,
-                                    .data_type = data_type_,
-                                    .sample_id = sample_id_,
-                                    .num_segments =
-                                        sample_chunker_->get_num_chunks(),
-                                    .seqnum = seq_num,
-                                    .data = std::move(chunk.data)};
-    std::vector<uint8_t> pkt = encode_sample_frame(std::move(segment_data));
+    FecParams chunk_fec = sample_chunker_->get_fec();
+    SampleFrameData segment_data = {
+        .metric_id = metric_id_,
+        .timestamp = timestamp_,
+        .data_type = data_type_,
+        .sample_id = sample_id_,
+        .num_segments = sample_chunker_->get_num_chunks(),
+        .seqnum = seq_num,
+        .data = chunk.data,
+        .fec_block_size = chunk_fec.block_size,
+        .fec_num_parity = chunk_fec.num_parity,
+        .data_size =
+            static_cast<unsigned int>(sample_chunker_->get_data_size())};
+    bool truncated;
+    {
+        // encoding may copy the chunk out of a mapped file, which raises
+        // SIGBUS if the file was truncated since the size check
+        MappedFile::ReadGuard guard(sample_chunker_->get_file());
+        frame.payload = encode_frame_(segment_data, frame.header);
+        truncated = guard.faulted();
+    }
+    if(truncated) {
+        std::cerr << "File of " << metric_id_ << " sample " << sample_id_
+                  << " was truncated while read, dropping it" << std::endl;
+        frame.payload = {};
+        drop_sample();
+        return get_pkt(frame, now);
+    }
+    frame.payload_owner = sample_chunker_->get_owner();
 #ifdef DEBUG
-    if(pkt.size() > get_max_pkt_size_()) {
+    if(frame.size() > get_max_pkt_size_()) {
         std::cerr << "Packet size exceeds maximum packet size" << std::endl;
-        std::cerr << "Actual packet size: " << pkt.size() << std::endl;
+        std::cerr << "Actual packet size: " << frame.size() << std::endl;
         std::cerr << "Maximum packet size: " << get_max_pkt_size_()
                   << std::endl;
     }
 #endif
-    return pkt;
+    return true;
+}
+
+void SampleTransmitter::handle_ack(const std::vector<SeqNumRange>& ranges,
+                                   SampleId sample_id,
+                                   ArqClock::time_point now)
+{
+    if(sample_id != sample_id_ || next_new_ == 0) {
+        return;
+    }
+    for(const SeqNumRange& range : ranges) {
+        // chunks that were never sent cannot have been recieved
+        SeqNum last = std::min<SeqNum>(range.last, next_new_ - 1);
+        for(SeqNum seqnum = range.first; seqnum <= last; seqnum++) {
+            mark_acked(seqnum, now);
+        }
+    }
+    while(window_base_ < chunks_.size() && chunks_[window_base_].acked) {
+        window_base_++;
+    }
+    // acked chunks are never resent, so their bytes can leave memory
+    sample_chunker_->release_below(window_base_);
+    // chunks of blocks the ground can already rebuild are never sent
+    next_new_ = std::max(next_new_, window_base_);
+    while(next_new_ < chunks_.size() && chunks_[next_new_].acked) {
+        next_new_++;
+    }
+}
+
+std::optional<ArqClock::time_point> SampleTransmitter::get_next_timeout() const
+{
+    if(in_flight_head_ == NO_SEQNUM) {
+        return std::nullopt;
+    }
+    return chunks_[in_flight_head_].sent_at + rtt_.get_rto();
+}
+
+size_t SampleTransmitter::get_num_unacked() const { return num_unacked_; }
+
+void SampleTransmitter::set_fec(FecParams fec) { fec_ = fec; }
+
+FecParams SampleTransmitter::get_fec() const { return fec_; }
+
+void SampleTransmitter::set_stream_files(bool stream_files)
+{
+    stream_files_ = stream_files;
+}
+
+const RttEstimator& SampleTransmitter::get_rtt_estimator() const
+{
+    return rtt_;
+}
+
+void SampleTransmitter::drop_sample()
+{
+    sample_chunker_ = nullptr;
+    chunks_.clear();
+    block_num_acked_.clear();
+    num_unacked_ = 0;
+    window_base_ = 0;
+    // acks of the dropped sample are ignored while nothing has been sent
+    next_new_ = 0;
+    in_flight_head_ = NO_SEQNUM;
+    in_flight_tail_ = NO_SEQNUM;
+    last_size_check_ = std::nullopt;
+}
+
+void SampleTransmitter::send_chunk(SeqNum seqnum, ArqClock::time_point now)
+{
+    ChunkState& chunk = chunks_[seqnum];
+    if(chunk.num_sends > 0) {
+        unlink_in_flight(seqnum);
+    }
+    chunk.sent_at = now;
+    chunk.num_sends++;
+    push_in_flight(seqnum);
 }
-void SampleTransmitter::handle_ack(const std::vector<uint32_t>& seqnums,
-                                   SampleId sample_id)
+
+void SampleTransmitter::mark_acked(SeqNum seqnum, ArqClock::time_point now)
 {
-    if(sample_id != sample_id_) {
+    ChunkState& chunk = chunks_[seqnum];
+    if(chunk.acked) {
+        return;
+    }
+    // a resent chunk's ack could be for any of its sends, so it gives no
+    // RTT sample
+    if(chunk.num_sends == 1) {
+        rtt_.add_sample(now - chunk.sent_at);
+    }
+    set_acked(seqnum);
+
+    if(sample_chunker_->get_fec().num_parity == 0) {
         return;
     }
-    // TODO: Reposition itr dynamically as erasing
-    // so we dont go back to start every erasure
-    int num_erased = 0;
-    for(auto seqnum : seqnums) {
-        if(unacked_seqnums_.find(seqnum) != unacked_seqnums_.end()) {
-            unacked_seqnums_.erase(seqnum);
-            num_erased++;
+    unsigned int block = sample_chunker_->get_block(seqnum);
+    block_num_acked_[block]++;
+    if(block_num_acked_[block] == sample_chunker_->get_block_num_data(block)) {
+        // the ground can rebuild the rest of the block
+        SeqNum block_start = sample_chunker_->get_block_start(block);
+        SeqNum block_end =
+            block_start + sample_chunker_->get_block_num_chunks(block);
+        for(SeqNum other = block_start; other < block_end; other++) {
+            if(!chunks_[other].acked) {
+                set_acked(other);
+            }
         }
     }
-    if(num_erased > 0) {
-        unacked_seqnums_itr_ = unacked_seqnums_.begin();
+}
+
+void SampleTransmitter::set_acked(SeqNum seqnum)
+{
+    ChunkState& chunk = chunks_[seqnum];
+    chunk.acked = true;
+    num_unacked_--;
+    if(chunk.num_sends > 0) {
+        unlink_in_flight(seqnum);
     }
 }
 
-void SampleTransmitter::increment_itr()
+void SampleTransmitter::push_in_flight(SeqNum seqnum)
 {
-    unacked_seqnums_itr_++;
-    if(unacked_seqnums_itr_ == unacked_seqnums_.end()) {
-        unacked_seqnums_itr_ = unacked_seqnums_.begin();
+    ChunkState& chunk = chunks_[seqnum];
+    chunk.next = NO_SEQNUM;
+    chunk.prev = in_flight_tail_;
+    if(in_flight_tail_ == NO_SEQNUM) {
+        in_flight_head_ = seqnum;
+    } else {
+        chunks_[in_flight_tail_].next = seqnum;
     }
+    in_flight_tail_ = seqnum;
 }
 
-unsigned int SampleTransmitter::get_itr_val() { return *unacked_seqnums_itr_; }
+void SampleTransmitter::unlink_in_flight(SeqNum seqnum)
+{
+    ChunkState& chunk = chunks_[seqnum];
+    if(chunk.prev == NO_SEQNUM) {
+        in_flight_head_ = chunk.next;
+    } else {
+        chunks_[chunk.prev].next = chunk.next;
+    }
+    if(chunk.next == NO_SEQNUM) {
+        in_flight_tail_ = chunk.prev;
+    } else {
+        chunks_[chunk.next].prev = chunk.prev;
+    }
+    chunk.next = NO_SEQNUM;
+    chunk.prev = NO_SEQNUM;
+}
@@ -1,45 +1,183 @@
 #pragma once
 
-#include "../command.hpp"
 #include "../sample.hpp"
 #include "chunker.hpp"
+#include "outgoing_frame.hpp"
+#include <chrono>
+#include <codec/downlink-tm-enc/sample_frame.hpp>
 #include <cstdint>
 #include <functional>
 #include <memory>
-#include <set>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
 typedef uint32_t SampleId;
 
-// Class to handle the segmented transmission of samples
+// Clock used for retransmit timers and RTT measurement
+typedef std::chrono::steady_clock ArqClock;
+
+// Number of chunks that may be sent past the lowest unacked chunk
+constexpr unsigned int DEFAULT_ARQ_WINDOW_SIZE = 256;
+
+// Data type of a file sample streamed as a header chunk followed by the
+// file's raw bytes, rather than encoded whole as a "file"
+constexpr std::string_view STREAMED_FILE_DATA_TYPE = "file_stream";
+
+// Inclusive range of acked sequence numbers
+struct SeqNumRange {
+    SeqNum first;
+    SeqNum last;
+};
+
+/**
+ * @brief Append the acked ranges of a selective ack bitmap to ranges.
+ *
+ * Bit i of the bitmap, counting from the least significant bit of byte 0,
+ * acks seqnum base + i. Runs of set bits become one range each.
+ */
+void append_bitmap_ranges(SeqNum base, std::span<const uint8_t> bitmap,
+                          std::vector<SeqNumRange>& ranges);
+
+/**
+ * @brief Smoothed round trip time estimate and retransmit timeout, as in
+ * RFC 6298.
+ */
+class RttEstimator
+{
+  public:
+    RttEstimator();
+
+    void add_sample(ArqClock::duration rtt);
+
+    // Double the retransmit timeout after a timeout, until the next sample
+    void backoff();
+
+    ArqClock::duration get_rto() const;
+
+    // std::nullopt until the first sample
+    std::optional<ArqClock::duration> get_srtt() const;
+
+  private:
+    bool has_sample_;
+    ArqClock::duration srtt_;
+    ArqClock::duration rttvar_;
+    ArqClock::duration rto_;
+};
+
+/**
+ * @brief Selective repeat transmission of the chunks of one metric's samples.
+ *
+ * At most window_size chunks past the lowest unacked chunk are in flight.
+ * Acked chunks are never resent. An unacked chunk is resent once its own
+ * timer, set when it was last sent, passes the retransmit timeout estimated
+ * from measured round trip times. Only chunks sent once give RTT samples,
+ * and the timeout is doubled on expiry until a new sample comes in (Karn's
+ * algorithm). The timeout is backed off at most once per timeout period, not
+ * once per expired chunk.
+ *
+ * A new sample is only taken once every chunk of the current one is acked.
+ *
+ * With erasure coding on, parity chunks are sent and acked like data chunks,
+ * and once as many chunks of a block are acked as it has data chunks the
+ * ground can rebuild the block, so the rest of it counts as acked.
+ */
 class SampleTransmitter
 {
   public:
+    // metric_id must outlive the transmitter, normally it is the id held by
+    // Command's MetricRegistry
     SampleTransmitter(
         std::function<std::shared_ptr<SampleData>()> get_new_sample,
-        std::function<size_t()> get_max_pkt_size, MetricId metric_id);
+        std::function<size_t()> get_max_pkt_size,
+        std::function<unsigned int()> get_window_size,
+        std::function<std::span<const uint8_t>(const SampleFrameData&,
+                                               std::vector<uint8_t>&)>
+            encode_frame,
+        std::string_view metric_id);
+
+    // Write the next packet to downlink into frame. Returns false if there is
+    // nothing to send now, either because there is no sample or because the
+    // window is full and no retransmit timer has expired. The payload of
+    // frame views into the sample's encoded data, so no per packet copy is
+    // made. A file sample whose file was truncated is dropped unsent, and the
+    // next sample is sent instead.
+    bool get_pkt(OutgoingFrame& frame, ArqClock::time_point now);
+
+    // Mark the chunks in ranges as succesfully recieved
+    void handle_ack(const std::vector<SeqNumRange>& ranges,
+                    SampleId sample_id, ArqClock::time_point now);
+
+    // Time at which the earliest retransmit timer expires, std::nullopt if
+    // nothing is in flight
+    std::optional<ArqClock::time_point> get_next_timeout() const;
+
+    // Number of chunks of the current sample not yet acked
+    size_t get_num_unacked() const;
 
-    // Get the next payload to downlink
-    std::optional<std::vector<uint8_t>> get_pkt();
+    // Erasure code samples from the next one on. num_parity 0 disables it.
+    void set_fec(FecParams fec);
 
-    // Mark a sequence number as succesfully recieved
-    void handle_ack(const std::vector<SeqNum>& seqnums,
-                    SampleId sample_id);
+    FecParams get_fec() const;
 
-    // // Mark the sample as succesfully recieved
-    // void signal_sample_recieved(SampleId sample_id);
+    // Stream file samples from the next one on, when they are not erasure
+    // coded. Off by default, so file samples are sent whole as "file".
+    void set_stream_files(bool stream_files);
+
+    const RttEstimator& get_rtt_estimator() const;
 
   private:
+    static constexpr SeqNum NO_SEQNUM = static_cast<SeqNum>(-1);
+
+    struct ChunkState {
+        ArqClock::time_point sent_at;
+        unsigned int num_sends;
+        bool acked;
+        // neighbours in the list of in flight chunks, ordered by sent_at
+        SeqNum next;
+        SeqNum prev;
+    };
+
     bool set_new_sample();
-    void increment_itr();
-    unsigned int get_itr_val();
+    // forget the current sample without sending the rest of it
+    void drop_sample();
+    void send_chunk(SeqNum seqnum, ArqClock::time_point now);
+    void mark_acked(SeqNum seqnum, ArqClock::time_point now);
+    void set_acked(SeqNum seqnum);
+    void push_in_flight(SeqNum seqnum);
+    void unlink_in_flight(SeqNum seqnum);
 
     std::function<std::shared_ptr<SampleData>()> get_new_sample_;
     std::function<size_t()> get_max_pkt_size_;
-    SampleMetadata sample_metadata_;
+    std::function<unsigned int()> get_window_size_;
+    std::function<std::span<const uint8_t>(const SampleFrameData&,
+                                           std::vector<uint8_t>&)>
+        encode_frame_;
+    std::string_view metric_id_;
+    float timestamp_;
     SampleId sample_id_;
     std::unique_ptr<Chunker> sample_chunker_;
-    std::set<unsigned int> unacked_seqnums_;
     std::string data_type_;
-    std::set<unsigned int>::iterator unacked_seqnums_itr_;
-};
\ No newline at end of file
+
+    FecParams fec_;
+    bool stream_files_;
+    std::vector<ChunkState> chunks_;
+    // acked chunks per erasure coding block
+    std::vector<unsigned int> block_num_acked_;
+    size_t num_unacked_;
+    // lowest unacked seqnum, the start of the window
+    SeqNum window_base_;
+    // lowest seqnum never sent
+    SeqNum next_new_;
+    // oldest and newest sent chunks still in flight
+    SeqNum in_flight_head_;
+    SeqNum in_flight_tail_;
+
+    RttEstimator rtt_;
+    // when the timeout was last backed off
+    std::optional<ArqClock::time_point> last_backoff_;
+    // when the current sample's file was last checked for truncation
+    std::optional<ArqClock::time_point> last_size_check_;
+};
@@ -0,0 +1,57 @@
+#include "token_bucket.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+constexpr uint64_t NS_PER_S = 1000000000;
+
+TokenBucket::TokenBucket(size_t bps, size_t burst_bytes)
+    : bps_(std::max<size_t>(bps, 1)), burst_bytes_(burst_bytes),
+      tolerance_(0), finish_time_(), cost_remainder_(0)
+{
+    update_tolerance();
+}
+
+void TokenBucket::set_bps(size_t bps)
+{
+    bps = std::max<size_t>(bps, 1);
+    if(bps != bps_) {
+        bps_ = bps;
+        cost_remainder_ = 0;
+        update_tolerance();
+    }
+}
+
+size_t TokenBucket::get_bps() const { return bps_; }
+
+void TokenBucket::set_burst(size_t burst_bytes)
+{
+    if(burst_bytes != burst_bytes_) {
+        burst_bytes_ = burst_bytes;
+        update_tolerance();
+    }
+}
+
+size_t TokenBucket::get_burst() const { return burst_bytes_; }
+
+PacerClock::time_point TokenBucket::get_send_time(
+    PacerClock::time_point now) const
+{
+    return std::max(now, finish_time_ - tolerance_);
+}
+
+void TokenBucket::consume(size_t bytes, PacerClock::time_point now)
+{
+    // an idle bucket does not bank more than the burst allowance
+    finish_time_ = std::max(finish_time_, now);
+    uint64_t bit_ns = static_cast<uint64_t>(bytes) * 8 * NS_PER_S +
+                      cost_remainder_;
+    cost_remainder_ = bit_ns % bps_;
+    finish_time_ += std::chrono::nanoseconds(bit_ns / bps_);
+}
+
+void TokenBucket::update_tolerance()
+{
+    tolerance_ = std::chrono::nanoseconds(
+        static_cast<uint64_t>(burst_bytes_) * 8 * NS_PER_S / bps_);
+}
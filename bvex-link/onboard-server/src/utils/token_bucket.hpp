@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+typedef std::chrono::steady_clock PacerClock;
+
+/**
+ * @brief Token bucket that paces sends to a bit rate, with a burst
+ * allowance.
+ *
+ * Kept as a virtual finish time rather than a token count (GCRA): every
+ * byte sent pushes the finish time 8e9 / bps ns further, and a send is
+ * allowed once the finish time is at most the burst allowance ahead of now.
+ * Costs are integer nanoseconds with the division remainder carried to the
+ * next send, so the long run rate is exact for any packet size and bps.
+ */
+class TokenBucket
+{
+  public:
+    TokenBucket(size_t bps, size_t burst_bytes);
+
+    // bps of 0 is treated as 1
+    void set_bps(size_t bps);
+
+    size_t get_bps() const;
+
+    // Bytes that may be sent back to back after the bucket has been idle
+    void set_burst(size_t burst_bytes);
+
+    size_t get_burst() const;
+
+    // Earliest time a send is allowed, now if it is allowed straight away
+    PacerClock::time_point get_send_time(PacerClock::time_point now) const;
+
+    // Take a send of bytes out of the bucket
+    void consume(size_t bytes, PacerClock::time_point now);
+
+  private:
+    // recompute the burst allowance in ns after bps or burst changes
+    void update_tolerance();
+
+    size_t bps_;
+    size_t burst_bytes_;
+    std::chrono::nanoseconds tolerance_;
+    // time at which every byte sent so far has drained at bps_
+    PacerClock::time_point finish_time_;
+    // remainder of the last cost division, in bit nanoseconds
+    uint64_t cost_remainder_;
+};